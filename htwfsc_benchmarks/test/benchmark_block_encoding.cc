@@ -0,0 +1,116 @@
+#include <benchmark/benchmark.h>
+#include <benchmark_catkin/benchmark_entrypoint.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+
+#include "voxblox/core/block.h"
+#include "voxblox/core/voxel.h"
+#include "voxblox/utils/quantized_block_encoding.h"
+
+// Compares the raw block encoding against the quantized TSDF encoding used for
+// sharing maps. The range is the percentage of observed voxels in the block.
+class BlockEncodingBenchmark : public ::benchmark::Fixture {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+ protected:
+  static constexpr double kVoxelSize = 0.05;
+  static constexpr size_t kVoxelsPerSide = 16u;
+  static constexpr float kTruncationDistance = 0.2;
+
+  void SetUp(const ::benchmark::State& state) {
+    const int observed_percentage = state.range(0);
+    block_.reset(new voxblox::Block<voxblox::TsdfVoxel>(
+        kVoxelsPerSide, kVoxelSize, voxblox::Point::Zero()));
+
+    // A sphere surface running through the block.
+    const voxblox::Point center(0.4, 0.4, -0.6);
+    const voxblox::FloatingPoint radius = 1.0;
+    std::srand(0);
+    for (size_t i = 0u; i < block_->num_voxels(); ++i) {
+      if (std::rand() % 100 >= observed_percentage) {
+        continue;
+      }
+      voxblox::TsdfVoxel& voxel = block_->getVoxelByLinearIndex(i);
+      const voxblox::FloatingPoint distance =
+          (block_->computeCoordinatesFromLinearIndex(i) - center).norm() -
+          radius;
+      voxel.distance = std::max(-kTruncationDistance,
+                                std::min(kTruncationDistance, distance));
+      voxel.weight = 1.0 + (std::rand() % 50) * 0.1;
+      voxel.color.r = 100;
+      voxel.color.g = 102;
+      voxel.color.b = 103;
+    }
+    block_->has_data() = true;
+
+    quantization_config_.truncation_distance = kTruncationDistance;
+
+    block_->getProto(&raw_proto_);
+    block_->getQuantizedProto(quantization_config_,
+                              voxblox::utils::CompressionType::kNone,
+                              &quantized_proto_);
+  }
+
+  void TearDown(const ::benchmark::State&) { block_.reset(); }
+
+  std::unique_ptr<voxblox::Block<voxblox::TsdfVoxel>> block_;
+  voxblox::utils::QuantizationConfig quantization_config_;
+  voxblox::BlockProto raw_proto_;
+  voxblox::BlockProto quantized_proto_;
+};
+
+BENCHMARK_DEFINE_F(BlockEncodingBenchmark, EncodeBlock_Baseline)
+(benchmark::State& state) {
+  state.counters["observed_percentage"] = state.range(0);
+  state.counters["bytes_per_block"] = raw_proto_.ByteSizeLong();
+  while (state.KeepRunning()) {
+    voxblox::BlockProto proto;
+    block_->getProto(&proto);
+    benchmark::DoNotOptimize(proto);
+  }
+}
+BENCHMARK_REGISTER_F(BlockEncodingBenchmark, EncodeBlock_Baseline)
+    ->DenseRange(10, 100, 30);
+
+BENCHMARK_DEFINE_F(BlockEncodingBenchmark, EncodeBlock_Other)
+(benchmark::State& state) {
+  state.counters["observed_percentage"] = state.range(0);
+  state.counters["bytes_per_block"] = quantized_proto_.ByteSizeLong();
+  while (state.KeepRunning()) {
+    voxblox::BlockProto proto;
+    block_->getQuantizedProto(quantization_config_,
+                              voxblox::utils::CompressionType::kNone, &proto);
+    benchmark::DoNotOptimize(proto);
+  }
+}
+BENCHMARK_REGISTER_F(BlockEncodingBenchmark, EncodeBlock_Other)
+    ->DenseRange(10, 100, 30);
+
+BENCHMARK_DEFINE_F(BlockEncodingBenchmark, DecodeBlock_Baseline)
+(benchmark::State& state) {
+  state.counters["observed_percentage"] = state.range(0);
+  state.counters["bytes_per_block"] = raw_proto_.ByteSizeLong();
+  while (state.KeepRunning()) {
+    voxblox::Block<voxblox::TsdfVoxel> block(raw_proto_);
+    benchmark::DoNotOptimize(block.getVoxelByLinearIndex(0u));
+  }
+}
+BENCHMARK_REGISTER_F(BlockEncodingBenchmark, DecodeBlock_Baseline)
+    ->DenseRange(10, 100, 30);
+
+BENCHMARK_DEFINE_F(BlockEncodingBenchmark, DecodeBlock_Other)
+(benchmark::State& state) {
+  state.counters["observed_percentage"] = state.range(0);
+  state.counters["bytes_per_block"] = quantized_proto_.ByteSizeLong();
+  while (state.KeepRunning()) {
+    voxblox::Block<voxblox::TsdfVoxel> block(quantized_proto_);
+    benchmark::DoNotOptimize(block.getVoxelByLinearIndex(0u));
+  }
+}
+BENCHMARK_REGISTER_F(BlockEncodingBenchmark, DecodeBlock_Other)
+    ->DenseRange(10, 100, 30);
+
+BENCHMARKING_ENTRY_POINT
@@ -0,0 +1,243 @@
+#include <cmath>
+#include <memory>
+#include <queue>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <benchmark_catkin/benchmark_entrypoint.h>
+
+#include "voxblox/core/layer.h"
+#include "voxblox/integrator/esdf_integrator.h"
+#include "voxblox/integrator/tsdf_integrator.h"
+#include "voxblox/utils/block_neighborhood.h"
+#include "voxblox/utils/bucket_queue.h"
+
+#include "htwfsc_benchmarks/simulation/sphere_simulator.h"
+
+namespace {
+
+// The previous BucketQueue, which keeps every bucket in a std::deque.
+template <typename T>
+class DequeBucketQueue {
+ public:
+  DequeBucketQueue(int num_buckets, double max_val)
+      : num_buckets_(num_buckets),
+        max_val_(max_val),
+        last_bucket_index_(0),
+        num_elements_(0u) {
+    buckets_.resize(num_buckets_);
+  }
+
+  void push(const T& key, double value) {
+    CHECK_NE(num_buckets_, 0);
+    if (value > max_val_) {
+      value = max_val_;
+    }
+    int bucket_index =
+        std::floor(std::abs(value) / max_val_ * (num_buckets_ - 1));
+    if (bucket_index >= num_buckets_) {
+      bucket_index = num_buckets_ - 1;
+    }
+    if (bucket_index < last_bucket_index_) {
+      last_bucket_index_ = bucket_index;
+    }
+    buckets_[bucket_index].push(key);
+    num_elements_++;
+  }
+
+  void pop() {
+    if (empty()) {
+      return;
+    }
+    while (buckets_[last_bucket_index_].empty() &&
+           last_bucket_index_ < num_buckets_) {
+      last_bucket_index_++;
+    }
+    if (last_bucket_index_ < num_buckets_) {
+      buckets_[last_bucket_index_].pop();
+      num_elements_--;
+    }
+  }
+
+  T front() {
+    CHECK_NE(num_buckets_, 0);
+    CHECK(!empty());
+    while (buckets_[last_bucket_index_].empty() &&
+           last_bucket_index_ < num_buckets_) {
+      last_bucket_index_++;
+    }
+    return buckets_[last_bucket_index_].front();
+  }
+
+  bool empty() { return num_elements_ == 0; }
+
+ private:
+  int num_buckets_;
+  double max_val_;
+  std::vector<std::queue<T, std::deque<T, Eigen::aligned_allocator<T>>>>
+      buckets_;
+  int last_bucket_index_;
+  size_t num_elements_;
+};
+
+}  // namespace
+
+class BucketQueueBenchmark : public ::benchmark::Fixture {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+ protected:
+  // A pop of the trace, or a push of a key with a value.
+  struct Operation {
+    bool is_push;
+    voxblox::VoxelKey key;
+    double value;
+  };
+
+  void SetUp(const ::benchmark::State& /*state*/) {
+    voxblox::TsdfIntegrator::Config config;
+    config.max_ray_length_m = 50.0;
+    config.default_truncation_distance = 4 * kVoxelSize;
+    config.use_weight_dropoff = false;
+
+    voxblox::Layer<voxblox::TsdfVoxel> tsdf_layer(kVoxelSize, kVoxelsPerSide);
+    voxblox::TsdfIntegrator integrator(config, &tsdf_layer);
+
+    voxblox::Pointcloud sphere_points_C;
+    htwfsc_benchmarks::sphere_sim::createSphere(kMean, kSigma, kRadius,
+                                                kNumPoints, &sphere_points_C);
+    voxblox::Colors colors(sphere_points_C.size(),
+                           voxblox::Color(128, 253, 5));
+    integrator.integratePointCloud(voxblox::Transformation(), sphere_points_C,
+                                   colors);
+
+    esdf_config_.min_distance_m = config.default_truncation_distance;
+    voxblox::Layer<voxblox::EsdfVoxel> esdf_layer(kVoxelSize, kVoxelsPerSide);
+    voxblox::EsdfIntegrator esdf_integrator(esdf_config_, &tsdf_layer,
+                                            &esdf_layer);
+    esdf_integrator.updateFromTsdfLayerBatch();
+    recordWavefrontTrace(&esdf_layer);
+  }
+
+  void TearDown(const ::benchmark::State& /*state*/) { trace_.clear(); }
+
+  // Records the queue operations of a wavefront that spreads from the fixed
+  // voxels to their neighbors in the order of the final ESDF, like the open
+  // set of a batch update.
+  void recordWavefrontTrace(voxblox::Layer<voxblox::EsdfVoxel>* esdf_layer) {
+    BucketQueue<voxblox::VoxelKey> queue(esdf_config_.num_buckets,
+                                         esdf_config_.max_distance_m);
+    voxblox::BlockIndexList block_indices;
+    esdf_layer->getAllAllocatedBlocks(&block_indices);
+    for (const voxblox::BlockIndex& block_index : block_indices) {
+      voxblox::Block<voxblox::EsdfVoxel>& block =
+          esdf_layer->getBlockByIndex(block_index);
+      for (size_t i = 0u; i < block.num_voxels(); ++i) {
+        voxblox::EsdfVoxel& voxel = block.getVoxelByLinearIndex(i);
+        voxel.in_queue = voxel.fixed;
+        if (voxel.fixed) {
+          const voxblox::VoxelKey key(
+              block_index, block.computeVoxelIndexFromLinearIndex(i));
+          queue.push(key, voxel.distance);
+          trace_.push_back({true, key, voxel.distance});
+        }
+      }
+    }
+
+    voxblox::BlockNeighborhood<voxblox::EsdfVoxel> neighborhood(esdf_layer);
+    voxblox::VoxelKey neighbor_key;
+    while (!queue.empty()) {
+      const voxblox::VoxelKey key = queue.front();
+      queue.pop();
+      trace_.push_back({false, key, 0.0});
+      neighborhood.setBlock(key.first);
+      const voxblox::EsdfVoxel& voxel = neighborhood.setVoxel(key.second);
+      for (size_t n = 0u; n < voxblox::NeighborStencil::kNumNeighbors; ++n) {
+        voxblox::EsdfVoxel* neighbor_voxel =
+            neighborhood.getNeighbor(n, &neighbor_key);
+        if (neighbor_voxel == nullptr || !neighbor_voxel->observed ||
+            neighbor_voxel->in_queue ||
+            std::abs(neighbor_voxel->distance) <= std::abs(voxel.distance) ||
+            std::abs(neighbor_voxel->distance) >=
+                esdf_config_.max_distance_m) {
+          continue;
+        }
+        neighbor_voxel->in_queue = true;
+        queue.push(neighbor_key, neighbor_voxel->distance);
+        trace_.push_back({true, neighbor_key, neighbor_voxel->distance});
+      }
+    }
+  }
+
+  // Replays the trace on a queue and returns the number of operations.
+  template <typename QueueType>
+  size_t replayTrace(QueueType* queue) const {
+    int checksum = 0;
+    for (const Operation& operation : trace_) {
+      if (operation.is_push) {
+        queue->push(operation.key, operation.value);
+      } else {
+        checksum += queue->front().second.x();
+        queue->pop();
+      }
+    }
+    benchmark::DoNotOptimize(checksum);
+    return trace_.size();
+  }
+
+  static constexpr double kVoxelSize = 0.05;
+  static constexpr size_t kVoxelsPerSide = 16u;
+
+  static constexpr double kMean = 0;
+  static constexpr double kSigma = 0.05;
+  static constexpr size_t kNumPoints = 100000u;
+  static constexpr double kRadius = 2.0;
+
+  voxblox::EsdfIntegrator::Config esdf_config_;
+  std::vector<Operation> trace_;
+};
+
+/////////////////////////////////////////////////////
+// BENCHMARK REPLAYING THE QUEUE TRACE OF AN ESDF UPDATE //
+/////////////////////////////////////////////////////
+
+BENCHMARK_DEFINE_F(BucketQueueBenchmark, Replay_Baseline)
+(benchmark::State& state) {
+  size_t num_operations = 0u;
+  while (state.KeepRunning()) {
+    DequeBucketQueue<voxblox::VoxelKey> queue(esdf_config_.num_buckets,
+                                              esdf_config_.max_distance_m);
+    num_operations += replayTrace(&queue);
+  }
+  state.SetItemsProcessed(num_operations);
+}
+BENCHMARK_REGISTER_F(BucketQueueBenchmark, Replay_Baseline)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_DEFINE_F(BucketQueueBenchmark, Replay_Fast)
+(benchmark::State& state) {
+  size_t num_operations = 0u;
+  while (state.KeepRunning()) {
+    BucketQueue<voxblox::VoxelKey> queue(esdf_config_.num_buckets,
+                                         esdf_config_.max_distance_m);
+    num_operations += replayTrace(&queue);
+  }
+  state.SetItemsProcessed(num_operations);
+}
+BENCHMARK_REGISTER_F(BucketQueueBenchmark, Replay_Fast)
+    ->Unit(benchmark::kMillisecond);
+
+// The same queue reused for every update, as the ESDF integrator does.
+BENCHMARK_DEFINE_F(BucketQueueBenchmark, Replay_Other)
+(benchmark::State& state) {
+  BucketQueue<voxblox::VoxelKey> queue(esdf_config_.num_buckets,
+                                       esdf_config_.max_distance_m);
+  size_t num_operations = 0u;
+  while (state.KeepRunning()) {
+    num_operations += replayTrace(&queue);
+  }
+  state.SetItemsProcessed(num_operations);
+}
+BENCHMARK_REGISTER_F(BucketQueueBenchmark, Replay_Other)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARKING_ENTRY_POINT
@@ -0,0 +1,587 @@
+#include <cmath>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <benchmark_catkin/benchmark_entrypoint.h>
+
+#include "voxblox/core/esdf_map.h"
+#include "voxblox/core/tsdf_map.h"
+#include "voxblox/integrator/esdf_integrator.h"
+#include "voxblox/integrator/esdf_occ_integrator.h"
+#include "voxblox/integrator/esdf_window_integrator.h"
+#include "voxblox/integrator/tsdf_integrator.h"
+#include "voxblox/interpolator/interpolator.h"
+#include "voxblox/utils/block_neighborhood.h"
+
+#include "htwfsc_benchmarks/simulation/sphere_simulator.h"
+
+class EsdfBenchmark : public ::benchmark::Fixture {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+ protected:
+  void SetUp(const ::benchmark::State& /*state*/) {
+    voxblox::TsdfIntegrator::Config config;
+    config.max_ray_length_m = 50.0;
+    config.default_truncation_distance = 4 * kVoxelSize;
+    config.use_weight_dropoff = false;
+
+    tsdf_layer_.reset(
+        new voxblox::Layer<voxblox::TsdfVoxel>(kVoxelSize, kVoxelsPerSide));
+    voxblox::TsdfIntegrator integrator(config, tsdf_layer_.get());
+
+    voxblox::Pointcloud sphere_points_C;
+    htwfsc_benchmarks::sphere_sim::createSphere(kMean, kSigma, kRadius,
+                                                kNumPoints, &sphere_points_C);
+    voxblox::Colors colors(sphere_points_C.size(),
+                           voxblox::Color(128, 253, 5));
+    integrator.integratePointCloud(voxblox::Transformation(), sphere_points_C,
+                                   colors);
+
+    esdf_config_.min_distance_m = config.default_truncation_distance;
+    esdf_layer_.reset(
+        new voxblox::Layer<voxblox::EsdfVoxel>(kVoxelSize, kVoxelsPerSide));
+    voxblox::EsdfIntegrator esdf_integrator(esdf_config_, tsdf_layer_.get(),
+                                            esdf_layer_.get());
+    esdf_integrator.updateFromTsdfLayerBatch();
+    esdf_layer_->getAllAllocatedBlocks(&esdf_blocks_);
+  }
+
+  void TearDown(const ::benchmark::State& /*state*/) {
+    tsdf_layer_.reset();
+    esdf_layer_.reset();
+    esdf_blocks_.clear();
+  }
+
+  static constexpr double kVoxelSize = 0.05;
+  static constexpr size_t kVoxelsPerSide = 16u;
+
+  static constexpr double kMean = 0;
+  static constexpr double kSigma = 0.05;
+  static constexpr size_t kNumPoints = 100000u;
+  static constexpr double kRadius = 2.0;
+
+  voxblox::EsdfIntegrator::Config esdf_config_;
+  std::unique_ptr<voxblox::Layer<voxblox::TsdfVoxel>> tsdf_layer_;
+  std::unique_ptr<voxblox::Layer<voxblox::EsdfVoxel>> esdf_layer_;
+  voxblox::BlockIndexList esdf_blocks_;
+};
+
+/////////////////////////////////////////////////////////
+// BENCHMARK VISITING THE 26 NEIGHBORS OF ALL ESDF VOXELS //
+/////////////////////////////////////////////////////////
+
+BENCHMARK_DEFINE_F(EsdfBenchmark, NeighborIteration_Baseline)
+(benchmark::State& state) {
+  voxblox::EsdfIntegrator esdf_integrator(esdf_config_, tsdf_layer_.get(),
+                                          esdf_layer_.get());
+  size_t num_voxels = 0u;
+  while (state.KeepRunning()) {
+    float distance_sum = 0.0f;
+    for (const voxblox::BlockIndex& block_index : esdf_blocks_) {
+      voxblox::Block<voxblox::EsdfVoxel>::Ptr block =
+          esdf_layer_->getBlockPtrByIndex(block_index);
+      for (size_t i = 0u; i < block->num_voxels(); ++i) {
+        const voxblox::VoxelIndex voxel_index =
+            block->computeVoxelIndexFromLinearIndex(i);
+        std::vector<voxblox::VoxelKey> neighbors;
+        std::vector<float> distances;
+        std::vector<Eigen::Vector3i> directions;
+        esdf_integrator.getNeighborsAndDistances(
+            block_index, voxel_index, &neighbors, &distances, &directions);
+        for (size_t n = 0u; n < neighbors.size(); ++n) {
+          voxblox::Block<voxblox::EsdfVoxel>::Ptr neighbor_block;
+          if (neighbors[n].first == block_index) {
+            neighbor_block = block;
+          } else {
+            neighbor_block = esdf_layer_->getBlockPtrByIndex(neighbors[n].first);
+          }
+          if (neighbor_block) {
+            distance_sum +=
+                neighbor_block->getVoxelByVoxelIndex(neighbors[n].second)
+                    .distance;
+          }
+        }
+      }
+      num_voxels += block->num_voxels();
+    }
+    benchmark::DoNotOptimize(distance_sum);
+  }
+  state.SetItemsProcessed(num_voxels);
+}
+BENCHMARK_REGISTER_F(EsdfBenchmark, NeighborIteration_Baseline)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_DEFINE_F(EsdfBenchmark, NeighborIteration_Fast)
+(benchmark::State& state) {
+  size_t num_voxels = 0u;
+  while (state.KeepRunning()) {
+    float distance_sum = 0.0f;
+    voxblox::BlockNeighborhood<voxblox::EsdfVoxel> neighborhood(
+        esdf_layer_.get());
+    voxblox::VoxelKey neighbor_key;
+    for (const voxblox::BlockIndex& block_index : esdf_blocks_) {
+      voxblox::Block<voxblox::EsdfVoxel>* block =
+          neighborhood.setBlock(block_index);
+      for (size_t i = 0u; i < block->num_voxels(); ++i) {
+        neighborhood.setVoxel(block->computeVoxelIndexFromLinearIndex(i));
+        for (size_t n = 0u; n < voxblox::NeighborStencil::kNumNeighbors;
+             ++n) {
+          const voxblox::EsdfVoxel* neighbor_voxel =
+              neighborhood.getNeighbor(n, &neighbor_key);
+          if (neighbor_voxel != nullptr) {
+            distance_sum += neighbor_voxel->distance;
+          }
+        }
+      }
+      num_voxels += block->num_voxels();
+    }
+    benchmark::DoNotOptimize(distance_sum);
+  }
+  state.SetItemsProcessed(num_voxels);
+}
+BENCHMARK_REGISTER_F(EsdfBenchmark, NeighborIteration_Fast)
+    ->Unit(benchmark::kMillisecond);
+
+///////////////////////////////////
+// BENCHMARK FULL ESDF UPDATES //
+///////////////////////////////////
+
+BENCHMARK_DEFINE_F(EsdfBenchmark, BatchUpdate_Fast)
+(benchmark::State& state) {
+  voxblox::EsdfIntegrator esdf_integrator(esdf_config_, tsdf_layer_.get(),
+                                          esdf_layer_.get());
+  state.counters["num_blocks"] = tsdf_layer_->getNumberOfAllocatedBlocks();
+  while (state.KeepRunning()) {
+    esdf_integrator.updateFromTsdfLayerBatch();
+  }
+}
+BENCHMARK_REGISTER_F(EsdfBenchmark, BatchUpdate_Fast)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_DEFINE_F(EsdfBenchmark, BatchUpdate_Other)
+(benchmark::State& state) {
+  esdf_config_.integrator_threads = state.range(0);
+  voxblox::EsdfIntegrator esdf_integrator(esdf_config_, tsdf_layer_.get(),
+                                          esdf_layer_.get());
+  state.counters["num_blocks"] = tsdf_layer_->getNumberOfAllocatedBlocks();
+  while (state.KeepRunning()) {
+    esdf_integrator.updateFromTsdfLayerBatchExact();
+  }
+}
+BENCHMARK_REGISTER_F(EsdfBenchmark, BatchUpdate_Other)
+    ->RangeMultiplier(2)
+    ->Range(1, 16)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+BENCHMARK_DEFINE_F(EsdfBenchmark, IncrementalUpdate_Fast)
+(benchmark::State& state) {
+  voxblox::EsdfIntegrator esdf_integrator(esdf_config_, tsdf_layer_.get(),
+                                          esdf_layer_.get());
+  // Moves the surface voxels of a slice of the blocks in and out again, which
+  // raises and lowers the distances around them.
+  voxblox::BlockIndexList updated_blocks;
+  for (const voxblox::BlockIndex& block_index : esdf_blocks_) {
+    if (block_index.z() == 0) {
+      updated_blocks.push_back(block_index);
+    }
+  }
+  state.counters["num_blocks"] = updated_blocks.size();
+  float offset = 2.0 * kVoxelSize;
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    for (const voxblox::BlockIndex& block_index : updated_blocks) {
+      voxblox::Block<voxblox::TsdfVoxel>& block =
+          tsdf_layer_->getBlockByIndex(block_index);
+      for (size_t i = 0u; i < block.num_voxels(); ++i) {
+        block.getVoxelByLinearIndex(i).distance += offset;
+      }
+    }
+    offset = -offset;
+    state.ResumeTiming();
+    esdf_integrator.updateFromTsdfBlocks(updated_blocks);
+  }
+}
+BENCHMARK_REGISTER_F(EsdfBenchmark, IncrementalUpdate_Fast)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_DEFINE_F(EsdfBenchmark, IncrementalUpdate_Other)
+(benchmark::State& state) {
+  esdf_config_.integrator_threads = state.range(0);
+  esdf_config_.parallel_incremental_update = true;
+  voxblox::EsdfIntegrator esdf_integrator(esdf_config_, tsdf_layer_.get(),
+                                          esdf_layer_.get());
+  voxblox::BlockIndexList updated_blocks;
+  for (const voxblox::BlockIndex& block_index : esdf_blocks_) {
+    if (block_index.z() == 0) {
+      updated_blocks.push_back(block_index);
+    }
+  }
+  state.counters["num_blocks"] = updated_blocks.size();
+  float offset = 2.0 * kVoxelSize;
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    for (const voxblox::BlockIndex& block_index : updated_blocks) {
+      voxblox::Block<voxblox::TsdfVoxel>& block =
+          tsdf_layer_->getBlockByIndex(block_index);
+      for (size_t i = 0u; i < block.num_voxels(); ++i) {
+        block.getVoxelByLinearIndex(i).distance += offset;
+      }
+    }
+    offset = -offset;
+    state.ResumeTiming();
+    esdf_integrator.updateFromTsdfBlocks(updated_blocks);
+  }
+}
+BENCHMARK_REGISTER_F(EsdfBenchmark, IncrementalUpdate_Other)
+    ->RangeMultiplier(2)
+    ->Range(1, 16)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+//////////////////////////////////////////////////////////////
+// BENCHMARK INCREMENTAL UPDATES WITH FULL EUCLIDEAN DISTANCES //
+//////////////////////////////////////////////////////////////
+
+BENCHMARK_DEFINE_F(EsdfBenchmark, FullEuclideanUpdate_Baseline)
+(benchmark::State& state) {
+  esdf_config_.integrator_threads = 1u;
+  voxblox::EsdfIntegrator esdf_integrator(esdf_config_, tsdf_layer_.get(),
+                                          esdf_layer_.get());
+  voxblox::BlockIndexList updated_blocks;
+  for (const voxblox::BlockIndex& block_index : esdf_blocks_) {
+    if (block_index.z() == 0) {
+      updated_blocks.push_back(block_index);
+    }
+  }
+  state.counters["num_blocks"] = updated_blocks.size();
+  float offset = 2.0 * kVoxelSize;
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    for (const voxblox::BlockIndex& block_index : updated_blocks) {
+      voxblox::Block<voxblox::TsdfVoxel>& block =
+          tsdf_layer_->getBlockByIndex(block_index);
+      for (size_t i = 0u; i < block.num_voxels(); ++i) {
+        block.getVoxelByLinearIndex(i).distance += offset;
+      }
+    }
+    offset = -offset;
+    state.ResumeTiming();
+    esdf_integrator.updateFromTsdfBlocks(updated_blocks);
+  }
+}
+BENCHMARK_REGISTER_F(EsdfBenchmark, FullEuclideanUpdate_Baseline)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_DEFINE_F(EsdfBenchmark, FullEuclideanUpdate_Fast)
+(benchmark::State& state) {
+  esdf_config_.integrator_threads = 1u;
+  esdf_config_.full_euclidean_distance = true;
+  voxblox::EsdfIntegrator esdf_integrator(esdf_config_, tsdf_layer_.get(),
+                                          esdf_layer_.get());
+  // The parents of the quasi-Euclidean layer are no offsets to sites.
+  esdf_integrator.updateFromTsdfLayerBatch();
+  voxblox::BlockIndexList updated_blocks;
+  for (const voxblox::BlockIndex& block_index : esdf_blocks_) {
+    if (block_index.z() == 0) {
+      updated_blocks.push_back(block_index);
+    }
+  }
+  state.counters["num_blocks"] = updated_blocks.size();
+  float offset = 2.0 * kVoxelSize;
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    for (const voxblox::BlockIndex& block_index : updated_blocks) {
+      voxblox::Block<voxblox::TsdfVoxel>& block =
+          tsdf_layer_->getBlockByIndex(block_index);
+      for (size_t i = 0u; i < block.num_voxels(); ++i) {
+        block.getVoxelByLinearIndex(i).distance += offset;
+      }
+    }
+    offset = -offset;
+    state.ResumeTiming();
+    esdf_integrator.updateFromTsdfBlocks(updated_blocks);
+  }
+}
+BENCHMARK_REGISTER_F(EsdfBenchmark, FullEuclideanUpdate_Fast)
+    ->Unit(benchmark::kMillisecond);
+
+///////////////////////////////////////////////
+// BENCHMARK DISTANCE QUERIES AROUND THE ROBOT //
+///////////////////////////////////////////////
+
+namespace {
+
+// Robot position next to the surface of the sphere, and query positions
+// around it as a local planner would check them.
+const voxblox::Point kRobotPosition(1.6, 0.3, 0.1);
+constexpr double kWindowRadius = 1.0;
+constexpr size_t kNumQueries = 100000u;
+
+void createQueryPositions(voxblox::Pointcloud* positions) {
+  std::mt19937 generator(0u);
+  std::uniform_real_distribution<float> offset(-0.9 * kWindowRadius,
+                                               0.9 * kWindowRadius);
+  positions->clear();
+  for (size_t i = 0u; i < kNumQueries; ++i) {
+    positions->push_back(kRobotPosition + voxblox::Point(offset(generator),
+                                                         offset(generator),
+                                                         offset(generator)));
+  }
+}
+
+}  // namespace
+
+BENCHMARK_DEFINE_F(EsdfBenchmark, LocalQuery_Baseline)
+(benchmark::State& state) {
+  voxblox::Pointcloud positions;
+  createQueryPositions(&positions);
+  const voxblox::Layer<voxblox::EsdfVoxel>& esdf_layer = *esdf_layer_;
+  while (state.KeepRunning()) {
+    float sum = 0.0f;
+    for (const voxblox::Point& position : positions) {
+      voxblox::Block<voxblox::EsdfVoxel>::ConstPtr block =
+          esdf_layer.getBlockPtrByCoordinates(position);
+      if (block) {
+        const voxblox::EsdfVoxel& voxel =
+            block->getVoxelByCoordinates(position);
+        if (voxel.observed) {
+          sum += voxel.distance;
+        }
+      }
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * positions.size());
+}
+BENCHMARK_REGISTER_F(EsdfBenchmark, LocalQuery_Baseline)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_DEFINE_F(EsdfBenchmark, LocalQuery_Fast)
+(benchmark::State& state) {
+  voxblox::Pointcloud positions;
+  createQueryPositions(&positions);
+  voxblox::EsdfWindowIntegrator::Config window_config;
+  window_config.radius_m = kWindowRadius;
+  window_config.min_distance_m = esdf_config_.min_distance_m;
+  voxblox::EsdfWindowIntegrator window_integrator(window_config,
+                                                  tsdf_layer_.get());
+  window_integrator.updateFromTsdfBlocks(kRobotPosition,
+                                         voxblox::BlockIndexList());
+  while (state.KeepRunning()) {
+    float sum = 0.0f;
+    for (const voxblox::Point& position : positions) {
+      float distance;
+      if (window_integrator.getDistanceAtPosition(position, &distance)) {
+        sum += distance;
+      }
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * positions.size());
+}
+BENCHMARK_REGISTER_F(EsdfBenchmark, LocalQuery_Fast)
+    ->Unit(benchmark::kMillisecond);
+
+// Moves the window back and forth by one voxel along x and recomputes it.
+BENCHMARK_DEFINE_F(EsdfBenchmark, LocalWindowUpdate_Fast)
+(benchmark::State& state) {
+  voxblox::EsdfWindowIntegrator::Config window_config;
+  window_config.radius_m = kWindowRadius;
+  window_config.min_distance_m = esdf_config_.min_distance_m;
+  voxblox::EsdfWindowIntegrator window_integrator(window_config,
+                                                  tsdf_layer_.get());
+  const voxblox::BlockIndexList no_blocks;
+  window_integrator.updateFromTsdfBlocks(kRobotPosition, no_blocks);
+  voxblox::Point position = kRobotPosition;
+  float step = kVoxelSize;
+  while (state.KeepRunning()) {
+    position.x() += step;
+    step = -step;
+    window_integrator.updateFromTsdfBlocks(position, no_blocks);
+  }
+}
+BENCHMARK_REGISTER_F(EsdfBenchmark, LocalWindowUpdate_Fast)
+    ->Unit(benchmark::kMillisecond);
+
+/////////////////////////////////////////////////////////
+// BENCHMARK DISTANCE AND GRADIENT QUERIES OF TRAJECTORIES //
+/////////////////////////////////////////////////////////
+
+namespace {
+
+constexpr size_t kNumTrajectories = 20u;
+constexpr size_t kNumSamplesPerTrajectory = 500u;
+
+// Samples of curved trajectories between random points on both sides of the
+// sphere, as an optimizer would query them in one iteration.
+void createTrajectorySamples(voxblox::Pointcloud* samples) {
+  std::mt19937 generator(0u);
+  std::uniform_real_distribution<float> coordinate(-2.5, 2.5);
+  std::uniform_real_distribution<float> bend(-0.5, 0.5);
+  samples->clear();
+  for (size_t i = 0u; i < kNumTrajectories; ++i) {
+    const voxblox::Point start(-2.5, coordinate(generator),
+                               coordinate(generator));
+    const voxblox::Point goal(2.5, coordinate(generator),
+                              coordinate(generator));
+    const voxblox::Point bend_offset(0.0, bend(generator), bend(generator));
+    for (size_t j = 0u; j < kNumSamplesPerTrajectory; ++j) {
+      const float t = static_cast<float>(j) / (kNumSamplesPerTrajectory - 1);
+      samples->push_back(start + t * (goal - start) +
+                         std::sin(M_PI * t) * bend_offset);
+    }
+  }
+}
+
+}  // namespace
+
+BENCHMARK_DEFINE_F(EsdfBenchmark, TrajectoryQuery_Baseline)
+(benchmark::State& state) {
+  voxblox::Pointcloud samples;
+  createTrajectorySamples(&samples);
+  voxblox::Interpolator<voxblox::EsdfVoxel> interpolator(esdf_layer_.get());
+  std::vector<float> distances(samples.size());
+  voxblox::Pointcloud gradients(samples.size());
+  while (state.KeepRunning()) {
+    for (size_t i = 0u; i < samples.size(); ++i) {
+      interpolator.getAdaptiveDistanceAndGradient(samples[i], &distances[i],
+                                                  &gradients[i]);
+    }
+    benchmark::DoNotOptimize(distances.data());
+  }
+  state.SetItemsProcessed(state.iterations() * samples.size());
+}
+BENCHMARK_REGISTER_F(EsdfBenchmark, TrajectoryQuery_Baseline)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_DEFINE_F(EsdfBenchmark, TrajectoryQuery_Fast)
+(benchmark::State& state) {
+  voxblox::Pointcloud samples;
+  createTrajectorySamples(&samples);
+  voxblox::Interpolator<voxblox::EsdfVoxel> interpolator(esdf_layer_.get());
+  std::vector<float> distances;
+  voxblox::Pointcloud gradients;
+  std::vector<bool> success;
+  while (state.KeepRunning()) {
+    interpolator.getAdaptiveDistancesAndGradients(samples, &distances,
+                                                  &gradients, &success);
+    benchmark::DoNotOptimize(distances.data());
+  }
+  state.SetItemsProcessed(state.iterations() * samples.size());
+}
+BENCHMARK_REGISTER_F(EsdfBenchmark, TrajectoryQuery_Fast)
+    ->Unit(benchmark::kMillisecond);
+
+/////////////////////////////////////////////////////
+// BENCHMARK ESDF UPDATES FROM AN OCCUPANCY LAYER //
+/////////////////////////////////////////////////////
+
+namespace {
+
+// Occupancy of the observed TSDF voxels, occupied within a voxel of the
+// surface.
+void createOccupancyLayer(const voxblox::Layer<voxblox::TsdfVoxel>& tsdf_layer,
+                          voxblox::Layer<voxblox::OccupancyVoxel>* occ_layer) {
+  voxblox::BlockIndexList blocks;
+  tsdf_layer.getAllAllocatedBlocks(&blocks);
+  for (const voxblox::BlockIndex& block_index : blocks) {
+    const voxblox::Block<voxblox::TsdfVoxel>& tsdf_block =
+        tsdf_layer.getBlockByIndex(block_index);
+    voxblox::Block<voxblox::OccupancyVoxel>::Ptr occ_block =
+        occ_layer->allocateBlockPtrByIndex(block_index);
+    for (size_t i = 0u; i < tsdf_block.num_voxels(); ++i) {
+      const voxblox::TsdfVoxel& tsdf_voxel =
+          tsdf_block.getVoxelByLinearIndex(i);
+      voxblox::OccupancyVoxel& occ_voxel = occ_block->getVoxelByLinearIndex(i);
+      occ_voxel.observed = tsdf_voxel.weight > 0.0;
+      occ_voxel.probability_log =
+          (std::abs(tsdf_voxel.distance) < tsdf_layer.voxel_size()) ? 1.0
+                                                                    : -1.0;
+    }
+    occ_block->updated() = true;
+  }
+}
+
+}  // namespace
+
+BENCHMARK_DEFINE_F(EsdfBenchmark, OccupancyBatchUpdate_Baseline)
+(benchmark::State& state) {
+  voxblox::Layer<voxblox::OccupancyVoxel> occ_layer(kVoxelSize,
+                                                    kVoxelsPerSide);
+  createOccupancyLayer(*tsdf_layer_, &occ_layer);
+  voxblox::EsdfOccIntegrator esdf_integrator(
+      voxblox::EsdfOccIntegrator::Config(), &occ_layer, esdf_layer_.get());
+  state.counters["num_blocks"] = occ_layer.getNumberOfAllocatedBlocks();
+  while (state.KeepRunning()) {
+    esdf_integrator.updateFromOccLayerBatch();
+  }
+}
+BENCHMARK_REGISTER_F(EsdfBenchmark, OccupancyBatchUpdate_Baseline)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_DEFINE_F(EsdfBenchmark, OccupancyBatchUpdate_Fast)
+(benchmark::State& state) {
+  voxblox::Layer<voxblox::OccupancyVoxel> occ_layer(kVoxelSize,
+                                                    kVoxelsPerSide);
+  createOccupancyLayer(*tsdf_layer_, &occ_layer);
+  voxblox::EsdfOccIntegrator::Config config;
+  config.integrator_threads = state.range(0);
+  voxblox::EsdfOccIntegrator esdf_integrator(config, &occ_layer,
+                                             esdf_layer_.get());
+  state.counters["num_blocks"] = occ_layer.getNumberOfAllocatedBlocks();
+  while (state.KeepRunning()) {
+    esdf_integrator.updateFromOccLayerBatchExact();
+  }
+}
+BENCHMARK_REGISTER_F(EsdfBenchmark, OccupancyBatchUpdate_Fast)
+    ->RangeMultiplier(2)
+    ->Range(1, 16)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+BENCHMARK_DEFINE_F(EsdfBenchmark, OccupancyIncrementalUpdate_Fast)
+(benchmark::State& state) {
+  voxblox::Layer<voxblox::OccupancyVoxel> occ_layer(kVoxelSize,
+                                                    kVoxelsPerSide);
+  createOccupancyLayer(*tsdf_layer_, &occ_layer);
+  voxblox::EsdfOccIntegrator esdf_integrator(
+      voxblox::EsdfOccIntegrator::Config(), &occ_layer, esdf_layer_.get());
+  esdf_integrator.updateFromOccLayerBatchExact();
+  esdf_integrator.updateFromOccLayer(true);
+  // Frees the occupied voxels of a slice of the blocks and occupies them
+  // again, which raises and lowers the distances around them.
+  voxblox::BlockIndexList updated_blocks;
+  for (const voxblox::BlockIndex& block_index : esdf_blocks_) {
+    if (block_index.z() == 0) {
+      updated_blocks.push_back(block_index);
+    }
+  }
+  state.counters["num_blocks"] = updated_blocks.size();
+  float probability_log = -1.0;
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    for (const voxblox::BlockIndex& block_index : updated_blocks) {
+      voxblox::Block<voxblox::OccupancyVoxel>& occ_block =
+          occ_layer.getBlockByIndex(block_index);
+      const voxblox::Block<voxblox::TsdfVoxel>& tsdf_block =
+          tsdf_layer_->getBlockByIndex(block_index);
+      for (size_t i = 0u; i < occ_block.num_voxels(); ++i) {
+        if (std::abs(tsdf_block.getVoxelByLinearIndex(i).distance) <
+            kVoxelSize) {
+          occ_block.getVoxelByLinearIndex(i).probability_log = probability_log;
+        }
+      }
+      occ_block.updated() = true;
+    }
+    probability_log = -probability_log;
+    state.ResumeTiming();
+    esdf_integrator.updateFromOccLayer(true);
+  }
+}
+BENCHMARK_REGISTER_F(EsdfBenchmark, OccupancyIncrementalUpdate_Fast)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARKING_ENTRY_POINT
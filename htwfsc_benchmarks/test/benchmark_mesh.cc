@@ -0,0 +1,325 @@
+#include <cstdlib>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <benchmark_catkin/benchmark_entrypoint.h>
+
+#include "voxblox/core/tsdf_map.h"
+#include "voxblox/integrator/tsdf_integrator.h"
+#include "voxblox/io/mesh_ply.h"
+#include "voxblox/mesh/mesh_integrator.h"
+#include "voxblox/mesh/mesh_layer.h"
+
+#include "htwfsc_benchmarks/simulation/sphere_simulator.h"
+
+class MeshBenchmark : public ::benchmark::Fixture {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+ protected:
+  void SetUp(const ::benchmark::State& /*state*/) {
+    voxblox::TsdfIntegrator::Config config;
+    config.max_ray_length_m = 50.0;
+    config.use_weight_dropoff = false;
+
+    layer_.reset(
+        new voxblox::Layer<voxblox::TsdfVoxel>(kVoxelSize, kVoxelsPerSide));
+    voxblox::TsdfIntegrator integrator(config, layer_.get());
+
+    voxblox::Pointcloud sphere_points_C;
+    htwfsc_benchmarks::sphere_sim::createSphere(kMean, kSigma, kRadius,
+                                                kNumPoints, &sphere_points_C);
+    voxblox::Colors colors(sphere_points_C.size(),
+                           voxblox::Color(128, 253, 5));
+    integrator.integratePointCloud(voxblox::Transformation(), sphere_points_C,
+                                   colors);
+
+    mesh_layer_.reset(new voxblox::MeshLayer(layer_->block_size()));
+    block_version_ = voxblox::getNextBlockVersion();
+  }
+
+  // Marks num_voxels random observed voxels as updated.
+  void updateRandomVoxels(size_t num_voxels) {
+    if (observed_voxels_.empty()) {
+      voxblox::BlockIndexList block_indices;
+      layer_->getAllAllocatedBlocks(&block_indices);
+      for (const voxblox::BlockIndex& block_index : block_indices) {
+        const voxblox::Block<voxblox::TsdfVoxel>& block =
+            layer_->getBlockByIndex(block_index);
+        for (size_t i = 0u; i < block.num_voxels(); ++i) {
+          if (block.getVoxelByLinearIndex(i).weight > 0.0) {
+            observed_voxels_.emplace_back(
+                block_index, block.computeVoxelIndexFromLinearIndex(i));
+          }
+        }
+      }
+    }
+    for (size_t i = 0u; i < num_voxels; ++i) {
+      const std::pair<voxblox::BlockIndex, voxblox::VoxelIndex>& voxel =
+          observed_voxels_[std::rand() % observed_voxels_.size()];
+      layer_->getBlockByIndex(voxel.first).setUpdated(voxel.second,
+                                                      block_version_);
+    }
+  }
+
+  void TearDown(const ::benchmark::State& /*state*/) {
+    layer_.reset();
+    mesh_layer_.reset();
+    observed_voxels_.clear();
+  }
+
+  static constexpr double kVoxelSize = 0.02;
+  static constexpr size_t kVoxelsPerSide = 16u;
+
+  static constexpr double kMean = 0;
+  static constexpr double kSigma = 0.05;
+  static constexpr size_t kNumPoints = 100000u;
+  static constexpr double kRadius = 2.0;
+
+  std::unique_ptr<voxblox::Layer<voxblox::TsdfVoxel>> layer_;
+  std::unique_ptr<voxblox::MeshLayer> mesh_layer_;
+  std::vector<std::pair<voxblox::BlockIndex, voxblox::VoxelIndex>>
+      observed_voxels_;
+  uint64_t block_version_ = 0u;
+};
+
+////////////////////////////////////////////////////////
+// BENCHMARK WHOLE MAP MESHING WITH CHANGING THREADS //
+////////////////////////////////////////////////////////
+
+BENCHMARK_DEFINE_F(MeshBenchmark, WholeMesh_Baseline)
+(benchmark::State& state) {
+  voxblox::MeshIntegrator::Config mesh_config;
+  mesh_config.integrator_threads = 1u;
+  voxblox::MeshIntegrator mesh_integrator(mesh_config, layer_.get(),
+                                          mesh_layer_.get());
+  state.counters["num_blocks"] = layer_->getNumberOfAllocatedBlocks();
+  state.counters["num_threads"] = 1;
+  while (state.KeepRunning()) {
+    mesh_integrator.generateWholeMesh();
+  }
+}
+BENCHMARK_REGISTER_F(MeshBenchmark, WholeMesh_Baseline)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+BENCHMARK_DEFINE_F(MeshBenchmark, WholeMesh_Other)
+(benchmark::State& state) {
+  voxblox::MeshIntegrator::Config mesh_config;
+  mesh_config.integrator_threads = state.range(0);
+  voxblox::MeshIntegrator mesh_integrator(mesh_config, layer_.get(),
+                                          mesh_layer_.get());
+  state.counters["num_blocks"] = layer_->getNumberOfAllocatedBlocks();
+  state.counters["num_threads"] = state.range(0);
+  while (state.KeepRunning()) {
+    mesh_integrator.generateWholeMesh();
+  }
+}
+BENCHMARK_REGISTER_F(MeshBenchmark, WholeMesh_Other)
+    ->RangeMultiplier(2)
+    ->Range(1, 16)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+////////////////////////////////////////////////////
+// BENCHMARK SINGLE THREADED BLOCK MESH EXTRACTION //
+////////////////////////////////////////////////////
+
+BENCHMARK_DEFINE_F(MeshBenchmark, ExtractBlockMesh_Baseline)
+(benchmark::State& state) {
+  voxblox::MeshIntegrator::Config mesh_config;
+  voxblox::MeshIntegrator mesh_integrator(mesh_config, layer_.get(),
+                                          mesh_layer_.get());
+  voxblox::BlockIndexList block_indices;
+  layer_->getAllAllocatedBlocks(&block_indices);
+  voxblox::Mesh::Ptr mesh(
+      new voxblox::Mesh(layer_->block_size(), voxblox::Point::Zero()));
+  state.counters["num_blocks"] = block_indices.size();
+  while (state.KeepRunning()) {
+    for (const voxblox::BlockIndex& block_index : block_indices) {
+      mesh->clear();
+      mesh_integrator.extractBlockMeshPerCube(
+          layer_->getBlockPtrByIndex(block_index), mesh);
+    }
+  }
+}
+BENCHMARK_REGISTER_F(MeshBenchmark, ExtractBlockMesh_Baseline)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_DEFINE_F(MeshBenchmark, ExtractBlockMesh_Fast)
+(benchmark::State& state) {
+  voxblox::MeshIntegrator::Config mesh_config;
+  voxblox::MeshIntegrator mesh_integrator(mesh_config, layer_.get(),
+                                          mesh_layer_.get());
+  voxblox::BlockIndexList block_indices;
+  layer_->getAllAllocatedBlocks(&block_indices);
+  voxblox::Mesh::Ptr mesh(
+      new voxblox::Mesh(layer_->block_size(), voxblox::Point::Zero()));
+  state.counters["num_blocks"] = block_indices.size();
+  while (state.KeepRunning()) {
+    for (const voxblox::BlockIndex& block_index : block_indices) {
+      mesh->clear();
+      mesh_integrator.extractBlockMesh(layer_->getBlockPtrByIndex(block_index),
+                                       mesh);
+    }
+  }
+}
+BENCHMARK_REGISTER_F(MeshBenchmark, ExtractBlockMesh_Fast)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_DEFINE_F(MeshBenchmark, ExtractBlockMesh_Other)
+(benchmark::State& state) {
+  voxblox::MeshIntegrator::Config mesh_config;
+  mesh_config.use_dual_contouring = true;
+  voxblox::MeshIntegrator mesh_integrator(mesh_config, layer_.get(),
+                                          mesh_layer_.get());
+  voxblox::BlockIndexList block_indices;
+  layer_->getAllAllocatedBlocks(&block_indices);
+  voxblox::Mesh::Ptr mesh(
+      new voxblox::Mesh(layer_->block_size(), voxblox::Point::Zero()));
+  state.counters["num_blocks"] = block_indices.size();
+  while (state.KeepRunning()) {
+    for (const voxblox::BlockIndex& block_index : block_indices) {
+      mesh->clear();
+      mesh_integrator.extractBlockMesh(layer_->getBlockPtrByIndex(block_index),
+                                       mesh);
+    }
+  }
+}
+BENCHMARK_REGISTER_F(MeshBenchmark, ExtractBlockMesh_Other)
+    ->Unit(benchmark::kMillisecond);
+
+/////////////////////////////////////////////////////////
+// BENCHMARK BLOCK MESH EXTRACTION INCLUDING THE NORMALS //
+/////////////////////////////////////////////////////////
+
+BENCHMARK_DEFINE_F(MeshBenchmark, BlockNormals_Baseline)
+(benchmark::State& state) {
+  voxblox::MeshIntegrator::Config mesh_config;
+  mesh_config.compute_normals = false;
+  voxblox::MeshIntegrator mesh_integrator(mesh_config, layer_.get(),
+                                          mesh_layer_.get());
+  voxblox::BlockIndexList block_indices;
+  layer_->getAllAllocatedBlocks(&block_indices);
+  voxblox::Mesh::Ptr mesh(
+      new voxblox::Mesh(layer_->block_size(), voxblox::Point::Zero()));
+  state.counters["num_blocks"] = block_indices.size();
+  while (state.KeepRunning()) {
+    for (const voxblox::BlockIndex& block_index : block_indices) {
+      voxblox::Block<voxblox::TsdfVoxel>::ConstPtr block =
+          layer_->getBlockPtrByIndex(block_index);
+      mesh->clear();
+      mesh_integrator.extractBlockMesh(block, mesh);
+      mesh_integrator.computeMeshNormals(*block, mesh.get());
+    }
+  }
+}
+BENCHMARK_REGISTER_F(MeshBenchmark, BlockNormals_Baseline)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_DEFINE_F(MeshBenchmark, BlockNormals_Fast)
+(benchmark::State& state) {
+  voxblox::MeshIntegrator::Config mesh_config;
+  mesh_config.compute_normals = true;
+  voxblox::MeshIntegrator mesh_integrator(mesh_config, layer_.get(),
+                                          mesh_layer_.get());
+  voxblox::BlockIndexList block_indices;
+  layer_->getAllAllocatedBlocks(&block_indices);
+  voxblox::Mesh::Ptr mesh(
+      new voxblox::Mesh(layer_->block_size(), voxblox::Point::Zero()));
+  state.counters["num_blocks"] = block_indices.size();
+  while (state.KeepRunning()) {
+    for (const voxblox::BlockIndex& block_index : block_indices) {
+      mesh->clear();
+      mesh_integrator.extractBlockMesh(layer_->getBlockPtrByIndex(block_index),
+                                       mesh);
+    }
+  }
+}
+BENCHMARK_REGISTER_F(MeshBenchmark, BlockNormals_Fast)
+    ->Unit(benchmark::kMillisecond);
+
+/////////////////////////////////////////////////////////
+// BENCHMARK MESH UPDATES WITH CHANGING NUMBER OF VOXELS //
+/////////////////////////////////////////////////////////
+
+BENCHMARK_DEFINE_F(MeshBenchmark, UpdateMesh_Baseline)
+(benchmark::State& state) {
+  voxblox::MeshIntegrator::Config mesh_config;
+  mesh_config.integrator_threads = 1u;
+  voxblox::MeshIntegrator mesh_integrator(mesh_config, layer_.get(),
+                                          mesh_layer_.get());
+  constexpr bool kClearUpdatedFlag = true;
+  mesh_integrator.generateMeshForUpdatedBlocks(kClearUpdatedFlag);
+  std::srand(0);
+  state.counters["num_voxels"] = state.range(0);
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    updateRandomVoxels(state.range(0));
+    state.ResumeTiming();
+    mesh_integrator.generateMeshForUpdatedBlocks(kClearUpdatedFlag);
+  }
+}
+BENCHMARK_REGISTER_F(MeshBenchmark, UpdateMesh_Baseline)
+    ->RangeMultiplier(8)
+    ->Range(1, 4096)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_DEFINE_F(MeshBenchmark, UpdateMesh_Other)
+(benchmark::State& state) {
+  voxblox::MeshIntegrator::Config mesh_config;
+  mesh_config.integrator_threads = 1u;
+  mesh_config.use_sub_cell_updates = true;
+  voxblox::MeshIntegrator mesh_integrator(mesh_config, layer_.get(),
+                                          mesh_layer_.get());
+  constexpr bool kClearUpdatedFlag = true;
+  mesh_integrator.generateMeshForUpdatedBlocks(kClearUpdatedFlag);
+  std::srand(0);
+  state.counters["num_voxels"] = state.range(0);
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    updateRandomVoxels(state.range(0));
+    state.ResumeTiming();
+    mesh_integrator.generateMeshForUpdatedBlocks(kClearUpdatedFlag);
+  }
+}
+BENCHMARK_REGISTER_F(MeshBenchmark, UpdateMesh_Other)
+    ->RangeMultiplier(8)
+    ->Range(1, 4096)
+    ->Unit(benchmark::kMillisecond);
+
+//////////////////////////////////////////
+// BENCHMARK PLY EXPORT OF THE WHOLE MESH //
+//////////////////////////////////////////
+
+BENCHMARK_DEFINE_F(MeshBenchmark, ExportPly_Baseline)
+(benchmark::State& state) {
+  voxblox::MeshIntegrator::Config mesh_config;
+  voxblox::MeshIntegrator mesh_integrator(mesh_config, layer_.get(),
+                                          mesh_layer_.get());
+  mesh_integrator.generateWholeMesh();
+  while (state.KeepRunning()) {
+    CHECK(voxblox::outputMeshLayerAsPly("bm_mesh_export.ply", *mesh_layer_,
+                                        voxblox::io::PlyFormat::kAscii));
+  }
+}
+BENCHMARK_REGISTER_F(MeshBenchmark, ExportPly_Baseline)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_DEFINE_F(MeshBenchmark, ExportPly_Fast)
+(benchmark::State& state) {
+  voxblox::MeshIntegrator::Config mesh_config;
+  voxblox::MeshIntegrator mesh_integrator(mesh_config, layer_.get(),
+                                          mesh_layer_.get());
+  mesh_integrator.generateWholeMesh();
+  while (state.KeepRunning()) {
+    CHECK(voxblox::outputMeshLayerAsPly(
+        "bm_mesh_export.ply", *mesh_layer_,
+        voxblox::io::PlyFormat::kBinaryLittleEndian));
+  }
+}
+BENCHMARK_REGISTER_F(MeshBenchmark, ExportPly_Fast)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARKING_ENTRY_POINT
@@ -6,9 +6,19 @@
 
 #include "./Block.pb.h"
 #include "voxblox/core/common.h"
+#include "voxblox/utils/compression_utils.h"
+#include "voxblox/utils/quantized_block_encoding.h"
 
 namespace voxblox {
 
+// Thread-safe source of the block versions, see Block::setUpdated().
+uint64_t getNextBlockVersion();
+
+// Blocks are split into kSubCellsPerSide^3 sub-cells, whose updates are
+// tracked in a 64 bit mask, see Block::dirty_sub_cells().
+constexpr int kSubCellsPerSide = 4;
+constexpr uint64_t kAllSubCells = ~static_cast<uint64_t>(0);
+
 template <typename VoxelType>
 class Block {
  public:
@@ -22,11 +32,15 @@ class Block {
         voxel_size_(voxel_size),
         origin_(origin),
         has_data_(false),
-        updated_(false) {
+        updated_(false),
+        version_(getNextBlockVersion()),
+        dirty_sub_cells_(0u) {
     num_voxels_ = voxels_per_side_ * voxels_per_side_ * voxels_per_side_;
     voxel_size_inv_ = 1.0 / voxel_size_;
     block_size_ = voxels_per_side_ * voxel_size_;
     block_size_inv_ = 1.0 / block_size_;
+    sub_cell_size_ =
+        (voxels_per_side_ + kSubCellsPerSide - 1) / kSubCellsPerSide;
     voxels_.reset(new VoxelType[num_voxels_]);
   }
 
@@ -111,6 +125,15 @@ class Block {
     return voxels_[computeLinearIndexFromCoordinates(coords)];
   }
 
+  // Bit of the sub-cell in the masks of dirty_sub_cells(), x fastest.
+  inline size_t computeSubCellIndexFromVoxelIndex(
+      const VoxelIndex& index) const {
+    DCHECK(isValidVoxelIndex(index));
+    return index.x() / sub_cell_size_ +
+           kSubCellsPerSide * (index.y() / sub_cell_size_ +
+                               kSubCellsPerSide * (index.z() / sub_cell_size_));
+  }
+
   inline bool isValidVoxelIndex(const VoxelIndex& index) const {
     if (index.x() < 0 || index.x() >= voxels_per_side_) {
       return false;
@@ -141,6 +164,7 @@ class Block {
   size_t num_voxels() const { return num_voxels_; }
   Point origin() const { return origin_; }
   FloatingPoint block_size() const { return block_size_; }
+  size_t sub_cell_size() const { return sub_cell_size_; }
 
   bool has_data() const { return has_data_; }
   bool updated() const { return updated_; }
@@ -148,10 +172,49 @@ class Block {
   bool& updated() { return updated_; }
   bool& has_data() { return has_data_; }
 
+  // Marks the block as updated and gives it a new version. Versions
+  // increase monotonically and are never reset, so unlike the updated flag
+  // they can be used by any number of consumers to detect modifications, e.g.
+  // for incremental checkpoints.
+  void setUpdated() {
+    updated_ = true;
+    version_ = getNextBlockVersion();
+    dirty_sub_cells_ = kAllSubCells;
+  }
+  // Same as above, but only marks the sub-cell of the updated voxel as dirty.
+  // The version is passed in, so integrators can draw it once per integration
+  // call instead of once per voxel.
+  void setUpdated(const VoxelIndex& voxel_index, uint64_t version) {
+    updated_ = true;
+    version_ = version;
+    dirty_sub_cells_ |= static_cast<uint64_t>(1)
+                        << computeSubCellIndexFromVoxelIndex(voxel_index);
+  }
+  uint64_t version() const { return version_; }
+
+  // Sub-cells that were modified through setUpdated() since the last call to
+  // clearDirtySubCells(). Blocks that are only flagged through updated() have
+  // no dirty sub-cells, consumers should then treat the whole block as dirty.
+  uint64_t dirty_sub_cells() const { return dirty_sub_cells_; }
+  void clearDirtySubCells() { dirty_sub_cells_ = 0u; }
+
   // Serialization.
   void getProto(BlockProto* proto) const;
+  // Same as above, but stores the voxel data compressed with the given codec.
+  void getProto(utils::CompressionType compression, BlockProto* proto) const;
+  // Lossy but much smaller encoding for sending maps over the network, see
+  // voxblox/utils/quantized_block_encoding.h. Only available for TSDF blocks.
+  void getQuantizedProto(const utils::QuantizationConfig& config,
+                         utils::CompressionType compression,
+                         BlockProto* proto) const;
   void serializeToIntegers(std::vector<uint32_t>* data) const;
   void deserializeFromIntegers(const std::vector<uint32_t>& data);
+  // Same as above, but work directly on a preallocated buffer of
+  // num_voxels() * getNumDataPacketsPerVoxel() words, e.g. the payload of a
+  // message, to avoid intermediate copies.
+  void serializeToIntegers(uint32_t* data) const;
+  void deserializeFromIntegers(const uint32_t* data, size_t num_data_packets);
+  static size_t getNumDataPacketsPerVoxel();
 
   bool mergeBlock(const Block<VoxelType>& other_block);
 
@@ -160,6 +223,8 @@ class Block {
  private:
   void deserializeProto(const BlockProto& proto);
   void serializeProto(BlockProto* proto) const;
+  // Sets everything but the voxel data.
+  void getProtoHeader(BlockProto* proto) const;
 
   // Base parameters.
   const size_t voxels_per_side_;
@@ -171,11 +236,16 @@ class Block {
   FloatingPoint voxel_size_inv_;
   FloatingPoint block_size_;
   FloatingPoint block_size_inv_;
+  size_t sub_cell_size_;
 
   // Is set to true if any one of the voxels in this block received an update.
   bool has_data_;
   // Is set to true when data is updated.
   bool updated_;
+  // Changes every time the block is marked as updated through setUpdated().
+  uint64_t version_;
+  // Bit i is set if a voxel in sub-cell i was updated.
+  uint64_t dirty_sub_cells_;
 
   std::unique_ptr<VoxelType[]> voxels_;
 };
@@ -3,6 +3,7 @@
 
 #include "./Block.pb.h"
 
+#include <algorithm>
 #include <vector>
 
 namespace voxblox {
@@ -13,19 +14,88 @@ Block<VoxelType>::Block(const BlockProto& proto)
             Point(proto.origin_x(), proto.origin_y(), proto.origin_z())) {
   has_data_ = proto.has_data();
 
-  // Convert the data into a vector of integers.
-  std::vector<uint32_t> data;
-  data.reserve(proto.voxel_data_size());
-
-  for (uint32_t word : proto.voxel_data()) {
-    data.push_back(word);
+  const uint32_t* data = proto.voxel_data().data();
+  size_t num_data_packets = proto.voxel_data_size();
+  std::vector<uint32_t> decompressed_data;
+  const utils::CompressionType compression =
+      static_cast<utils::CompressionType>(proto.compression());
+  if (compression != utils::CompressionType::kNone) {
+    CHECK(utils::decompressVoxelData(compression,
+                                     proto.compressed_voxel_data(),
+                                     &decompressed_data))
+        << "Could not decompress the voxel data of block at "
+        << origin_.transpose();
+    data = decompressed_data.data();
+    num_data_packets = decompressed_data.size();
   }
 
-  deserializeFromIntegers(data);
+  const utils::BlockEncoding encoding =
+      static_cast<utils::BlockEncoding>(proto.encoding());
+  if (encoding == utils::BlockEncoding::kQuantizedTsdf) {
+    CHECK(utils::decodeQuantizedBlock(data, num_data_packets, this))
+        << "Could not decode the quantized voxel data of block at "
+        << origin_.transpose();
+  } else {
+    CHECK(encoding == utils::BlockEncoding::kRaw)
+        << "Unknown block encoding: " << proto.encoding();
+    deserializeFromIntegers(data, num_data_packets);
+  }
 }
 
 template <typename VoxelType>
 void Block<VoxelType>::getProto(BlockProto* proto) const {
+  getProto(utils::CompressionType::kNone, proto);
+}
+
+template <typename VoxelType>
+void Block<VoxelType>::getProto(utils::CompressionType compression,
+                                BlockProto* proto) const {
+  CHECK_NOTNULL(proto);
+  getProtoHeader(proto);
+
+  if (compression == utils::CompressionType::kNone) {
+    // Not quite actually a word since we're in a 64-bit age now, but whatever.
+    // Serialize straight into the repeated field to avoid a copy.
+    proto->mutable_voxel_data()->Resize(
+        num_voxels_ * getNumDataPacketsPerVoxel(), 0u);
+    serializeToIntegers(proto->mutable_voxel_data()->mutable_data());
+  } else {
+    std::vector<uint32_t> data;
+    serializeToIntegers(&data);
+    CHECK(utils::compressVoxelData(compression, data,
+                                   getNumDataPacketsPerVoxel(),
+                                   proto->mutable_compressed_voxel_data()));
+    proto->set_compression(static_cast<uint32_t>(compression));
+  }
+}
+
+template <typename VoxelType>
+void Block<VoxelType>::getQuantizedProto(
+    const utils::QuantizationConfig& config,
+    utils::CompressionType compression, BlockProto* proto) const {
+  CHECK_NOTNULL(proto);
+  getProtoHeader(proto);
+
+  std::vector<uint32_t> data;
+  utils::encodeQuantizedBlock(*this, config, &data);
+  proto->set_encoding(
+      static_cast<uint32_t>(utils::BlockEncoding::kQuantizedTsdf));
+  if (compression == utils::CompressionType::kNone) {
+    proto->mutable_voxel_data()->Resize(data.size(), 0u);
+    std::copy(data.begin(), data.end(),
+              proto->mutable_voxel_data()->mutable_data());
+  } else {
+    // The quantized stream has no fixed voxel size, so let the RLE codec
+    // look for runs of single words.
+    constexpr size_t kWordsPerRun = 1u;
+    CHECK(utils::compressVoxelData(compression, data, kWordsPerRun,
+                                   proto->mutable_compressed_voxel_data()));
+    proto->set_compression(static_cast<uint32_t>(compression));
+  }
+}
+
+template <typename VoxelType>
+void Block<VoxelType>::getProtoHeader(BlockProto* proto) const {
   CHECK_NOTNULL(proto);
 
   proto->set_voxels_per_side(voxels_per_side_);
@@ -36,13 +106,19 @@ void Block<VoxelType>::getProto(BlockProto* proto) const {
   proto->set_origin_z(origin_.z());
 
   proto->set_has_data(has_data_);
+}
 
-  std::vector<uint32_t> data;
-  serializeToIntegers(&data);
-  // Not quite actually a word since we're in a 64-bit age now, but whatever.
-  for (uint32_t word : data) {
-    proto->add_voxel_data(word);
-  }
+template <typename VoxelType>
+void Block<VoxelType>::serializeToIntegers(std::vector<uint32_t>* data) const {
+  CHECK_NOTNULL(data);
+  data->resize(num_voxels_ * getNumDataPacketsPerVoxel());
+  serializeToIntegers(data->data());
+}
+
+template <typename VoxelType>
+void Block<VoxelType>::deserializeFromIntegers(
+    const std::vector<uint32_t>& data) {
+  deserializeFromIntegers(data.data(), data.size());
 }
 
 template <typename VoxelType>
@@ -63,9 +139,12 @@ size_t Block<VoxelType>::getMemorySize() const {
   size += sizeof(num_voxels_);
   size += sizeof(voxel_size_inv_);
   size += sizeof(block_size_);
+  size += sizeof(sub_cell_size_);
 
   size += sizeof(has_data_);
   size += sizeof(updated_);
+  size += sizeof(version_);
+  size += sizeof(dirty_sub_cells_);
 
   if (num_voxels_ > 0u) {
     size += (num_voxels_ * sizeof(voxels_[0]));
@@ -27,6 +27,9 @@ typedef AnyIndex BlockIndex;
 
 typedef std::pair<BlockIndex, VoxelIndex> VoxelKey;
 
+template <typename Type>
+using AlignedVector = std::vector<Type, Eigen::aligned_allocator<Type>>;
+
 typedef std::vector<AnyIndex, Eigen::aligned_allocator<AnyIndex> > IndexVector;
 typedef IndexVector BlockIndexList;
 typedef IndexVector VoxelIndexList;
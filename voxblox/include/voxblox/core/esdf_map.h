@@ -4,6 +4,7 @@
 #include <glog/logging.h>
 #include <memory>
 #include <utility>
+#include <vector>
 
 #include "voxblox/core/common.h"
 #include "voxblox/core/layer.h"
@@ -45,6 +46,13 @@ class EsdfMap {
                                         double* distance,
                                         Eigen::Vector3d* gradient) const;
 
+  // Batched getDistanceAndGradientAtPosition() for the columns of positions,
+  // e.g. the samples of a trajectory. observed(i) is 1 if column i has a
+  // result, otherwise its distance and gradient are zero.
+  void batchGetDistanceAndGradientAtPosition(
+      const Eigen::Matrix3Xd& positions, Eigen::VectorXd* distances,
+      Eigen::Matrix3Xd* gradients, Eigen::VectorXi* observed) const;
+
   bool isObserved(const Eigen::Vector3d& position) const;
 
  protected:
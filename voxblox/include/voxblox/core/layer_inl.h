@@ -145,6 +145,13 @@ bool Layer<VoxelType>::addBlockFromProto(const BlockProto& block_proto,
       << "The voxel type of this layer is not serializable!";
 
   if (isCompatible(block_proto)) {
+    if (block_proto.removed()) {
+      // Removal marker of an incremental checkpoint, see layer_checkpoint.h.
+      const Point origin(block_proto.origin_x(), block_proto.origin_y(),
+                         block_proto.origin_z());
+      removeBlock(getGridIndexFromOriginPoint(origin, block_size_inv_));
+      return true;
+    }
     typename BlockType::Ptr block_ptr(new BlockType(block_proto));
     const BlockIndex block_index =
         getGridIndexFromOriginPoint(block_ptr->origin(), block_size_inv_);
@@ -174,7 +181,7 @@ bool Layer<VoxelType>::addBlockFromProto(const BlockProto& block_proto,
         return false;
     }
     // Mark that this block has been updated.
-    block_map_[block_index]->updated() = true;
+    block_map_[block_index]->setUpdated();
   } else {
     LOG(ERROR)
         << "The blocks from this protobuf are not compatible with this layer!";
@@ -0,0 +1,158 @@
+#ifndef VOXBLOX_CORE_RING_BUFFER_GRID_H_
+#define VOXBLOX_CORE_RING_BUFFER_GRID_H_
+
+#include <glog/logging.h>
+#include <Eigen/Core>
+#include <utility>
+#include <vector>
+
+#include "voxblox/core/common.h"
+
+namespace voxblox {
+
+// Dense cubic window of the global voxel grid with a fixed side length.
+// Every voxel is stored at its global index modulo the side length, so when
+// the window moves only the slices that leave it are reset and reused for
+// the ones that enter it, all others stay where they are. The memory never
+// changes after construction.
+template <typename VoxelType>
+class RingBufferGrid {
+ public:
+  // Half-open box [first, second) of global voxel indices.
+  typedef std::pair<AnyIndex, AnyIndex> IndexBox;
+  typedef std::vector<IndexBox, Eigen::aligned_allocator<IndexBox> >
+      IndexBoxList;
+
+  explicit RingBufferGrid(int voxels_per_side)
+      : voxels_per_side_(voxels_per_side), origin_(AnyIndex::Zero()) {
+    CHECK_GT(voxels_per_side_, 0);
+    voxels_.resize(static_cast<size_t>(voxels_per_side_) * voxels_per_side_ *
+                   voxels_per_side_);
+  }
+
+  int voxels_per_side() const { return voxels_per_side_; }
+  size_t num_voxels() const { return voxels_.size(); }
+
+  // Global index of the lowest corner of the window.
+  const AnyIndex& origin() const { return origin_; }
+
+  inline bool isInside(const AnyIndex& global_voxel_index) const {
+    return ((global_voxel_index - origin_).array() >= 0).all() &&
+           ((global_voxel_index - origin_).array() < voxels_per_side_).all();
+  }
+
+  // The index must be inside the window.
+  inline VoxelType& getVoxelByGlobalIndex(const AnyIndex& global_voxel_index) {
+    DCHECK(isInside(global_voxel_index));
+    return voxels_[computeStorageIndex(global_voxel_index)];
+  }
+  inline const VoxelType& getVoxelByGlobalIndex(
+      const AnyIndex& global_voxel_index) const {
+    DCHECK(isInside(global_voxel_index));
+    return voxels_[computeStorageIndex(global_voxel_index)];
+  }
+
+  // Returns nullptr outside of the window.
+  inline VoxelType* getVoxelPtrByGlobalIndex(
+      const AnyIndex& global_voxel_index) {
+    if (!isInside(global_voxel_index)) {
+      return nullptr;
+    }
+    return &voxels_[computeStorageIndex(global_voxel_index)];
+  }
+  inline const VoxelType* getVoxelPtrByGlobalIndex(
+      const AnyIndex& global_voxel_index) const {
+    if (!isInside(global_voxel_index)) {
+      return nullptr;
+    }
+    return &voxels_[computeStorageIndex(global_voxel_index)];
+  }
+
+  // Moves the lowest corner of the window to origin. The voxels that enter
+  // the window are reset to VoxelType(), and the disjoint boxes they make up
+  // are appended to entered_boxes if it is not nullptr.
+  void moveOrigin(const AnyIndex& origin, IndexBoxList* entered_boxes) {
+    const AnyIndex shift = origin - origin_;
+    if (shift.isZero()) {
+      return;
+    }
+    if ((shift.array().abs() >= voxels_per_side_).any()) {
+      origin_ = origin;
+      reset();
+      if (entered_boxes != nullptr) {
+        entered_boxes->emplace_back(
+            origin_, origin_ + AnyIndex::Constant(voxels_per_side_));
+      }
+      return;
+    }
+
+    // The box of axis a spans the entered slices along a, the new window
+    // along the axes after a and only the kept part of the window along the
+    // axes before a, which the earlier boxes already cover.
+    const AnyIndex old_origin = origin_;
+    origin_ = origin;
+    AnyIndex kept_min = origin_;
+    AnyIndex kept_max = origin_ + AnyIndex::Constant(voxels_per_side_);
+    for (int axis = 0; axis < 3; ++axis) {
+      if (shift(axis) == 0) {
+        continue;
+      }
+      IndexBox box(kept_min, kept_max);
+      if (shift(axis) > 0) {
+        box.first(axis) = old_origin(axis) + voxels_per_side_;
+        kept_max(axis) = box.first(axis);
+      } else {
+        box.second(axis) = old_origin(axis);
+        kept_min(axis) = box.second(axis);
+      }
+      resetBox(box);
+      if (entered_boxes != nullptr) {
+        entered_boxes->push_back(box);
+      }
+    }
+  }
+
+  // Resets all voxels to VoxelType().
+  void reset() {
+    for (VoxelType& voxel : voxels_) {
+      voxel = VoxelType();
+    }
+  }
+
+ private:
+  inline size_t computeStorageIndex(const AnyIndex& global_voxel_index) const {
+    return wrap(global_voxel_index.x()) +
+           voxels_per_side_ *
+               (wrap(global_voxel_index.y()) +
+                static_cast<size_t>(voxels_per_side_) *
+                    wrap(global_voxel_index.z()));
+  }
+
+  inline size_t wrap(IndexElement index) const {
+    const IndexElement wrapped = index % voxels_per_side_;
+    return wrapped < 0 ? wrapped + voxels_per_side_ : wrapped;
+  }
+
+  void resetBox(const IndexBox& box) {
+    AnyIndex global_voxel_index;
+    for (global_voxel_index.z() = box.first.z();
+         global_voxel_index.z() < box.second.z(); ++global_voxel_index.z()) {
+      for (global_voxel_index.y() = box.first.y();
+           global_voxel_index.y() < box.second.y(); ++global_voxel_index.y()) {
+        for (global_voxel_index.x() = box.first.x();
+             global_voxel_index.x() < box.second.x();
+             ++global_voxel_index.x()) {
+          voxels_[computeStorageIndex(global_voxel_index)] = VoxelType();
+        }
+      }
+    }
+  }
+
+  const int voxels_per_side_;
+  AnyIndex origin_;
+  std::vector<VoxelType, Eigen::aligned_allocator<VoxelType> > voxels_;
+};
+
+}  // namespace voxblox
+
+#endif  // VOXBLOX_CORE_RING_BUFFER_GRID_H_
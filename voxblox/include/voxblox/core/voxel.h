@@ -14,18 +14,45 @@ struct TsdfVoxel {
   Color color;
 };
 
+// Offset from an ESDF voxel to its parent, in voxels.
+typedef Eigen::Matrix<int8_t, 3, 1> ParentOffset;
+constexpr int kMaxParentOffset = 127;
+
+// Packed into 8 bytes, so the wavefronts of the ESDF integrators touch as few
+// cache lines as possible. The flags are bit fields and the parent offset is
+// stored with one byte per axis.
 struct EsdfVoxel {
-  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  EsdfVoxel()
+      : distance(0.0f),
+        observed(false),
+        in_queue(false),
+        fixed(false),
+        parent(ParentOffset::Zero()) {}
 
-  float distance = 0.0f;
-  bool observed = false;
-  bool in_queue = false;
-  bool fixed = false;
+  float distance;
+  bool observed : 1;
+  bool in_queue : 1;
+  bool fixed : 1;
   // Relative direction toward parent. If itself, then either uninitialized
-  // or in the fixed frontier.
-  Eigen::Vector3i parent = Eigen::Vector3i::Zero();
+  // or in the fixed frontier. Offsets beyond kMaxParentOffset voxels cannot
+  // be stored, see setParentOffset().
+  ParentOffset parent;
 };
 
+static_assert(sizeof(EsdfVoxel) == 8u, "EsdfVoxel is not packed.");
+
+// Sets the parent offset of an ESDF voxel. Returns false and leaves the voxel
+// without parent if the offset is out of the range of the packed
+// representation, a clamped offset would point to the wrong voxel.
+inline bool setParentOffset(const Eigen::Vector3i& offset, EsdfVoxel* voxel) {
+  if (offset.cwiseAbs().maxCoeff() > kMaxParentOffset) {
+    voxel->parent.setZero();
+    return false;
+  }
+  voxel->parent = offset.cast<int8_t>();
+  return true;
+}
+
 struct OccupancyVoxel {
   float probability_log = 0.0f;
   bool observed = false;
@@ -4,14 +4,21 @@
 #include <glog/logging.h>
 #include <Eigen/Core>
 #include <algorithm>
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <memory>
 #include <queue>
+#include <thread>
 #include <utility>
 #include <vector>
 
 #include "voxblox/core/layer.h"
 #include "voxblox/core/voxel.h"
 #include "voxblox/integrator/integrator_utils.h"
+#include "voxblox/utils/block_neighborhood.h"
 #include "voxblox/utils/bucket_queue.h"
+#include "voxblox/utils/distance_transform.h"
 #include "voxblox/utils/timing.h"
 
 namespace voxblox {
@@ -41,6 +48,24 @@ class EsdfIntegrator {
     // the radiuses used around each robot position.
     FloatingPoint clear_sphere_radius = 1.5;
     FloatingPoint occupied_sphere_radius = 5.0;
+
+    // Number of threads of the exact batch update, and of the incremental
+    // updates if parallel_incremental_update is set.
+    size_t integrator_threads = std::thread::hardware_concurrency();
+    // Makes the incremental updates process separate parts of the map on
+    // separate threads, see updateFromTsdfBlocksParallel(). Only pays off if
+    // the updated blocks are spread out, so this is opt-in.
+    bool parallel_incremental_update = false;
+    // Side length in blocks of the tiles of the exact batch update. Every
+    // tile is transformed on a dense grid that is padded by the blocks within
+    // max_distance_m + min_distance_m, at about 20 bytes per voxel.
+    int exact_tile_size_blocks = 8;
+    // Makes the incremental updates propagate the offset to the nearest fixed
+    // voxel instead of the direction to the parent, which gives Euclidean
+    // instead of quasi-Euclidean distances. The offsets are limited to
+    // kMaxParentOffset voxels per axis, so max_distance_m may be at most
+    // kMaxParentOffset voxels. Always runs on one thread.
+    bool full_euclidean_distance = false;
   };
 
   EsdfIntegrator(const Config& config, Layer<TsdfVoxel>* tsdf_layer,
@@ -62,11 +87,33 @@ class EsdfIntegrator {
   void updateFromTsdfBlocks(const BlockIndexList& tsdf_blocks);
   void updateFromTsdfBlocks(const BlockIndexList& tsdf_blocks,
                             bool push_neighbors);
+  // Same as the serial incremental update, on config_.integrator_threads
+  // threads. Used by updateFromTsdfBlocks() if
+  // config_.parallel_incremental_update is set. The updated blocks, and the
+  // voxels that are already queued, are grouped into regions that are too far
+  // apart for their wavefronts to meet. Every region is processed as a whole
+  // by one thread, in the same order as by the serial update, so the result
+  // is exactly the serial one. Should a wavefront leave its region anyway,
+  // all regions are undone and false is returned, as it is if there are not
+  // at least two regions. The serial update then runs instead.
+  bool updateFromTsdfBlocksParallel(const BlockIndexList& tsdf_blocks,
+                                    bool push_neighbors);
 
   // Specialty update functions for testing/evaluations. Should not be used
   // otherwise.
   void updateFromTsdfLayerBatchOccupancy();
   void updateFromTsdfLayerBatchFullEuclidean();
+  // Batch update with exact Euclidean distances to the nearest fixed voxel,
+  // computed by a separable distance transform over dense grids of
+  // config_.exact_tile_size_blocks blocks per side, each padded by the blocks
+  // whose fixed voxels can still be closer than the maximum distance. Unlike
+  // the wavefront updates, the distances are straight lines that also pass
+  // through unobserved voxels. The parents are the full offsets to the
+  // nearest fixed voxel, as in the full Euclidean update, so only incremental
+  // updates with config_.full_euclidean_distance can continue from the
+  // result. Voxels whose offset exceeds kMaxParentOffset get the default
+  // distance instead.
+  void updateFromTsdfLayerBatchExact();
   void updateFromTsdfBlocksFullEuclidean(const BlockIndexList& tsdf_blocks);
   void updateFromTsdfBlocksAsOccupancy(const BlockIndexList& tsdf_blocks);
 
@@ -83,16 +130,27 @@ class EsdfIntegrator {
   // set is empty.
   void processOpenSet();
 
-  // Process the open set as above, but using full Euclidean distance.
-  // Much slower so not recommended.
+  // Same as above for config_.full_euclidean_distance, in the style of
+  // FIESTA (Han et al., IROS 2019): the parent of every voxel is the offset to
+  // its site, the fixed voxel it is closest to, and the neighbors of a voxel
+  // get their distances straight from its site. A voxel is raised if its
+  // distance does not follow from its site anymore.
+  void processRaiseSetFullEuclidean();
   void processOpenSetFullEuclidean();
 
   // Pushes neighbors of newly allocated voxels to the open set, to make sure
   // that they get a valid value. Only necessary in incremental.
   void pushNeighborsToOpen(const BlockIndex& block_index,
                            const VoxelIndex& voxel_index);
+  // Same as above for a voxel of the block the neighborhood is set to, which
+  // saves the block lookups for consecutive voxels of the same block, and the
+  // given open set.
+  void pushNeighborsToOpen(const VoxelIndex& voxel_index,
+                           BlockNeighborhood<EsdfVoxel>* neighborhood,
+                           BucketQueue<VoxelKey>* open);
 
-  // Uses 26-connectivity and quasi-Euclidean distances.
+  // Uses 26-connectivity and quasi-Euclidean distances, in the order of
+  // NeighborStencil. The update loops use a BlockNeighborhood instead.
   // Directions is the direction that the neighbor voxel lives in. If you
   // need the direction FROM the neighbor voxel TO the current voxel, take
   // negative of the given direction.
@@ -116,11 +174,106 @@ class EsdfIntegrator {
     return dist_m < 0.0;
   }
 
+  // Updates neighbor n of a voxel with the given distance, which is fixed or
+  // not, if the path through the voxel is shorter or if the voxel is on the
+  // other side of the surface. Returns true if the neighbor has to be
+  // propagated further.
+  bool lowerNeighbor(FloatingPoint distance, bool fixed, size_t n,
+                     EsdfVoxel* neighbor_voxel) const;
+
+  // Distance of a voxel on the positive or negative side of the surface from
+  // a site with the given distance at the given offset.
+  inline FloatingPoint computeFullEuclideanDistance(
+      FloatingPoint site_distance, const Eigen::Vector3i& offset,
+      bool positive) const {
+    const FloatingPoint offset_distance =
+        offset.cast<FloatingPoint>().norm() * esdf_voxel_size_;
+    return positive ? site_distance + offset_distance
+                    : site_distance - offset_distance;
+  }
+  // Returns the site of the voxel at key if its distance still follows from
+  // it, nullptr otherwise. Moves the neighborhood to the voxel.
+  const EsdfVoxel* getValidSite(
+      const VoxelKey& key, const EsdfVoxel& voxel,
+      BlockNeighborhood<EsdfVoxel>* neighborhood) const;
+
  protected:
+  // Writes the ESDF of the blocks in [begin, end) from the grid.
+  void writeExactDistances(const BlockIndexList& block_indices, size_t begin,
+                           size_t end, const DenseDistanceGrid& grid);
+
+  // State of one thread of the parallel incremental update.
+  struct RegionWorker {
+    BucketQueue<VoxelKey> open;
+    std::queue<VoxelKey> raise;
+    // Region that is processed, and its blocks whose neighbors were checked
+    // to be in the region.
+    size_t region_index;
+    IndexSet entered_blocks;
+    // The voxels of every ESDF block in the regions of this worker before the
+    // update, to undo it.
+    BlockHashMapType<std::vector<EsdfVoxel>>::type original_blocks;
+  };
+  // Updated TSDF blocks and queued voxels of one region, in their order of
+  // the serial update. The open set voxels keep their buckets.
+  struct Region {
+    BlockIndexList blocks;
+    std::vector<std::pair<VoxelKey, int>> open;
+    std::vector<VoxelKey> raise;
+  };
+
+  // Copies the voxels of a TSDF block into the allocated ESDF block and
+  // queues the ones that changed, adding up their numbers in the counters.
+  void propagateTsdfBlock(const BlockIndex& block_index, bool push_neighbors,
+                          std::queue<VoxelKey>* raise,
+                          BucketQueue<VoxelKey>* open, size_t* num_lower,
+                          size_t* num_raise, size_t* num_new);
+  // processRaiseSet() and processOpenSet() on the given queues. With a
+  // worker, the neighbors of a voxel are only visited once enterRegionBlock()
+  // accepted its block, otherwise false is returned right away.
+  bool processRaiseSet(std::queue<VoxelKey>* raise,
+                       BucketQueue<VoxelKey>* open, RegionWorker* worker);
+  bool processOpenSet(BucketQueue<VoxelKey>* open, RegionWorker* worker);
+
+  // Groups the blocks into regions, which are the blocks around them within
+  // the reach of the wavefronts of an update, merged where they overlap.
+  // Fills region_indices_ and returns the number of regions.
+  size_t computeRegions(const BlockIndexList& block_indices);
+  // Runs the serial update of the regions that next_region hands out, until
+  // they run out or one of them left its region, which sets left_region.
+  void updateRegions(const std::vector<Region>& regions, bool push_neighbors,
+                     std::atomic<size_t>* next_region,
+                     std::atomic<bool>* left_region, RegionWorker* worker);
+  // Runs the serial update of one region, which is the worker's
+  // region_index. Returns false if it left the region.
+  bool updateRegion(const Region& region, bool push_neighbors,
+                    RegionWorker* worker);
+  // Returns true if all allocated neighbor blocks of the block, including
+  // itself, are in the worker's region, and saves them for undoing the
+  // update.
+  bool enterRegionBlock(const BlockIndex& block_index,
+                        RegionWorker* worker) const;
+
   // Convenience functions for planning.
-  typedef BlockHashMapType<VoxelIndexList>::type BlockVoxelListMap;
-  void getSphereAroundPoint(const Point& center, FloatingPoint radius,
-                            BlockVoxelListMap* block_voxel_list) const;
+  // Voxels within a radius of a voxel, as the half length along x of the row
+  // at every y and z offset, or -1 for rows outside of the radius.
+  struct SphereStencil {
+    int radius_voxels = 0;
+    std::vector<int> half_lengths;
+
+    inline int getHalfLength(int y, int z) const {
+      const int size = 2 * radius_voxels + 1;
+      return half_lengths[(y + radius_voxels) + size * (z + radius_voxels)];
+    }
+  };
+  void computeSphereStencil(FloatingPoint radius,
+                            SphereStencil* stencil) const;
+  // Sets the unobserved voxels of the stencil around the voxel with the given
+  // global index to observed with the given distance, allocating the blocks
+  // on the way. Visits the rows of the stencil block by block.
+  void setUnknownVoxelsInSphere(const AnyIndex& center_voxel_index,
+                                const SphereStencil& stencil,
+                                FloatingPoint distance);
 
   Config config_;
 
@@ -140,6 +293,15 @@ class EsdfIntegrator {
   FloatingPoint esdf_voxel_size_;
 
   IndexSet updated_blocks_;
+
+  // Computed once for the radiuses of addNewRobotPosition().
+  SphereStencil clear_sphere_stencil_;
+  SphereStencil occupied_sphere_stencil_;
+
+  // Region of every block in reach of the parallel incremental update.
+  BlockHashMapType<size_t>::type region_indices_;
+  // Kept between updates to reuse the memory of the queues.
+  std::vector<std::unique_ptr<RegionWorker>> region_workers_;
 };
 
 }  // namespace voxblox
@@ -5,12 +5,15 @@
 #include <Eigen/Core>
 #include <glog/logging.h>
 #include <queue>
+#include <thread>
 #include <utility>
 #include <vector>
 
 #include "voxblox/core/layer.h"
 #include "voxblox/core/voxel.h"
 #include "voxblox/integrator/integrator_utils.h"
+#include "voxblox/utils/block_neighborhood.h"
+#include "voxblox/utils/distance_transform.h"
 #include "voxblox/utils/timing.h"
 #include "voxblox/utils/bucket_queue.h"
 
@@ -26,20 +29,52 @@ class EsdfOccIntegrator {
     FloatingPoint default_distance_m = 2.0;
     // Number of buckets for the bucketed priority queue.
     int num_buckets = 20;
+    // Number of threads of the exact batch update.
+    size_t integrator_threads = std::thread::hardware_concurrency();
+    // Side length in blocks of the tiles of the exact batch update. Every
+    // tile is transformed on a dense grid that is padded by the blocks within
+    // max_distance_m, at about 20 bytes per voxel.
+    int exact_tile_size_blocks = 8;
   };
 
   EsdfOccIntegrator(const Config& config, Layer<OccupancyVoxel>* occ_layer,
                     Layer<EsdfVoxel>* esdf_layer);
 
   // Fixed is overloaded as occupied in this case.
-  // Only batch operations are currently supported for the occupancy map.
+  // Quasi-Euclidean batch update from all occupancy blocks, on one thread.
   void updateFromOccLayerBatch();
   void updateFromOccBlocks(const BlockIndexList& occ_blocks,
                            bool push_neighbors);
 
+  // Batch update with exact Euclidean distances to the nearest occupied voxel,
+  // computed by a separable distance transform on config_.integrator_threads
+  // threads over dense grids of config_.exact_tile_size_blocks blocks per
+  // side, each padded by the blocks within the maximum distance. The parents
+  // are the offsets to the nearest occupied voxel, so the incremental updates
+  // below can continue from the result.
+  void updateFromOccLayerBatchExact();
+
+  // Incremental update from the occupancy blocks that OccupancyIntegrator
+  // marked as updated, optionally clearing their updated flags. Like
+  // EsdfIntegrator with full_euclidean_distance, every voxel keeps the offset
+  // to its nearest occupied voxel as parent, which is up to kMaxParentOffset
+  // voxels per axis, so max_distance_m may be at most kMaxParentOffset
+  // voxels. The occupied voxels that turned free raise the voxels that were
+  // closest to them. Continues from
+  // updateFromOccLayerBatchExact() or from an empty ESDF layer.
+  void updateFromOccLayer(bool clear_updated_flag);
+  void updateFromOccBlocksIncremental(const BlockIndexList& occ_blocks);
+
   void processOpenSet();
 
-  // Uses 26-connectivity and quasi-Euclidean distances.
+  // Same as above for the incremental updates. The raise set resets all
+  // voxels whose nearest occupied voxel turned free, the open set passes the
+  // nearest occupied voxel of every voxel on to its neighbors.
+  void processRaiseSetIncremental();
+  void processOpenSetIncremental();
+
+  // Uses 26-connectivity and quasi-Euclidean distances, in the order of
+  // NeighborStencil. The update loops use a BlockNeighborhood instead.
   // Directions is the direction that the neighbor voxel lives in. If you
   // need the direction FROM the neighbor voxel TO the current voxel, take
   // negative of the given direction.
@@ -53,7 +88,26 @@ class EsdfOccIntegrator {
                    BlockIndex* neighbor_block_index,
                    VoxelIndex* neighbor_voxel_index) const;
 
+  inline bool isOccupied(const OccupancyVoxel& occ_voxel) const {
+    return occ_voxel.probability_log > 0.0;
+  }
+
  protected:
+  // Writes the ESDF of the blocks in [begin, end) from the grid.
+  void writeExactDistances(const BlockIndexList& block_indices, size_t begin,
+                           size_t end, const DenseDistanceGrid& grid);
+
+  // Pushes the observed neighbors of the voxel, which the neighborhood is
+  // moved to, to the open set.
+  void pushNeighborsToOpen(const VoxelIndex& voxel_index,
+                           BlockNeighborhood<EsdfVoxel>* neighborhood);
+
+  // Returns true if the parent of the voxel at key, which is not fixed,
+  // still points to an occupied voxel at the voxel's distance. Moves the
+  // neighborhood to the voxel.
+  bool hasValidSite(const VoxelKey& key, const EsdfVoxel& voxel,
+                    BlockNeighborhood<EsdfVoxel>* neighborhood) const;
+
   Config config_;
 
   Layer<OccupancyVoxel>* occ_layer_;
@@ -0,0 +1,114 @@
+#ifndef VOXBLOX_INTEGRATOR_ESDF_WINDOW_INTEGRATOR_H_
+#define VOXBLOX_INTEGRATOR_ESDF_WINDOW_INTEGRATOR_H_
+
+#include <glog/logging.h>
+#include <Eigen/Core>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "voxblox/core/layer.h"
+#include "voxblox/core/ring_buffer_grid.h"
+#include "voxblox/core/voxel.h"
+#include "voxblox/utils/distance_transform.h"
+#include "voxblox/utils/timing.h"
+
+namespace voxblox {
+
+// ESDF of a local window around the robot, for planners that only look at
+// their surroundings. The window is a dense RingBufferGrid that is filled
+// from the TSDF layer, so only the voxels that enter the window when it moves
+// and the voxels of updated TSDF blocks are copied. The distances are exact
+// Euclidean distances to the nearest fixed voxel inside the window, as in
+// EsdfIntegrator::updateFromTsdfLayerBatchExact(), and are recomputed for the
+// whole window after every change. Only recomputing around the changed
+// voxels would still need a margin of max_distance_m on both sides of them,
+// which covers most of the window for typical radii. Queries are plain array
+// accesses and the memory is fixed by the radius.
+class EsdfWindowIntegrator {
+ public:
+  struct Config {
+    // The window is the cube of voxels around the voxel of the robot that
+    // contains the sphere of this radius.
+    FloatingPoint radius_m = 3.0;
+    // Same meaning as in EsdfIntegrator::Config.
+    FloatingPoint max_distance_m = 2.0;
+    FloatingPoint min_distance_m = 0.2;
+    FloatingPoint default_distance_m = 2.0;
+    float min_weight = 1e-6;
+  };
+
+  EsdfWindowIntegrator(const Config& config, Layer<TsdfVoxel>* tsdf_layer);
+
+  // Centers the window on the voxel of position, copies the TSDF into the
+  // voxels that entered the window and into the parts of tsdf_blocks that
+  // overlap it, and recomputes the distances of the window if any of its
+  // voxels changed.
+  void updateFromTsdfBlocks(const Point& position,
+                            const BlockIndexList& tsdf_blocks);
+  // Same as above with all updated blocks of the TSDF layer. Does not clear
+  // their updated flags.
+  void updateFromTsdfLayer(const Point& position);
+
+  // Return false outside of the window and in unobserved voxels. The gradient
+  // is a central difference of the neighboring voxels, or a one-sided one if
+  // a neighbor is unobserved or outside.
+  bool getDistanceAtPosition(const Point& position,
+                             FloatingPoint* distance) const;
+  bool getDistanceAndGradientAtPosition(const Point& position,
+                                        FloatingPoint* distance,
+                                        Point* gradient) const;
+
+  // Returns nullptr outside of the window.
+  inline const EsdfVoxel* getVoxelPtrByGlobalIndex(
+      const AnyIndex& global_voxel_index) const {
+    const WindowVoxel* voxel =
+        window_.getVoxelPtrByGlobalIndex(global_voxel_index);
+    return voxel == nullptr ? nullptr : &voxel->esdf;
+  }
+
+  // Global index of the lowest corner of the window.
+  const AnyIndex& getWindowOrigin() const { return window_.origin(); }
+  int getWindowVoxelsPerSide() const { return window_.voxels_per_side(); }
+  FloatingPoint voxel_size() const { return voxel_size_; }
+
+ protected:
+  // The TSDF distance is kept next to the ESDF voxel, as the distances of
+  // the voxels that are not fixed only keep the side of the surface.
+  struct WindowVoxel {
+    EsdfVoxel esdf;
+    float tsdf_distance = 0.0f;
+  };
+  typedef RingBufferGrid<WindowVoxel> WindowGrid;
+
+  // Copies the TSDF voxels of the box, which must lie inside the window.
+  void copyTsdfBox(const WindowGrid::IndexBox& box);
+  // Runs the distance transform over the whole window.
+  void updateDistances();
+
+  inline bool isFixed(FloatingPoint dist_m) const {
+    return std::abs(dist_m) <= config_.min_distance_m;
+  }
+
+  Config config_;
+
+  Layer<TsdfVoxel>* tsdf_layer_;
+  FloatingPoint voxel_size_;
+  FloatingPoint voxel_size_inv_;
+  int voxels_per_block_;
+  int radius_voxels_;
+
+  WindowGrid window_;
+  bool window_initialized_;
+  bool distances_outdated_;
+
+  // Squared distances in voxels and minimizers of the distance transform of
+  // the window, kept to reuse their memory.
+  std::vector<float> squared_distances_;
+  std::vector<int> nearest_[3];
+};
+
+}  // namespace voxblox
+
+#endif  // VOXBLOX_INTEGRATOR_ESDF_WINDOW_INTEGRATOR_H_
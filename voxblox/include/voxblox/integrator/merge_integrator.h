@@ -36,7 +36,7 @@ class MergeIntegrator {
       return;
     } else {
       block_B->has_data() = true;
-      block_B->updated() = true;
+      block_B->setUpdated();
 
       for (IndexElement voxel_idx = 0; voxel_idx < block_B->num_voxels();
            ++voxel_idx) {
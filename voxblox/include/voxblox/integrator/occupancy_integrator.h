@@ -140,7 +140,7 @@ class OccupancyIntegrator {
 
       if (!block || block_idx != last_block_idx) {
         block = layer_->allocateBlockPtrByIndex(block_idx);
-        block->updated() = true;
+        block->setUpdated();
         last_block_idx = block_idx;
       }
 
@@ -158,7 +158,7 @@ class OccupancyIntegrator {
 
       if (!block || block_idx != last_block_idx) {
         block = layer_->allocateBlockPtrByIndex(block_idx);
-        block->updated() = true;
+        block->setUpdated();
         last_block_idx = block_idx;
       }
 
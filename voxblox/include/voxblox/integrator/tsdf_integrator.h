@@ -171,6 +171,7 @@ class TsdfIntegrator {
     timing::Timer integrate_timer("integrate");
 
     const Point& origin = T_G_C.getPosition();
+    const uint64_t block_version = getNextBlockVersion();
 
     for (size_t pt_idx = 0; pt_idx < points_C.size(); ++pt_idx) {
       const Point& point_C = points_C[pt_idx];
@@ -225,9 +226,9 @@ class TsdfIntegrator {
 
         if (!block || block_idx != last_block_idx) {
           block = layer_->allocateBlockPtrByIndex(block_idx);
-          block->updated() = true;
           last_block_idx = block_idx;
         }
+        block->setUpdated(local_voxel_idx, block_version);
 
         const Point voxel_center_G =
             block->computeCoordinatesFromVoxelIndex(local_voxel_idx);
@@ -306,6 +307,7 @@ class TsdfIntegrator {
     timing::Timer integrate_timer("integrate");
 
     const Point& origin = T_G_C.getPosition();
+    const uint64_t block_version = getNextBlockVersion();
 
     for (size_t pt_idx = 0; pt_idx < points_C.size(); ++pt_idx) {
       const Point& point_C = points_C[pt_idx];
@@ -360,9 +362,9 @@ class TsdfIntegrator {
 
         if (!block || block_idx != last_block_idx) {
           block = layer_->allocateBlockPtrByIndex(block_idx);
-          block->updated() = true;
           last_block_idx = block_idx;
         }
+        block->setUpdated(local_voxel_idx, block_version);
 
         const Point voxel_center_G =
             block->computeCoordinatesFromVoxelIndex(local_voxel_idx);
@@ -407,15 +409,16 @@ class TsdfIntegrator {
               << " clear rays.";
   }
 
-  void updateVoxel(const VoxelInfo& voxel_info, const Point& origin) {
+  void updateVoxel(const VoxelInfo& voxel_info, const Point& origin,
+                   uint64_t block_version) {
     static BlockIndex last_block_idx = BlockIndex::Zero();
     static Block<TsdfVoxel>::Ptr block;
 
     if (!block || voxel_info.block_idx != last_block_idx) {
       block = layer_->allocateBlockPtrByIndex(voxel_info.block_idx);
-      block->updated() = true;
       last_block_idx = voxel_info.block_idx;
     }
+    block->setUpdated(voxel_info.local_voxel_idx, block_version);
 
     const Point voxel_center_G =
         block->computeCoordinatesFromVoxelIndex(voxel_info.local_voxel_idx);
@@ -542,7 +545,8 @@ class TsdfIntegrator {
       const Transformation& T_G_C, const Pointcloud& points_C,
       const Colors& colors, bool discard, bool clearing_ray,
       const BlockHashMapType<std::vector<size_t>>::type& voxel_map,
-      const BlockHashMapType<std::vector<size_t>>::type& clear_map) {
+      const BlockHashMapType<std::vector<size_t>>::type& clear_map,
+      uint64_t block_version) {
     std::vector<std::queue<VoxelInfo>> voxel_update_queues(
         config_.integrator_threads);
 
@@ -567,7 +571,7 @@ class TsdfIntegrator {
     }
     for (std::queue<VoxelInfo>& voxel_update_queue : voxel_update_queues) {
       while (!voxel_update_queue.empty()) {
-        updateVoxel(voxel_update_queue.front(), origin);
+        updateVoxel(voxel_update_queue.front(), origin, block_version);
         voxel_update_queue.pop();
       }
     }
@@ -588,12 +592,14 @@ class TsdfIntegrator {
 
     bundleRays(T_G_C, points_C, &voxel_map, &clear_map);
 
+    const uint64_t block_version = getNextBlockVersion();
     integrateRays(T_G_C, points_C, colors, discard, false, voxel_map,
-                  clear_map);
+                  clear_map, block_version);
 
     timing::Timer clear_timer("integrate/clear");
 
-    integrateRays(T_G_C, points_C, colors, discard, true, voxel_map, clear_map);
+    integrateRays(T_G_C, points_C, colors, discard, true, voxel_map, clear_map,
+                  block_version);
 
     clear_timer.Stop();
 
@@ -1,7 +1,10 @@
 #ifndef VOXBLOX_INTERPOLATOR_INTERPOLATOR_H_
 #define VOXBLOX_INTERPOLATOR_INTERPOLATOR_H_
 
+#include <algorithm>
+#include <array>
 #include <memory>
+#include <vector>
 
 #include "voxblox/core/common.h"
 #include "voxblox/core/layer.h"
@@ -32,13 +35,72 @@ class Interpolator {
   bool getAdaptiveDistanceAndGradient(const Point& pos, FloatingPoint* distance,
                                       Point* grad) const;
 
+  // Batched getAdaptiveDistanceAndGradient() for many points, e.g. the
+  // samples of a trajectory. Gives the same results, but the points are
+  // processed in the order of their blocks, so the queries in one block share
+  // the block lookups. success[i] tells whether point i has a result.
+  void getAdaptiveDistancesAndGradients(const Pointcloud& positions,
+                                        std::vector<FloatingPoint>* distances,
+                                        Pointcloud* gradients,
+                                        std::vector<bool>* success) const;
+
   // Without interpolation.
   bool getNearestDistanceAndWeight(const Point& pos, FloatingPoint* distance,
                                    float* weight) const;
 
  private:
+  typedef typename Layer<VoxelType>::BlockType BlockType;
+
+  // Pointers to the 3x3x3 blocks around a center block, looked up in the
+  // layer on first use. Blocks further away are looked up every time. The
+  // queries of a point only touch the blocks next to it, so the hash lookups
+  // of one query or of a batch of queries in one block are done once.
+  class BlockCache {
+   public:
+    BlockCache(const Layer<VoxelType>* layer, const BlockIndex& center)
+        : layer_(layer) {
+      setCenter(center);
+    }
+
+    void setCenter(const BlockIndex& center) {
+      center_ = center;
+      looked_up_.fill(false);
+    }
+
+    const BlockType* getBlockPtrByIndex(const BlockIndex& block_index) {
+      const BlockIndex offset = block_index - center_ + BlockIndex::Ones();
+      if ((offset.array() < 0).any() || (offset.array() > 2).any()) {
+        return layer_->getBlockPtrByIndex(block_index).get();
+      }
+      const int i = offset.x() + 3 * (offset.y() + 3 * offset.z());
+      if (!looked_up_[i]) {
+        blocks_[i] = layer_->getBlockPtrByIndex(block_index).get();
+        looked_up_[i] = true;
+      }
+      return blocks_[i];
+    }
+
+    const BlockType* getBlockPtrByCoordinates(const Point& pos) {
+      return getBlockPtrByIndex(layer_->computeBlockIndexFromCoordinates(pos));
+    }
+
+   private:
+    const Layer<VoxelType>* layer_;
+    BlockIndex center_;
+    std::array<const BlockType*, 27> blocks_;
+    std::array<bool, 27> looked_up_;
+  };
+
+  // Same as the public functions, with the blocks from the cache.
+  bool getDistance(const Point& pos, FloatingPoint* distance, bool interpolate,
+                   BlockCache* cache) const;
+  bool getGradient(const Point& pos, Point* grad, bool interpolate,
+                   BlockCache* cache) const;
+  bool getAdaptiveDistanceAndGradient(const Point& pos, FloatingPoint* distance,
+                                      Point* grad, BlockCache* cache) const;
+
   bool setIndexes(const Point& pos, BlockIndex* block_index,
-                  InterpIndexes* voxel_indexes) const;
+                  InterpIndexes* voxel_indexes, BlockCache* cache) const;
 
   // Q vector from http://spie.org/samples/PM159.pdf
   // Relates the interpolation distance of any arbitrary point inside a voxel
@@ -48,19 +110,23 @@ class Interpolator {
 
   bool getVoxelsAndQVector(const BlockIndex& block_index,
                            const InterpIndexes& voxel_indexes, const Point& pos,
-                           const VoxelType** voxels,
-                           InterpVector* q_vector) const;
+                           const VoxelType** voxels, InterpVector* q_vector,
+                           BlockCache* cache) const;
 
   bool getVoxelsAndQVector(const Point& pos, const VoxelType** voxels,
-                           InterpVector* q_vector) const;
+                           InterpVector* q_vector, BlockCache* cache) const;
 
-  bool getInterpDistance(const Point& pos, FloatingPoint* distance) const;
+  bool getInterpDistance(const Point& pos, FloatingPoint* distance,
+                         BlockCache* cache) const;
 
-  bool getNearestDistance(const Point& pos, FloatingPoint* distance) const;
+  bool getNearestDistance(const Point& pos, FloatingPoint* distance,
+                          BlockCache* cache) const;
 
-  bool getInterpVoxel(const Point& pos, VoxelType* voxel) const;
+  bool getInterpVoxel(const Point& pos, VoxelType* voxel,
+                      BlockCache* cache) const;
 
-  bool getNearestVoxel(const Point& pos, VoxelType* voxel) const;
+  bool getNearestVoxel(const Point& pos, VoxelType* voxel,
+                       BlockCache* cache) const;
 
   // Allow this class to be templated on all kinds of voxels.
   static FloatingPoint getVoxelDistance(const VoxelType& voxel);
@@ -13,30 +13,47 @@ template <typename VoxelType>
 bool Interpolator<VoxelType>::getDistance(const Point& pos,
                                           FloatingPoint* distance,
                                           bool interpolate) const {
+  BlockCache cache(layer_, layer_->computeBlockIndexFromCoordinates(pos));
+  return getDistance(pos, distance, interpolate, &cache);
+}
+
+template <typename VoxelType>
+bool Interpolator<VoxelType>::getDistance(const Point& pos,
+                                          FloatingPoint* distance,
+                                          bool interpolate,
+                                          BlockCache* cache) const {
   if (interpolate) {
-    return getInterpDistance(pos, distance);
+    return getInterpDistance(pos, distance, cache);
   } else {
-    return getNearestDistance(pos, distance);
+    return getNearestDistance(pos, distance, cache);
   }
 }
 
 template <typename VoxelType>
 bool Interpolator<VoxelType>::getVoxel(const Point& pos, VoxelType* voxel,
                                        bool interpolate) const {
+  BlockCache cache(layer_, layer_->computeBlockIndexFromCoordinates(pos));
   if (interpolate) {
-    return getInterpVoxel(pos, voxel);
+    return getInterpVoxel(pos, voxel, &cache);
   } else {
-    return getNearestVoxel(pos, voxel);
+    return getNearestVoxel(pos, voxel, &cache);
   }
 }
 
 template <typename VoxelType>
 bool Interpolator<VoxelType>::getGradient(const Point& pos, Point* grad,
                                           const bool interpolate) const {
+  BlockCache cache(layer_, layer_->computeBlockIndexFromCoordinates(pos));
+  return getGradient(pos, grad, interpolate, &cache);
+}
+
+template <typename VoxelType>
+bool Interpolator<VoxelType>::getGradient(const Point& pos, Point* grad,
+                                          const bool interpolate,
+                                          BlockCache* cache) const {
   CHECK_NOTNULL(grad);
 
-  typename Layer<VoxelType>::BlockType::ConstPtr block_ptr =
-      layer_->getBlockPtrByCoordinates(pos);
+  const BlockType* block_ptr = cache->getBlockPtrByCoordinates(pos);
   if (block_ptr == nullptr) {
     return false;
   }
@@ -49,7 +66,7 @@ bool Interpolator<VoxelType>::getGradient(const Point& pos, Point* grad,
       Point offset = Point::Zero();
       offset(i) = sign * block_ptr->voxel_size();
       FloatingPoint offset_distance;
-      if (!getDistance(pos + offset, &offset_distance, interpolate)) {
+      if (!getDistance(pos + offset, &offset_distance, interpolate, cache)) {
         return false;
       }
       (*grad)(i) += offset_distance * static_cast<FloatingPoint>(sign);
@@ -65,27 +82,85 @@ bool Interpolator<VoxelType>::getGradient(const Point& pos, Point* grad,
 template <typename VoxelType>
 bool Interpolator<VoxelType>::getAdaptiveDistanceAndGradient(
     const Point& pos, FloatingPoint* distance, Point* grad) const {
-  // TODO(helenol): try to see how to minimize number of lookups for the
-  // gradient and interpolation calculations...
+  BlockCache cache(layer_, layer_->computeBlockIndexFromCoordinates(pos));
+  return getAdaptiveDistanceAndGradient(pos, distance, grad, &cache);
+}
+
+template <typename VoxelType>
+void Interpolator<VoxelType>::getAdaptiveDistancesAndGradients(
+    const Pointcloud& positions, std::vector<FloatingPoint>* distances,
+    Pointcloud* gradients, std::vector<bool>* success) const {
+  CHECK_NOTNULL(distances);
+  CHECK_NOTNULL(gradients);
+  CHECK_NOTNULL(success);
+  const size_t num_points = positions.size();
+  distances->assign(num_points, 0.0f);
+  gradients->assign(num_points, Point::Zero());
+  success->assign(num_points, false);
+  if (num_points == 0u) {
+    return;
+  }
+
+  // Bins the points by block. The order within a block is kept, so the
+  // results do not depend on it.
+  BlockIndexList block_indices(num_points);
+  std::vector<size_t> order(num_points);
+  for (size_t i = 0u; i < num_points; ++i) {
+    block_indices[i] = layer_->computeBlockIndexFromCoordinates(positions[i]);
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [&block_indices](size_t lhs, size_t rhs) {
+                     const BlockIndex& a = block_indices[lhs];
+                     const BlockIndex& b = block_indices[rhs];
+                     if (a.z() != b.z()) {
+                       return a.z() < b.z();
+                     }
+                     if (a.y() != b.y()) {
+                       return a.y() < b.y();
+                     }
+                     return a.x() < b.x();
+                   });
+
+  BlockCache cache(layer_, block_indices[order.front()]);
+  for (size_t k = 0u; k < num_points; ++k) {
+    const size_t i = order[k];
+    if (k > 0u && block_indices[i] != block_indices[order[k - 1]]) {
+      cache.setCenter(block_indices[i]);
+    }
+    FloatingPoint distance = 0.0f;
+    Point gradient = Point::Zero();
+    if (getAdaptiveDistanceAndGradient(positions[i], &distance, &gradient,
+                                       &cache)) {
+      (*distances)[i] = distance;
+      (*gradients)[i] = gradient;
+      (*success)[i] = true;
+    }
+  }
+}
 
+template <typename VoxelType>
+bool Interpolator<VoxelType>::getAdaptiveDistanceAndGradient(
+    const Point& pos, FloatingPoint* distance, Point* grad,
+    BlockCache* cache) const {
   // Get the nearest neighbor distance first, we need this for the gradient
   // calculations anyway.
   FloatingPoint nearest_neighbor_distance = 0.0f;
   bool interpolate = false;
-  if (!getDistance(pos, &nearest_neighbor_distance, interpolate)) {
+  if (!getDistance(pos, &nearest_neighbor_distance, interpolate, cache)) {
     // Then there is no data here at all.
     return false;
   }
 
   // Then try to get the interpolated distance.
   interpolate = true;
-  bool has_interpolated_distance = getDistance(pos, distance, interpolate);
+  bool has_interpolated_distance =
+      getDistance(pos, distance, interpolate, cache);
 
   // Now try to estimate the gradient. Same general procedure as getGradient()
   // above, but also allow finite difference methods other than central
   // difference (left difference, right difference).
-  typename Layer<VoxelType>::BlockType::ConstPtr block_ptr =
-      layer_->getBlockPtrByCoordinates(pos);
+  const BlockType* block_ptr = cache->getBlockPtrByCoordinates(pos);
   if (block_ptr == nullptr) {
     return false;
   }
@@ -95,7 +170,8 @@ bool Interpolator<VoxelType>::getAdaptiveDistanceAndGradient(
   // Try to get the full gradient if possible.
   bool has_interpolated_gradient = false;
   if (has_interpolated_distance) {
-    has_interpolated_gradient = getGradient(pos, &gradient, interpolate);
+    has_interpolated_gradient =
+        getGradient(pos, &gradient, interpolate, cache);
   }
 
   if (!has_interpolated_gradient) {
@@ -106,9 +182,10 @@ bool Interpolator<VoxelType>::getAdaptiveDistanceAndGradient(
       Point offset = Point::Zero();
       offset(i) = block_ptr->voxel_size();
       FloatingPoint left_distance = 0.0f, right_distance = 0.0f;
-      bool left_valid = getDistance(pos - offset, &left_distance, interpolate);
+      bool left_valid =
+          getDistance(pos - offset, &left_distance, interpolate, cache);
       bool right_valid =
-          getDistance(pos + offset, &right_distance, interpolate);
+          getDistance(pos + offset, &right_distance, interpolate, cache);
 
       if (left_valid && right_valid) {
         gradient(i) =
@@ -143,11 +220,11 @@ bool Interpolator<VoxelType>::getAdaptiveDistanceAndGradient(
 template <typename VoxelType>
 bool Interpolator<VoxelType>::setIndexes(const Point& pos,
                                          BlockIndex* block_index,
-                                         InterpIndexes* voxel_indexes) const {
+                                         InterpIndexes* voxel_indexes,
+                                         BlockCache* cache) const {
   // get voxel index
   *block_index = layer_->computeBlockIndexFromCoordinates(pos);
-  typename Layer<VoxelType>::BlockType::ConstPtr block_ptr =
-      layer_->getBlockPtrByIndex(*block_index);
+  const BlockType* block_ptr = cache->getBlockPtrByIndex(*block_index);
   if (block_ptr == nullptr) {
     return false;
   }
@@ -183,33 +260,35 @@ void Interpolator<VoxelType>::getQVector(const Point& voxel_pos,
                                          InterpVector* q_vector) const {
   CHECK_NOTNULL(q_vector);
 
-  Point voxel_offset = pos - voxel_pos;
+  const Point voxel_offset = pos - voxel_pos;
 
   CHECK((voxel_offset.array() >= 0).all());  // NOLINT
 
-  *q_vector << 1,                                           // NOLINT
-      voxel_offset[0],                                      // NOLINT
-      voxel_offset[1],                                      // NOLINT
-      voxel_offset[2],                                      // NOLINT
-      voxel_offset[0] * voxel_offset[1],                    // NOLINT
-      voxel_offset[1] * voxel_offset[2],                    // NOLINT
-      voxel_offset[2] * voxel_offset[0],                    // NOLINT
-      voxel_offset[0] * voxel_offset[1] * voxel_offset[2];  // NOLINT
+  // The products of the offsets, formed as the elementwise product of the
+  // offset with itself rotated by one.
+  const Point pair_products =
+      voxel_offset.cwiseProduct(Point(voxel_offset.y(), voxel_offset.z(),
+                                      voxel_offset.x()));
+  (*q_vector)[0] = 1.0f;
+  q_vector->template segment<3>(1) = voxel_offset.transpose();
+  q_vector->template segment<3>(4) = pair_products.transpose();
+  (*q_vector)[7] = pair_products.x() * voxel_offset.z();
 }
 
 template <typename VoxelType>
 bool Interpolator<VoxelType>::getVoxelsAndQVector(
     const BlockIndex& block_index, const InterpIndexes& voxel_indexes,
-    const Point& pos, const VoxelType** voxels, InterpVector* q_vector) const {
+    const Point& pos, const VoxelType** voxels, InterpVector* q_vector,
+    BlockCache* cache) const {
   CHECK_NOTNULL(q_vector);
 
+  const BlockType* corner_block_ptr = cache->getBlockPtrByIndex(block_index);
+  if (corner_block_ptr == nullptr) {
+    return false;
+  }
   // for each voxel index
   for (size_t i = 0; i < voxel_indexes.cols(); ++i) {
-    typename Layer<VoxelType>::BlockType::ConstPtr block_ptr =
-        layer_->getBlockPtrByIndex(block_index);
-    if (block_ptr == nullptr) {
-      return false;
-    }
+    const BlockType* block_ptr = corner_block_ptr;
 
     VoxelIndex voxel_index = voxel_indexes.col(i);
     // if voxel index is too large get neighboring block and update index
@@ -221,7 +300,7 @@ bool Interpolator<VoxelType>::getVoxelsAndQVector(
           voxel_index(j) -= block_ptr->voxels_per_side();
         }
       }
-      block_ptr = layer_->getBlockPtrByIndex(new_block_index);
+      block_ptr = cache->getBlockPtrByIndex(new_block_index);
       if (block_ptr == nullptr) {
         return false;
       }
@@ -244,27 +323,30 @@ bool Interpolator<VoxelType>::getVoxelsAndQVector(
 
 template <typename VoxelType>
 bool Interpolator<VoxelType>::getVoxelsAndQVector(
-    const Point& pos, const VoxelType** voxels, InterpVector* q_vector) const {
+    const Point& pos, const VoxelType** voxels, InterpVector* q_vector,
+    BlockCache* cache) const {
   // get block and voxels indexes (some voxels may have negative indexes)
   BlockIndex block_index;
   InterpIndexes voxel_indexes;
-  if (!setIndexes(pos, &block_index, &voxel_indexes)) {
+  if (!setIndexes(pos, &block_index, &voxel_indexes, cache)) {
     return false;
   }
 
   // get distances of 8 surrounding voxels and weights vector
-  return getVoxelsAndQVector(block_index, voxel_indexes, pos, voxels, q_vector);
+  return getVoxelsAndQVector(block_index, voxel_indexes, pos, voxels, q_vector,
+                             cache);
 }
 
 template <typename VoxelType>
 bool Interpolator<VoxelType>::getInterpDistance(const Point& pos,
-                                                FloatingPoint* distance) const {
+                                                FloatingPoint* distance,
+                                                BlockCache* cache) const {
   CHECK_NOTNULL(distance);
 
   // get distances of 8 surrounding voxels and weights vector
   const VoxelType* voxels[9];
   InterpVector q_vector;
-  if (!getVoxelsAndQVector(pos, voxels, &q_vector)) {
+  if (!getVoxelsAndQVector(pos, voxels, &q_vector, cache)) {
     return false;
   } else {
     *distance = interpMember(q_vector, voxels, &getVoxelDistance);
@@ -273,12 +355,12 @@ bool Interpolator<VoxelType>::getInterpDistance(const Point& pos,
 }
 
 template <typename VoxelType>
-bool Interpolator<VoxelType>::getNearestDistance(
-    const Point& pos, FloatingPoint* distance) const {
+bool Interpolator<VoxelType>::getNearestDistance(const Point& pos,
+                                                 FloatingPoint* distance,
+                                                 BlockCache* cache) const {
   CHECK_NOTNULL(distance);
 
-  typename Layer<VoxelType>::BlockType::ConstPtr block_ptr =
-      layer_->getBlockPtrByCoordinates(pos);
+  const BlockType* block_ptr = cache->getBlockPtrByCoordinates(pos);
   if (block_ptr == nullptr) {
     return false;
   }
@@ -292,13 +374,14 @@ bool Interpolator<VoxelType>::getNearestDistance(
 
 template <typename VoxelType>
 bool Interpolator<VoxelType>::getInterpVoxel(const Point& pos,
-                                             VoxelType* voxel) const {
+                                             VoxelType* voxel,
+                                             BlockCache* cache) const {
   CHECK_NOTNULL(voxel);
 
   // get voxels of 8 surrounding voxels and weights vector
   const VoxelType* voxels[9];
   InterpVector q_vector;
-  if (!getVoxelsAndQVector(pos, voxels, &q_vector)) {
+  if (!getVoxelsAndQVector(pos, voxels, &q_vector, cache)) {
     return false;
   } else {
     *voxel = interpVoxel(q_vector, voxels);
@@ -308,11 +391,11 @@ bool Interpolator<VoxelType>::getInterpVoxel(const Point& pos,
 
 template <typename VoxelType>
 bool Interpolator<VoxelType>::getNearestVoxel(const Point& pos,
-                                              VoxelType* voxel) const {
+                                              VoxelType* voxel,
+                                              BlockCache* cache) const {
   CHECK_NOTNULL(voxel);
 
-  typename Layer<VoxelType>::BlockType::ConstPtr block_ptr =
-      layer_->getBlockPtrByCoordinates(pos);
+  const BlockType* block_ptr = cache->getBlockPtrByCoordinates(pos);
   if (block_ptr == nullptr) {
     return false;
   }
@@ -0,0 +1,111 @@
+#ifndef VOXBLOX_IO_ASYNC_LAYER_SAVER_H_
+#define VOXBLOX_IO_ASYNC_LAYER_SAVER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "./Block.pb.h"
+#include "./Layer.pb.h"
+#include "voxblox/core/block.h"
+#include "voxblox/core/common.h"
+#include "voxblox/core/layer.h"
+#include "voxblox/utils/compression_utils.h"
+
+namespace voxblox {
+namespace io {
+
+// Saves a layer to file without blocking the caller for the duration of the
+// serialization. The blocks to save are snapshotted on the calling thread,
+// after which they are serialized (and optionally compressed) by a pool of
+// worker threads and written to file in the background. The resulting file
+// has the same format as Layer::saveToFile and can be loaded with LoadLayer.
+// Only one save can be in flight at a time, starting a new one waits for the
+// previous one to finish.
+template <typename VoxelType>
+class AsyncLayerSaver {
+ public:
+  struct Config {
+    // Number of threads used to serialize the blocks.
+    size_t serialization_threads = std::thread::hardware_concurrency();
+    // Codec applied to the voxel data of every block.
+    utils::CompressionType compression = utils::CompressionType::kNone;
+    // If true, the voxel data of all saved blocks is copied when the save is
+    // started, so the layer can safely be integrated into while saving. If
+    // false, the snapshot only holds a reference to each block, which keeps
+    // blocks alive that are removed from the layer in the meantime, but the
+    // voxels of the saved blocks must not be modified until the save is done.
+    bool copy_voxel_data = true;
+  };
+
+  struct Progress {
+    size_t num_blocks = 0u;
+    size_t blocks_written = 0u;
+    size_t bytes_written = 0u;
+  };
+
+  // Called from the writer thread after every written block.
+  typedef std::function<void(const Progress&)> ProgressCallback;
+
+  explicit AsyncLayerSaver(const Config& config);
+  ~AsyncLayerSaver();
+
+  // Snapshots all blocks of the layer and starts writing them to file.
+  bool saveLayer(const Layer<VoxelType>& layer, const std::string& file_path,
+                 const ProgressCallback& progress_callback = ProgressCallback());
+  // Same as above, but only for the given blocks, unless include_all_blocks
+  // is set. Indices of blocks that are not allocated are ignored.
+  bool saveLayerSubset(
+      const Layer<VoxelType>& layer, const std::string& file_path,
+      const BlockIndexList& blocks_to_include, bool include_all_blocks,
+      const ProgressCallback& progress_callback = ProgressCallback());
+
+  // Blocks until the current save is done, returns true if it succeeded.
+  bool wait();
+
+  bool isSaving() const { return is_saving_; }
+  Progress getProgress() const;
+
+ private:
+  typedef typename Block<VoxelType>::ConstPtr BlockConstPtr;
+
+  void snapshotBlock(const BlockConstPtr& block);
+
+  // Entry point of the background thread.
+  void save(const std::string& file_path,
+            const ProgressCallback& progress_callback);
+  void serializeBlocks();
+
+  Config config_;
+
+  std::thread save_thread_;
+  std::atomic<bool> is_saving_;
+  bool success_;
+
+  // State of the current save.
+  LayerProto layer_proto_;
+  std::vector<BlockConstPtr> snapshot_;
+  std::vector<std::string> serialized_blocks_;
+  std::vector<bool> is_serialized_;
+  std::atomic<size_t> next_block_to_serialize_;
+  std::mutex serialized_mutex_;
+  std::condition_variable serialized_condition_;
+
+  size_t num_blocks_;
+  std::atomic<size_t> blocks_written_;
+  std::atomic<size_t> bytes_written_;
+};
+
+}  // namespace io
+}  // namespace voxblox
+
+#include "voxblox/io/async_layer_saver_inl.h"
+
+#endif  // VOXBLOX_IO_ASYNC_LAYER_SAVER_H_
@@ -0,0 +1,240 @@
+#ifndef VOXBLOX_IO_ASYNC_LAYER_SAVER_INL_H_
+#define VOXBLOX_IO_ASYNC_LAYER_SAVER_INL_H_
+
+#include <algorithm>
+#include <fstream>  // NOLINT
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <google/protobuf/io/coded_stream.h>
+
+#include "voxblox/utils/protobuf_utils.h"
+#include "voxblox/utils/timing.h"
+
+namespace voxblox {
+namespace io {
+
+template <typename VoxelType>
+AsyncLayerSaver<VoxelType>::AsyncLayerSaver(const Config& config)
+    : config_(config),
+      is_saving_(false),
+      success_(true),
+      next_block_to_serialize_(0u),
+      num_blocks_(0u),
+      blocks_written_(0u),
+      bytes_written_(0u) {
+  if (config_.serialization_threads == 0) {
+    LOG(WARNING) << "Automatic core count failed, defaulting to 1 threads";
+    config_.serialization_threads = 1;
+  }
+  CHECK(utils::isCompressionAvailable(config_.compression))
+      << "The requested block compression is not available in this build.";
+}
+
+template <typename VoxelType>
+AsyncLayerSaver<VoxelType>::~AsyncLayerSaver() {
+  wait();
+}
+
+template <typename VoxelType>
+bool AsyncLayerSaver<VoxelType>::saveLayer(
+    const Layer<VoxelType>& layer, const std::string& file_path,
+    const ProgressCallback& progress_callback) {
+  constexpr bool kIncludeAllBlocks = true;
+  return saveLayerSubset(layer, file_path, BlockIndexList(), kIncludeAllBlocks,
+                         progress_callback);
+}
+
+template <typename VoxelType>
+bool AsyncLayerSaver<VoxelType>::saveLayerSubset(
+    const Layer<VoxelType>& layer, const std::string& file_path,
+    const BlockIndexList& blocks_to_include, bool include_all_blocks,
+    const ProgressCallback& progress_callback) {
+  CHECK(!file_path.empty());
+  CHECK_NE(getVoxelType<VoxelType>().compare(voxel_types::kNotSerializable),
+           0)
+      << "The voxel type of this layer is not serializable!";
+
+  // Finish the previous save first, all the state below is reused.
+  wait();
+
+  timing::Timer snapshot_timer("save_layer_async/snapshot");
+  layer.getProto(&layer_proto_);
+
+  BlockIndexList block_indices;
+  if (include_all_blocks) {
+    layer.getAllAllocatedBlocks(&block_indices);
+  } else {
+    block_indices = blocks_to_include;
+    // Make sure that no block ends up in the file twice.
+    std::sort(block_indices.begin(), block_indices.end(),
+              [](const BlockIndex& a, const BlockIndex& b) {
+                return std::lexicographical_compare(
+                    a.data(), a.data() + a.size(), b.data(),
+                    b.data() + b.size());
+              });
+    block_indices.erase(
+        std::unique(block_indices.begin(), block_indices.end()),
+        block_indices.end());
+  }
+
+  snapshot_.clear();
+  snapshot_.reserve(block_indices.size());
+  for (const BlockIndex& block_index : block_indices) {
+    BlockConstPtr block = layer.getBlockPtrByIndex(block_index);
+    if (block) {
+      snapshotBlock(block);
+    }
+  }
+  snapshot_timer.Stop();
+  num_blocks_ = snapshot_.size();
+
+  serialized_blocks_.clear();
+  serialized_blocks_.resize(snapshot_.size());
+  is_serialized_.assign(snapshot_.size(), false);
+  next_block_to_serialize_ = 0u;
+  blocks_written_ = 0u;
+  bytes_written_ = 0u;
+  success_ = true;
+
+  is_saving_ = true;
+  save_thread_ = std::thread(&AsyncLayerSaver::save, this, file_path,
+                             progress_callback);
+  return true;
+}
+
+template <typename VoxelType>
+bool AsyncLayerSaver<VoxelType>::wait() {
+  if (save_thread_.joinable()) {
+    save_thread_.join();
+  }
+  return success_;
+}
+
+template <typename VoxelType>
+typename AsyncLayerSaver<VoxelType>::Progress
+AsyncLayerSaver<VoxelType>::getProgress() const {
+  Progress progress;
+  progress.num_blocks = num_blocks_;
+  progress.blocks_written = blocks_written_;
+  progress.bytes_written = bytes_written_;
+  return progress;
+}
+
+template <typename VoxelType>
+void AsyncLayerSaver<VoxelType>::snapshotBlock(const BlockConstPtr& block) {
+  if (!config_.copy_voxel_data) {
+    // Holding on to the block is enough to keep it alive if it is removed or
+    // replaced in the layer while we are still saving.
+    snapshot_.push_back(block);
+    return;
+  }
+
+  typename Block<VoxelType>::Ptr block_copy(new Block<VoxelType>(
+      block->voxels_per_side(), block->voxel_size(), block->origin()));
+  block_copy->has_data() = block->has_data();
+  const size_t num_voxels = block->num_voxels();
+  for (size_t linear_index = 0u; linear_index < num_voxels; ++linear_index) {
+    block_copy->getVoxelByLinearIndex(linear_index) =
+        block->getVoxelByLinearIndex(linear_index);
+  }
+  snapshot_.push_back(block_copy);
+}
+
+template <typename VoxelType>
+void AsyncLayerSaver<VoxelType>::serializeBlocks() {
+  size_t block_idx;
+  while ((block_idx = next_block_to_serialize_++) < snapshot_.size()) {
+    BlockProto block_proto;
+    snapshot_[block_idx]->getProto(config_.compression, &block_proto);
+    std::string serialized_block;
+    CHECK(block_proto.SerializeToString(&serialized_block));
+    // The snapshot of this block is no longer needed.
+    snapshot_[block_idx].reset();
+
+    {
+      std::lock_guard<std::mutex> lock(serialized_mutex_);
+      serialized_blocks_[block_idx].swap(serialized_block);
+      is_serialized_[block_idx] = true;
+    }
+    serialized_condition_.notify_all();
+  }
+}
+
+template <typename VoxelType>
+void AsyncLayerSaver<VoxelType>::save(
+    const std::string& file_path, const ProgressCallback& progress_callback) {
+  std::vector<std::thread> serialization_threads;
+  for (size_t i = 0; i < config_.serialization_threads; ++i) {
+    serialization_threads.emplace_back(&AsyncLayerSaver::serializeBlocks,
+                                       this);
+  }
+
+  std::fstream outfile;
+  outfile.open(file_path, std::fstream::out | std::fstream::binary);
+  bool success = outfile.is_open();
+  if (!success) {
+    LOG(ERROR) << "Could not open file for writing: " << file_path;
+  }
+
+  // One layer header and then all the blocks, same as Layer::saveToFile.
+  const uint32_t num_messages = 1u + snapshot_.size();
+  if (success && !utils::writeProtoMsgCountToStream(num_messages, &outfile)) {
+    LOG(ERROR) << "Could not write message number to file.";
+    success = false;
+  }
+  if (success && !utils::writeProtoMsgToStream(layer_proto_, &outfile)) {
+    LOG(ERROR) << "Could not write layer header message.";
+    success = false;
+  }
+  if (success) {
+    const uint32_t header_size =
+        static_cast<uint32_t>(layer_proto_.ByteSizeLong());
+    bytes_written_ =
+        google::protobuf::io::CodedOutputStream::VarintSize32(num_messages) +
+        google::protobuf::io::CodedOutputStream::VarintSize32(header_size) +
+        header_size;
+  }
+
+  // Write the blocks in snapshot order as soon as they are serialized.
+  for (size_t block_idx = 0u; success && block_idx < snapshot_.size();
+       ++block_idx) {
+    std::string serialized_block;
+    {
+      std::unique_lock<std::mutex> lock(serialized_mutex_);
+      serialized_condition_.wait(
+          lock, [this, block_idx] { return is_serialized_[block_idx]; });
+      serialized_block.swap(serialized_blocks_[block_idx]);
+    }
+
+    size_t bytes_written = 0u;
+    if (!utils::writeSerializedProtoMsgToStream(serialized_block, &outfile,
+                                                &bytes_written)) {
+      LOG(ERROR) << "Could not write block message.";
+      success = false;
+      break;
+    }
+    bytes_written_ += bytes_written;
+    ++blocks_written_;
+
+    if (progress_callback) {
+      progress_callback(getProgress());
+    }
+  }
+
+  for (std::thread& thread : serialization_threads) {
+    thread.join();
+  }
+  outfile.close();
+  serialized_blocks_.clear();
+  snapshot_.clear();
+
+  success_ = success && !outfile.fail();
+  is_saving_ = false;
+}
+
+}  // namespace io
+}  // namespace voxblox
+
+#endif  // VOXBLOX_IO_ASYNC_LAYER_SAVER_INL_H_
@@ -0,0 +1,99 @@
+#ifndef VOXBLOX_IO_LAYER_CHECKPOINT_H_
+#define VOXBLOX_IO_LAYER_CHECKPOINT_H_
+
+#include <string>
+
+#include <glog/logging.h>
+
+#include "./Block.pb.h"
+#include "./Layer.pb.h"
+#include "voxblox/core/block_hash.h"
+#include "voxblox/core/common.h"
+#include "voxblox/core/layer.h"
+#include "voxblox/core/voxel.h"
+
+namespace voxblox {
+namespace io {
+
+// Whether the blocks of a layer are marked through Block::setUpdated() by
+// all integrators writing to it, which is what incremental checkpoints rely
+// on to find the modified blocks. The ESDF integrators propagate their
+// wavefronts into neighboring blocks without doing so, therefore ESDF layers
+// are always checkpointed in full.
+template <typename VoxelType>
+inline bool hasVersionedBlocks() {
+  return true;
+}
+template <>
+inline bool hasVersionedBlocks<EsdfVoxel>() {
+  return false;
+}
+
+// Incremental checkpoints consist of a base file, which is a regular layer
+// file, and an append-only delta log next to it. Every segment of the log has
+// the layout of a layer file and contains the blocks that were added or
+// updated since the previous checkpoint, as well as markers for removed
+// blocks. The layer is restored by loading the base file and replaying all
+// segments in order.
+inline std::string getCheckpointDeltaLogPath(const std::string& base_path) {
+  return base_path + ".delta";
+}
+
+template <typename VoxelType>
+class LayerCheckpointer {
+ public:
+  explicit LayerCheckpointer(const std::string& base_path);
+
+  // Writes a checkpoint of the layer. The first checkpoint writes the full
+  // layer to the base file and clears the delta log, all following ones only
+  // append the blocks whose version changed since the previous checkpoint.
+  // Layers without versioned blocks, see hasVersionedBlocks(), are written in
+  // full every time. If appending to the delta log fails, the next checkpoint
+  // rewrites the base file, so a partially written segment never hides later
+  // ones.
+  bool writeCheckpoint(const Layer<VoxelType>& layer);
+
+  // Forces the next checkpoint to write the full layer again.
+  void reset() {
+    has_base_ = false;
+    checkpointed_versions_.clear();
+  }
+
+  // Number of added, updated and removed blocks written by the last
+  // checkpoint.
+  size_t getNumBlocksInLastCheckpoint() const {
+    return num_blocks_in_last_checkpoint_;
+  }
+
+ private:
+  typedef BlockHashMapType<uint64_t>::type BlockVersionMap;
+
+  bool writeDeltaSegment(const Layer<VoxelType>& layer,
+                         const BlockIndexList& updated_blocks,
+                         const BlockIndexList& removed_blocks) const;
+
+  const std::string base_path_;
+
+  bool has_base_;
+  // Version of every block at the time of the last checkpoint.
+  BlockVersionMap checkpointed_versions_;
+  size_t num_blocks_in_last_checkpoint_;
+};
+
+// Loads the base file and replays the delta log on top of it. A truncated
+// last segment, e.g. from a crash during a checkpoint, is skipped.
+template <typename VoxelType>
+bool LoadLayerCheckpoint(const std::string& base_path,
+                         typename Layer<VoxelType>::Ptr* layer_ptr);
+
+// Merges the delta log into the base file and clears the log. Replaying a
+// segment twice is harmless, so a crash between the two steps loses nothing.
+template <typename VoxelType>
+bool CompactLayerCheckpoint(const std::string& base_path);
+
+}  // namespace io
+}  // namespace voxblox
+
+#include "voxblox/io/layer_checkpoint_inl.h"
+
+#endif  // VOXBLOX_IO_LAYER_CHECKPOINT_H_
@@ -0,0 +1,251 @@
+#ifndef VOXBLOX_IO_LAYER_CHECKPOINT_INL_H_
+#define VOXBLOX_IO_LAYER_CHECKPOINT_INL_H_
+
+#include <cstdio>
+#include <fstream>  // NOLINT
+#include <string>
+#include <vector>
+
+#include "voxblox/io/layer_io.h"
+#include "voxblox/utils/protobuf_utils.h"
+#include "voxblox/utils/timing.h"
+
+namespace voxblox {
+namespace io {
+
+template <typename VoxelType>
+LayerCheckpointer<VoxelType>::LayerCheckpointer(const std::string& base_path)
+    : base_path_(base_path),
+      has_base_(false),
+      num_blocks_in_last_checkpoint_(0u) {
+  CHECK(!base_path_.empty());
+}
+
+template <typename VoxelType>
+bool LayerCheckpointer<VoxelType>::writeCheckpoint(
+    const Layer<VoxelType>& layer) {
+  timing::Timer checkpoint_timer("checkpoint");
+
+  BlockIndexList all_blocks;
+  layer.getAllAllocatedBlocks(&all_blocks);
+
+  if (!has_base_ || !hasVersionedBlocks<VoxelType>()) {
+    // Full checkpoint, which makes all previous deltas obsolete. The layer is
+    // written to a temporary file first and the delta log is cleared before
+    // that file replaces the base. Interrupting this at any point leaves a
+    // consistent, if possibly older, checkpoint on disk, but never a base
+    // followed by deltas that are older than it.
+    const std::string tmp_path = base_path_ + ".tmp";
+    if (!layer.saveToFile(tmp_path)) {
+      return false;
+    }
+    // From here on the files on disk no longer match the remembered
+    // versions, so a failure has to be followed by a full checkpoint.
+    reset();
+    std::fstream delta_log;
+    delta_log.open(getCheckpointDeltaLogPath(base_path_),
+                   std::fstream::out | std::fstream::trunc);
+    if (!delta_log.is_open()) {
+      LOG(ERROR) << "Could not clear the checkpoint delta log of: "
+                 << base_path_;
+      return false;
+    }
+    delta_log.close();
+    if (std::rename(tmp_path.c_str(), base_path_.c_str()) != 0) {
+      LOG(ERROR) << "Could not replace the checkpoint base file: "
+                 << base_path_;
+      return false;
+    }
+    num_blocks_in_last_checkpoint_ = all_blocks.size();
+  } else {
+    BlockIndexList updated_blocks;
+    for (const BlockIndex& block_index : all_blocks) {
+      const uint64_t version =
+          layer.getBlockPtrByIndex(block_index)->version();
+      typename BlockVersionMap::const_iterator it =
+          checkpointed_versions_.find(block_index);
+      if (it == checkpointed_versions_.end() || it->second != version) {
+        updated_blocks.push_back(block_index);
+      }
+    }
+    BlockIndexList removed_blocks;
+    for (const typename BlockVersionMap::value_type& kv :
+         checkpointed_versions_) {
+      if (!layer.hasBlock(kv.first)) {
+        removed_blocks.push_back(kv.first);
+      }
+    }
+
+    if (!updated_blocks.empty() || !removed_blocks.empty()) {
+      if (!writeDeltaSegment(layer, updated_blocks, removed_blocks)) {
+        // The segment may be partially written, which would make the loader
+        // skip all segments appended after it.
+        reset();
+        return false;
+      }
+    }
+    num_blocks_in_last_checkpoint_ =
+        updated_blocks.size() + removed_blocks.size();
+  }
+
+  // Only remember the versions once the checkpoint is safely on disk, so a
+  // failed checkpoint is retried in full by the next one.
+  checkpointed_versions_.clear();
+  for (const BlockIndex& block_index : all_blocks) {
+    checkpointed_versions_[block_index] =
+        layer.getBlockPtrByIndex(block_index)->version();
+  }
+  has_base_ = true;
+  return true;
+}
+
+template <typename VoxelType>
+bool LayerCheckpointer<VoxelType>::writeDeltaSegment(
+    const Layer<VoxelType>& layer, const BlockIndexList& updated_blocks,
+    const BlockIndexList& removed_blocks) const {
+  const std::string delta_log_path = getCheckpointDeltaLogPath(base_path_);
+  std::fstream delta_log;
+  delta_log.open(delta_log_path, std::fstream::out | std::fstream::binary |
+                                     std::fstream::app);
+  if (!delta_log.is_open()) {
+    LOG(ERROR) << "Could not open checkpoint delta log for writing: "
+               << delta_log_path;
+    return false;
+  }
+
+  // A segment has the same layout as a layer file: the number of messages,
+  // the layer header and then the blocks. Since the log is opened in append
+  // mode, all writes end up at the end of the file.
+  const uint32_t num_messages =
+      1u + updated_blocks.size() + removed_blocks.size();
+  if (!utils::writeProtoMsgCountToStream(num_messages, &delta_log)) {
+    LOG(ERROR) << "Could not write message number to checkpoint delta log.";
+    return false;
+  }
+
+  LayerProto proto_layer;
+  layer.getProto(&proto_layer);
+  if (!utils::writeProtoMsgToStream(proto_layer, &delta_log)) {
+    LOG(ERROR) << "Could not write layer header message.";
+    return false;
+  }
+
+  for (const BlockIndex& block_index : updated_blocks) {
+    BlockProto block_proto;
+    layer.getBlockPtrByIndex(block_index)->getProto(&block_proto);
+    if (!utils::writeProtoMsgToStream(block_proto, &delta_log)) {
+      LOG(ERROR) << "Could not write block message.";
+      return false;
+    }
+  }
+
+  for (const BlockIndex& block_index : removed_blocks) {
+    const Point origin =
+        getOriginPointFromGridIndex(block_index, layer.block_size());
+    BlockProto block_proto;
+    block_proto.set_voxels_per_side(layer.voxels_per_side());
+    block_proto.set_voxel_size(layer.voxel_size());
+    block_proto.set_origin_x(origin.x());
+    block_proto.set_origin_y(origin.y());
+    block_proto.set_origin_z(origin.z());
+    block_proto.set_removed(true);
+    if (!utils::writeProtoMsgToStream(block_proto, &delta_log)) {
+      LOG(ERROR) << "Could not write block message.";
+      return false;
+    }
+  }
+
+  delta_log.close();
+  return !delta_log.fail();
+}
+
+template <typename VoxelType>
+bool LoadLayerCheckpoint(const std::string& base_path,
+                         typename Layer<VoxelType>::Ptr* layer_ptr) {
+  CHECK_NOTNULL(layer_ptr);
+
+  if (!LoadLayer<VoxelType>(base_path, layer_ptr)) {
+    return false;
+  }
+
+  std::fstream delta_log;
+  delta_log.open(getCheckpointDeltaLogPath(base_path),
+                 std::fstream::in | std::fstream::binary);
+  if (!delta_log.is_open()) {
+    // No deltas were written since the last full checkpoint.
+    return true;
+  }
+
+  uint64_t byte_offset = 0u;
+  uint32_t num_messages;
+  size_t segment_idx = 0u;
+  while (utils::readProtoMsgCountFromStreamAtOffset(&delta_log, &num_messages,
+                                                    &byte_offset)) {
+    // Read the whole segment before applying it, so that a segment that was
+    // only partially written does not leave the layer half updated.
+    LayerProto layer_proto;
+    std::vector<BlockProto> block_protos(num_messages > 0u ? num_messages - 1u
+                                                           : 0u);
+    bool segment_complete =
+        num_messages > 0u &&
+        utils::readProtoMsgFromStream(&delta_log, &layer_proto, &byte_offset);
+    for (size_t i = 0u; segment_complete && i < block_protos.size(); ++i) {
+      segment_complete = utils::readProtoMsgFromStream(
+          &delta_log, &block_protos[i], &byte_offset);
+    }
+    if (!segment_complete) {
+      LOG(WARNING) << "Checkpoint delta segment " << segment_idx
+                   << " is incomplete, ignoring it and all following ones.";
+      break;
+    }
+
+    if (!(*layer_ptr)->isCompatible(layer_proto)) {
+      LOG(ERROR) << "Checkpoint delta segment " << segment_idx
+                 << " is not compatible with the base layer!";
+      return false;
+    }
+    for (const BlockProto& block_proto : block_protos) {
+      if (!(*layer_ptr)->addBlockFromProto(
+              block_proto,
+              Layer<VoxelType>::BlockMergingStrategy::kReplace)) {
+        LOG(ERROR) << "Could not add the block protobuf message to the layer!";
+        return false;
+      }
+    }
+    ++segment_idx;
+  }
+  return true;
+}
+
+template <typename VoxelType>
+bool CompactLayerCheckpoint(const std::string& base_path) {
+  typename Layer<VoxelType>::Ptr layer;
+  if (!LoadLayerCheckpoint<VoxelType>(base_path, &layer)) {
+    LOG(ERROR) << "Could not load checkpoint to compact: " << base_path;
+    return false;
+  }
+
+  // Write to a temporary file first, so the base file is replaced atomically.
+  const std::string tmp_path = base_path + ".tmp";
+  if (!layer->saveToFile(tmp_path)) {
+    return false;
+  }
+  if (std::rename(tmp_path.c_str(), base_path.c_str()) != 0) {
+    LOG(ERROR) << "Could not replace the checkpoint base file: " << base_path;
+    return false;
+  }
+
+  std::fstream delta_log;
+  delta_log.open(getCheckpointDeltaLogPath(base_path),
+                 std::fstream::out | std::fstream::trunc);
+  if (!delta_log.is_open()) {
+    LOG(ERROR) << "Could not clear the checkpoint delta log of: " << base_path;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace io
+}  // namespace voxblox
+
+#endif  // VOXBLOX_IO_LAYER_CHECKPOINT_INL_H_
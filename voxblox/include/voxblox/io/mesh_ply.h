@@ -23,18 +23,20 @@
 #ifndef VOXBLOX_MESH_MESH_PLY_H_
 #define VOXBLOX_MESH_MESH_PLY_H_
 
+#include "voxblox/io/ply_writer.h"
 #include "voxblox/mesh/mesh_layer.h"
 
-#include <iostream>
-#include <fstream>
 #include <string>
 
 namespace voxblox {
 
+// Streams the meshes of all blocks to the file, without combining them first.
 bool outputMeshLayerAsPly(const std::string& filename,
-                          const MeshLayer& mesh_layer);
+                          const MeshLayer& mesh_layer,
+                          io::PlyFormat format = io::PlyFormat::kAscii);
 
-bool outputMeshAsPly(const std::string& filename, const Mesh& mesh);
+bool outputMeshAsPly(const std::string& filename, const Mesh& mesh,
+                     io::PlyFormat format = io::PlyFormat::kAscii);
 
 }  // namespace voxblox
 
@@ -1,7 +1,12 @@
 #ifndef VOXBLOX_CORE_IO_PLY_WRITER_H_
 #define VOXBLOX_CORE_IO_PLY_WRITER_H_
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <fstream>  // NOLINT
+#include <iomanip>
+#include <limits>
 #include <string>
 
 #include <glog/logging.h>
@@ -11,19 +16,38 @@
 namespace voxblox {
 
 namespace io {
+
+enum class PlyFormat { kAscii = 0, kBinaryLittleEndian };
+
 // For reference on the format, see:
 //  http://paulbourke.net/dataformats/ply/
+// The vertices and faces are streamed to the file. Their numbers in the header
+// are only estimates until the file is closed, then they are overwritten with
+// the numbers that were actually written, so they do not have to be known in
+// advance.
 class PlyWriter {
  public:
-  explicit PlyWriter(const std::string& filename)
-      : header_written_(false),
+  explicit PlyWriter(const std::string& filename,
+                     PlyFormat format = PlyFormat::kAscii)
+      : format_(format),
+        header_written_(false),
         parameters_set_(false),
         vertices_total_(0),
         vertices_written_(0),
         has_color_(false),
-        file_(filename) {}
+        has_faces_(false),
+        faces_total_(0),
+        faces_written_(0),
+        vertex_count_position_(-1),
+        face_count_position_(-1),
+        file_(filename, std::ios::out | std::ios::binary) {
+#if defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__)
+    static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+                  "Binary PLY output assumes a little endian host.");
+#endif
+  }
 
-  virtual ~PlyWriter() {}
+  virtual ~PlyWriter() { closeFile(); }
 
   void addVerticesWithProperties(size_t num_vertices, bool has_color) {
     vertices_total_ = num_vertices;
@@ -31,6 +55,12 @@ class PlyWriter {
     parameters_set_ = true;
   }
 
+  // Adds a face element of triangles to the file.
+  void addFaces(size_t num_faces) {
+    faces_total_ = num_faces;
+    has_faces_ = true;
+  }
+
   bool writeHeader() {
     if (!file_) {
       // Output a warning -- couldn't open file?
@@ -46,20 +76,35 @@ class PlyWriter {
       return false;
     }
 
-    file_ << "ply" << std::endl;
-    file_ << "format ascii 1.0" << std::endl;
-    file_ << "element vertex " << vertices_total_ << std::endl;
-    file_ << "property float x" << std::endl;
-    file_ << "property float y" << std::endl;
-    file_ << "property float z" << std::endl;
+    file_ << "ply\n";
+    if (format_ == PlyFormat::kAscii) {
+      file_ << "format ascii 1.0\n";
+    } else {
+      file_ << "format binary_little_endian 1.0\n";
+    }
+    file_ << "element vertex ";
+    vertex_count_position_ = file_.tellp();
+    writeCount(vertices_total_);
+    file_ << "\n";
+    file_ << "property float x\n";
+    file_ << "property float y\n";
+    file_ << "property float z\n";
 
     if (has_color_) {
-      file_ << "property uchar red" << std::endl;
-      file_ << "property uchar green" << std::endl;
-      file_ << "property uchar blue" << std::endl;
+      file_ << "property uchar red\n";
+      file_ << "property uchar green\n";
+      file_ << "property uchar blue\n";
+    }
+
+    if (has_faces_) {
+      file_ << "element face ";
+      face_count_position_ = file_.tellp();
+      writeCount(faces_total_);
+      file_ << "\n";
+      file_ << "property list uchar int vertex_index\n";
     }
 
-    file_ << "end_header" << std::endl;
+    file_ << "end_header\n";
 
     header_written_ = true;
     return true;
@@ -71,10 +116,15 @@ class PlyWriter {
         return false;
       }
     }
-    if (vertices_written_ >= vertices_total_ || has_color_) {
+    if (has_color_) {
       return false;
     }
-    file_ << coord.x() << " " << coord.y() << " " << coord.z() << std::endl;
+    if (format_ == PlyFormat::kAscii) {
+      file_ << coord.x() << " " << coord.y() << " " << coord.z() << "\n";
+    } else {
+      writeCoordinates(coord);
+    }
+    ++vertices_written_;
     return true;
   }
 
@@ -84,18 +134,93 @@ class PlyWriter {
         return false;
       }
     }
-    if (vertices_written_ >= vertices_total_ || !has_color_) {
+    if (!has_color_) {
+      return false;
+    }
+    if (format_ == PlyFormat::kAscii) {
+      file_ << coord.x() << " " << coord.y() << " " << coord.z() << " ";
+      file_ << static_cast<int>(rgb.r) << " " << static_cast<int>(rgb.g) << " "
+            << static_cast<int>(rgb.b) << "\n";
+    } else {
+      char buffer[3 * sizeof(float) + 3];
+      const float xyz[3] = {static_cast<float>(coord.x()),
+                            static_cast<float>(coord.y()),
+                            static_cast<float>(coord.z())};
+      std::memcpy(buffer, xyz, sizeof(xyz));
+      buffer[sizeof(xyz)] = static_cast<char>(rgb.r);
+      buffer[sizeof(xyz) + 1] = static_cast<char>(rgb.g);
+      buffer[sizeof(xyz) + 2] = static_cast<char>(rgb.b);
+      file_.write(buffer, sizeof(buffer));
+    }
+    ++vertices_written_;
+    return true;
+  }
+
+  // Faces can only be written after all vertices, as the PLY format stores
+  // the elements one after another.
+  bool writeFace(VertexIndex v0, VertexIndex v1, VertexIndex v2) {
+    if (!header_written_ || !has_faces_) {
       return false;
     }
-    file_ << coord.x() << " " << coord.y() << " " << coord.z() << " ";
-    file_ << static_cast<int>(rgb.r) << " " << static_cast<int>(rgb.g) << " "
-          << static_cast<int>(rgb.b) << std::endl;
+    DCHECK_LT(std::max(v0, std::max(v1, v2)),
+              static_cast<VertexIndex>(std::numeric_limits<int32_t>::max()));
+    if (format_ == PlyFormat::kAscii) {
+      file_ << "3 " << v0 << " " << v1 << " " << v2 << "\n";
+    } else {
+      char buffer[1 + 3 * sizeof(int32_t)];
+      const int32_t indices[3] = {static_cast<int32_t>(v0),
+                                  static_cast<int32_t>(v1),
+                                  static_cast<int32_t>(v2)};
+      buffer[0] = 3;
+      std::memcpy(buffer + 1, indices, sizeof(indices));
+      file_.write(buffer, sizeof(buffer));
+    }
+    ++faces_written_;
     return true;
   }
 
-  void closeFile() { file_.close(); }
+  size_t vertices_written() const { return vertices_written_; }
+  size_t faces_written() const { return faces_written_; }
+
+  // Fixes up the element counts in the header and closes the file. Returns
+  // false if anything could not be written or the file was not open.
+  bool closeFile() {
+    if (!file_.is_open()) {
+      return false;
+    }
+    if (header_written_) {
+      if (vertices_written_ != vertices_total_) {
+        file_.seekp(vertex_count_position_);
+        writeCount(vertices_written_);
+      }
+      if (has_faces_ && faces_written_ != faces_total_) {
+        file_.seekp(face_count_position_);
+        writeCount(faces_written_);
+      }
+    }
+    const bool success = static_cast<bool>(file_);
+    file_.close();
+    return success;
+  }
 
  private:
+  // Element counts are padded to a fixed width, so they can be overwritten
+  // in place.
+  static constexpr int kCountWidth = 20;
+
+  void writeCount(size_t count) {
+    file_ << std::left << std::setw(kCountWidth) << count;
+  }
+
+  void writeCoordinates(const Point& coord) {
+    const float xyz[3] = {static_cast<float>(coord.x()),
+                          static_cast<float>(coord.y()),
+                          static_cast<float>(coord.z())};
+    file_.write(reinterpret_cast<const char*>(xyz), sizeof(xyz));
+  }
+
+  const PlyFormat format_;
+
   bool header_written_;
   bool parameters_set_;
 
@@ -103,6 +228,13 @@ class PlyWriter {
   size_t vertices_written_;
   bool has_color_;
 
+  bool has_faces_;
+  size_t faces_total_;
+  size_t faces_written_;
+
+  std::streampos vertex_count_position_;
+  std::streampos face_count_position_;
+
   std::ofstream file_;
 };
 
@@ -3,9 +3,11 @@
 
 #include <algorithm>
 #include <string>
+#include <thread>
 
 #include "voxblox/io/ply_writer.h"
 #include "voxblox/core/layer.h"
+#include "voxblox/utils/voxel_extraction.h"
 
 namespace voxblox {
 
@@ -18,18 +20,29 @@ enum PlyOutputTypes {
   kSdfIsosurface
 };
 
+// The voxels are extracted with num_threads threads.
 template <typename VoxelType>
-bool outputLayerAsPly(const Layer<VoxelType>& layer,
-                      const std::string& filename, PlyOutputTypes type) {
+bool outputLayerAsPly(
+    const Layer<VoxelType>& layer, const std::string& filename,
+    PlyOutputTypes type, PlyFormat format = PlyFormat::kBinaryLittleEndian,
+    size_t num_threads = std::thread::hardware_concurrency()) {
   return false;
 }
 
 template <>
-bool outputLayerAsPly<TsdfVoxel>(const Layer<TsdfVoxel>& layer,
-                                 const std::string& filename,
-                                 PlyOutputTypes type) {
+inline bool outputLayerAsPly<TsdfVoxel>(const Layer<TsdfVoxel>& layer,
+                                        const std::string& filename,
+                                        PlyOutputTypes type, PlyFormat format,
+                                        size_t num_threads) {
+  struct ColoredVertex {
+    Point coord;
+    Color color;
+    bool observed;
+  };
+  constexpr size_t kBlocksPerBatch = 1024u;
+
   // Create a PlyWriter.
-  PlyWriter writer(filename);
+  PlyWriter writer(filename, format);
 
   if (type == kSdfDistanceColor) {
     // In this case, we get all the allocated voxels and color them based on
@@ -51,48 +64,45 @@ bool outputLayerAsPly<TsdfVoxel>(const Layer<TsdfVoxel>& layer,
     BlockIndexList blocks;
     layer.getAllAllocatedBlocks(&blocks);
 
-    int observed_voxels = 0;
+    size_t observed_voxels = 0u;
 
-    // Iterate over all blocks.
+    // Decide how to color the voxels.
+    // Distance > 0 = blue, distance < 0 = red.
     const float max_distance = 20;
-    for (const BlockIndex& index : blocks) {
-      // Iterate over all voxels in said blocks.
-      const Block<TsdfVoxel>& block = layer.getBlockByIndex(index);
-
-      VoxelIndex voxel_index = VoxelIndex::Zero();
-      for (voxel_index.x() = 0; voxel_index.x() < vps; ++voxel_index.x()) {
-        for (voxel_index.y() = 0; voxel_index.y() < vps; ++voxel_index.y()) {
-          for (voxel_index.z() = 0; voxel_index.z() < vps; ++voxel_index.z()) {
-            const TsdfVoxel& voxel =
-                block.getVoxelByVoxelIndex(voxel_index);
-
-            float distance = voxel.distance;
-            float weight = voxel.weight;
-
-            // Get back the original coordinate of this voxel.
-            Point coord =
-                block.computeCoordinatesFromVoxelIndex(voxel_index);
-
-            // Decide how to color this.
-            // Distance > 0 = blue, distance < 0 = red.
-            Color distance_color = Color::blendTwoColors(
-                Color(255, 0, 0, 0),
-                std::max<float>(1 - distance / max_distance, 0.0),
-                Color(0, 0, 255, 0),
-                std::max<float>(1 + distance / max_distance, 0.0));
-            Color color;
-            if (weight > 0) {
-              color = distance_color;
-              observed_voxels++;
-            }
-            writer.writeVertex(coord, color);
-          }
-        }
+    auto extractor = [max_distance](const TsdfVoxel& voxel, const Point& coord,
+                                    ColoredVertex* vertex) {
+      vertex->coord = coord;
+      vertex->color = Color();
+      vertex->observed = voxel.weight > 0;
+      if (vertex->observed) {
+        vertex->color = Color::blendTwoColors(
+            Color(255, 0, 0, 0),
+            std::max<float>(1 - voxel.distance / max_distance, 0.0),
+            Color(0, 0, 255, 0),
+            std::max<float>(1 + voxel.distance / max_distance, 0.0));
+      }
+      return true;
+    };
+
+    // The voxels are extracted in parallel, in batches of blocks to bound the
+    // memory of the buffered vertices.
+    AlignedVector<ColoredVertex> vertices;
+    BlockIndexList batch;
+    for (size_t batch_start = 0u; batch_start < blocks.size();
+         batch_start += kBlocksPerBatch) {
+      batch.assign(
+          blocks.begin() + batch_start,
+          blocks.begin() + std::min(batch_start + kBlocksPerBatch,
+                                    blocks.size()));
+      extractVoxelsFromBlocks<TsdfVoxel, ColoredVertex>(
+          layer, batch, extractor, num_threads, &vertices);
+      for (const ColoredVertex& vertex : vertices) {
+        writer.writeVertex(vertex.coord, vertex.color);
+        observed_voxels += vertex.observed;
       }
     }
     LOG(INFO) << "Number of observed voxels: " << observed_voxels;
-    writer.closeFile();
-    return true;
+    return writer.closeFile();
   }
   return false;
 }
@@ -0,0 +1,95 @@
+#ifndef VOXBLOX_MESH_DUAL_CONTOURING_H_
+#define VOXBLOX_MESH_DUAL_CONTOURING_H_
+
+#include <Eigen/Core>
+#include <Eigen/Eigenvalues>
+
+#include "voxblox/core/common.h"
+
+namespace voxblox {
+
+// Helpers for dual contouring, which places one vertex per cube at the
+// minimizer of a quadratic error function (QEF) built from the zero crossings
+// on the edges of the cube and the SDF normals there. Unlike the vertices of
+// marching cubes, these can lie on sharp edges and corners of the surface.
+// The corners of a cube are numbered like in MarchingCubes.
+class DualContouring {
+ public:
+  // Accumulates the planes through the zero crossings of a cube.
+  struct Qef {
+    Qef() : ata(Eigen::Matrix3f::Zero()), atb(Point::Zero()),
+            mass_point_sum(Point::Zero()), num_points(0) {}
+
+    void addPlane(const Point& point, const Point& normal) {
+      ata += normal * normal.transpose();
+      atb += normal * normal.dot(point);
+      mass_point_sum += point;
+      ++num_points;
+    }
+
+    Point massPoint() const {
+      return mass_point_sum / static_cast<FloatingPoint>(num_points);
+    }
+
+    Eigen::Matrix3f ata;
+    Point atb;
+    Point mass_point_sum;
+    int num_points;
+  };
+
+  // Minimizes the QEF relative to its mass point. Directions along which the
+  // planes do not constrain the vertex, i.e. eigenvalues of A^T A below
+  // singular_threshold, are kept at the mass point, so flat surfaces and
+  // edges do not pull the vertex away from the zero crossings.
+  static Point solveQef(const Qef& qef, FloatingPoint singular_threshold) {
+    DCHECK_GT(qef.num_points, 0);
+    const Point mass_point = qef.massPoint();
+    const Point residual = qef.atb - qef.ata * mass_point;
+    const Eigen::SelfAdjointEigenSolver<Eigen::Matrix3f> solver(qef.ata);
+    const FloatingPoint max_eigenvalue = solver.eigenvalues().maxCoeff();
+    Point vertex = mass_point;
+    for (int i = 0; i < 3; ++i) {
+      const FloatingPoint eigenvalue = solver.eigenvalues()(i);
+      if (eigenvalue > singular_threshold * max_eigenvalue) {
+        const Point eigenvector = solver.eigenvectors().col(i);
+        vertex += eigenvector * (eigenvector.dot(residual) / eigenvalue);
+      }
+    }
+    return vertex;
+  }
+
+  // Gradient of the trilinear interpolation of the corner distances at a
+  // point of the unit cube. It only depends on the cube itself, so the
+  // vertex of a cube is the same in all blocks that mesh it.
+  static Point computeTrilinearGradient(
+      const Eigen::Matrix<FloatingPoint, 8, 1>& corner_sdf,
+      const Point& point) {
+    const FloatingPoint x = point.x();
+    const FloatingPoint y = point.y();
+    const FloatingPoint z = point.z();
+    // Differences along the edges, corners numbered as in MarchingCubes.
+    const FloatingPoint dx_00 = corner_sdf(1) - corner_sdf(0);
+    const FloatingPoint dx_10 = corner_sdf(2) - corner_sdf(3);
+    const FloatingPoint dx_01 = corner_sdf(5) - corner_sdf(4);
+    const FloatingPoint dx_11 = corner_sdf(6) - corner_sdf(7);
+    const FloatingPoint dy_00 = corner_sdf(3) - corner_sdf(0);
+    const FloatingPoint dy_10 = corner_sdf(2) - corner_sdf(1);
+    const FloatingPoint dy_01 = corner_sdf(7) - corner_sdf(4);
+    const FloatingPoint dy_11 = corner_sdf(6) - corner_sdf(5);
+    const FloatingPoint dz_00 = corner_sdf(4) - corner_sdf(0);
+    const FloatingPoint dz_10 = corner_sdf(5) - corner_sdf(1);
+    const FloatingPoint dz_01 = corner_sdf(7) - corner_sdf(3);
+    const FloatingPoint dz_11 = corner_sdf(6) - corner_sdf(2);
+    return Point(
+        (1 - y) * (1 - z) * dx_00 + y * (1 - z) * dx_10 + (1 - y) * z * dx_01 +
+            y * z * dx_11,
+        (1 - x) * (1 - z) * dy_00 + x * (1 - z) * dy_10 + (1 - x) * z * dy_01 +
+            x * z * dy_11,
+        (1 - x) * (1 - y) * dz_00 + x * (1 - y) * dz_10 + (1 - x) * y * dz_01 +
+            x * y * dz_11);
+  }
+};
+
+}  // namespace voxblox
+
+#endif  // VOXBLOX_MESH_DUAL_CONTOURING_H_
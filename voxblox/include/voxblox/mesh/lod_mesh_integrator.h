@@ -0,0 +1,220 @@
+#ifndef VOXBLOX_MESH_LOD_MESH_INTEGRATOR_H_
+#define VOXBLOX_MESH_LOD_MESH_INTEGRATOR_H_
+
+#include <memory>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "voxblox/core/common.h"
+#include "voxblox/core/layer.h"
+#include "voxblox/core/voxel.h"
+#include "voxblox/mesh/mesh_integrator.h"
+#include "voxblox/mesh/mesh_layer.h"
+
+namespace voxblox {
+
+// Meshes a TSDF layer at several levels of detail. Level 0 is the TSDF layer
+// itself, level l is meshed from a copy of it that is downsampled by 2^l
+// along every axis and stored in the level of detail l of the mesh layer.
+// The downsampled layers keep the block size, so the meshes of all levels
+// share the block indices and MeshLayer::getMeshesForViewpoint can pick a
+// level per block.
+class LodMeshIntegrator {
+ public:
+  struct Config {
+    MeshIntegrator::Config mesh_config;
+    // Number of levels of detail, including the full resolution one. The
+    // voxels per side of the TSDF blocks must be divisible by 2^(num_lods-1).
+    size_t num_lods = 3;
+  };
+
+  LodMeshIntegrator(const Config& config, Layer<TsdfVoxel>* tsdf_layer,
+                    MeshLayer* mesh_layer)
+      : config_(config),
+        tsdf_layer_(CHECK_NOTNULL(tsdf_layer)),
+        mesh_layer_(CHECK_NOTNULL(mesh_layer)) {
+    CHECK_GT(config_.num_lods, 0u);
+    lod_integrators_.emplace_back(
+        new MeshIntegrator(config_.mesh_config, tsdf_layer_, mesh_layer_));
+
+    for (size_t lod = 1u; lod < config_.num_lods; ++lod) {
+      const size_t factor = 1u << lod;
+      CHECK_EQ(tsdf_layer_->voxels_per_side() % factor, 0u)
+          << "Can not downsample blocks with "
+          << tsdf_layer_->voxels_per_side() << " voxels per side " << factor
+          << " times.";
+      lod_tsdf_layers_.emplace_back(
+          new Layer<TsdfVoxel>(tsdf_layer_->voxel_size() * factor,
+                               tsdf_layer_->voxels_per_side() / factor));
+      lod_integrators_.emplace_back(new MeshIntegrator(
+          config_.mesh_config, lod_tsdf_layers_.back().get(),
+          mesh_layer_->allocateLodLayer(lod)));
+    }
+  }
+
+  // Generates the meshes of all levels for the entire TSDF layer from scratch.
+  void generateWholeMesh() {
+    BlockIndexList all_tsdf_blocks;
+    tsdf_layer_->getAllAllocatedBlocks(&all_tsdf_blocks);
+    for (const std::unique_ptr<Layer<TsdfVoxel>>& lod_layer :
+         lod_tsdf_layers_) {
+      lod_layer->removeAllBlocks();
+    }
+    downsampleBlocks(all_tsdf_blocks);
+
+    for (const std::unique_ptr<MeshIntegrator>& integrator : lod_integrators_) {
+      integrator->generateWholeMesh();
+    }
+  }
+
+  // Only updates the meshes of the blocks that have been updated, on all
+  // levels.
+  void generateMeshForUpdatedBlocks(bool clear_updated_flag) {
+    // The full resolution integrator may clear the flags, so the downsampled
+    // blocks are updated first.
+    pruneRemovedBlocks();
+    BlockIndexList updated_blocks;
+    tsdf_layer_->getAllUpdatedBlocks(&updated_blocks);
+    downsampleBlocks(updated_blocks);
+
+    lod_integrators_[0]->generateMeshForUpdatedBlocks(clear_updated_flag);
+    const bool clear_lod_updated_flag = true;
+    for (size_t lod = 1u; lod < lod_integrators_.size(); ++lod) {
+      lod_integrators_[lod]->generateMeshForUpdatedBlocks(
+          clear_lod_updated_flag);
+    }
+  }
+
+  // Pools the voxels of a block into the coarser block, which covers the same
+  // space with an integer fraction of the voxels per side. The distances and
+  // colors of the fine voxels with more than min_weight, the ones the mesh
+  // integrator considers observed, are averaged weighted by their weights,
+  // and the weights are summed.
+  static void downsampleBlock(const Block<TsdfVoxel>& block, float min_weight,
+                              Block<TsdfVoxel>* coarse_block) {
+    CHECK_NOTNULL(coarse_block);
+    const size_t vps = block.voxels_per_side();
+    const size_t coarse_vps = coarse_block->voxels_per_side();
+    CHECK_EQ(vps % coarse_vps, 0u);
+    const size_t factor = vps / coarse_vps;
+
+    size_t coarse_linear_index = 0u;
+    for (size_t z = 0u; z < coarse_vps; ++z) {
+      for (size_t y = 0u; y < coarse_vps; ++y) {
+        for (size_t x = 0u; x < coarse_vps; ++x, ++coarse_linear_index) {
+          float weight = 0.0f;
+          float weighted_distance = 0.0f;
+          float weighted_rgba[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+          for (size_t dz = 0u; dz < factor; ++dz) {
+            for (size_t dy = 0u; dy < factor; ++dy) {
+              const size_t row_start = factor * x +
+                                       vps * ((factor * y + dy) +
+                                              vps * (factor * z + dz));
+              for (size_t dx = 0u; dx < factor; ++dx) {
+                const TsdfVoxel& voxel =
+                    block.getVoxelByLinearIndex(row_start + dx);
+                if (voxel.weight <= min_weight) {
+                  continue;
+                }
+                weight += voxel.weight;
+                weighted_distance += voxel.weight * voxel.distance;
+                weighted_rgba[0] += voxel.weight * voxel.color.r;
+                weighted_rgba[1] += voxel.weight * voxel.color.g;
+                weighted_rgba[2] += voxel.weight * voxel.color.b;
+                weighted_rgba[3] += voxel.weight * voxel.color.a;
+              }
+            }
+          }
+
+          TsdfVoxel& coarse_voxel =
+              coarse_block->getVoxelByLinearIndex(coarse_linear_index);
+          coarse_voxel = TsdfVoxel();
+          if (weight > 0.0f) {
+            const float weight_inv = 1.0f / weight;
+            coarse_voxel.weight = weight;
+            coarse_voxel.distance = weighted_distance * weight_inv;
+            coarse_voxel.color.r = weighted_rgba[0] * weight_inv + 0.5f;
+            coarse_voxel.color.g = weighted_rgba[1] * weight_inv + 0.5f;
+            coarse_voxel.color.b = weighted_rgba[2] * weight_inv + 0.5f;
+            coarse_voxel.color.a = weighted_rgba[3] * weight_inv + 0.5f;
+          }
+        }
+      }
+    }
+  }
+
+  const Layer<TsdfVoxel>& getLodTsdfLayer(size_t lod) const {
+    if (lod == 0u) {
+      return *tsdf_layer_;
+    }
+    CHECK_LT(lod, config_.num_lods);
+    return *lod_tsdf_layers_[lod - 1u];
+  }
+
+ protected:
+  // Downsamples the given blocks into all coarser levels and flags them as
+  // updated there.
+  void downsampleBlocks(const BlockIndexList& block_indices) {
+    for (const BlockIndex& block_index : block_indices) {
+      const Block<TsdfVoxel>& block = tsdf_layer_->getBlockByIndex(block_index);
+      for (const std::unique_ptr<Layer<TsdfVoxel>>& lod_layer :
+           lod_tsdf_layers_) {
+        Block<TsdfVoxel>::Ptr coarse_block =
+            lod_layer->allocateBlockPtrByIndex(block_index);
+        downsampleBlock(block, config_.mesh_config.min_weight,
+                        coarse_block.get());
+        coarse_block->setUpdated();
+      }
+    }
+  }
+
+  // Removes the blocks and meshes of the coarser levels whose block was
+  // removed from the TSDF layer. The meshes of their coarse neighbors may be
+  // connected to them, so the neighbors are flagged as updated.
+  void pruneRemovedBlocks() {
+    for (size_t lod = 1u; lod < config_.num_lods; ++lod) {
+      Layer<TsdfVoxel>* lod_layer = lod_tsdf_layers_[lod - 1u].get();
+      MeshLayer* lod_mesh_layer = mesh_layer_->allocateLodLayer(lod);
+      BlockIndexList lod_blocks;
+      lod_layer->getAllAllocatedBlocks(&lod_blocks);
+      for (const BlockIndex& block_index : lod_blocks) {
+        if (tsdf_layer_->hasBlock(block_index)) {
+          continue;
+        }
+        lod_layer->removeBlock(block_index);
+        lod_mesh_layer->removeMesh(block_index);
+
+        BlockIndex block_offset;
+        for (block_offset.x() = -1; block_offset.x() <= 1;
+             ++block_offset.x()) {
+          for (block_offset.y() = -1; block_offset.y() <= 1;
+               ++block_offset.y()) {
+            for (block_offset.z() = -1; block_offset.z() <= 1;
+                 ++block_offset.z()) {
+              Block<TsdfVoxel>::Ptr neighbor_block =
+                  lod_layer->getBlockPtrByIndex(block_index + block_offset);
+              if (neighbor_block) {
+                neighbor_block->setUpdated();
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+
+  Config config_;
+
+  Layer<TsdfVoxel>* tsdf_layer_;
+  MeshLayer* mesh_layer_;
+
+  // Downsampled TSDF layers of the levels 1 and up.
+  std::vector<std::unique_ptr<Layer<TsdfVoxel>>> lod_tsdf_layers_;
+  // Integrators of all levels, from the finest to the coarsest.
+  std::vector<std::unique_ptr<MeshIntegrator>> lod_integrators_;
+};
+
+}  // namespace voxblox
+
+#endif  // VOXBLOX_MESH_LOD_MESH_INTEGRATOR_H_
@@ -23,6 +23,12 @@
 #ifndef VOXBLOX_MESH_MARCHING_CUBES_H_
 #define VOXBLOX_MESH_MARCHING_CUBES_H_
 
+#include <cstdint>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
 #include "voxblox/mesh/mesh.h"
 
 namespace voxblox {
@@ -31,6 +37,7 @@ class MarchingCubes {
  public:
   static int kTriangleTable[256][16];
   static int kEdgeIndexPairs[12][2];
+  static int kEdgeStartCornerAndAxis[12][2];
 
   MarchingCubes() {}
   virtual ~MarchingCubes() {}
@@ -105,6 +112,48 @@ class MarchingCubes {
     }
   }
 
+  // Bit i of the result is set if values[i] < threshold, for up to 64 values.
+  static inline uint64_t computeLessThanMask(const FloatingPoint* values,
+                                             int num_values,
+                                             FloatingPoint threshold) {
+    DCHECK_LE(num_values, 64);
+    uint64_t mask = 0u;
+    int i = 0;
+#ifdef __SSE__
+    const __m128 threshold_4 = _mm_set1_ps(threshold);
+    for (; i + 4 <= num_values; i += 4) {
+      mask |= static_cast<uint64_t>(_mm_movemask_ps(
+                  _mm_cmplt_ps(_mm_loadu_ps(values + i), threshold_4)))
+              << i;
+    }
+#endif
+    for (; i < num_values; ++i) {
+      mask |= static_cast<uint64_t>(values[i] < threshold) << i;
+    }
+    return mask;
+  }
+
+  // Bit i of the result is set if values[i] > threshold, for up to 64 values.
+  static inline uint64_t computeGreaterThanMask(const FloatingPoint* values,
+                                                int num_values,
+                                                FloatingPoint threshold) {
+    DCHECK_LE(num_values, 64);
+    uint64_t mask = 0u;
+    int i = 0;
+#ifdef __SSE__
+    const __m128 threshold_4 = _mm_set1_ps(threshold);
+    for (; i + 4 <= num_values; i += 4) {
+      mask |= static_cast<uint64_t>(_mm_movemask_ps(
+                  _mm_cmpgt_ps(_mm_loadu_ps(values + i), threshold_4)))
+              << i;
+    }
+#endif
+    for (; i < num_values; ++i) {
+      mask |= static_cast<uint64_t>(values[i] > threshold) << i;
+    }
+    return mask;
+  }
+
   static int calculateVertexConfiguration(
       const Eigen::Matrix<FloatingPoint, 8, 1>& vertex_sdf) {
     return (vertex_sdf(0) < 0 ? (1 << 0) : 0) |
@@ -140,13 +189,20 @@ class MarchingCubes {
   static inline Point interpolateVertex(const Point& vertex1,
                                         const Point& vertex2, float sdf1,
                                         float sdf2) {
+    const FloatingPoint t = computeInterpolationWeight(sdf1, sdf2);
+    return Point(vertex1 + t * (vertex2 - vertex1));
+  }
+
+  // Position of the zero crossing between two corners, from 0 at the first
+  // to 1 at the second one.
+  static inline FloatingPoint computeInterpolationWeight(float sdf1,
+                                                         float sdf2) {
     const FloatingPoint min_diff = 1e-6;
     const FloatingPoint sdf_diff = sdf1 - sdf2;
     if (std::abs(sdf_diff) < min_diff) {
-      return Point(vertex1 + 0.5 * vertex2);
+      return 0.5;
     }
-    const FloatingPoint t = sdf1 / sdf_diff;
-    return Point(vertex1 + t * (vertex2 - vertex1));
+    return sdf1 / sdf_diff;
   }
 };
 
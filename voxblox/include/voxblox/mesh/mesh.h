@@ -24,6 +24,7 @@
 #define VOXBLOX_MESH_MESH_H_
 
 #include <cstdint>
+#include <vector>
 
 #include "voxblox/core/common.h"
 
@@ -50,6 +51,8 @@ struct Mesh {
     normals.clear();
     colors.clear();
     indices.clear();
+    sub_cell_vertex_offsets.clear();
+    sub_cell_index_offsets.clear();
   }
 
   Pointcloud vertices;
@@ -57,6 +60,12 @@ struct Mesh {
   Pointcloud normals;
   Colors colors;
 
+  // If the mesh was extracted per sub-cell of the block, see
+  // MeshIntegrator::Config::use_sub_cell_updates, the vertices and indices of
+  // sub-cell i are in the range [offsets[i], offsets[i + 1]).
+  std::vector<size_t> sub_cell_vertex_offsets;
+  std::vector<size_t> sub_cell_index_offsets;
+
   FloatingPoint block_size;
   Point origin;
 };
@@ -24,6 +24,10 @@
 #define VOXBLOX_MESH_MESH_INTEGRATOR_H_
 
 #include <algorithm>
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <thread>
 #include <vector>
 
 #include <Eigen/Core>
@@ -31,6 +35,7 @@
 
 #include "voxblox/core/layer.h"
 #include "voxblox/core/voxel.h"
+#include "voxblox/mesh/dual_contouring.h"
 #include "voxblox/mesh/marching_cubes.h"
 #include "voxblox/mesh/mesh_layer.h"
 #include "voxblox/utils/timing.h"
@@ -40,10 +45,29 @@ namespace voxblox {
 
 class MeshIntegrator {
  public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
   struct Config {
     bool use_color = true;
     bool compute_normals = true;
     float min_weight = 1e-4;
+    // Share the vertices between the triangles of a block instead of storing
+    // three vertices per triangle.
+    bool use_indexed_mesh = false;
+    // Blocks are meshed in parallel by this many threads.
+    size_t integrator_threads = std::thread::hardware_concurrency();
+    // Extract the meshes per sub-cell of the blocks, so that updates only
+    // re-mesh the sub-cells whose cubes touch updated voxels, including the
+    // ones in neighboring blocks. Indexed meshes then only share vertices
+    // within a sub-cell.
+    bool use_sub_cell_updates = false;
+    // Place one vertex per cube at the minimizer of the QEF of its zero
+    // crossings instead of running marching cubes, which keeps sharp edges
+    // and corners of the surface. Sub-cell updates are not supported.
+    bool use_dual_contouring = false;
+    // Relative eigenvalue threshold of the dual contouring QEF below which a
+    // direction is considered unconstrained.
+    float dual_contouring_singular_threshold = 0.1;
   };
 
   MeshIntegrator(const Config& config, Layer<TsdfVoxel>* tsdf_layer,
@@ -51,6 +75,16 @@ class MeshIntegrator {
       : config_(config),
         tsdf_layer_(CHECK_NOTNULL(tsdf_layer)),
         mesh_layer_(CHECK_NOTNULL(mesh_layer)) {
+    if (config_.integrator_threads == 0) {
+      LOG(WARNING) << "Automatic core count failed, defaulting to 1 threads";
+      config_.integrator_threads = 1;
+    }
+    if (config_.use_dual_contouring && config_.use_sub_cell_updates) {
+      LOG(WARNING) << "Sub-cell updates are not supported with dual "
+                      "contouring, meshing whole blocks instead.";
+      config_.use_sub_cell_updates = false;
+    }
+
     voxel_size_ = tsdf_layer_->voxel_size();
     block_size_ = tsdf_layer_->block_size();
     voxels_per_side_ = tsdf_layer_->voxels_per_side();
@@ -61,6 +95,10 @@ class MeshIntegrator {
 
     cube_index_offsets_ << 0, 1, 1, 0, 0, 1, 1, 0, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0,
         0, 0, 1, 1, 1, 1;
+    cube_coord_offsets_ =
+        cube_index_offsets_.cast<FloatingPoint>() * voxel_size_;
+
+    initializeSubCellDependencies();
   }
 
   // Generates mesh for the entire tsdf layer from scratch.
@@ -70,9 +108,7 @@ class MeshIntegrator {
     BlockIndexList all_tsdf_blocks;
     tsdf_layer_->getAllAllocatedBlocks(&all_tsdf_blocks);
 
-    for (const BlockIndex& block_index : all_tsdf_blocks) {
-      updateMeshForBlock(block_index);
-    }
+    generateMeshForBlocks(all_tsdf_blocks);
   }
 
   void generateMeshForUpdatedBlocks(bool clear_updated_flag) {
@@ -82,19 +118,81 @@ class MeshIntegrator {
     BlockIndexList all_tsdf_blocks;
     tsdf_layer_->getAllAllocatedBlocks(&all_tsdf_blocks);
 
+    BlockIndexList updated_blocks;
     for (const BlockIndex& block_index : all_tsdf_blocks) {
-      Block<TsdfVoxel>::Ptr block =
-          tsdf_layer_->getBlockPtrByIndex(block_index);
-      if (block->updated()) {
-        updateMeshForBlock(block_index);
-        if (clear_updated_flag) {
-          block->updated() = false;
-        }
+      if (tsdf_layer_->getBlockByIndex(block_index).updated()) {
+        updated_blocks.push_back(block_index);
+      }
+    }
+
+    if (config_.use_sub_cell_updates) {
+      BlockIndexList dirty_blocks;
+      std::vector<uint64_t> dirty_sub_cells;
+      getDirtySubCells(updated_blocks, &dirty_blocks, &dirty_sub_cells);
+      generateMeshForBlocks(dirty_blocks, dirty_sub_cells);
+    } else {
+      generateMeshForBlocks(updated_blocks);
+    }
+
+    if (clear_updated_flag) {
+      for (const BlockIndex& block_index : updated_blocks) {
+        Block<TsdfVoxel>& block = tsdf_layer_->getBlockByIndex(block_index);
+        block.updated() = false;
+        block.clearDirtySubCells();
+      }
+    }
+  }
+
+  void generateMeshForBlocks(const BlockIndexList& block_indices) {
+    generateMeshForBlocks(
+        block_indices,
+        std::vector<uint64_t>(block_indices.size(), kAllSubCells));
+  }
+
+  // Meshes the given blocks with config_.integrator_threads threads. The
+  // extraction of a block only reads the TSDF layer and writes its own mesh,
+  // so the only shared state is the mesh layer, whose meshes are allocated
+  // before the threads are started. Only the given sub-cells of the blocks are
+  // re-meshed if config_.use_sub_cell_updates is set.
+  void generateMeshForBlocks(const BlockIndexList& block_indices,
+                             const std::vector<uint64_t>& sub_cells) {
+    DCHECK_EQ(block_indices.size(), sub_cells.size());
+    std::vector<Mesh::Ptr> meshes;
+    meshes.reserve(block_indices.size());
+    for (const BlockIndex& block_index : block_indices) {
+      meshes.push_back(mesh_layer_->allocateMeshPtrByIndex(block_index));
+    }
+
+    std::atomic<size_t> next_block_idx(0u);
+    const size_t num_threads =
+        std::min(config_.integrator_threads, block_indices.size());
+    if (num_threads <= 1u) {
+      updateMeshForBlocks(block_indices, sub_cells, meshes, &next_block_idx);
+    } else {
+      std::vector<std::thread> integration_threads;
+      for (size_t i = 0; i < num_threads; ++i) {
+        integration_threads.emplace_back(
+            &MeshIntegrator::updateMeshForBlocks, this,
+            std::cref(block_indices), std::cref(sub_cells), std::cref(meshes),
+            &next_block_idx);
+      }
+
+      for (std::thread& thread : integration_threads) {
+        thread.join();
       }
     }
   }
 
   void extractBlockMesh(Block<TsdfVoxel>::ConstPtr block, Mesh::Ptr mesh) {
+    CHECK(block);
+    CHECK(mesh);
+    extractBlockMeshSlabs(*block, mesh.get());
+  }
+
+  // Reference implementation of extractBlockMesh that gathers the corners of
+  // every cube separately. Does not support indexed meshes.
+  void extractBlockMeshPerCube(Block<TsdfVoxel>::ConstPtr block,
+                               Mesh::Ptr mesh) {
     size_t vps = block->voxels_per_side();
     VertexIndex next_mesh_index = 0;
 
@@ -141,29 +239,225 @@ class MeshIntegrator {
     }
   }
 
+  // Marching cubes over whole z-slabs of the block. The block is first copied
+  // into a padded block that also contains the adjacent voxels of its
+  // neighbors, together with bitmasks of the observed and the inside voxels of
+  // every row along x. The kernel then runs uniformly over all cubes without
+  // any block lookups, and rows of cubes without an observed sign change are
+  // skipped on the bitmasks alone. If enabled, the vertex colors and normals
+  // are interpolated along the edges from the colors and SDF gradients at the
+  // corners.
+  //
+  // For indexed meshes every zero crossing on a voxel edge becomes a single
+  // vertex that is shared by all triangles touching it. The vertex ids of the
+  // edges in the bottom and top slice of the slab are cached, so each crossing
+  // is only interpolated once.
+  void extractBlockMeshSlabs(const Block<TsdfVoxel>& block, Mesh* mesh) {
+    DCHECK_NOTNULL(mesh);
+    PaddedBlock padded_block;
+    fillPaddedBlock(block, &padded_block);
+    if (config_.use_dual_contouring) {
+      extractPaddedBlockDualMesh(block, padded_block, mesh);
+    } else {
+      extractPaddedBlockMesh(
+          block, padded_block, VoxelIndex::Zero(),
+          VoxelIndex::Constant(static_cast<int>(block.voxels_per_side())),
+          mesh);
+    }
+
+    if (config_.use_indexed_mesh && !config_.compute_normals) {
+      computeIndexedMeshFaceNormals(mesh);
+    }
+  }
+
+  // Area weighted face normals of the shared vertices, used if the SDF
+  // gradient normals are disabled.
+  void computeIndexedMeshFaceNormals(Mesh* mesh) const {
+    DCHECK_NOTNULL(mesh);
+    mesh->normals.assign(mesh->vertices.size(), Point::Zero());
+    for (size_t i = 0; i < mesh->indices.size(); i += 3) {
+      const Point& p0 = mesh->vertices[mesh->indices[i]];
+      const Point& p1 = mesh->vertices[mesh->indices[i + 1]];
+      const Point& p2 = mesh->vertices[mesh->indices[i + 2]];
+      const Point n = (p1 - p0).cross(p2 - p0);
+      mesh->normals[mesh->indices[i]] += n;
+      mesh->normals[mesh->indices[i + 1]] += n;
+      mesh->normals[mesh->indices[i + 2]] += n;
+    }
+    for (Point& normal : mesh->normals) {
+      const FloatingPoint norm = normal.norm();
+      if (norm > 0.0) {
+        normal /= norm;
+      }
+    }
+  }
+
+  // Called from the meshing threads for different blocks at the same time,
+  // overrides have to be thread-safe in that respect.
   virtual void updateMeshForBlock(const BlockIndex& block_index) {
-    Mesh::Ptr mesh = mesh_layer_->allocateMeshPtrByIndex(block_index);
-    mesh->clear();
+    updateMeshForBlock(block_index,
+                       mesh_layer_->allocateMeshPtrByIndex(block_index));
+  }
+
+  void updateMeshForBlock(const BlockIndex& block_index, Mesh::Ptr mesh) {
+    updateMeshForBlock(block_index, kAllSubCells, mesh);
+  }
+
+  // Regenerates the already allocated mesh of a block, safe to call from
+  // several threads for different blocks. The sub-cells are only used if
+  // config_.use_sub_cell_updates is set.
+  void updateMeshForBlock(const BlockIndex& block_index, uint64_t sub_cells,
+                          Mesh::Ptr mesh) {
+    CHECK(mesh);
     // This block should already exist, otherwise it makes no sense to update
     // the mesh for it. ;)
     Block<TsdfVoxel>::ConstPtr block =
         tsdf_layer_->getBlockPtrByIndex(block_index);
 
     if (!block) {
+      mesh->clear();
       LOG(ERROR) << "Trying to mesh a non-existent block at index: "
                  << block_index.transpose();
       return;
     }
 
+    if (config_.use_sub_cell_updates) {
+      updateMeshForSubCells(*block, sub_cells, mesh.get());
+      return;
+    }
+
+    mesh->clear();
     extractBlockMesh(block, mesh);
+  }
 
-    // Update colors if needed.
-    if (config_.use_color) {
-      updateMeshColor(*block, mesh.get());
+  // Re-meshes the given sub-cells of the block and keeps the triangles of all
+  // others. Meshes that were not extracted per sub-cell are regenerated
+  // completely.
+  void updateMeshForSubCells(const Block<TsdfVoxel>& block, uint64_t sub_cells,
+                             Mesh* mesh) {
+    DCHECK_NOTNULL(mesh);
+    if (mesh->sub_cell_vertex_offsets.size() != kNumSubCells + 1u) {
+      sub_cells = kAllSubCells;
+    }
+
+    // Only the voxels around the dirty sub-cells are needed.
+    VoxelIndex min_dirty_index =
+        VoxelIndex::Constant(static_cast<int>(voxels_per_side_));
+    VoxelIndex max_dirty_index = VoxelIndex::Zero();
+    VoxelIndex min_index, max_index;
+    for (int sub_cell = 0; sub_cell < kNumSubCells; ++sub_cell) {
+      if (((sub_cells >> sub_cell) & 1u) != 0u &&
+          getSubCellVoxelRange(sub_cell, &min_index, &max_index)) {
+        min_dirty_index = min_dirty_index.cwiseMin(min_index);
+        max_dirty_index = max_dirty_index.cwiseMax(max_index);
+      }
+    }
+    PaddedBlock padded_block;
+    fillPaddedBlock(block, min_dirty_index, max_dirty_index, &padded_block);
+
+    Mesh updated_mesh(mesh->block_size, mesh->origin);
+    updated_mesh.sub_cell_vertex_offsets.reserve(kNumSubCells + 1u);
+    updated_mesh.sub_cell_index_offsets.reserve(kNumSubCells + 1u);
+    Mesh sub_cell_mesh(mesh->block_size, mesh->origin);
+    for (int sub_cell = 0; sub_cell < kNumSubCells; ++sub_cell) {
+      updated_mesh.sub_cell_vertex_offsets.push_back(
+          updated_mesh.vertices.size());
+      updated_mesh.sub_cell_index_offsets.push_back(
+          updated_mesh.indices.size());
+
+      if (((sub_cells >> sub_cell) & 1u) == 0u) {
+        appendMeshRange(*mesh, mesh->sub_cell_vertex_offsets[sub_cell],
+                        mesh->sub_cell_vertex_offsets[sub_cell + 1],
+                        mesh->sub_cell_index_offsets[sub_cell],
+                        mesh->sub_cell_index_offsets[sub_cell + 1],
+                        &updated_mesh);
+        continue;
+      }
+
+      if (!getSubCellVoxelRange(sub_cell, &min_index, &max_index)) {
+        continue;
+      }
+      sub_cell_mesh.clear();
+      extractPaddedBlockMesh(block, padded_block, min_index, max_index,
+                             &sub_cell_mesh);
+      if (config_.use_indexed_mesh && !config_.compute_normals) {
+        computeIndexedMeshFaceNormals(&sub_cell_mesh);
+      }
+      appendMeshRange(sub_cell_mesh, 0u, sub_cell_mesh.vertices.size(), 0u,
+                      sub_cell_mesh.indices.size(), &updated_mesh);
+    }
+    updated_mesh.sub_cell_vertex_offsets.push_back(
+        updated_mesh.vertices.size());
+    updated_mesh.sub_cell_index_offsets.push_back(updated_mesh.indices.size());
+
+    mesh->vertices.swap(updated_mesh.vertices);
+    mesh->indices.swap(updated_mesh.indices);
+    mesh->normals.swap(updated_mesh.normals);
+    mesh->colors.swap(updated_mesh.colors);
+    mesh->sub_cell_vertex_offsets.swap(updated_mesh.sub_cell_vertex_offsets);
+    mesh->sub_cell_index_offsets.swap(updated_mesh.sub_cell_index_offsets);
+  }
+
+  // Collects the sub-cells of all blocks whose cubes have a corner in a dirty
+  // sub-cell of the updated blocks. The cubes on the max faces of a block
+  // reach into its neighbors in positive direction, so the neighbors in
+  // negative direction of an updated block may have to be re-meshed as well.
+  void getDirtySubCells(const BlockIndexList& updated_blocks,
+                        BlockIndexList* dirty_blocks,
+                        std::vector<uint64_t>* dirty_sub_cells) const {
+    CHECK_NOTNULL(dirty_blocks);
+    CHECK_NOTNULL(dirty_sub_cells);
+    BlockHashMapType<uint64_t>::type dirty_block_map;
+    for (const BlockIndex& block_index : updated_blocks) {
+      uint64_t voxel_sub_cells =
+          tsdf_layer_->getBlockByIndex(block_index).dirty_sub_cells();
+      if (voxel_sub_cells == 0u) {
+        voxel_sub_cells = kAllSubCells;
+      }
+      BlockIndex block_offset;
+      for (block_offset.x() = -1; block_offset.x() <= 1; ++block_offset.x()) {
+        for (block_offset.y() = -1; block_offset.y() <= 1;
+             ++block_offset.y()) {
+          for (block_offset.z() = -1; block_offset.z() <= 1;
+               ++block_offset.z()) {
+            const uint64_t cube_sub_cells =
+                getDependentCubeSubCells(voxel_sub_cells, block_offset);
+            const BlockIndex dependent_index = block_index - block_offset;
+            if (cube_sub_cells != 0u &&
+                tsdf_layer_->hasBlock(dependent_index)) {
+              dirty_block_map[dependent_index] |= cube_sub_cells;
+            }
+          }
+        }
+      }
     }
 
-    if (config_.compute_normals) {
-      computeMeshNormals(*block, mesh.get());
+    dirty_blocks->clear();
+    dirty_sub_cells->clear();
+    for (const std::pair<const BlockIndex, uint64_t>& kv : dirty_block_map) {
+      dirty_blocks->push_back(kv.first);
+      dirty_sub_cells->push_back(kv.second);
+    }
+  }
+
+  // Worker of generateMeshForBlocks, pulls blocks until none are left.
+  void updateMeshForBlocks(const BlockIndexList& block_indices,
+                           const std::vector<uint64_t>& sub_cells,
+                           const std::vector<Mesh::Ptr>& meshes,
+                           std::atomic<size_t>* next_block_idx) {
+    DCHECK_NOTNULL(next_block_idx);
+    DCHECK_EQ(block_indices.size(), meshes.size());
+    size_t block_idx;
+    while ((block_idx = (*next_block_idx)++) < block_indices.size()) {
+      // Whole blocks go through the virtual overload so subclasses can
+      // customize the meshing. Its mesh lookup does not allocate, since all
+      // meshes were allocated before the threads were started.
+      if (sub_cells[block_idx] == kAllSubCells) {
+        updateMeshForBlock(block_indices[block_idx]);
+      } else {
+        updateMeshForBlock(block_indices[block_idx], sub_cells[block_idx],
+                           meshes[block_idx]);
+      }
     }
   }
 
@@ -266,11 +560,14 @@ class MeshIntegrator {
     }
   }
 
+  // Nearest neighbor colors of the vertices. The mesh extraction interpolates
+  // the colors of the corner voxels instead if config_.use_color is set, this
+  // is kept for reference.
   void updateMeshColor(const Block<TsdfVoxel>& block, Mesh* mesh) {
     CHECK_NOTNULL(mesh);
 
     mesh->colors.clear();
-    mesh->colors.resize(mesh->indices.size());
+    mesh->colors.resize(mesh->vertices.size());
 
     // Use nearest-neighbor search.
     for (size_t i = 0; i < mesh->vertices.size(); i++) {
@@ -301,9 +598,12 @@ class MeshIntegrator {
     }
   }
 
+  // Normals from the interpolated gradient of the TSDF layer. The mesh
+  // extraction computes them directly from the corner voxels if
+  // config_.compute_normals is set, this is kept for reference.
   void computeMeshNormals(const Block<TsdfVoxel>& block, Mesh* mesh) {
     mesh->normals.clear();
-    mesh->normals.resize(mesh->indices.size(), Point::Zero());
+    mesh->normals.resize(mesh->vertices.size(), Point::Zero());
 
     Interpolator<TsdfVoxel> interpolator(tsdf_layer_);
 
@@ -320,6 +620,745 @@ class MeshIntegrator {
   }
 
  protected:
+  // Copy of a block padded with one layer of voxels of its neighbors on the
+  // min faces and two on the max faces, i.e. the voxels in [-1, vps + 1]^3 in
+  // the layout of a block. This covers the corners of all cubes of the block
+  // and the central differences at these corners. The rows along x are split
+  // into segments of up to kCubesPerRowSegment cubes, so that the voxels of a
+  // segment fit into a 64 bit mask.
+  struct PaddedBlock {
+    int side;
+    int num_segments;
+    std::vector<FloatingPoint> distances;
+    std::vector<FloatingPoint> weights;
+    // Only filled if the colors are used.
+    std::vector<Color> colors;
+    // Per row and segment, bit i is set if voxel segment_start + i is
+    // observed or inside the surface, respectively, starting at x = 0.
+    std::vector<uint64_t> observed;
+    std::vector<uint64_t> inside;
+
+    inline size_t getRowIndex(int y, int z) const {
+      return (y + 1) + side * (z + 1);
+    }
+    inline size_t getLinearIndex(const VoxelIndex& index) const {
+      return (index.x() + 1) + side * getRowIndex(index.y(), index.z());
+    }
+  };
+
+  static constexpr int kCubesPerRowSegment = 63;
+  static constexpr int kNumSubCells =
+      kSubCellsPerSide * kSubCellsPerSide * kSubCellsPerSide;
+
+  // Sub-cell coordinates of bit sub_cell of a sub-cell mask, x fastest.
+  static VoxelIndex getSubCellIndex(int sub_cell) {
+    return VoxelIndex(sub_cell % kSubCellsPerSide,
+                      (sub_cell / kSubCellsPerSide) % kSubCellsPerSide,
+                      sub_cell / (kSubCellsPerSide * kSubCellsPerSide));
+  }
+
+  // Voxel range [min_index, max_index) of a sub-cell, which is empty for the
+  // last sub-cells if the voxels per side are not divisible by
+  // kSubCellsPerSide.
+  bool getSubCellVoxelRange(int sub_cell, VoxelIndex* min_index,
+                            VoxelIndex* max_index) const {
+    DCHECK_NOTNULL(min_index);
+    DCHECK_NOTNULL(max_index);
+    *min_index = getSubCellIndex(sub_cell) * sub_cell_size_;
+    *max_index = (min_index->array() + static_cast<int>(sub_cell_size_))
+                     .min(static_cast<int>(voxels_per_side_));
+    return (max_index->array() > min_index->array()).all();
+  }
+
+  // Sub-cells of the cubes of the block at -block_offset that have a corner,
+  // or a voxel used for the normals, in one of the given sub-cells of the
+  // voxels of this block.
+  uint64_t getDependentCubeSubCells(uint64_t voxel_sub_cells,
+                                    const BlockIndex& block_offset) const {
+    uint64_t sub_cells = voxel_sub_cells;
+    int stride = 1;
+    for (int axis = 0; axis < 3; ++axis, stride *= kSubCellsPerSide) {
+      const uint8_t* dependencies =
+          sub_cell_dependencies_[block_offset(axis) + 1];
+      uint64_t dependent_sub_cells = 0u;
+      for (int voxel_cell = 0; voxel_cell < kSubCellsPerSide; ++voxel_cell) {
+        const uint64_t layer = sub_cells & sub_cell_layers_[axis][voxel_cell];
+        if (layer == 0u) {
+          continue;
+        }
+        for (int cube_cell = 0; cube_cell < kSubCellsPerSide; ++cube_cell) {
+          if (((dependencies[voxel_cell] >> cube_cell) & 1u) == 0u) {
+            continue;
+          }
+          const int shift = (cube_cell - voxel_cell) * stride;
+          dependent_sub_cells |= (shift >= 0) ? (layer << shift)
+                                              : (layer >> -shift);
+        }
+      }
+      sub_cells = dependent_sub_cells;
+    }
+    return sub_cells;
+  }
+
+  // Precomputes along a single axis which sub-cells of cubes depend on which
+  // sub-cells of voxels, for the same block and the neighbors on both sides.
+  void initializeSubCellDependencies() {
+    sub_cell_size_ =
+        (voxels_per_side_ + kSubCellsPerSide - 1) / kSubCellsPerSide;
+    const int vps = static_cast<int>(voxels_per_side_);
+    const int sub_cell_size = static_cast<int>(sub_cell_size_);
+
+    // The cube at v has its corners at v and v + 1, the normals are central
+    // differences around the corners and reach one voxel further.
+    const int reach = config_.compute_normals ? 1 : 0;
+    for (int offset = -1; offset <= 1; ++offset) {
+      for (int voxel_cell = 0; voxel_cell < kSubCellsPerSide; ++voxel_cell) {
+        uint8_t& dependencies = sub_cell_dependencies_[offset + 1][voxel_cell];
+        dependencies = 0u;
+        // Voxel range of the sub-cell in the frame of the other block.
+        const int voxel_begin = voxel_cell * sub_cell_size + offset * vps;
+        const int voxel_end =
+            std::min((voxel_cell + 1) * sub_cell_size, vps) + offset * vps;
+        for (int cube_cell = 0; cube_cell < kSubCellsPerSide; ++cube_cell) {
+          const int cube_begin = cube_cell * sub_cell_size;
+          const int cube_end = std::min(cube_begin + sub_cell_size, vps);
+          if (voxel_begin < voxel_end && cube_begin < cube_end &&
+              cube_begin < voxel_end + reach &&
+              voxel_begin - 1 - reach < cube_end) {
+            dependencies |= 1u << cube_cell;
+          }
+        }
+      }
+    }
+
+    for (int axis = 0; axis < 3; ++axis) {
+      for (int cell = 0; cell < kSubCellsPerSide; ++cell) {
+        sub_cell_layers_[axis][cell] = 0u;
+      }
+    }
+    for (int sub_cell = 0; sub_cell < kNumSubCells; ++sub_cell) {
+      const VoxelIndex sub_cell_index = getSubCellIndex(sub_cell);
+      for (int axis = 0; axis < 3; ++axis) {
+        sub_cell_layers_[axis][sub_cell_index(axis)] |=
+            static_cast<uint64_t>(1) << sub_cell;
+      }
+    }
+  }
+
+  static void appendMeshRange(const Mesh& source, size_t vertex_begin,
+                              size_t vertex_end, size_t index_begin,
+                              size_t index_end, Mesh* target) {
+    DCHECK_NOTNULL(target);
+    const size_t target_vertex_begin = target->vertices.size();
+    target->vertices.insert(target->vertices.end(),
+                            source.vertices.begin() + vertex_begin,
+                            source.vertices.begin() + vertex_end);
+    if (source.hasNormals()) {
+      target->normals.insert(target->normals.end(),
+                             source.normals.begin() + vertex_begin,
+                             source.normals.begin() + vertex_end);
+    }
+    if (source.hasColors()) {
+      target->colors.insert(target->colors.end(),
+                            source.colors.begin() + vertex_begin,
+                            source.colors.begin() + vertex_end);
+    }
+    for (size_t i = index_begin; i < index_end; ++i) {
+      target->indices.push_back(source.indices[i] - vertex_begin +
+                                target_vertex_begin);
+    }
+  }
+
+  void fillPaddedBlock(const Block<TsdfVoxel>& block,
+                       PaddedBlock* padded_block) const {
+    fillPaddedBlock(
+        block, VoxelIndex::Zero(),
+        VoxelIndex::Constant(static_cast<int>(voxels_per_side_)),
+        padded_block);
+  }
+
+  // Voxels of unallocated neighbor blocks are unobserved. Only fills the rows
+  // needed for the cubes with min corner in [min_index, max_index), the
+  // neighbor blocks are only looked up once here.
+  void fillPaddedBlock(const Block<TsdfVoxel>& block,
+                       const VoxelIndex& min_index, const VoxelIndex& max_index,
+                       PaddedBlock* padded_block) const {
+    DCHECK_NOTNULL(padded_block);
+    const int vps = static_cast<int>(voxels_per_side_);
+    DCHECK_GE(vps, 2);
+    const int side = vps + 3;
+    const int num_segments =
+        (vps + kCubesPerRowSegment - 1) / kCubesPerRowSegment;
+    padded_block->side = side;
+    padded_block->num_segments = num_segments;
+    padded_block->distances.resize(side * side * side);
+    padded_block->weights.resize(side * side * side);
+    if (config_.use_color) {
+      padded_block->colors.resize(side * side * side);
+    }
+    padded_block->observed.resize(side * side * num_segments);
+    padded_block->inside.resize(side * side * num_segments);
+
+    // Indexed by (x + 1) + 3 * ((y + 1) + 3 * (z + 1)) for a block offset of
+    // (x, y, z).
+    const VoxelIndex min_voxel = min_index.array() - 1;
+    const VoxelIndex max_voxel = max_index.array() + 1;
+    const BlockIndex min_block_offset(
+        -1, (min_voxel.y() < 0) ? -1 : 0, (min_voxel.z() < 0) ? -1 : 0);
+    const BlockIndex max_block_offset(1, (max_voxel.y() < vps) ? 0 : 1,
+                                      (max_voxel.z() < vps) ? 0 : 1);
+    Block<TsdfVoxel>::ConstPtr neighbor_blocks[27];
+    const Block<TsdfVoxel>* blocks[27];
+    BlockIndex block_offset;
+    for (block_offset.z() = min_block_offset.z();
+         block_offset.z() <= max_block_offset.z(); ++block_offset.z()) {
+      for (block_offset.y() = min_block_offset.y();
+           block_offset.y() <= max_block_offset.y(); ++block_offset.y()) {
+        for (block_offset.x() = -1; block_offset.x() <= 1; ++block_offset.x()) {
+          const int i =
+              (block_offset.x() + 1) +
+              3 * ((block_offset.y() + 1) + 3 * (block_offset.z() + 1));
+          if (block_offset.isZero()) {
+            blocks[i] = &block;
+            continue;
+          }
+          neighbor_blocks[i] =
+              static_cast<const Layer<TsdfVoxel>*>(tsdf_layer_)
+                  ->getBlockPtrByIndex(block.block_index() + block_offset);
+          blocks[i] = neighbor_blocks[i].get();
+        }
+      }
+    }
+
+    for (int z = min_voxel.z(); z <= max_voxel.z(); ++z) {
+      const int block_z = (z < 0) ? -1 : ((z < vps) ? 0 : 1);
+      for (int y = min_voxel.y(); y <= max_voxel.y(); ++y) {
+        const int block_y = (y < 0) ? -1 : ((y < vps) ? 0 : 1);
+        const size_t row_start_index =
+            vps * ((y - block_y * vps) + vps * (z - block_z * vps));
+        const int row_blocks = 1 + 3 * ((block_y + 1) + 3 * (block_z + 1));
+        const size_t row_index = padded_block->getRowIndex(y, z);
+        FloatingPoint* distances = &padded_block->distances[row_index * side];
+        FloatingPoint* weights = &padded_block->weights[row_index * side];
+        Color* colors = config_.use_color
+                            ? &padded_block->colors[row_index * side]
+                            : nullptr;
+
+        // Voxels -1, [0, vps) and [vps, vps + 1] along x.
+        copyVoxels(blocks[row_blocks - 1], row_start_index + vps - 1, 1,
+                   distances, weights, colors);
+        copyVoxels(blocks[row_blocks], row_start_index, vps, distances + 1,
+                   weights + 1, (colors != nullptr) ? colors + 1 : nullptr);
+        copyVoxels(blocks[row_blocks + 1], row_start_index, 2,
+                   distances + vps + 1, weights + vps + 1,
+                   (colors != nullptr) ? colors + vps + 1 : nullptr);
+
+        for (int segment = 0; segment < num_segments; ++segment) {
+          const int segment_start = 1 + segment * kCubesPerRowSegment;
+          const int num_voxels =
+              std::min(kCubesPerRowSegment + 1, vps + 2 - segment_start);
+          padded_block->observed[row_index * num_segments + segment] =
+              MarchingCubes::computeGreaterThanMask(weights + segment_start,
+                                                    num_voxels,
+                                                    config_.min_weight);
+          padded_block->inside[row_index * num_segments + segment] =
+              MarchingCubes::computeLessThanMask(distances + segment_start,
+                                                 num_voxels, 0.0);
+        }
+      }
+    }
+  }
+
+  // The colors are skipped if null.
+  static void copyVoxels(const Block<TsdfVoxel>* block, size_t linear_index,
+                         int num_voxels, FloatingPoint* distances,
+                         FloatingPoint* weights, Color* colors) {
+    if (block == nullptr) {
+      std::fill(distances, distances + num_voxels, 0.0);
+      std::fill(weights, weights + num_voxels, 0.0);
+      return;
+    }
+    const TsdfVoxel* voxels = &block->getVoxelByLinearIndex(linear_index);
+    for (int i = 0; i < num_voxels; ++i) {
+      distances[i] = voxels[i].distance;
+      weights[i] = voxels[i].weight;
+    }
+    if (colors != nullptr) {
+      for (int i = 0; i < num_voxels; ++i) {
+        colors[i] = voxels[i].color;
+      }
+    }
+  }
+
+  // SDF gradient at a voxel of the padded block from central differences, or
+  // one-sided ones if only one neighbor is observed. Not scaled by the voxel
+  // size, as it is only used for normals.
+  inline Point computePaddedBlockGradient(const PaddedBlock& padded_block,
+                                          size_t linear_index) const {
+    const FloatingPoint* distances = padded_block.distances.data();
+    const FloatingPoint* weights = padded_block.weights.data();
+    Point gradient;
+    size_t stride = 1u;
+    for (int axis = 0; axis < 3; ++axis, stride *= padded_block.side) {
+      const size_t prev = linear_index - stride;
+      const size_t next = linear_index + stride;
+      const bool has_prev = weights[prev] > config_.min_weight;
+      const bool has_next = weights[next] > config_.min_weight;
+      if (has_prev && has_next) {
+        gradient(axis) = 0.5 * (distances[next] - distances[prev]);
+      } else if (has_next) {
+        gradient(axis) = distances[next] - distances[linear_index];
+      } else if (has_prev) {
+        gradient(axis) = distances[linear_index] - distances[prev];
+      } else {
+        gradient(axis) = 0.0;
+      }
+    }
+    return gradient;
+  }
+
+  // Appends the mesh of the cubes with min corner in [min_index, max_index).
+  void extractPaddedBlockMesh(const Block<TsdfVoxel>& block,
+                              const PaddedBlock& padded_block,
+                              const VoxelIndex& min_index,
+                              const VoxelIndex& max_index, Mesh* mesh) {
+    DCHECK_NOTNULL(mesh);
+    const int vps = static_cast<int>(block.voxels_per_side());
+    const int slice_side = vps + 1;
+    const VertexIndex kNoVertex = std::numeric_limits<VertexIndex>::max();
+    const int num_segments = padded_block.num_segments;
+
+    // Offsets of the cube corners in the padded block.
+    size_t corner_offsets[8];
+    for (unsigned int i = 0; i < 8; ++i) {
+      corner_offsets[i] =
+          padded_block.getLinearIndex(cube_index_offsets_.col(i)) -
+          padded_block.getLinearIndex(VoxelIndex::Zero());
+    }
+
+    // Vertex ids of the x, y and z edges starting at every voxel of the bottom
+    // and top slice. Only the x and y edges of the top slice are in the slab.
+    std::vector<VertexIndex> bottom_edge_vertices;
+    std::vector<VertexIndex> top_edge_vertices;
+    if (config_.use_indexed_mesh) {
+      bottom_edge_vertices.resize(3 * slice_side * slice_side, kNoVertex);
+      top_edge_vertices.resize(3 * slice_side * slice_side, kNoVertex);
+    }
+
+    Eigen::Matrix<FloatingPoint, 8, 1> corner_sdf;
+    // Vertex ids of the edges of the current cube, or just a marker for the
+    // interpolated ones if the mesh is not indexed.
+    VertexIndex edge_vertices[12];
+    Point edge_points[12];
+    Point edge_normals[12];
+    Color edge_colors[12];
+    VoxelIndex index;
+    for (index.z() = min_index.z(); index.z() < max_index.z(); ++index.z()) {
+      for (index.y() = min_index.y(); index.y() < max_index.y(); ++index.y()) {
+        // The four rows of voxels touched by this row of cubes.
+        const size_t row_00 =
+            padded_block.getRowIndex(index.y(), index.z()) * num_segments;
+        const size_t row_10 = row_00 + num_segments;
+        const size_t row_01 = row_00 + padded_block.side * num_segments;
+        const size_t row_11 = row_01 + num_segments;
+        for (int segment = 0; segment < num_segments; ++segment) {
+          // Bit i stands for the cube (or its corners) at x = segment_start + i
+          // and x = segment_start + i + 1.
+          const int segment_start = segment * kCubesPerRowSegment;
+          const int begin_cube = std::max(min_index.x() - segment_start, 0);
+          const int end_cube =
+              std::min(max_index.x() - segment_start,
+                       (vps - segment_start < kCubesPerRowSegment)
+                           ? vps - segment_start
+                           : kCubesPerRowSegment);
+          if (end_cube <= begin_cube) {
+            continue;
+          }
+          const std::vector<uint64_t>& observed_rows = padded_block.observed;
+          const std::vector<uint64_t>& inside_rows = padded_block.inside;
+          const uint64_t observed = observed_rows[row_00 + segment] &
+                                    observed_rows[row_10 + segment] &
+                                    observed_rows[row_01 + segment] &
+                                    observed_rows[row_11 + segment];
+          const uint64_t all_inside =
+              inside_rows[row_00 + segment] & inside_rows[row_10 + segment] &
+              inside_rows[row_01 + segment] & inside_rows[row_11 + segment];
+          const uint64_t any_inside =
+              inside_rows[row_00 + segment] | inside_rows[row_10 + segment] |
+              inside_rows[row_01 + segment] | inside_rows[row_11 + segment];
+          uint64_t active_cubes = observed & (observed >> 1) &
+                                  (any_inside | (any_inside >> 1)) &
+                                  ~(all_inside & (all_inside >> 1)) &
+                                  ((uint64_t(1) << end_cube) - 1u) &
+                                  ~((uint64_t(1) << begin_cube) - 1u);
+
+          while (active_cubes != 0u) {
+            index.x() = segment_start + __builtin_ctzll(active_cubes);
+            active_cubes &= active_cubes - 1u;
+
+            const size_t cube_linear_index = padded_block.getLinearIndex(index);
+            const FloatingPoint* cube_distances =
+                &padded_block.distances[cube_linear_index];
+            for (unsigned int i = 0; i < 8; ++i) {
+              corner_sdf(i) = cube_distances[corner_offsets[i]];
+            }
+            const Point coords = block.computeCoordinatesFromVoxelIndex(index);
+
+            const int* table_row = MarchingCubes::kTriangleTable[
+                MarchingCubes::calculateVertexConfiguration(corner_sdf)];
+            std::fill(edge_vertices, edge_vertices + 12, kNoVertex);
+            for (int table_col = 0; table_row[table_col] != -1; ++table_col) {
+              const int edge = table_row[table_col];
+              if (edge_vertices[edge] != kNoVertex) {
+                continue;
+              }
+              const int start_corner =
+                  MarchingCubes::kEdgeStartCornerAndAxis[edge][0];
+              VertexIndex* cached_vertex = nullptr;
+              if (config_.use_indexed_mesh) {
+                const int axis =
+                    MarchingCubes::kEdgeStartCornerAndAxis[edge][1];
+                std::vector<VertexIndex>& slice_edge_vertices =
+                    (cube_index_offsets_(2, start_corner) == 0)
+                        ? bottom_edge_vertices
+                        : top_edge_vertices;
+                cached_vertex = &slice_edge_vertices[
+                    3 * ((index.y() + cube_index_offsets_(1, start_corner)) *
+                             slice_side +
+                         index.x() + cube_index_offsets_(0, start_corner)) +
+                    axis];
+                if (*cached_vertex != kNoVertex) {
+                  edge_vertices[edge] = *cached_vertex;
+                  continue;
+                }
+              }
+
+              const int end_corner =
+                  (MarchingCubes::kEdgeIndexPairs[edge][0] == start_corner)
+                      ? MarchingCubes::kEdgeIndexPairs[edge][1]
+                      : MarchingCubes::kEdgeIndexPairs[edge][0];
+              const FloatingPoint t = MarchingCubes::computeInterpolationWeight(
+                  corner_sdf(start_corner), corner_sdf(end_corner));
+              const Point start_point =
+                  coords + cube_coord_offsets_.col(start_corner);
+              const Point end_point =
+                  coords + cube_coord_offsets_.col(end_corner);
+              edge_points[edge] = start_point + t * (end_point - start_point);
+              if (config_.compute_normals) {
+                const Point start_gradient = computePaddedBlockGradient(
+                    padded_block,
+                    cube_linear_index + corner_offsets[start_corner]);
+                const Point end_gradient = computePaddedBlockGradient(
+                    padded_block,
+                    cube_linear_index + corner_offsets[end_corner]);
+                Point& normal = edge_normals[edge];
+                normal = (1.0 - t) * start_gradient + t * end_gradient;
+                const FloatingPoint norm = normal.norm();
+                if (norm > 0.0) {
+                  normal /= norm;
+                }
+              }
+              if (config_.use_color) {
+                edge_colors[edge] = Color::blendTwoColors(
+                    padded_block.colors[cube_linear_index +
+                                        corner_offsets[start_corner]],
+                    1.0 - t,
+                    padded_block.colors[cube_linear_index +
+                                        corner_offsets[end_corner]],
+                    t);
+              }
+
+              if (cached_vertex == nullptr) {
+                edge_vertices[edge] = edge;
+                continue;
+              }
+              *cached_vertex = mesh->vertices.size();
+              edge_vertices[edge] = *cached_vertex;
+              mesh->vertices.push_back(edge_points[edge]);
+              if (config_.compute_normals) {
+                mesh->normals.push_back(edge_normals[edge]);
+              }
+              if (config_.use_color) {
+                mesh->colors.push_back(edge_colors[edge]);
+              }
+            }
+
+            // Same winding as MarchingCubes::meshCube.
+            for (int table_col = 0; table_row[table_col] != -1;
+                 table_col += 3) {
+              if (config_.use_indexed_mesh) {
+                for (int i = 2; i >= 0; --i) {
+                  mesh->indices.push_back(
+                      edge_vertices[table_row[table_col + i]]);
+                }
+                continue;
+              }
+              for (int i = 2; i >= 0; --i) {
+                const int edge = table_row[table_col + i];
+                mesh->indices.push_back(mesh->vertices.size());
+                mesh->vertices.push_back(edge_points[edge]);
+                if (config_.compute_normals) {
+                  mesh->normals.push_back(edge_normals[edge]);
+                }
+                if (config_.use_color) {
+                  mesh->colors.push_back(edge_colors[edge]);
+                }
+              }
+              if (!config_.compute_normals) {
+                const size_t first_vertex = mesh->vertices.size() - 3u;
+                const Point& p0 = mesh->vertices[first_vertex];
+                const Point& p1 = mesh->vertices[first_vertex + 1u];
+                const Point& p2 = mesh->vertices[first_vertex + 2u];
+                const Point n = (p1 - p0).cross(p2 - p0).normalized();
+                mesh->normals.push_back(n);
+                mesh->normals.push_back(n);
+                mesh->normals.push_back(n);
+              }
+            }
+          }
+        }
+      }
+
+      if (config_.use_indexed_mesh) {
+        bottom_edge_vertices.swap(top_edge_vertices);
+        std::fill(top_edge_vertices.begin(), top_edge_vertices.end(),
+                  kNoVertex);
+      }
+    }
+  }
+
+  // Vertex of a cube for dual contouring.
+  struct DualVertex {
+    Point point;
+    Point normal;
+    Color color;
+  };
+
+  // Computes the dual contouring vertex of the cube with min corner index,
+  // which may be in [-1, vps) along every axis. Returns false if the cube is
+  // not fully observed or has no zero crossing. The normals of the zero
+  // crossings are the gradients of the trilinear interpolation in the cube,
+  // so the vertex only depends on the 8 corners and is identical in both
+  // blocks that share the cube.
+  bool computeDualVertex(const Block<TsdfVoxel>& block,
+                         const PaddedBlock& padded_block,
+                         const size_t corner_offsets[8],
+                         const VoxelIndex& index, DualVertex* vertex) const {
+    DCHECK_NOTNULL(vertex);
+    const size_t cube_linear_index = padded_block.getLinearIndex(index);
+    Eigen::Matrix<FloatingPoint, 8, 1> corner_sdf;
+    for (unsigned int i = 0; i < 8; ++i) {
+      const size_t linear_index = cube_linear_index + corner_offsets[i];
+      if (padded_block.weights[linear_index] <= config_.min_weight) {
+        return false;
+      }
+      corner_sdf(i) = padded_block.distances[linear_index];
+    }
+    const int configuration =
+        MarchingCubes::calculateVertexConfiguration(corner_sdf);
+    if (configuration == 0 || configuration == 255) {
+      return false;
+    }
+
+    DualContouring::Qef qef;
+    Point normal_sum = Point::Zero();
+    FloatingPoint rgb_sum[3] = {0.0, 0.0, 0.0};
+    for (int edge = 0; edge < 12; ++edge) {
+      const int corner_0 = MarchingCubes::kEdgeIndexPairs[edge][0];
+      const int corner_1 = MarchingCubes::kEdgeIndexPairs[edge][1];
+      if ((corner_sdf(corner_0) < 0.0) == (corner_sdf(corner_1) < 0.0)) {
+        continue;
+      }
+      const FloatingPoint t = MarchingCubes::computeInterpolationWeight(
+          corner_sdf(corner_0), corner_sdf(corner_1));
+      const Point start = cube_index_offsets_.col(corner_0).cast<FloatingPoint>();
+      const Point end = cube_index_offsets_.col(corner_1).cast<FloatingPoint>();
+      const Point crossing = start + t * (end - start);
+      Point normal =
+          DualContouring::computeTrilinearGradient(corner_sdf, crossing);
+      const FloatingPoint norm = normal.norm();
+      if (norm > 0.0) {
+        normal /= norm;
+      }
+      qef.addPlane(crossing, normal);
+      normal_sum += normal;
+      if (config_.use_color) {
+        const Color color = Color::blendTwoColors(
+            padded_block.colors[cube_linear_index + corner_offsets[corner_0]],
+            1.0 - t,
+            padded_block.colors[cube_linear_index + corner_offsets[corner_1]],
+            t);
+        rgb_sum[0] += color.r;
+        rgb_sum[1] += color.g;
+        rgb_sum[2] += color.b;
+      }
+    }
+
+    // In units of voxels relative to the min corner, clamped to the cube.
+    const Point local_point =
+        DualContouring::solveQef(qef, config_.dual_contouring_singular_threshold)
+            .cwiseMax(0.0)
+            .cwiseMin(1.0);
+    vertex->point = block.computeCoordinatesFromVoxelIndex(index) +
+                    local_point * voxel_size_;
+    const FloatingPoint normal_norm = normal_sum.norm();
+    vertex->normal =
+        (normal_norm > 0.0) ? Point(normal_sum / normal_norm) : Point::Zero();
+    if (config_.use_color) {
+      vertex->color = Color(rgb_sum[0] / qef.num_points + 0.5,
+                            rgb_sum[1] / qef.num_points + 0.5,
+                            rgb_sum[2] / qef.num_points + 0.5);
+    }
+    return true;
+  }
+
+  // Dual contouring of a block. Every voxel edge with a zero crossing that
+  // starts at a voxel of the block becomes a quad connecting the vertices of
+  // the four cubes around it. The cubes around the edges on the min faces of
+  // the block belong to its neighbors, their vertices are computed here as
+  // well.
+  void extractPaddedBlockDualMesh(const Block<TsdfVoxel>& block,
+                                  const PaddedBlock& padded_block,
+                                  Mesh* mesh) const {
+    DCHECK_NOTNULL(mesh);
+    const int vps = static_cast<int>(block.voxels_per_side());
+    const VertexIndex kNoVertex = std::numeric_limits<VertexIndex>::max();
+    const VertexIndex kInvalidVertex = kNoVertex - 1u;
+
+    size_t corner_offsets[8];
+    for (unsigned int i = 0; i < 8; ++i) {
+      corner_offsets[i] =
+          padded_block.getLinearIndex(cube_index_offsets_.col(i)) -
+          padded_block.getLinearIndex(VoxelIndex::Zero());
+    }
+
+    // Ids of the computed vertices of the cubes in [-1, vps)^3.
+    const int cube_side = vps + 1;
+    std::vector<VertexIndex> cube_vertex_ids(cube_side * cube_side * cube_side,
+                                             kNoVertex);
+    AlignedVector<DualVertex> vertices;
+    auto get_vertex_id = [&](const VoxelIndex& cube_index) {
+      VertexIndex& id =
+          cube_vertex_ids[(cube_index.x() + 1) +
+                          cube_side * ((cube_index.y() + 1) +
+                                       cube_side * (cube_index.z() + 1))];
+      if (id == kNoVertex) {
+        DualVertex vertex;
+        if (computeDualVertex(block, padded_block, corner_offsets, cube_index,
+                              &vertex)) {
+          id = vertices.size();
+          vertices.push_back(vertex);
+        } else {
+          id = kInvalidVertex;
+        }
+      }
+      return id;
+    };
+
+    // Vertex ids in the mesh if it is indexed.
+    std::vector<VertexIndex> mesh_vertex_ids;
+    auto add_triangle = [&](VertexIndex v0, VertexIndex v1, VertexIndex v2) {
+      const VertexIndex triangle[3] = {v0, v1, v2};
+      if (config_.use_indexed_mesh) {
+        for (const VertexIndex id : triangle) {
+          if (mesh_vertex_ids[id] == kNoVertex) {
+            mesh_vertex_ids[id] = mesh->vertices.size();
+            mesh->vertices.push_back(vertices[id].point);
+            if (config_.compute_normals) {
+              mesh->normals.push_back(vertices[id].normal);
+            }
+            if (config_.use_color) {
+              mesh->colors.push_back(vertices[id].color);
+            }
+          }
+          mesh->indices.push_back(mesh_vertex_ids[id]);
+        }
+        return;
+      }
+      for (const VertexIndex id : triangle) {
+        mesh->indices.push_back(mesh->vertices.size());
+        mesh->vertices.push_back(vertices[id].point);
+        if (config_.compute_normals) {
+          mesh->normals.push_back(vertices[id].normal);
+        }
+        if (config_.use_color) {
+          mesh->colors.push_back(vertices[id].color);
+        }
+      }
+      if (!config_.compute_normals) {
+        const Point& p0 = vertices[v0].point;
+        const Point n = (vertices[v1].point - p0)
+                            .cross(vertices[v2].point - p0)
+                            .normalized();
+        mesh->normals.push_back(n);
+        mesh->normals.push_back(n);
+        mesh->normals.push_back(n);
+      }
+    };
+
+    const FloatingPoint* distances = padded_block.distances.data();
+    const FloatingPoint* weights = padded_block.weights.data();
+    VoxelIndex index;
+    for (index.z() = 0; index.z() < vps; ++index.z()) {
+      for (index.y() = 0; index.y() < vps; ++index.y()) {
+        for (index.x() = 0; index.x() < vps; ++index.x()) {
+          const size_t linear_index = padded_block.getLinearIndex(index);
+          if (weights[linear_index] <= config_.min_weight) {
+            continue;
+          }
+          const bool inside = distances[linear_index] < 0.0;
+          size_t stride = 1u;
+          for (int axis = 0; axis < 3; ++axis, stride *= padded_block.side) {
+            const size_t next_index = linear_index + stride;
+            if (weights[next_index] <= config_.min_weight ||
+                (distances[next_index] < 0.0) == inside) {
+              continue;
+            }
+
+            // The cubes around the edge, counter-clockwise around the axis.
+            const int axis_1 = (axis + 1) % 3;
+            const int axis_2 = (axis + 2) % 3;
+            VertexIndex quad[4];
+            bool valid = true;
+            for (int i = 0; i < 4 && valid; ++i) {
+              VoxelIndex cube_index = index;
+              cube_index(axis_1) -= (i == 1 || i == 2) ? 1 : 0;
+              cube_index(axis_2) -= (i >= 2) ? 1 : 0;
+              quad[i] = get_vertex_id(cube_index);
+              valid = quad[i] != kInvalidVertex;
+            }
+            if (!valid) {
+              continue;
+            }
+            if (config_.use_indexed_mesh && mesh_vertex_ids.size() <
+                                                vertices.size()) {
+              mesh_vertex_ids.resize(vertices.size(), kNoVertex);
+            }
+
+            // The quad faces along +axis if the surface is crossed from the
+            // inside to the outside. It is split along its shorter diagonal.
+            if (!inside) {
+              std::swap(quad[1], quad[3]);
+            }
+            const FloatingPoint diagonal_02 =
+                (vertices[quad[2]].point - vertices[quad[0]].point)
+                    .squaredNorm();
+            const FloatingPoint diagonal_13 =
+                (vertices[quad[3]].point - vertices[quad[1]].point)
+                    .squaredNorm();
+            if (diagonal_02 <= diagonal_13) {
+              add_triangle(quad[0], quad[1], quad[2]);
+              add_triangle(quad[0], quad[2], quad[3]);
+            } else {
+              add_triangle(quad[1], quad[2], quad[3]);
+              add_triangle(quad[1], quad[3], quad[0]);
+            }
+          }
+        }
+      }
+    }
+  }
+
   Config config_;
 
   Layer<TsdfVoxel>* tsdf_layer_;
@@ -337,6 +1376,16 @@ class MeshIntegrator {
 
   // Cached index map.
   Eigen::Matrix<int, 3, 8> cube_index_offsets_;
+  Eigen::Matrix<FloatingPoint, 3, 8> cube_coord_offsets_;
+
+  // Sub-cell layout of the blocks, see Block::dirty_sub_cells().
+  size_t sub_cell_size_;
+  // Masks of the sub-cells with the given coordinate along every axis.
+  uint64_t sub_cell_layers_[3][kSubCellsPerSide];
+  // Bit i of [offset + 1][j] is set if the cubes in sub-cell i of a block
+  // depend on the voxels in sub-cell j of its neighbor at +offset along an
+  // axis.
+  uint8_t sub_cell_dependencies_[3][kSubCellsPerSide];
 };
 
 }  // namespace voxblox
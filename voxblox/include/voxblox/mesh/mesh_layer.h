@@ -2,7 +2,9 @@
 #define VOXBLOX_CORE_MESH_LAYER_H_
 
 #include <glog/logging.h>
+#include <algorithm>
 #include <utility>
+#include <vector>
 
 #include "voxblox/core/block_hash.h"
 #include "voxblox/core/common.h"
@@ -18,7 +20,8 @@ class MeshLayer {
   typedef std::shared_ptr<const MeshLayer> ConstPtr;
   typedef typename BlockHashMapType<Mesh::Ptr>::type MeshMap;
 
-  explicit MeshLayer(FloatingPoint block_size) : block_size_(block_size) {}
+  explicit MeshLayer(FloatingPoint block_size)
+      : block_size_(block_size), block_size_inv_(1.0 / block_size) {}
   virtual ~MeshLayer() {}
 
   // By index.
@@ -125,8 +128,76 @@ class MeshLayer {
   }
 
   size_t getNumberOfAllocatedMeshes() const { return mesh_map_.size(); }
-  // Deletes ALL parts of the mesh.
-  void clear() { mesh_map_.clear(); }
+  // Deletes ALL parts of the mesh, including the coarser levels of detail.
+  void clear() {
+    mesh_map_.clear();
+    for (const MeshLayer::Ptr& lod_layer : lod_layers_) {
+      lod_layer->clear();
+    }
+  }
+
+  // Levels of detail of the mesh. Level 0 is this layer itself, level l holds
+  // the meshes of the same blocks extracted at 2^l times the voxel size, see
+  // LodMeshIntegrator.
+  size_t getNumberOfLods() const { return lod_layers_.size() + 1u; }
+
+  // Gets the layer of a level of detail, allocating it if necessary.
+  MeshLayer* allocateLodLayer(size_t lod) {
+    if (lod == 0u) {
+      return this;
+    }
+    while (lod_layers_.size() < lod) {
+      lod_layers_.emplace_back(new MeshLayer(block_size_));
+    }
+    return lod_layers_[lod - 1u].get();
+  }
+
+  const MeshLayer& getLodLayer(size_t lod) const {
+    if (lod == 0u) {
+      return *this;
+    }
+    CHECK_LE(lod, lod_layers_.size()) << "Accessed unallocated level of detail "
+                                      << lod;
+    return *lod_layers_[lod - 1u];
+  }
+
+  // Level of detail of a block for a viewer at the viewpoint. Level i is used
+  // up to a distance of lod_distances[i] between the viewpoint and the block
+  // center, the coarsest allocated level beyond that.
+  size_t selectLod(const BlockIndex& index, const Point& viewpoint,
+                   const std::vector<FloatingPoint>& lod_distances) const {
+    const Point block_center =
+        (index.cast<FloatingPoint>() + Point::Constant(0.5)) * block_size_;
+    const FloatingPoint distance = (block_center - viewpoint).norm();
+    size_t lod = 0u;
+    while (lod < lod_distances.size() && distance > lod_distances[lod]) {
+      ++lod;
+    }
+    return std::min(lod, getNumberOfLods() - 1u);
+  }
+
+  // Collects the mesh of every block at the level of detail selected by
+  // selectLod. Blocks without a mesh at that level are skipped.
+  void getMeshesForViewpoint(const Point& viewpoint,
+                             const std::vector<FloatingPoint>& lod_distances,
+                             std::vector<Mesh::ConstPtr>* meshes) const {
+    CHECK_NOTNULL(meshes);
+    meshes->clear();
+    meshes->reserve(mesh_map_.size());
+    for (const std::pair<const BlockIndex, typename Mesh::Ptr>& kv :
+         mesh_map_) {
+      const size_t lod = selectLod(kv.first, viewpoint, lod_distances);
+      if (lod == 0u) {
+        meshes->push_back(kv.second);
+        continue;
+      }
+      const MeshMap& lod_map = lod_layers_[lod - 1u]->mesh_map_;
+      typename MeshMap::const_iterator it = lod_map.find(kv.first);
+      if (it != lod_map.end()) {
+        meshes->push_back(it->second);
+      }
+    }
+  }
 
   FloatingPoint block_size() const { return block_size_; }
 
@@ -137,6 +208,9 @@ class MeshLayer {
   FloatingPoint block_size_inv_;
 
   MeshMap mesh_map_;
+
+  // Levels of detail 1 and up.
+  std::vector<MeshLayer::Ptr> lod_layers_;
 };
 
 }  // namespace voxblox
@@ -0,0 +1,255 @@
+#ifndef VOXBLOX_UTILS_BLOCK_NEIGHBORHOOD_H_
+#define VOXBLOX_UTILS_BLOCK_NEIGHBORHOOD_H_
+
+#include <cmath>
+#include <cstdint>
+
+#include <Eigen/Core>
+#include <glog/logging.h>
+
+#include "voxblox/core/common.h"
+#include "voxblox/core/layer.h"
+#include "voxblox/core/voxel.h"
+
+namespace voxblox {
+
+// The 26-connected neighborhood of a voxel with quasi-Euclidean distances.
+// The neighbors are ordered like in EsdfIntegrator::getNeighborsAndDistances:
+// first the 6 faces, then the 12 edges and then the 8 corners.
+class NeighborStencil {
+ public:
+  static constexpr size_t kNumNeighbors = 26u;
+
+  // Direction of every neighbor, in voxels.
+  static const Eigen::Vector3i& direction(size_t n) {
+    DCHECK(n < kNumNeighbors);
+    return get().directions_[n];
+  }
+
+  // Parent offset of a voxel whose parent is its neighbor n, the opposite of
+  // the direction.
+  static const ParentOffset& parentOffset(size_t n) {
+    DCHECK(n < kNumNeighbors);
+    return get().parent_offsets_[n];
+  }
+
+  // Distance to every neighbor, in voxels.
+  static float distance(size_t n) {
+    DCHECK(n < kNumNeighbors);
+    return get().distances_[n];
+  }
+
+ private:
+  NeighborStencil() {
+    size_t n = 0u;
+    Eigen::Vector3i direction = Eigen::Vector3i::Zero();
+    // Distance 1 set.
+    for (unsigned int i = 0; i < 3; ++i) {
+      for (int j = -1; j <= 1; j += 2) {
+        direction(i) = j;
+        add(direction, 1.0f, &n);
+      }
+      direction(i) = 0;
+    }
+    // Distance sqrt(2) set.
+    for (unsigned int i = 0; i < 3; ++i) {
+      const unsigned int next_i = (i + 1) % 3;
+      for (int j = -1; j <= 1; j += 2) {
+        direction(i) = j;
+        for (int k = -1; k <= 1; k += 2) {
+          direction(next_i) = k;
+          add(direction, std::sqrt(2.0), &n);
+        }
+        direction(i) = 0;
+        direction(next_i) = 0;
+      }
+    }
+    // Distance sqrt(3) set.
+    for (int i = -1; i <= 1; i += 2) {
+      direction(0) = i;
+      for (int j = -1; j <= 1; j += 2) {
+        direction(1) = j;
+        for (int k = -1; k <= 1; k += 2) {
+          direction(2) = k;
+          add(direction, std::sqrt(3.0), &n);
+        }
+      }
+    }
+    CHECK(n == kNumNeighbors);
+  }
+
+  void add(const Eigen::Vector3i& direction, float distance, size_t* n) {
+    directions_[*n] = direction;
+    parent_offsets_[*n] = (-direction).cast<int8_t>();
+    distances_[*n] = distance;
+    ++(*n);
+  }
+
+  static const NeighborStencil& get() {
+    static const NeighborStencil stencil;
+    return stencil;
+  }
+
+  Eigen::Vector3i directions_[kNumNeighbors];
+  ParentOffset parent_offsets_[kNumNeighbors];
+  float distances_[kNumNeighbors];
+};
+
+// Visits the 26 neighbors of the voxels of one block of a layer without any
+// allocations. The pointers to the 27 blocks around the current block are
+// looked up once, on first use, and cached until the block changes. Neighbors
+// of voxels that do not touch the block border are addressed with constant
+// linear index offsets inside the block itself.
+//
+// The cached pointers are not updated if blocks are allocated or removed in
+// the layer, so a neighborhood must not outlive such changes.
+template <typename VoxelType>
+class BlockNeighborhood {
+ public:
+  explicit BlockNeighborhood(Layer<VoxelType>* layer)
+      : layer_(CHECK_NOTNULL(layer)),
+        voxels_per_side_(static_cast<int>(layer->voxels_per_side())),
+        has_block_(false),
+        resolved_blocks_(0u),
+        center_block_(nullptr),
+        linear_index_(0u),
+        is_interior_(false) {
+    for (size_t n = 0u; n < NeighborStencil::kNumNeighbors; ++n) {
+      const Eigen::Vector3i& direction = NeighborStencil::direction(n);
+      directions_[n] = direction;
+      linear_offsets_[n] =
+          direction.x() +
+          voxels_per_side_ * (direction.y() + voxels_per_side_ * direction.z());
+    }
+  }
+
+  // Moves the neighborhood to the given block. Returns the block, or nullptr
+  // if it is not allocated.
+  Block<VoxelType>* setBlock(const BlockIndex& block_index) {
+    if (!has_block_ || block_index != block_index_) {
+      has_block_ = true;
+      block_index_ = block_index;
+      resolved_blocks_ = 0u;
+      center_block_ = getBlockAtOffset(kCenterSlot);
+    }
+    return center_block_;
+  }
+
+  // Sets the voxel of the current block whose neighbors are visited next and
+  // returns it.
+  VoxelType& setVoxel(const VoxelIndex& voxel_index) {
+    DCHECK(has_block_);
+    DCHECK(center_block_ != nullptr);
+    DCHECK(center_block_->isValidVoxelIndex(voxel_index));
+    voxel_index_ = voxel_index;
+    linear_index_ = center_block_->computeLinearIndexFromVoxelIndex(voxel_index);
+    is_interior_ = (voxel_index.array() > 0).all() &&
+                   (voxel_index.array() < voxels_per_side_ - 1).all();
+    return center_block_->getVoxelByLinearIndex(linear_index_);
+  }
+
+  // Returns neighbor n of the current voxel and its key, or nullptr if it
+  // lies in a block that is not allocated.
+  inline VoxelType* getNeighbor(size_t n, VoxelKey* key) {
+    DCHECK_NOTNULL(key);
+    DCHECK(n < NeighborStencil::kNumNeighbors);
+    const Eigen::Vector3i& direction = directions_[n];
+    if (is_interior_) {
+      key->first = block_index_;
+      key->second = voxel_index_ + direction;
+      return &center_block_->getVoxelByLinearIndex(linear_index_ +
+                                                   linear_offsets_[n]);
+    }
+
+    key->second = voxel_index_ + direction;
+    int slot = kCenterSlot;
+    int slot_stride = 1;
+    BlockIndex block_offset = BlockIndex::Zero();
+    for (unsigned int i = 0; i < 3; ++i, slot_stride *= 3) {
+      if (key->second(i) < 0) {
+        key->second(i) += voxels_per_side_;
+        block_offset(i) = -1;
+        slot -= slot_stride;
+      } else if (key->second(i) >= voxels_per_side_) {
+        key->second(i) -= voxels_per_side_;
+        block_offset(i) = 1;
+        slot += slot_stride;
+      }
+    }
+    key->first = block_index_ + block_offset;
+    Block<VoxelType>* block = getBlockAtOffset(slot);
+    if (block == nullptr) {
+      return nullptr;
+    }
+    return &block->getVoxelByVoxelIndex(key->second);
+  }
+
+  // Returns the voxel at any offset from the current voxel and its key, or
+  // nullptr if it lies in a block that is not allocated. Blocks beyond the
+  // neighbors of the current block are looked up in the layer every time.
+  inline VoxelType* getVoxelAtOffset(const Eigen::Vector3i& offset,
+                                     VoxelKey* key) {
+    DCHECK_NOTNULL(key);
+    key->second = voxel_index_ + offset;
+    BlockIndex block_offset;
+    for (unsigned int i = 0; i < 3; ++i) {
+      // Rounds towards negative infinity.
+      block_offset(i) = (key->second(i) >= 0
+                             ? key->second(i)
+                             : key->second(i) - voxels_per_side_ + 1) /
+                        voxels_per_side_;
+      key->second(i) -= block_offset(i) * voxels_per_side_;
+    }
+    key->first = block_index_ + block_offset;
+    Block<VoxelType>* block = nullptr;
+    if ((block_offset.array().abs() <= 1).all()) {
+      block = getBlockAtOffset(kCenterSlot + block_offset.x() +
+                               3 * block_offset.y() + 9 * block_offset.z());
+    } else {
+      block = layer_->getBlockPtrByIndex(key->first).get();
+    }
+    if (block == nullptr) {
+      return nullptr;
+    }
+    return &block->getVoxelByVoxelIndex(key->second);
+  }
+
+ private:
+  // Slots of the blocks around the current one are numbered
+  // (dx + 1) + 3 * (dy + 1) + 9 * (dz + 1).
+  static constexpr int kCenterSlot = 13;
+
+  Block<VoxelType>* getBlockAtOffset(int slot) {
+    if ((resolved_blocks_ & (1u << slot)) == 0u) {
+      const BlockIndex block_index =
+          block_index_ +
+          BlockIndex(slot % 3 - 1, (slot / 3) % 3 - 1, slot / 9 - 1);
+      typename Block<VoxelType>::Ptr block =
+          layer_->getBlockPtrByIndex(block_index);
+      blocks_[slot] = block.get();
+      resolved_blocks_ |= 1u << slot;
+    }
+    return blocks_[slot];
+  }
+
+  Layer<VoxelType>* layer_;
+  const int voxels_per_side_;
+
+  bool has_block_;
+  BlockIndex block_index_;
+  // Bitmask of the slots in blocks_ that have been looked up.
+  uint32_t resolved_blocks_;
+  Block<VoxelType>* blocks_[27];
+  Block<VoxelType>* center_block_;
+
+  VoxelIndex voxel_index_;
+  size_t linear_index_;
+  bool is_interior_;
+  // Copy of the stencil directions and their offsets inside a block.
+  Eigen::Vector3i directions_[NeighborStencil::kNumNeighbors];
+  int linear_offsets_[NeighborStencil::kNumNeighbors];
+};
+
+}  // namespace voxblox
+
+#endif  // VOXBLOX_UTILS_BLOCK_NEIGHBORHOOD_H_
@@ -2,41 +2,69 @@
 #define VOXBLOX_UTILS_BUCKET_QUEUE_H_
 
 #include <glog/logging.h>
-#include <queue>
+#include <Eigen/Core>
+#include <cmath>
 #include <vector>
 
 // Bucketed priority queue, mostly following L. Yatziv et al in
 // O(N) Implementation of the Fast Marching Algorithm, though skipping the
 // circular aspect (don't care about a bit more memory used for this).
-
+// Elements are popped from the lowest non-empty bucket, in the order they
+// were pushed to it. Unlike in a monotone queue, elements may be pushed to
+// buckets below the last popped one, which the ESDF updates rely on.
+//
+// Every bucket is a contiguous vector that keeps its memory when it runs
+// empty, so a queue that is reused for many updates stops allocating once it
+// has seen the largest one.
 template <typename T>
 class BucketQueue {
  public:
-  BucketQueue() : last_bucket_index_(0) {}
-  explicit BucketQueue(int num_buckets, double max_val)
-      : num_buckets_(num_buckets), max_val_(max_val), last_bucket_index_(0) {
-    buckets_.resize(num_buckets_);
+  BucketQueue()
+      : num_buckets_(0),
+        max_val_(0.0),
+        bucket_scale_(0.0),
+        last_bucket_index_(0),
+        num_elements_(0u) {}
+  explicit BucketQueue(int num_buckets, double max_val) : BucketQueue() {
+    setNumBuckets(num_buckets, max_val);
   }
 
   // WARNING: will CLEAR THE QUEUE!
   void setNumBuckets(int num_buckets, double max_val) {
+    CHECK_GT(num_buckets, 0);
+    CHECK_GT(max_val, 0.0);
     max_val_ = max_val;
     num_buckets_ = num_buckets;
+    bucket_scale_ = (num_buckets_ - 1) / max_val_;
     buckets_.clear();
     buckets_.resize(num_buckets_);
-    num_elements_ = 0;
+    last_bucket_index_ = 0;
+    num_elements_ = 0u;
   }
 
-  void push(const T& key, double value) {
-    CHECK_NE(num_buckets_, 0);
-    if (value > max_val_) {
-      value = max_val_;
-    }
-    int bucket_index =
-        std::floor(std::abs(value) / max_val_ * (num_buckets_ - 1));
-    if (bucket_index >= num_buckets_) {
-      bucket_index = num_buckets_ - 1;
+  // Reserves memory for num_elements elements in every bucket.
+  void reserve(size_t num_elements) {
+    for (Bucket& bucket : buckets_) {
+      bucket.reserve(num_elements);
     }
+  }
+
+  void push(const T& key, double value) {
+    DCHECK_GT(num_buckets_, 0);
+    // Values above max_val_ go to the last bucket. The scaled value is never
+    // negative, so the cast rounds it down.
+    const double scaled_value = std::abs(value) * bucket_scale_;
+    const int bucket_index = (scaled_value < num_buckets_ - 1)
+                                 ? static_cast<int>(scaled_value)
+                                 : num_buckets_ - 1;
+    pushToBucket(key, bucket_index);
+  }
+
+  // Pushes to the given bucket, for moving elements between queues with the
+  // same buckets in their order.
+  void pushToBucket(const T& key, int bucket_index) {
+    DCHECK_GE(bucket_index, 0);
+    DCHECK_LT(bucket_index, num_buckets_);
     if (bucket_index < last_bucket_index_) {
       last_bucket_index_ = bucket_index;
     }
@@ -48,33 +76,73 @@ class BucketQueue {
     if (empty()) {
       return;
     }
-    while (buckets_[last_bucket_index_].empty() &&
-           last_bucket_index_ < num_buckets_) {
-      last_bucket_index_++;
-    }
-    if (last_bucket_index_ < num_buckets_) {
-      buckets_[last_bucket_index_].pop();
-      num_elements_--;
-    }
+    buckets_[findFrontBucket()].pop();
+    num_elements_--;
   }
 
-  T front() {
-    CHECK_NE(num_buckets_, 0);
+  const T& front() {
     CHECK(!empty());
-    while (buckets_[last_bucket_index_].empty() &&
-           last_bucket_index_ < num_buckets_) {
-      last_bucket_index_++;
-    }
-    return buckets_[last_bucket_index_].front();
+    return buckets_[findFrontBucket()].front();
+  }
+
+  // Bucket of the element front() returns.
+  int frontBucket() {
+    CHECK(!empty());
+    return findFrontBucket();
   }
 
-  bool empty() { return num_elements_ == 0; }
+  bool empty() const { return num_elements_ == 0u; }
+
+  size_t size() const { return num_elements_; }
 
  private:
+  // FIFO bucket. Popped elements stay in the vector until they make up more
+  // than half of it, then the remaining ones are moved down. This keeps the
+  // memory of a bucket that never runs empty bounded by twice its size, at
+  // amortized constant cost per pop.
+  class Bucket {
+   public:
+    Bucket() : front_index_(0u) {}
+
+    bool empty() const { return front_index_ == elements_.size(); }
+
+    const T& front() const { return elements_[front_index_]; }
+
+    void push(const T& key) { elements_.push_back(key); }
+
+    void pop() {
+      ++front_index_;
+      if (empty()) {
+        elements_.clear();
+        front_index_ = 0u;
+      } else if (2u * front_index_ > elements_.size()) {
+        elements_.erase(elements_.begin(), elements_.begin() + front_index_);
+        front_index_ = 0u;
+      }
+    }
+
+    void reserve(size_t num_elements) { elements_.reserve(num_elements); }
+
+   private:
+    std::vector<T, Eigen::aligned_allocator<T>> elements_;
+    size_t front_index_;
+  };
+
+  // Moves last_bucket_index_ to the lowest non-empty bucket. The queue must
+  // not be empty.
+  int findFrontBucket() {
+    while (buckets_[last_bucket_index_].empty()) {
+      last_bucket_index_++;
+    }
+    DCHECK_LT(last_bucket_index_, num_buckets_);
+    return last_bucket_index_;
+  }
+
   int num_buckets_;
   double max_val_;
-  std::vector<std::queue<T, std::deque<T, Eigen::aligned_allocator<T>>>>
-      buckets_;
+  // Converts absolute values to bucket indices.
+  double bucket_scale_;
+  std::vector<Bucket> buckets_;
 
   // Speed up retrivals.
   int last_bucket_index_;
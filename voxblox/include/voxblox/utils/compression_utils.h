@@ -0,0 +1,45 @@
+#ifndef VOXBLOX_UTILS_COMPRESSION_UTILS_H_
+#define VOXBLOX_UTILS_COMPRESSION_UTILS_H_
+
+#include <string>
+#include <vector>
+
+#include <glog/logging.h>
+
+namespace voxblox {
+
+namespace utils {
+
+// Codecs for the serialized voxel words of a block. The values are stored in
+// BlockProto::compression, so never change the numbering.
+enum class CompressionType : uint32_t {
+  kNone = 0u,
+  // Built-in run-length encoding over whole voxels. Always available and
+  // very effective for unobserved or uniform regions of a block.
+  kRle = 1u,
+  // Only available if voxblox was built with zstd (VOXBLOX_WITH_ZSTD).
+  kZstd = 2u,
+  // Only available if voxblox was built with LZ4 (VOXBLOX_WITH_LZ4).
+  kLz4 = 3u
+};
+
+bool isCompressionAvailable(CompressionType compression);
+
+// Returns zstd if available, otherwise LZ4, otherwise the built-in RLE.
+CompressionType getBestAvailableCompression();
+
+// Compresses the serialized voxel words of one block. words_per_voxel is the
+// number of consecutive words that make up a single voxel, it is used by the
+// RLE codec to find runs of identical voxels.
+bool compressVoxelData(CompressionType compression,
+                       const std::vector<uint32_t>& data,
+                       size_t words_per_voxel, std::string* compressed_data);
+
+bool decompressVoxelData(CompressionType compression,
+                         const std::string& compressed_data,
+                         std::vector<uint32_t>* data);
+
+}  // namespace utils
+}  // namespace voxblox
+
+#endif  // VOXBLOX_UTILS_COMPRESSION_UTILS_H_
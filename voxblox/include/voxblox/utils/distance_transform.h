@@ -0,0 +1,260 @@
+#ifndef VOXBLOX_UTILS_DISTANCE_TRANSFORM_H_
+#define VOXBLOX_UTILS_DISTANCE_TRANSFORM_H_
+
+#include <algorithm>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#include <glog/logging.h>
+#include <Eigen/Core>
+
+#include "voxblox/core/block_hash.h"
+#include "voxblox/core/common.h"
+
+namespace voxblox {
+
+// One dimensional squared Euclidean distance transform of a sampled function,
+// see Felzenszwalb and Huttenlocher, "Distance Transforms of Sampled
+// Functions", Theory of Computing, 2012. Computes
+//   d(q) = min_p (q - p)^2 + f(p)
+// in linear time as the lower envelope of the parabolas rooted at the samples,
+// together with the minimizing p. Samples with an infinite f are skipped.
+// Running it along x, y and z in turn gives the exact 3D Euclidean distance
+// transform, the minimizers of the passes chain up to the nearest site.
+class DistanceTransform1D {
+ public:
+  static constexpr float kInfinity = std::numeric_limits<float>::infinity();
+
+  // Reserves the buffers for rows of up to max_size samples.
+  explicit DistanceTransform1D(size_t max_size)
+      : parabola_roots_(max_size), boundaries_(max_size + 1) {}
+
+  // Transforms the n samples of f into d and stores the minimizing sample of
+  // every entry in arg, or -1 if all samples are infinite. f and d must not
+  // overlap.
+  void compute(const float* f, size_t n, float* d, int* arg) {
+    DCHECK_LE(n, parabola_roots_.size());
+    // Lower envelope: parabola k is the lowest one for q in
+    // [boundaries_[k], boundaries_[k + 1]).
+    int k = -1;
+    for (int q = 0; q < static_cast<int>(n); ++q) {
+      if (f[q] == kInfinity) {
+        continue;
+      }
+      const double f_q = static_cast<double>(f[q]) + q * q;
+      double s = -std::numeric_limits<double>::infinity();
+      while (k >= 0) {
+        const int p = parabola_roots_[k];
+        s = (f_q - (static_cast<double>(f[p]) + p * p)) / (2.0 * (q - p));
+        if (s > boundaries_[k]) {
+          break;
+        }
+        --k;
+      }
+      ++k;
+      parabola_roots_[k] = q;
+      boundaries_[k] = (k == 0) ? -std::numeric_limits<double>::infinity() : s;
+      boundaries_[k + 1] = std::numeric_limits<double>::infinity();
+    }
+
+    if (k < 0) {
+      for (size_t q = 0u; q < n; ++q) {
+        d[q] = kInfinity;
+        arg[q] = -1;
+      }
+      return;
+    }
+    k = 0;
+    for (int q = 0; q < static_cast<int>(n); ++q) {
+      while (boundaries_[k + 1] < q) {
+        ++k;
+      }
+      const int p = parabola_roots_[k];
+      d[q] = static_cast<float>((q - p) * (q - p)) + f[p];
+      arg[q] = p;
+    }
+  }
+
+ private:
+  std::vector<int> parabola_roots_;
+  std::vector<double> boundaries_;
+};
+
+// Runs the transform along axis over the rows [begin, end) of a dense grid
+// with x running fastest, the rows are numbered in memory order of their
+// first sample. Overwrites the squared distances of the rows and stores the
+// minimizing coordinate along axis in nearest.
+inline void transformGridRows(const Eigen::Vector3i& size, int axis,
+                              size_t begin, size_t end,
+                              float* squared_distances, int* nearest) {
+  DCHECK_NOTNULL(squared_distances);
+  DCHECK_NOTNULL(nearest);
+  const size_t nx = size.x();
+  const size_t ny = size.y();
+  const size_t length = size(axis);
+  size_t stride = 1u;
+  if (axis == 1) {
+    stride = nx;
+  } else if (axis == 2) {
+    stride = nx * ny;
+  }
+
+  DistanceTransform1D transform(length);
+  std::vector<float> row(length);
+  std::vector<float> row_distances(length);
+  std::vector<int> row_nearest(length);
+  for (size_t r = begin; r < end; ++r) {
+    size_t base = r;
+    if (axis == 0) {
+      base = r * nx;
+    } else if (axis == 1) {
+      base = r % nx + nx * ny * (r / nx);
+    }
+
+    for (size_t q = 0u; q < length; ++q) {
+      row[q] = squared_distances[base + q * stride];
+    }
+    transform.compute(row.data(), length, row_distances.data(),
+                      row_nearest.data());
+    for (size_t q = 0u; q < length; ++q) {
+      squared_distances[base + q * stride] = row_distances[q];
+      nearest[base + q * stride] = row_nearest[q];
+    }
+  }
+}
+
+// Part of a map that is transformed on its own dense grid by the exact batch
+// updates. The grid spans the blocks of the tile padded by a halo of blocks,
+// whose sites are needed for the distances inside the tile.
+struct DistanceGridTile {
+  BlockIndex min_block_index;
+  BlockIndex max_block_index;
+  BlockIndexList block_indices;
+};
+
+// Splits the blocks into cubic tiles of tile_size_blocks blocks per side and
+// pads each tile by halo_blocks blocks, clipped to the bounding box of all
+// blocks. This bounds the memory of the dense grids by the tile size instead
+// of the extent of the map, and skips the empty space of sparse maps. The
+// result equals the one on a single grid as long as the halo covers the
+// largest distance of interest.
+inline void splitIntoDistanceGridTiles(const BlockIndexList& block_indices,
+                                       int tile_size_blocks, int halo_blocks,
+                                       std::vector<DistanceGridTile>* tiles) {
+  CHECK_NOTNULL(tiles);
+  CHECK_GT(tile_size_blocks, 0);
+  tiles->clear();
+  if (block_indices.empty()) {
+    return;
+  }
+  BlockIndex min_block_index = block_indices.front();
+  BlockIndex max_block_index = block_indices.front();
+  BlockHashMapType<size_t>::type tile_map;
+  for (const BlockIndex& block_index : block_indices) {
+    min_block_index = min_block_index.cwiseMin(block_index);
+    max_block_index = max_block_index.cwiseMax(block_index);
+    BlockIndex tile_index;
+    for (int i = 0; i < 3; ++i) {
+      // Rounds towards negative infinity, also for negative indices.
+      tile_index(i) = (block_index(i) >= 0)
+                          ? block_index(i) / tile_size_blocks
+                          : -((-block_index(i) - 1) / tile_size_blocks) - 1;
+    }
+    BlockHashMapType<size_t>::type::const_iterator it =
+        tile_map.find(tile_index);
+    if (it == tile_map.end()) {
+      it = tile_map.emplace(tile_index, tiles->size()).first;
+      tiles->emplace_back();
+      tiles->back().min_block_index = block_index;
+      tiles->back().max_block_index = block_index;
+    }
+    DistanceGridTile& tile = (*tiles)[it->second];
+    tile.min_block_index = tile.min_block_index.cwiseMin(block_index);
+    tile.max_block_index = tile.max_block_index.cwiseMax(block_index);
+    tile.block_indices.push_back(block_index);
+  }
+
+  const BlockIndex halo = BlockIndex::Constant(halo_blocks);
+  for (DistanceGridTile& tile : *tiles) {
+    tile.min_block_index =
+        (tile.min_block_index - halo).cwiseMax(min_block_index);
+    tile.max_block_index =
+        (tile.max_block_index + halo).cwiseMin(max_block_index);
+  }
+}
+
+// Squared distances in voxels and minimizers of the exact distance transform
+// on a dense grid of voxels over whole blocks. The minimizers are the
+// coordinates along the axis of the pass that produced them. The sites start
+// at a squared distance of 0, all other voxels at infinity.
+struct DenseDistanceGrid {
+  BlockIndex min_block_index;
+  Eigen::Vector3i size;
+  std::vector<float> squared_distances;
+  std::vector<float> site_distances;
+  std::vector<int> nearest[3];
+
+  // Sizes the grid to the blocks of the tile, including its halo, without
+  // sites. The memory is about 20 bytes per voxel of the grid.
+  void reset(const DistanceGridTile& tile, int voxels_per_side) {
+    min_block_index = tile.min_block_index;
+    size = (tile.max_block_index - tile.min_block_index + BlockIndex::Ones()) *
+           voxels_per_side;
+    const size_t num_voxels =
+        static_cast<size_t>(size.x()) * size.y() * size.z();
+    squared_distances.assign(num_voxels,
+                             std::numeric_limits<float>::infinity());
+    site_distances.resize(num_voxels);
+  }
+
+  inline size_t getLinearIndex(int x, int y, int z) const {
+    return x + size.x() * (y + static_cast<size_t>(size.y()) * z);
+  }
+
+  // Follows the minimizers of the z, y and x passes back to the nearest site
+  // of the voxel. Returns false if there is none.
+  inline bool getNearestSite(const Eigen::Vector3i& voxel,
+                             Eigen::Vector3i* site) const {
+    DCHECK_NOTNULL(site);
+    const int site_z =
+        nearest[2][getLinearIndex(voxel.x(), voxel.y(), voxel.z())];
+    if (site_z < 0) {
+      return false;
+    }
+    const int site_y = nearest[1][getLinearIndex(voxel.x(), voxel.y(), site_z)];
+    const int site_x = nearest[0][getLinearIndex(voxel.x(), site_y, site_z)];
+    *site = Eigen::Vector3i(site_x, site_y, site_z);
+    return true;
+  }
+
+  // Runs the passes along x, y and z. The rows of a pass are independent and
+  // are spread over num_threads threads.
+  void transform(size_t num_threads) {
+    const size_t num_voxels = squared_distances.size();
+    for (int axis = 0; axis < 3; ++axis) {
+      nearest[axis].resize(num_voxels);
+      const size_t num_rows = num_voxels / size(axis);
+      const size_t num_pass_threads = std::min(num_threads, num_rows);
+      if (num_pass_threads <= 1u) {
+        transformGridRows(size, axis, 0u, num_rows, squared_distances.data(),
+                          nearest[axis].data());
+        continue;
+      }
+      std::vector<std::thread> threads;
+      for (size_t i = 0; i < num_pass_threads; ++i) {
+        threads.emplace_back(transformGridRows, size, axis,
+                             i * num_rows / num_pass_threads,
+                             (i + 1) * num_rows / num_pass_threads,
+                             squared_distances.data(), nearest[axis].data());
+      }
+      for (std::thread& thread : threads) {
+        thread.join();
+      }
+    }
+  }
+};
+
+}  // namespace voxblox
+
+#endif  // VOXBLOX_UTILS_DISTANCE_TRANSFORM_H_
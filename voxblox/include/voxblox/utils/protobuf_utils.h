@@ -2,6 +2,7 @@
 #define VOXBLOX_UTILS_PROTOBUF_UTILS_H_
 
 #include <fstream>
+#include <string>
 #include <glog/logging.h>
 #include <google/protobuf/message.h>
 #include <google/protobuf/message_lite.h>
@@ -15,13 +16,31 @@ bool readProtoMsgCountToStream(std::fstream* stream_in, uint32_t* message_count,
 bool writeProtoMsgCountToStream(uint32_t message_count,
                                 std::fstream* stream_out);
 
+// Same as readProtoMsgCountToStream, but reads the count at byte_offset
+// instead of the beginning of the stream and advances byte_offset past it.
+// Used for files that consist of several concatenated message segments, which
+// can grow beyond 4 GB, hence the 64 bit offset.
+bool readProtoMsgCountFromStreamAtOffset(std::fstream* stream_in,
+                                         uint32_t* message_count,
+                                         uint64_t* byte_offset);
+
 bool readProtoMsgFromStream(std::fstream* stream_in,
                             google::protobuf::Message* message,
                             uint32_t* byte_offset);
+bool readProtoMsgFromStream(std::fstream* stream_in,
+                            google::protobuf::Message* message,
+                            uint64_t* byte_offset);
 
 bool writeProtoMsgToStream(const google::protobuf::Message& message,
                            std::fstream* stream_out);
 
+// Writes a message that was already serialized (e.g. on another thread) with
+// the same length-delimited framing as writeProtoMsgToStream. Returns the
+// number of bytes written to the stream in bytes_written, if not null.
+bool writeSerializedProtoMsgToStream(const std::string& serialized_message,
+                                     std::fstream* stream_out,
+                                     size_t* bytes_written);
+
 }  // namespace utils
 }  // namespace voxblox
 
@@ -0,0 +1,69 @@
+#ifndef VOXBLOX_UTILS_QUANTIZED_BLOCK_ENCODING_H_
+#define VOXBLOX_UTILS_QUANTIZED_BLOCK_ENCODING_H_
+
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "voxblox/core/common.h"
+#include "voxblox/core/voxel.h"
+
+namespace voxblox {
+
+template <typename VoxelType>
+class Block;
+
+namespace utils {
+
+// Encoding of the voxel words of a block. The values are stored in
+// BlockProto::encoding and voxblox_msgs::Block::encoding, so never change the
+// numbering.
+enum class BlockEncoding : uint32_t {
+  // The per voxel-type layout of Block::serializeToIntegers.
+  kRaw = 0u,
+  // Lossy, compact encoding of TSDF blocks for sending maps over the network:
+  // a bitmask of observed voxels (weight > 0), followed by the distance of
+  // every observed voxel quantized to 8 or 16 bits relative to the truncation
+  // distance, the delta-coded weights (rounded to bfloat16) and optionally
+  // the colors. Unobserved voxels are decoded as default voxels.
+  kQuantizedTsdf = 1u
+};
+
+struct QuantizationConfig {
+  // Distances are clamped to +- this value before quantization, it should
+  // match the truncation distance of the TSDF integrator.
+  FloatingPoint truncation_distance = 0.1;
+  // 16 instead of 8 bits per distance.
+  bool use_16_bit_distance = false;
+  bool include_color = true;
+};
+
+// Only implemented for TSDF blocks.
+template <typename VoxelType>
+void encodeQuantizedBlock(const Block<VoxelType>& /*block*/,
+                          const QuantizationConfig& /*config*/,
+                          std::vector<uint32_t>* /*data*/) {
+  LOG(FATAL) << "Quantized encoding is only implemented for TSDF blocks.";
+}
+
+// Returns false if the data is malformed or does not match the block size.
+template <typename VoxelType>
+bool decodeQuantizedBlock(const uint32_t* /*data*/, size_t /*num_words*/,
+                          Block<VoxelType>* /*block*/) {
+  LOG(ERROR) << "Quantized encoding is only implemented for TSDF blocks.";
+  return false;
+}
+
+template <>
+void encodeQuantizedBlock<TsdfVoxel>(const Block<TsdfVoxel>& block,
+                                     const QuantizationConfig& config,
+                                     std::vector<uint32_t>* data);
+
+template <>
+bool decodeQuantizedBlock<TsdfVoxel>(const uint32_t* data, size_t num_words,
+                                     Block<TsdfVoxel>* block);
+
+}  // namespace utils
+}  // namespace voxblox
+
+#endif  // VOXBLOX_UTILS_QUANTIZED_BLOCK_ENCODING_H_
@@ -0,0 +1,124 @@
+#ifndef VOXBLOX_UTILS_VOXEL_EXTRACTION_H_
+#define VOXBLOX_UTILS_VOXEL_EXTRACTION_H_
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "voxblox/core/common.h"
+#include "voxblox/core/layer.h"
+
+namespace voxblox {
+
+// Collects an item for every voxel of a layer that passes a filter, e.g. the
+// points of a visualization pointcloud or the vertices of a PLY file. The
+// extractor is called as
+//   bool extractor(const VoxelType& voxel, const Point& coord, ItemType* item)
+// with the center of the voxel and fills the item if it returns true. It is a
+// template parameter, so lambdas and functors are inlined into the voxel loop.
+
+namespace internal {
+
+// Extracts the items of the blocks in [begin, end) into items, which is not
+// cleared first.
+template <typename VoxelType, typename ItemType, typename ExtractorType>
+void extractVoxelsFromBlockRange(const Layer<VoxelType>& layer,
+                                 const BlockIndexList& block_indices,
+                                 size_t begin, size_t end,
+                                 const ExtractorType& extractor,
+                                 AlignedVector<ItemType>* items) {
+  DCHECK_NOTNULL(items);
+  const size_t vps = layer.voxels_per_side();
+  // Offsets of the voxel centers from the block origin along one axis,
+  // computed like Block::computeCoordinatesFromVoxelIndex.
+  std::vector<FloatingPoint> center_offsets(vps);
+  for (size_t i = 0u; i < vps; ++i) {
+    center_offsets[i] = getCenterPointFromGridIndex(
+        AnyIndex(i, 0, 0), layer.voxel_size()).x();
+  }
+
+  ItemType item;
+  for (size_t block_idx = begin; block_idx < end; ++block_idx) {
+    const Block<VoxelType>& block =
+        layer.getBlockByIndex(block_indices[block_idx]);
+    const Point origin = block.origin();
+    size_t linear_index = 0u;
+    for (size_t z = 0u; z < vps; ++z) {
+      for (size_t y = 0u; y < vps; ++y) {
+        for (size_t x = 0u; x < vps; ++x, ++linear_index) {
+          const Point coord =
+              origin +
+              Point(center_offsets[x], center_offsets[y], center_offsets[z]);
+          if (extractor(block.getVoxelByLinearIndex(linear_index), coord,
+                        &item)) {
+            items->push_back(item);
+          }
+        }
+      }
+    }
+  }
+}
+
+}  // namespace internal
+
+// Extracts the items of the given blocks with num_threads threads. Every
+// thread extracts a contiguous range of the blocks into its own buffer, and
+// the buffers are concatenated in order at the end. The items are thus in
+// the order of the blocks and of the voxels inside them, independent of the
+// number of threads.
+template <typename VoxelType, typename ItemType, typename ExtractorType>
+void extractVoxelsFromBlocks(const Layer<VoxelType>& layer,
+                             const BlockIndexList& block_indices,
+                             const ExtractorType& extractor,
+                             size_t num_threads,
+                             AlignedVector<ItemType>* items) {
+  CHECK_NOTNULL(items);
+  items->clear();
+  num_threads = std::min(std::max<size_t>(num_threads, 1u),
+                         std::max<size_t>(block_indices.size(), 1u));
+  if (num_threads == 1u) {
+    internal::extractVoxelsFromBlockRange(layer, block_indices, 0u,
+                                          block_indices.size(), extractor,
+                                          items);
+    return;
+  }
+
+  std::vector<AlignedVector<ItemType>> thread_items(num_threads);
+  std::vector<std::thread> extraction_threads;
+  for (size_t i = 0u; i < num_threads; ++i) {
+    const size_t begin = i * block_indices.size() / num_threads;
+    const size_t end = (i + 1u) * block_indices.size() / num_threads;
+    extraction_threads.emplace_back(
+        &internal::extractVoxelsFromBlockRange<VoxelType, ItemType,
+                                               ExtractorType>,
+        std::cref(layer), std::cref(block_indices), begin, end,
+        std::cref(extractor), &thread_items[i]);
+  }
+
+  size_t num_items = 0u;
+  for (size_t i = 0u; i < num_threads; ++i) {
+    extraction_threads[i].join();
+    num_items += thread_items[i].size();
+  }
+  items->reserve(num_items);
+  for (const AlignedVector<ItemType>& local_items : thread_items) {
+    items->insert(items->end(), local_items.begin(), local_items.end());
+  }
+}
+
+// Same as above for all blocks of the layer.
+template <typename VoxelType, typename ItemType, typename ExtractorType>
+void extractVoxelsFromLayer(const Layer<VoxelType>& layer,
+                            const ExtractorType& extractor, size_t num_threads,
+                            AlignedVector<ItemType>* items) {
+  BlockIndexList block_indices;
+  layer.getAllAllocatedBlocks(&block_indices);
+  extractVoxelsFromBlocks(layer, block_indices, extractor, num_threads,
+                          items);
+}
+
+}  // namespace voxblox
+
+#endif  // VOXBLOX_UTILS_VOXEL_EXTRACTION_H_
@@ -1,21 +1,25 @@
 #include "voxblox/core/block.h"
+
+#include <atomic>
+#include <cstring>
+
 #include "voxblox/core/voxel.h"
 
 namespace voxblox {
 
-// Hidden serialization helpers:
-uint8_t serializeDirection(const Eigen::Vector3i& dir) {
-  uint8_t data = 0;
-  // [0 0] = 0, [1 0] = -1, [0 1] = 1.
-  uint8_t dir_x = dir.x() == 0 ? 0 : dir.x() > 0 ? 1 : 2;
-  uint8_t dir_y = dir.y() == 0 ? 0 : dir.y() > 0 ? 1 : 2;
-  uint8_t dir_z = dir.z() == 0 ? 0 : dir.z() > 0 ? 1 : 2;
-
-  // Leading 2 bits are 0.
-  data = dir_x << 4 | dir_y << 2 | dir_z;
-  return data;
+uint64_t getNextBlockVersion() {
+  static std::atomic<uint64_t> next_version(0u);
+  return next_version++;
 }
 
+// Hidden serialization helpers:
+// Marks the second data packet of ESDF voxels that store the full parent
+// offset. Older data stores the observed flag alone in the lowest byte, so
+// this bit is never set there.
+constexpr uint32_t kEsdfParentOffsetFormatFlag = 0x00000080;
+
+// Parents used to be stored as the signs of their direction, 2 bits per axis:
+// [0 0] = 0, [1 0] = -1, [0 1] = 1. Only read for data in that format.
 Eigen::Vector3i deserializeDirection(uint8_t data) {
   Eigen::Vector3i dir;
   uint8_t byte_x = data >> 4;
@@ -30,27 +34,37 @@ Eigen::Vector3i deserializeDirection(uint8_t data) {
   return dir;
 }
 
+template <>
+size_t Block<TsdfVoxel>::getNumDataPacketsPerVoxel() {
+  return 3u;
+}
+
+template <>
+size_t Block<OccupancyVoxel>::getNumDataPacketsPerVoxel() {
+  return 2u;
+}
+
+template <>
+size_t Block<EsdfVoxel>::getNumDataPacketsPerVoxel() {
+  return 2u;
+}
+
 // Deserialization functions:
 template <>
-void Block<TsdfVoxel>::deserializeFromIntegers(
-    const std::vector<uint32_t>& data) {
+void Block<TsdfVoxel>::deserializeFromIntegers(const uint32_t* data,
+                                               size_t num_data_packets) {
+  CHECK_NOTNULL(data);
   constexpr size_t kNumDataPacketsPerVoxel = 3u;
-  const size_t num_data_packets = data.size();
   CHECK_EQ(num_voxels_ * kNumDataPacketsPerVoxel, num_data_packets);
-  for (size_t voxel_idx = 0u, data_idx = 0u;
-       voxel_idx < num_voxels_ && data_idx < num_data_packets;
+  for (size_t voxel_idx = 0u, data_idx = 0u; voxel_idx < num_voxels_;
        ++voxel_idx, data_idx += kNumDataPacketsPerVoxel) {
-    const uint32_t bytes_1 = data[data_idx];
-    const uint32_t bytes_2 = data[data_idx + 1u];
-    const uint32_t bytes_3 = data[data_idx + 2u];
-
     TsdfVoxel& voxel = voxels_[voxel_idx];
 
-    // TODO(mfehr, helenol): find a better way to do this!
-
-    memcpy(&(voxel.distance), &bytes_1, sizeof(bytes_1));
-    memcpy(&(voxel.weight), &bytes_2, sizeof(bytes_2));
+    // Distance and weight are stored as their raw float bits.
+    memcpy(&(voxel.distance), &data[data_idx], sizeof(uint32_t));
+    memcpy(&(voxel.weight), &data[data_idx + 1u], sizeof(uint32_t));
 
+    const uint32_t bytes_3 = data[data_idx + 2u];
     voxel.color.r = static_cast<uint8_t>(bytes_3 >> 24);
     voxel.color.g = static_cast<uint8_t>((bytes_3 & 0x00FF0000) >> 16);
     voxel.color.b = static_cast<uint8_t>((bytes_3 & 0x0000FF00) >> 8);
@@ -59,121 +73,106 @@ void Block<TsdfVoxel>::deserializeFromIntegers(
 }
 
 template <>
-void Block<OccupancyVoxel>::deserializeFromIntegers(
-    const std::vector<uint32_t>& data) {
+void Block<OccupancyVoxel>::deserializeFromIntegers(const uint32_t* data,
+                                                    size_t num_data_packets) {
+  CHECK_NOTNULL(data);
   constexpr size_t kNumDataPacketsPerVoxel = 2u;
-  const size_t num_data_packets = data.size();
   CHECK_EQ(num_voxels_ * kNumDataPacketsPerVoxel, num_data_packets);
-  for (size_t voxel_idx = 0u, data_idx = 0u;
-       voxel_idx < num_voxels_ && data_idx < num_data_packets;
+  for (size_t voxel_idx = 0u, data_idx = 0u; voxel_idx < num_voxels_;
        ++voxel_idx, data_idx += kNumDataPacketsPerVoxel) {
-    const uint32_t bytes_1 = data[data_idx];
-    const uint32_t bytes_2 = data[data_idx + 1u];
-
     OccupancyVoxel& voxel = voxels_[voxel_idx];
 
-    memcpy(&(voxel.probability_log), &bytes_1, sizeof(bytes_1));
-    voxel.observed = static_cast<bool>(bytes_2 & 0x000000FF);
+    memcpy(&(voxel.probability_log), &data[data_idx], sizeof(uint32_t));
+    voxel.observed = static_cast<bool>(data[data_idx + 1u] & 0x000000FF);
   }
 }
 
 template <>
-void Block<EsdfVoxel>::deserializeFromIntegers(
-    const std::vector<uint32_t>& data) {
+void Block<EsdfVoxel>::deserializeFromIntegers(const uint32_t* data,
+                                               size_t num_data_packets) {
+  CHECK_NOTNULL(data);
   constexpr size_t kNumDataPacketsPerVoxel = 2u;
-  const size_t num_data_packets = data.size();
   CHECK_EQ(num_voxels_ * kNumDataPacketsPerVoxel, num_data_packets);
-  for (size_t voxel_idx = 0u, data_idx = 0u;
-       voxel_idx < num_voxels_ && data_idx < num_data_packets;
+  for (size_t voxel_idx = 0u, data_idx = 0u; voxel_idx < num_voxels_;
        ++voxel_idx, data_idx += kNumDataPacketsPerVoxel) {
-    const uint32_t bytes_1 = data[data_idx];
     const uint32_t bytes_2 = data[data_idx + 1u];
 
     EsdfVoxel& voxel = voxels_[voxel_idx];
 
-    memcpy(&(voxel.distance), &bytes_1, sizeof(bytes_1));
-
-    voxel.observed = static_cast<bool>(bytes_2 & 0x000000FF);
-    voxel.in_queue = static_cast<bool>(bytes_2 & 0x0000FF00);
-    voxel.fixed = static_cast<bool>(bytes_2 & 0x00FF0000);
-    voxel.parent =
-        deserializeDirection(static_cast<uint8_t>(bytes_2 & 0xFF000000));
+    memcpy(&(voxel.distance), &data[data_idx], sizeof(uint32_t));
+
+    if ((bytes_2 & kEsdfParentOffsetFormatFlag) != 0u) {
+      voxel.observed = static_cast<bool>(bytes_2 & 0x00000001);
+      voxel.in_queue = static_cast<bool>(bytes_2 & 0x00000002);
+      voxel.fixed = static_cast<bool>(bytes_2 & 0x00000004);
+      voxel.parent.x() = static_cast<int8_t>((bytes_2 >> 8) & 0xFF);
+      voxel.parent.y() = static_cast<int8_t>((bytes_2 >> 16) & 0xFF);
+      voxel.parent.z() = static_cast<int8_t>(bytes_2 >> 24);
+    } else {
+      // Older data, with one byte per flag and only the direction towards
+      // the parent.
+      voxel.observed = static_cast<bool>(bytes_2 & 0x000000FF);
+      voxel.in_queue = static_cast<bool>(bytes_2 & 0x0000FF00);
+      voxel.fixed = static_cast<bool>(bytes_2 & 0x00FF0000);
+      voxel.parent = deserializeDirection(static_cast<uint8_t>(bytes_2 >> 24))
+                         .cast<int8_t>();
+    }
   }
 }
 
 // Serialization functions:
 template <>
-void Block<TsdfVoxel>::serializeToIntegers(std::vector<uint32_t>* data) const {
+void Block<TsdfVoxel>::serializeToIntegers(uint32_t* data) const {
   CHECK_NOTNULL(data);
   constexpr size_t kNumDataPacketsPerVoxel = 3u;
-  data->clear();
-  data->reserve(num_voxels_ * kNumDataPacketsPerVoxel);
-  for (size_t voxel_idx = 0u; voxel_idx < num_voxels_; ++voxel_idx) {
+  for (size_t voxel_idx = 0u, data_idx = 0u; voxel_idx < num_voxels_;
+       ++voxel_idx, data_idx += kNumDataPacketsPerVoxel) {
     const TsdfVoxel& voxel = voxels_[voxel_idx];
 
-    // TODO(mfehr, helenol): find a better way to do this!
-    const uint32_t* bytes_1_ptr =
-        reinterpret_cast<const uint32_t*>(&voxel.distance);
-    data->push_back(*bytes_1_ptr);
-
-    const uint32_t* bytes_2_ptr =
-        reinterpret_cast<const uint32_t*>(&voxel.weight);
-    data->push_back(*bytes_2_ptr);
-
-    data->push_back(static_cast<uint32_t>(voxel.color.a) |
-                    (static_cast<uint32_t>(voxel.color.b) << 8) |
-                    (static_cast<uint32_t>(voxel.color.g) << 16) |
-                    (static_cast<uint32_t>(voxel.color.r) << 24));
+    memcpy(&data[data_idx], &(voxel.distance), sizeof(uint32_t));
+    memcpy(&data[data_idx + 1u], &(voxel.weight), sizeof(uint32_t));
+    data[data_idx + 2u] = static_cast<uint32_t>(voxel.color.a) |
+                          (static_cast<uint32_t>(voxel.color.b) << 8) |
+                          (static_cast<uint32_t>(voxel.color.g) << 16) |
+                          (static_cast<uint32_t>(voxel.color.r) << 24);
   }
-  CHECK_EQ(num_voxels_ * kNumDataPacketsPerVoxel, data->size());
 }
 
 template <>
-void Block<OccupancyVoxel>::serializeToIntegers(
-    std::vector<uint32_t>* data) const {
+void Block<OccupancyVoxel>::serializeToIntegers(uint32_t* data) const {
   CHECK_NOTNULL(data);
   constexpr size_t kNumDataPacketsPerVoxel = 2u;
-  data->clear();
-  data->reserve(num_voxels_ * kNumDataPacketsPerVoxel);
-  for (size_t voxel_idx = 0u; voxel_idx < num_voxels_; ++voxel_idx) {
+  for (size_t voxel_idx = 0u, data_idx = 0u; voxel_idx < num_voxels_;
+       ++voxel_idx, data_idx += kNumDataPacketsPerVoxel) {
     const OccupancyVoxel& voxel = voxels_[voxel_idx];
 
-    const uint32_t* bytes_1_ptr =
-        reinterpret_cast<const uint32_t*>(&voxel.probability_log);
-    data->push_back(*bytes_1_ptr);
-    data->push_back(static_cast<uint32_t>(voxel.observed));
+    memcpy(&data[data_idx], &(voxel.probability_log), sizeof(uint32_t));
+    data[data_idx + 1u] = static_cast<uint32_t>(voxel.observed);
   }
-  CHECK_EQ(num_voxels_ * kNumDataPacketsPerVoxel, data->size());
 }
 
 template <>
-void Block<EsdfVoxel>::serializeToIntegers(std::vector<uint32_t>* data) const {
+void Block<EsdfVoxel>::serializeToIntegers(uint32_t* data) const {
   CHECK_NOTNULL(data);
   constexpr size_t kNumDataPacketsPerVoxel = 2u;
-  data->clear();
-  data->reserve(num_voxels_ * kNumDataPacketsPerVoxel);
-  for (size_t voxel_idx = 0u; voxel_idx < num_voxels_; ++voxel_idx) {
+  for (size_t voxel_idx = 0u, data_idx = 0u; voxel_idx < num_voxels_;
+       ++voxel_idx, data_idx += kNumDataPacketsPerVoxel) {
     const EsdfVoxel& voxel = voxels_[voxel_idx];
 
-    const uint32_t* bytes_1_ptr =
-        reinterpret_cast<const uint32_t*>(&voxel.distance);
-    data->push_back(*bytes_1_ptr);
-    // Repack this as a bunch of bools. Could also pack into a since uint8_t
-    // to save space, but this maybe simpler.
-    // observed is byte 1, in_queue is byte 2, fixed is byte 3,
-    // then direction is packed into byte 4.
-    uint8_t byte1 = voxel.observed;
-    uint8_t byte2 = voxel.in_queue;
-    uint8_t byte3 = voxel.fixed;
-    // Packing here is a bit more creative. 2 bits per direction.
-    // [0 0] = 0, [1 0] = -1, [0 1] = 1.
-    uint8_t byte4 = serializeDirection(voxel.parent);
-    data->push_back(static_cast<uint32_t>(byte1) |
-                    (static_cast<uint32_t>(byte2) << 8) |
-                    (static_cast<uint32_t>(byte3) << 16) |
-                    (static_cast<uint32_t>(byte4) << 24));
+    memcpy(&data[data_idx], &(voxel.distance), sizeof(uint32_t));
+    // The flags are packed into the lowest byte, next to the marker of this
+    // format, followed by the parent offset as one int8 per axis, so offsets
+    // of more than one voxel survive the round trip.
+    uint32_t flags = kEsdfParentOffsetFormatFlag;
+    flags |= voxel.observed ? 0x00000001 : 0u;
+    flags |= voxel.in_queue ? 0x00000002 : 0u;
+    flags |= voxel.fixed ? 0x00000004 : 0u;
+    const uint32_t parent_x = static_cast<uint8_t>(voxel.parent.x());
+    const uint32_t parent_y = static_cast<uint8_t>(voxel.parent.y());
+    const uint32_t parent_z = static_cast<uint8_t>(voxel.parent.z());
+    data[data_idx + 1u] =
+        flags | (parent_x << 8) | (parent_y << 16) | (parent_z << 24);
   }
-  CHECK_EQ(num_voxels_ * kNumDataPacketsPerVoxel, data->size());
 }
 
 }  // namespace voxblox
@@ -29,6 +29,33 @@ bool EsdfMap::getDistanceAndGradientAtPosition(
   return success;
 }
 
+void EsdfMap::batchGetDistanceAndGradientAtPosition(
+    const Eigen::Matrix3Xd& positions, Eigen::VectorXd* distances,
+    Eigen::Matrix3Xd* gradients, Eigen::VectorXi* observed) const {
+  CHECK_NOTNULL(distances);
+  CHECK_NOTNULL(gradients);
+  CHECK_NOTNULL(observed);
+  Pointcloud positions_fp(positions.cols());
+  for (int i = 0; i < positions.cols(); ++i) {
+    positions_fp[i] = positions.col(i).cast<FloatingPoint>();
+  }
+
+  std::vector<FloatingPoint> distances_fp;
+  Pointcloud gradients_fp;
+  std::vector<bool> success;
+  interpolator_.getAdaptiveDistancesAndGradients(positions_fp, &distances_fp,
+                                                 &gradients_fp, &success);
+
+  distances->resize(positions.cols());
+  gradients->resize(Eigen::NoChange, positions.cols());
+  observed->resize(positions.cols());
+  for (int i = 0; i < positions.cols(); ++i) {
+    (*distances)(i) = static_cast<double>(distances_fp[i]);
+    gradients->col(i) = gradients_fp[i].cast<double>();
+    (*observed)(i) = success[i] ? 1 : 0;
+  }
+}
+
 bool EsdfMap::isObserved(const Eigen::Vector3d& position) const {
   // Get the block.
   Block<EsdfVoxel>::Ptr block_ptr =
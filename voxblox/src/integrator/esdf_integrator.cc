@@ -15,29 +15,114 @@ EsdfIntegrator::EsdfIntegrator(const Config& config,
   CHECK_EQ(esdf_layer_->voxels_per_side(), tsdf_layer_->voxels_per_side());
   CHECK_NEAR(esdf_layer_->voxel_size(), tsdf_layer_->voxel_size(), 1e-6);
 
+  if (config_.integrator_threads == 0) {
+    LOG(WARNING) << "Automatic core count failed, defaulting to 1 threads";
+    config_.integrator_threads = 1;
+  }
+  // The full Euclidean updates store the offset to the nearest fixed voxel,
+  // which has to fit into the parent of every voxel below the maximum
+  // distance.
+  if (config_.full_euclidean_distance) {
+    CHECK_LE(config_.max_distance_m, kMaxParentOffset * esdf_voxel_size_)
+        << "Full Euclidean distances can only be propagated up to "
+        << kMaxParentOffset << " voxels.";
+  }
+
   open_.setNumBuckets(config_.num_buckets, config_.max_distance_m);
+
+  computeSphereStencil(config_.clear_sphere_radius, &clear_sphere_stencil_);
+  computeSphereStencil(config_.occupied_sphere_radius,
+                       &occupied_sphere_stencil_);
+}
+
+void EsdfIntegrator::computeSphereStencil(FloatingPoint radius,
+                                          SphereStencil* stencil) const {
+  DCHECK_NOTNULL(stencil);
+  const FloatingPoint radius_voxels = radius / esdf_voxel_size_;
+  // Voxels exactly on the sphere are part of it.
+  const FloatingPoint squared_radius_voxels =
+      radius_voxels * radius_voxels + 1e-4;
+  stencil->radius_voxels = std::floor(std::sqrt(squared_radius_voxels));
+  const int size = 2 * stencil->radius_voxels + 1;
+  stencil->half_lengths.resize(size * size);
+  for (int z = -stencil->radius_voxels; z <= stencil->radius_voxels; ++z) {
+    for (int y = -stencil->radius_voxels; y <= stencil->radius_voxels; ++y) {
+      const FloatingPoint squared_half_length =
+          squared_radius_voxels - y * y - z * z;
+      stencil->half_lengths[(y + stencil->radius_voxels) +
+                            size * (z + stencil->radius_voxels)] =
+          squared_half_length < 0.0
+              ? -1
+              : static_cast<int>(std::sqrt(squared_half_length));
+    }
+  }
 }
 
-void EsdfIntegrator::getSphereAroundPoint(
-    const Point& center, FloatingPoint radius,
-    BlockVoxelListMap* block_voxel_list) const {
-  // search a cube with side length 2*radius
-  for (FloatingPoint x = -radius; x <= radius; x += esdf_voxel_size_) {
-    for (FloatingPoint y = -radius; y <= radius; y += esdf_voxel_size_) {
-      for (FloatingPoint z = -radius; z <= radius; z += esdf_voxel_size_) {
-        Point point(x, y, z);
-
-        // check if point is inside the spheres radius
-        if (point.squaredNorm() <= radius * radius) {
-          // convert to global coordinate
-          point += center;
-
-          BlockIndex block_index =
-              esdf_layer_->computeBlockIndexFromCoordinates(point);
-
-          (*block_voxel_list)[block_index].push_back(
-              esdf_layer_->allocateBlockPtrByIndex(block_index)
-                  ->computeVoxelIndexFromCoordinates(point));
+void EsdfIntegrator::setUnknownVoxelsInSphere(
+    const AnyIndex& center_voxel_index, const SphereStencil& stencil,
+    FloatingPoint distance) {
+  const int voxels_per_side = static_cast<int>(esdf_voxels_per_side_);
+  const FloatingPoint voxels_per_side_inv = 1.0 / esdf_voxels_per_side_;
+  const BlockIndex min_block_index = getBlockIndexFromGlobalVoxelIndex(
+      center_voxel_index - AnyIndex::Constant(stencil.radius_voxels),
+      voxels_per_side_inv);
+  const BlockIndex max_block_index = getBlockIndexFromGlobalVoxelIndex(
+      center_voxel_index + AnyIndex::Constant(stencil.radius_voxels),
+      voxels_per_side_inv);
+
+  BlockNeighborhood<EsdfVoxel> neighborhood(esdf_layer_);
+  BlockIndex block_index;
+  for (block_index.z() = min_block_index.z();
+       block_index.z() <= max_block_index.z(); ++block_index.z()) {
+    for (block_index.y() = min_block_index.y();
+         block_index.y() <= max_block_index.y(); ++block_index.y()) {
+      for (block_index.x() = min_block_index.x();
+           block_index.x() <= max_block_index.x(); ++block_index.x()) {
+        // Offset of the first voxel of the block from the center voxel.
+        const AnyIndex block_offset =
+            block_index * voxels_per_side - center_voxel_index;
+        // Only allocated once a row of the stencil passes through it.
+        Block<EsdfVoxel>* block = nullptr;
+        bool updated = false;
+        VoxelIndex voxel_index;
+        for (voxel_index.z() = 0; voxel_index.z() < voxels_per_side;
+             ++voxel_index.z()) {
+          const int z = block_offset.z() + voxel_index.z();
+          if (std::abs(z) > stencil.radius_voxels) {
+            continue;
+          }
+          for (voxel_index.y() = 0; voxel_index.y() < voxels_per_side;
+               ++voxel_index.y()) {
+            const int y = block_offset.y() + voxel_index.y();
+            if (std::abs(y) > stencil.radius_voxels) {
+              continue;
+            }
+            const int half_length = stencil.getHalfLength(y, z);
+            const int begin_x =
+                std::max(-half_length - block_offset.x(), 0);
+            const int end_x =
+                std::min(half_length - block_offset.x() + 1, voxels_per_side);
+            if (begin_x >= end_x) {
+              continue;
+            }
+            if (block == nullptr) {
+              block = esdf_layer_->allocateBlockPtrByIndex(block_index).get();
+              neighborhood.setBlock(block_index);
+            }
+            for (voxel_index.x() = begin_x; voxel_index.x() < end_x;
+                 ++voxel_index.x()) {
+              EsdfVoxel& esdf_voxel = block->getVoxelByVoxelIndex(voxel_index);
+              if (!esdf_voxel.observed) {
+                esdf_voxel.distance = distance;
+                esdf_voxel.observed = true;
+                pushNeighborsToOpen(voxel_index, &neighborhood, &open_);
+                updated = true;
+              }
+            }
+          }
+        }
+        if (updated) {
+          updated_blocks_.insert(block_index);
         }
       }
     }
@@ -49,45 +134,14 @@ void EsdfIntegrator::getSphereAroundPoint(
 void EsdfIntegrator::addNewRobotPosition(const Point& position) {
   timing::Timer clear_timer("esdf/clear_radius");
 
+  const AnyIndex center_voxel_index =
+      getGridIndexFromPoint(position, 1.0 / esdf_voxel_size_);
   // First set all in inner sphere to free.
-  BlockVoxelListMap block_voxel_list;
-  getSphereAroundPoint(position, config_.clear_sphere_radius,
-                       &block_voxel_list);
-  for (const std::pair<BlockIndex, VoxelIndexList>& kv : block_voxel_list) {
-    // Get block.
-    Block<EsdfVoxel>::Ptr block_ptr =
-        esdf_layer_->allocateBlockPtrByIndex(kv.first);
-
-    for (const VoxelIndex& voxel_index : kv.second) {
-      EsdfVoxel& esdf_voxel = block_ptr->getVoxelByVoxelIndex(voxel_index);
-      if (!esdf_voxel.observed) {
-        esdf_voxel.distance = config_.default_distance_m;
-        esdf_voxel.observed = true;
-        pushNeighborsToOpen(kv.first, voxel_index);
-        updated_blocks_.insert(kv.first);
-      }
-    }
-  }
-
+  setUnknownVoxelsInSphere(center_voxel_index, clear_sphere_stencil_,
+                           config_.default_distance_m);
   // Second set all remaining unknown to occupied.
-  block_voxel_list.clear();
-  getSphereAroundPoint(position, config_.occupied_sphere_radius,
-                       &block_voxel_list);
-  for (const std::pair<BlockIndex, VoxelIndexList>& kv : block_voxel_list) {
-    // Get block.
-    Block<EsdfVoxel>::Ptr block_ptr =
-        esdf_layer_->allocateBlockPtrByIndex(kv.first);
-
-    for (const VoxelIndex& voxel_index : kv.second) {
-      EsdfVoxel& esdf_voxel = block_ptr->getVoxelByVoxelIndex(voxel_index);
-      if (!esdf_voxel.observed) {
-        esdf_voxel.distance = -config_.default_distance_m;
-        esdf_voxel.observed = true;
-        pushNeighborsToOpen(kv.first, voxel_index);
-        updated_blocks_.insert(kv.first);
-      }
-    }
-  }
+  setUnknownVoxelsInSphere(center_voxel_index, occupied_sphere_stencil_,
+                           -config_.default_distance_m);
   VLOG(3) << "Changed " << updated_blocks_.size()
           << " blocks from unknown to free or occupied near the robot.";
   clear_timer.Stop();
@@ -117,6 +171,172 @@ void EsdfIntegrator::updateFromTsdfLayerBatchFullEuclidean() {
   updateFromTsdfBlocksFullEuclidean(tsdf_blocks);
 }
 
+void EsdfIntegrator::updateFromTsdfLayerBatchExact() {
+  DCHECK_EQ(tsdf_layer_->voxels_per_side(), esdf_layer_->voxels_per_side());
+  timing::Timer esdf_timer("esdf");
+  esdf_layer_->removeAllBlocks();
+  updated_blocks_.clear();
+
+  BlockIndexList tsdf_blocks;
+  tsdf_layer_->getAllAllocatedBlocks(&tsdf_blocks);
+  if (tsdf_blocks.empty()) {
+    return;
+  }
+
+  // The blocks are allocated up front, so the threads only write voxels of
+  // their own blocks.
+  for (const BlockIndex& block_index : tsdf_blocks) {
+    esdf_layer_->allocateBlockPtrByIndex(block_index);
+  }
+
+  // Sites further away than the maximum distance plus the largest fixed
+  // distance only produce distances that are cut off anyway, so the grid of a
+  // tile only needs the sites within that halo around it.
+  const int vps = static_cast<int>(esdf_voxels_per_side_);
+  const int halo_blocks = static_cast<int>(
+      std::ceil((config_.max_distance_m + config_.min_distance_m) /
+                (esdf_voxel_size_ * vps)));
+  std::vector<DistanceGridTile> tiles;
+  splitIntoDistanceGridTiles(tsdf_blocks, config_.exact_tile_size_blocks,
+                             halo_blocks, &tiles);
+
+  DenseDistanceGrid grid;
+  for (const DistanceGridTile& tile : tiles) {
+    // Dense grid over the tile and its halo, with a squared distance of 0 at
+    // the fixed voxels and infinity everywhere else.
+    timing::Timer init_timer("esdf/exact_init");
+    grid.reset(tile, vps);
+    BlockIndex block_index;
+    for (block_index.z() = tile.min_block_index.z();
+         block_index.z() <= tile.max_block_index.z(); ++block_index.z()) {
+      for (block_index.y() = tile.min_block_index.y();
+           block_index.y() <= tile.max_block_index.y(); ++block_index.y()) {
+        for (block_index.x() = tile.min_block_index.x();
+             block_index.x() <= tile.max_block_index.x(); ++block_index.x()) {
+          Block<TsdfVoxel>::ConstPtr tsdf_block =
+              tsdf_layer_->getBlockPtrByIndex(block_index);
+          if (!tsdf_block) {
+            continue;
+          }
+          const Eigen::Vector3i block_origin =
+              (block_index - grid.min_block_index) * vps;
+          for (size_t lin_index = 0u; lin_index < tsdf_block->num_voxels();
+               ++lin_index) {
+            const TsdfVoxel& tsdf_voxel =
+                tsdf_block->getVoxelByLinearIndex(lin_index);
+            if (tsdf_voxel.weight < config_.min_weight ||
+                !isFixed(tsdf_voxel.distance)) {
+              continue;
+            }
+            const Eigen::Vector3i grid_index =
+                block_origin +
+                tsdf_block->computeVoxelIndexFromLinearIndex(lin_index);
+            const size_t grid_lin_index = grid.getLinearIndex(
+                grid_index.x(), grid_index.y(), grid_index.z());
+            grid.squared_distances[grid_lin_index] = 0.0f;
+            grid.site_distances[grid_lin_index] = tsdf_voxel.distance;
+          }
+        }
+      }
+    }
+    init_timer.Stop();
+
+    timing::Timer transform_timer("esdf/exact_transform");
+    grid.transform(config_.integrator_threads);
+    transform_timer.Stop();
+
+    timing::Timer write_timer("esdf/exact_write");
+    const BlockIndexList& tile_blocks = tile.block_indices;
+    const size_t num_threads =
+        std::min(config_.integrator_threads, tile_blocks.size());
+    if (num_threads <= 1u) {
+      writeExactDistances(tile_blocks, 0u, tile_blocks.size(), grid);
+    } else {
+      std::vector<std::thread> integration_threads;
+      for (size_t i = 0; i < num_threads; ++i) {
+        integration_threads.emplace_back(
+            &EsdfIntegrator::writeExactDistances, this, std::cref(tile_blocks),
+            i * tile_blocks.size() / num_threads,
+            (i + 1) * tile_blocks.size() / num_threads, std::cref(grid));
+      }
+      for (std::thread& thread : integration_threads) {
+        thread.join();
+      }
+    }
+    write_timer.Stop();
+  }
+
+  esdf_timer.Stop();
+}
+
+void EsdfIntegrator::writeExactDistances(const BlockIndexList& block_indices,
+                                         size_t begin, size_t end,
+                                         const DenseDistanceGrid& grid) {
+  const int vps = static_cast<int>(esdf_voxels_per_side_);
+  for (size_t i = begin; i < end; ++i) {
+    const BlockIndex& block_index = block_indices[i];
+    const Block<TsdfVoxel>& tsdf_block =
+        tsdf_layer_->getBlockByIndex(block_index);
+    Block<EsdfVoxel>& esdf_block = esdf_layer_->getBlockByIndex(block_index);
+    const Eigen::Vector3i block_origin =
+        (block_index - grid.min_block_index) * vps;
+
+    for (size_t lin_index = 0u; lin_index < tsdf_block.num_voxels();
+         ++lin_index) {
+      const TsdfVoxel& tsdf_voxel = tsdf_block.getVoxelByLinearIndex(lin_index);
+      if (tsdf_voxel.weight < config_.min_weight) {
+        continue;
+      }
+      EsdfVoxel& esdf_voxel = esdf_block.getVoxelByLinearIndex(lin_index);
+      esdf_voxel.observed = true;
+      esdf_voxel.in_queue = false;
+      esdf_voxel.parent.setZero();
+      if (isFixed(tsdf_voxel.distance)) {
+        esdf_voxel.distance = tsdf_voxel.distance;
+        esdf_voxel.fixed = true;
+        continue;
+      }
+      esdf_voxel.fixed = false;
+
+      const Eigen::Vector3i voxel =
+          block_origin +
+          esdf_block.computeVoxelIndexFromLinearIndex(lin_index);
+      const size_t grid_lin_index =
+          grid.getLinearIndex(voxel.x(), voxel.y(), voxel.z());
+      Eigen::Vector3i site;
+      if (!grid.getNearestSite(voxel, &site)) {
+        esdf_voxel.distance =
+            signum(tsdf_voxel.distance) * config_.default_distance_m;
+        continue;
+      }
+
+      const FloatingPoint site_distance =
+          grid.site_distances[grid.getLinearIndex(site.x(), site.y(),
+                                                  site.z())];
+      const FloatingPoint distance =
+          std::sqrt(grid.squared_distances[grid_lin_index]) * esdf_voxel_size_;
+      if (tsdf_voxel.distance >= 0.0) {
+        esdf_voxel.distance = std::max<FloatingPoint>(
+            site_distance + distance, 0.0);
+      } else {
+        esdf_voxel.distance = std::min<FloatingPoint>(
+            site_distance - distance, 0.0);
+      }
+      if (std::abs(esdf_voxel.distance) >= config_.max_distance_m) {
+        esdf_voxel.distance =
+            signum(tsdf_voxel.distance) * config_.default_distance_m;
+        continue;
+      }
+      // Sites too far away for the parent offset are treated like the ones
+      // beyond the maximum distance, as in EsdfOccIntegrator.
+      if (!setParentOffset(site - voxel, &esdf_voxel)) {
+        esdf_voxel.distance =
+            signum(tsdf_voxel.distance) * config_.default_distance_m;
+      }
+    }
+  }
+}
+
 void EsdfIntegrator::updateFromTsdfLayer(bool clear_updated_flag) {
   BlockIndexList tsdf_blocks;
   tsdf_layer_->getAllUpdatedBlocks(&tsdf_blocks);
@@ -220,6 +440,12 @@ void EsdfIntegrator::updateFromTsdfBlocks(const BlockIndexList& tsdf_blocks,
                                           bool push_neighbors) {
   DCHECK_EQ(tsdf_layer_->voxels_per_side(), esdf_layer_->voxels_per_side());
   timing::Timer esdf_timer("esdf");
+  if (config_.parallel_incremental_update && config_.integrator_threads > 1u &&
+      !config_.full_euclidean_distance &&
+      updateFromTsdfBlocksParallel(tsdf_blocks, push_neighbors)) {
+    esdf_timer.Stop();
+    return;
+  }
 
   // Get a specific list of voxels in the TSDF layer, and propagate out from
   // there.
@@ -234,106 +460,408 @@ void EsdfIntegrator::updateFromTsdfBlocks(const BlockIndexList& tsdf_blocks,
     if (!tsdf_layer_->hasBlock(block_index)) {
       continue;
     }
-    const Block<TsdfVoxel>& tsdf_block =
-        tsdf_layer_->getBlockByIndex(block_index);
-
     // Allocate the same block in the ESDF layer.
     // Block indices are the same across all layers.
-    Block<EsdfVoxel>::Ptr esdf_block =
-        esdf_layer_->allocateBlockPtrByIndex(block_index);
+    esdf_layer_->allocateBlockPtrByIndex(block_index);
+    propagateTsdfBlock(block_index, push_neighbors, &raise_, &open_,
+                       &num_lower, &num_raise, &num_new);
+  }
+  propagate_timer.Stop();
+  VLOG(3) << "[ESDF update]: Lower: " << num_lower << " Raise: " << num_raise
+          << " New: " << num_new;
 
-    // TODO(helenol): assumes that TSDF and ESDF layer are the same size.
-    // This will not always be true...
-    const size_t num_voxels_per_block = tsdf_block.num_voxels();
+  timing::Timer raise_timer("esdf/raise_esdf");
+  // Process the open set now.
+  if (config_.full_euclidean_distance) {
+    processRaiseSetFullEuclidean();
+  } else {
+    processRaiseSet();
+  }
+  raise_timer.Stop();
 
-    for (size_t lin_index = 0u; lin_index < num_voxels_per_block; ++lin_index) {
-      const TsdfVoxel& tsdf_voxel = tsdf_block.getVoxelByLinearIndex(lin_index);
+  timing::Timer update_timer("esdf/update_esdf");
+  // Process the open set now.
+  if (config_.full_euclidean_distance) {
+    processOpenSetFullEuclidean();
+  } else {
+    processOpenSet();
+  }
+  update_timer.Stop();
 
-      if (tsdf_voxel.weight < config_.min_weight) {
-        continue;
-      }
+  esdf_timer.Stop();
+}
 
-      EsdfVoxel& esdf_voxel = esdf_block->getVoxelByLinearIndex(lin_index);
-      VoxelIndex voxel_index =
-          esdf_block->computeVoxelIndexFromLinearIndex(lin_index);
-      // Check for frontier voxels.
-      // This is the check for the lower frontier.
-      if (isFixed(tsdf_voxel.distance)) {
-        // This is if the distance has been lowered or the voxel is new.
-        // Gets put into lower frontier (open_).
-        if (!esdf_voxel.observed ||
-            (tsdf_voxel.distance >= 0.0 &&
-             esdf_voxel.distance > tsdf_voxel.distance) ||
-            (tsdf_voxel.distance < 0.0 &&
-             esdf_voxel.distance < tsdf_voxel.distance)) {
-          esdf_voxel.distance = tsdf_voxel.distance;
-          esdf_voxel.observed = true;
-          esdf_voxel.fixed = true;
-          esdf_voxel.parent.setZero();
+void EsdfIntegrator::propagateTsdfBlock(const BlockIndex& block_index,
+                                        bool push_neighbors,
+                                        std::queue<VoxelKey>* raise,
+                                        BucketQueue<VoxelKey>* open,
+                                        size_t* num_lower, size_t* num_raise,
+                                        size_t* num_new) {
+  DCHECK_NOTNULL(raise);
+  DCHECK_NOTNULL(open);
+  DCHECK_NOTNULL(num_lower);
+  DCHECK_NOTNULL(num_raise);
+  DCHECK_NOTNULL(num_new);
+  const Block<TsdfVoxel>& tsdf_block =
+      tsdf_layer_->getBlockByIndex(block_index);
+  // No blocks are allocated while the voxels of this block are visited.
+  BlockNeighborhood<EsdfVoxel> neighborhood(esdf_layer_);
+  Block<EsdfVoxel>* esdf_block = neighborhood.setBlock(block_index);
+  DCHECK(esdf_block != nullptr);
+
+  // TODO(helenol): assumes that TSDF and ESDF layer are the same size.
+  // This will not always be true...
+  const size_t num_voxels_per_block = tsdf_block.num_voxels();
+
+  for (size_t lin_index = 0u; lin_index < num_voxels_per_block; ++lin_index) {
+    const TsdfVoxel& tsdf_voxel = tsdf_block.getVoxelByLinearIndex(lin_index);
+
+    if (tsdf_voxel.weight < config_.min_weight) {
+      continue;
+    }
 
-          esdf_voxel.in_queue = true;
-          open_.push(std::make_pair(block_index, voxel_index),
-                     esdf_voxel.distance);
-          num_lower++;
-        } else {
-          // In case the fixed voxel has a HIGHER distance than the esdf
-          // voxel. Need to raise it, and burn its children.
-          esdf_voxel.distance = tsdf_voxel.distance;
-          esdf_voxel.parent.setZero();
-          esdf_voxel.fixed = true;
-          raise_.push(std::make_pair(block_index, voxel_index));
-          // We need to also make sure this voxel ends up in the lower
-          // frontier, as it is fixed.
-          open_.push(std::make_pair(block_index, voxel_index),
-                     esdf_voxel.distance);
-          esdf_voxel.in_queue = true;
-          num_raise++;
-        }
+    EsdfVoxel& esdf_voxel = esdf_block->getVoxelByLinearIndex(lin_index);
+    VoxelIndex voxel_index =
+        esdf_block->computeVoxelIndexFromLinearIndex(lin_index);
+    // Check for frontier voxels.
+    // This is the check for the lower frontier.
+    if (isFixed(tsdf_voxel.distance)) {
+      // This is if the distance has been lowered or the voxel is new.
+      // Gets put into lower frontier (open).
+      if (!esdf_voxel.observed ||
+          (tsdf_voxel.distance >= 0.0 &&
+           esdf_voxel.distance > tsdf_voxel.distance) ||
+          (tsdf_voxel.distance < 0.0 &&
+           esdf_voxel.distance < tsdf_voxel.distance)) {
+        esdf_voxel.distance = tsdf_voxel.distance;
+        esdf_voxel.observed = true;
+        esdf_voxel.fixed = true;
+        esdf_voxel.parent.setZero();
+
+        esdf_voxel.in_queue = true;
+        open->push(std::make_pair(block_index, voxel_index),
+                   esdf_voxel.distance);
+        (*num_lower)++;
       } else {
-        // If the tsdf voxel isn't fixed...
-        // If it used to be, then this is a raise.
-        // Or sign is flipped...
+        // In case the fixed voxel has a HIGHER distance than the esdf
+        // voxel. Need to raise it, and burn its children.
+        esdf_voxel.distance = tsdf_voxel.distance;
+        esdf_voxel.parent.setZero();
+        esdf_voxel.fixed = true;
+        raise->push(std::make_pair(block_index, voxel_index));
+        // We need to also make sure this voxel ends up in the lower
+        // frontier, as it is fixed.
+        open->push(std::make_pair(block_index, voxel_index),
+                   esdf_voxel.distance);
+        esdf_voxel.in_queue = true;
+        (*num_raise)++;
+      }
+    } else {
+      // If the tsdf voxel isn't fixed...
+      // If it used to be, then this is a raise.
+      // Or sign is flipped...
+
+      if (esdf_voxel.observed &&
+          (esdf_voxel.fixed ||
+           signum(esdf_voxel.distance) != signum(tsdf_voxel.distance))) {
+        esdf_voxel.distance =
+            signum(tsdf_voxel.distance) * config_.default_distance_m;
+        esdf_voxel.parent.setZero();
+        esdf_voxel.fixed = false;
+        raise->push(std::make_pair(block_index, voxel_index));
+        (*num_raise)++;
+      }
+      // Then there's the case where it's a completely new voxel.
+      if (!esdf_voxel.observed) {
+        esdf_voxel.distance =
+            signum(tsdf_voxel.distance) * config_.default_distance_m;
+        esdf_voxel.observed = true;
+        esdf_voxel.fixed = false;
+        esdf_voxel.parent.setZero();
+        if (push_neighbors) {
+          pushNeighborsToOpen(voxel_index, &neighborhood, open);
+        }
+        (*num_new)++;
+      }
+    }
+  }
+}
 
-        if (esdf_voxel.observed &&
-            (esdf_voxel.fixed ||
-             signum(esdf_voxel.distance) != signum(tsdf_voxel.distance))) {
-          esdf_voxel.distance =
-              signum(tsdf_voxel.distance) * config_.default_distance_m;
-          esdf_voxel.parent.setZero();
-          esdf_voxel.fixed = false;
-          raise_.push(std::make_pair(block_index, voxel_index));
-          num_raise++;
+bool EsdfIntegrator::updateFromTsdfBlocksParallel(
+    const BlockIndexList& tsdf_blocks, bool push_neighbors) {
+  DCHECK_EQ(tsdf_layer_->voxels_per_side(), esdf_layer_->voxels_per_side());
+  timing::Timer regions_timer("esdf/parallel_regions");
+
+  // Voxels that are already queued, for example around a new robot position,
+  // are handed to the regions with their buckets, and are put back if the
+  // serial update runs instead.
+  std::vector<std::pair<VoxelKey, int>> queued_open;
+  queued_open.reserve(open_.size());
+  while (!open_.empty()) {
+    queued_open.emplace_back(open_.front(), open_.frontBucket());
+    open_.pop();
+  }
+  std::vector<VoxelKey> queued_raise;
+  queued_raise.reserve(raise_.size());
+  while (!raise_.empty()) {
+    queued_raise.push_back(raise_.front());
+    raise_.pop();
+  }
+  auto restore_queues = [&]() {
+    for (const std::pair<VoxelKey, int>& entry : queued_open) {
+      open_.pushToBucket(entry.first, entry.second);
+    }
+    for (const VoxelKey& kv : queued_raise) {
+      raise_.push(kv);
+    }
+  };
+
+  BlockIndexList seed_blocks;
+  for (const BlockIndex& block_index : tsdf_blocks) {
+    if (tsdf_layer_->hasBlock(block_index)) {
+      seed_blocks.push_back(block_index);
+    }
+  }
+  for (const std::pair<VoxelKey, int>& entry : queued_open) {
+    seed_blocks.push_back(entry.first.first);
+  }
+  for (const VoxelKey& kv : queued_raise) {
+    seed_blocks.push_back(kv.first);
+  }
+  const size_t num_regions = computeRegions(seed_blocks);
+  if (num_regions < 2u) {
+    restore_queues();
+    return false;
+  }
+
+  // All ESDF blocks are allocated before the threads start, so they can look
+  // up blocks in the layer concurrently.
+  std::vector<Region> regions(num_regions);
+  for (const BlockIndex& block_index : tsdf_blocks) {
+    if (!tsdf_layer_->hasBlock(block_index)) {
+      continue;
+    }
+    esdf_layer_->allocateBlockPtrByIndex(block_index);
+    regions[region_indices_.at(block_index)].blocks.push_back(block_index);
+  }
+  for (const std::pair<VoxelKey, int>& entry : queued_open) {
+    regions[region_indices_.at(entry.first.first)].open.push_back(entry);
+  }
+  for (const VoxelKey& kv : queued_raise) {
+    regions[region_indices_.at(kv.first)].raise.push_back(kv);
+  }
+  regions_timer.Stop();
+
+  timing::Timer update_timer("esdf/parallel_update_esdf");
+  const size_t num_workers =
+      std::min<size_t>(config_.integrator_threads, num_regions);
+  while (region_workers_.size() < num_workers) {
+    region_workers_.emplace_back(new RegionWorker);
+    region_workers_.back()->open.setNumBuckets(config_.num_buckets,
+                                               config_.max_distance_m);
+  }
+  std::atomic<size_t> next_region(0u);
+  std::atomic<bool> left_region(false);
+  std::vector<std::thread> integration_threads;
+  for (size_t i = 0u; i < num_workers; ++i) {
+    integration_threads.emplace_back(
+        &EsdfIntegrator::updateRegions, this, std::cref(regions),
+        push_neighbors, &next_region, &left_region, region_workers_[i].get());
+  }
+  for (std::thread& thread : integration_threads) {
+    thread.join();
+  }
+
+  const bool success = !left_region.load();
+  for (size_t i = 0u; i < num_workers; ++i) {
+    RegionWorker* worker = region_workers_[i].get();
+    if (!success) {
+      for (const std::pair<const BlockIndex, std::vector<EsdfVoxel>>& kv :
+           worker->original_blocks) {
+        Block<EsdfVoxel>& block = esdf_layer_->getBlockByIndex(kv.first);
+        for (size_t lin_index = 0u; lin_index < kv.second.size();
+             ++lin_index) {
+          block.getVoxelByLinearIndex(lin_index) = kv.second[lin_index];
         }
-        // Then there's the case where it's a completely new voxel.
-        if (!esdf_voxel.observed) {
-          esdf_voxel.distance =
-              signum(tsdf_voxel.distance) * config_.default_distance_m;
-          esdf_voxel.observed = true;
-          esdf_voxel.fixed = false;
-          esdf_voxel.parent.setZero();
-          if (push_neighbors) {
-            pushNeighborsToOpen(block_index, voxel_index);
+      }
+      // The worker that left its region stopped with voxels in its queues.
+      worker->open.setNumBuckets(config_.num_buckets, config_.max_distance_m);
+      std::queue<VoxelKey>().swap(worker->raise);
+    }
+    worker->original_blocks.clear();
+  }
+  update_timer.Stop();
+
+  if (!success) {
+    VLOG(3) << "[ESDF update]: A wavefront left its region, updating the "
+            << num_regions << " regions serially.";
+    restore_queues();
+    return false;
+  }
+  VLOG(3) << "[ESDF update]: Updated " << num_regions << " regions on "
+          << num_workers << " threads.";
+  return true;
+}
+
+size_t EsdfIntegrator::computeRegions(const BlockIndexList& block_indices) {
+  // Wavefronts stop at the maximum distance, after lowering the neighbors
+  // there. The raise set follows the parents, which are closer to the
+  // surface than their children, so it stops there as well.
+  const int reach_voxels =
+      static_cast<int>(std::ceil(config_.max_distance_m / esdf_voxel_size_)) +
+      4;
+  const int voxels_per_side = static_cast<int>(esdf_voxels_per_side_);
+  const int reach_blocks =
+      (reach_voxels + voxels_per_side - 1) / voxels_per_side + 1;
+
+  // Union-find over the distinct blocks, where parents leads to the block
+  // that stands for the region.
+  region_indices_.clear();
+  IndexSet seen_blocks;
+  BlockIndexList seeds;
+  for (const BlockIndex& block_index : block_indices) {
+    if (seen_blocks.insert(block_index).second) {
+      seeds.push_back(block_index);
+    }
+  }
+  std::vector<size_t> parents(seeds.size());
+  for (size_t i = 0u; i < seeds.size(); ++i) {
+    parents[i] = i;
+  }
+  auto find_root = [&parents](size_t i) {
+    while (parents[i] != i) {
+      parents[i] = parents[parents[i]];
+      i = parents[i];
+    }
+    return i;
+  };
+
+  // Every block within reach of a seed is claimed by it, and seeds that
+  // claim the same block are in the same region.
+  BlockIndex offset;
+  for (size_t i = 0u; i < seeds.size(); ++i) {
+    for (offset.z() = -reach_blocks; offset.z() <= reach_blocks; ++offset.z()) {
+      for (offset.y() = -reach_blocks; offset.y() <= reach_blocks;
+           ++offset.y()) {
+        for (offset.x() = -reach_blocks; offset.x() <= reach_blocks;
+             ++offset.x()) {
+          const std::pair<BlockHashMapType<size_t>::type::iterator, bool>
+              insertion = region_indices_.emplace(seeds[i] + offset, i);
+          if (!insertion.second) {
+            parents[find_root(insertion.first->second)] = find_root(i);
           }
-          num_new++;
         }
       }
     }
   }
-  propagate_timer.Stop();
-  VLOG(3) << "[ESDF update]: Lower: " << num_lower << " Raise: " << num_raise
-          << " New: " << num_new;
 
-  timing::Timer raise_timer("esdf/raise_esdf");
-  // Process the open set now.
-  processRaiseSet();
-  raise_timer.Stop();
+  // Numbers the regions in the order of their first seed.
+  constexpr size_t kNoRegion = std::numeric_limits<size_t>::max();
+  std::vector<size_t> root_regions(seeds.size(), kNoRegion);
+  size_t num_regions = 0u;
+  for (size_t i = 0u; i < seeds.size(); ++i) {
+    const size_t root = find_root(i);
+    if (root_regions[root] == kNoRegion) {
+      root_regions[root] = num_regions++;
+    }
+  }
+  for (std::pair<const BlockIndex, size_t>& kv : region_indices_) {
+    kv.second = root_regions[find_root(kv.second)];
+  }
+  return num_regions;
+}
 
-  timing::Timer update_timer("esdf/update_esdf");
-  // Process the open set now.
-  processOpenSet();
-  update_timer.Stop();
+void EsdfIntegrator::updateRegions(const std::vector<Region>& regions,
+                                   bool push_neighbors,
+                                   std::atomic<size_t>* next_region,
+                                   std::atomic<bool>* left_region,
+                                   RegionWorker* worker) {
+  DCHECK_NOTNULL(next_region);
+  DCHECK_NOTNULL(left_region);
+  DCHECK_NOTNULL(worker);
+  size_t region_index;
+  while (!left_region->load() &&
+         (region_index = next_region->fetch_add(1u)) < regions.size()) {
+    worker->region_index = region_index;
+    if (!updateRegion(regions[region_index], push_neighbors, worker)) {
+      left_region->store(true);
+    }
+  }
+}
 
-  esdf_timer.Stop();
+bool EsdfIntegrator::updateRegion(const Region& region, bool push_neighbors,
+                                  RegionWorker* worker) {
+  DCHECK_NOTNULL(worker);
+  // The blocks of the queued voxels are written before any neighbors are
+  // visited.
+  worker->entered_blocks.clear();
+  for (const BlockIndex& block_index : region.blocks) {
+    if (!enterRegionBlock(block_index, worker)) {
+      return false;
+    }
+  }
+  for (const std::pair<VoxelKey, int>& entry : region.open) {
+    if (!enterRegionBlock(entry.first.first, worker)) {
+      return false;
+    }
+    worker->open.pushToBucket(entry.first, entry.second);
+  }
+  for (const VoxelKey& kv : region.raise) {
+    if (!enterRegionBlock(kv.first, worker)) {
+      return false;
+    }
+    worker->raise.push(kv);
+  }
+
+  // Same as the serial update, on the queues of the worker.
+  size_t num_lower = 0u;
+  size_t num_raise = 0u;
+  size_t num_new = 0u;
+  for (const BlockIndex& block_index : region.blocks) {
+    propagateTsdfBlock(block_index, push_neighbors, &worker->raise,
+                       &worker->open, &num_lower, &num_raise, &num_new);
+  }
+  return processRaiseSet(&worker->raise, &worker->open, worker) &&
+         processOpenSet(&worker->open, worker);
+}
+
+bool EsdfIntegrator::enterRegionBlock(const BlockIndex& block_index,
+                                      RegionWorker* worker) const {
+  DCHECK_NOTNULL(worker);
+  if (worker->entered_blocks.count(block_index) > 0u) {
+    return true;
+  }
+  BlockIndex neighbor_index;
+  for (neighbor_index.z() = block_index.z() - 1;
+       neighbor_index.z() <= block_index.z() + 1; ++neighbor_index.z()) {
+    for (neighbor_index.y() = block_index.y() - 1;
+         neighbor_index.y() <= block_index.y() + 1; ++neighbor_index.y()) {
+      for (neighbor_index.x() = block_index.x() - 1;
+           neighbor_index.x() <= block_index.x() + 1; ++neighbor_index.x()) {
+        const Block<EsdfVoxel>::ConstPtr block =
+            esdf_layer_->getBlockPtrByIndex(neighbor_index);
+        if (!block) {
+          continue;
+        }
+        const BlockHashMapType<size_t>::type::const_iterator it =
+            region_indices_.find(neighbor_index);
+        if (it == region_indices_.end() ||
+            it->second != worker->region_index) {
+          return false;
+        }
+        std::vector<EsdfVoxel>& voxels =
+            worker->original_blocks[neighbor_index];
+        if (voxels.empty()) {
+          voxels.reserve(block->num_voxels());
+          for (size_t i = 0u; i < block->num_voxels(); ++i) {
+            voxels.push_back(block->getVoxelByLinearIndex(i));
+          }
+        }
+      }
+    }
+  }
+  worker->entered_blocks.insert(block_index);
+  return true;
 }
 
 void EsdfIntegrator::updateFromTsdfBlocksAsOccupancy(
@@ -430,114 +958,107 @@ void EsdfIntegrator::updateFromTsdfBlocksAsOccupancy(
 
 void EsdfIntegrator::pushNeighborsToOpen(const BlockIndex& block_index,
                                          const VoxelIndex& voxel_index) {
-  std::vector<VoxelKey> neighbors;
-  std::vector<float> distances;
-  std::vector<Eigen::Vector3i> directions;
-  getNeighborsAndDistances(block_index, voxel_index, &neighbors, &distances,
-                           &directions);
-
-  for (const VoxelKey& neighbor : neighbors) {
-    BlockIndex neighbor_block_index = neighbor.first;
-    VoxelIndex neighbor_voxel_index = neighbor.second;
-
-    // Get the block for this voxel.
-    Block<EsdfVoxel>::Ptr neighbor_block =
-        esdf_layer_->getBlockPtrByIndex(neighbor_block_index);
-    if (!neighbor_block) {
-      continue;
-    }
-    EsdfVoxel& neighbor_voxel =
-        neighbor_block->getVoxelByVoxelIndex(neighbor_voxel_index);
+  BlockNeighborhood<EsdfVoxel> neighborhood(esdf_layer_);
+  if (neighborhood.setBlock(block_index) == nullptr) {
+    return;
+  }
+  pushNeighborsToOpen(voxel_index, &neighborhood, &open_);
+}
 
-    if (!neighbor_voxel.observed) {
+void EsdfIntegrator::pushNeighborsToOpen(
+    const VoxelIndex& voxel_index, BlockNeighborhood<EsdfVoxel>* neighborhood,
+    BucketQueue<VoxelKey>* open) {
+  DCHECK_NOTNULL(neighborhood);
+  DCHECK_NOTNULL(open);
+  neighborhood->setVoxel(voxel_index);
+  VoxelKey neighbor_key;
+  for (size_t i = 0u; i < NeighborStencil::kNumNeighbors; ++i) {
+    EsdfVoxel* neighbor_voxel = neighborhood->getNeighbor(i, &neighbor_key);
+    if (neighbor_voxel == nullptr || !neighbor_voxel->observed) {
       continue;
     }
 
-    if (!neighbor_voxel.in_queue) {
-      open_.push(neighbor, neighbor_voxel.distance);
-      neighbor_voxel.in_queue = true;
+    if (!neighbor_voxel->in_queue) {
+      open->push(neighbor_key, neighbor_voxel->distance);
+      neighbor_voxel->in_queue = true;
     }
   }
 }
 
 // The raise set is always empty in batch operations.
 void EsdfIntegrator::processRaiseSet() {
+  processRaiseSet(&raise_, &open_, nullptr);
+}
+
+bool EsdfIntegrator::processRaiseSet(std::queue<VoxelKey>* raise,
+                                     BucketQueue<VoxelKey>* open,
+                                     RegionWorker* worker) {
+  DCHECK_NOTNULL(raise);
+  DCHECK_NOTNULL(open);
   size_t num_updates = 0u;
   // For the raise set, get all the neighbors, then:
   // 1. if the neighbor's parent is the current voxel, add it to the raise
   //    queue.
   // 2. if the neighbor's parent differs, add it to open (we will have to
   //    update our current distances, of course).
-  while (!raise_.empty()) {
-    VoxelKey kv = raise_.front();
-    raise_.pop();
+  BlockNeighborhood<EsdfVoxel> neighborhood(esdf_layer_);
+  VoxelKey neighbor_key;
+  while (!raise->empty()) {
+    VoxelKey kv = raise->front();
+    raise->pop();
 
-    Block<EsdfVoxel>::Ptr esdf_block =
-        esdf_layer_->getBlockPtrByIndex(kv.first);
+    if (neighborhood.setBlock(kv.first) == nullptr) {
+      continue;
+    }
+    if (worker != nullptr && !enterRegionBlock(kv.first, worker)) {
+      return false;
+    }
+    neighborhood.setVoxel(kv.second);
 
     // See if you can update the neighbors.
-    std::vector<VoxelKey> neighbors;
-    std::vector<float> distances;
-    std::vector<Eigen::Vector3i> directions;
-    getNeighborsAndDistances(kv.first, kv.second, &neighbors, &distances,
-                             &directions);
-
-    CHECK_EQ(neighbors.size(), distances.size());
-    for (size_t i = 0u; i < neighbors.size(); ++i) {
-      BlockIndex neighbor_block_index = neighbors[i].first;
-      VoxelIndex neighbor_voxel_index = neighbors[i].second;
-
-      // Get the block for this voxel.
-      Block<EsdfVoxel>::Ptr neighbor_block;
-      if (neighbor_block_index == kv.first) {
-        neighbor_block = esdf_block;
-      } else {
-        neighbor_block = esdf_layer_->getBlockPtrByIndex(neighbor_block_index);
-      }
-      if (!neighbor_block) {
-        continue;
-      }
-      CHECK(neighbor_block->isValidVoxelIndex(neighbor_voxel_index))
-          << "Neigbor voxel index: " << neighbor_voxel_index.transpose();
-
-      EsdfVoxel& neighbor_voxel =
-          neighbor_block->getVoxelByVoxelIndex(neighbor_voxel_index);
-
+    for (size_t i = 0u; i < NeighborStencil::kNumNeighbors; ++i) {
+      EsdfVoxel* neighbor_voxel = neighborhood.getNeighbor(i, &neighbor_key);
       // Do NOT update unobserved distances.
-      if (!neighbor_voxel.observed) {
+      if (neighbor_voxel == nullptr || !neighbor_voxel->observed) {
         continue;
       }
       // This will never update fixed voxels as they are their own parents.
-      if (neighbor_voxel.parent == -directions[i]) {
+      if (neighbor_voxel->parent == NeighborStencil::parentOffset(i)) {
         // This is the case where we are the parent of this one, so we
         // should clear it and raise it.
-        neighbor_voxel.distance =
-            signum(neighbor_voxel.distance) * config_.default_distance_m;
-        neighbor_voxel.parent.setZero();
-        raise_.push(neighbors[i]);
+        neighbor_voxel->distance =
+            signum(neighbor_voxel->distance) * config_.default_distance_m;
+        neighbor_voxel->parent.setZero();
+        raise->push(neighbor_key);
       } else {
         // If it's not in the queue, then add it to open so it can update
         // our weights back.
-        if (!neighbor_voxel.in_queue) {
-          open_.push(neighbors[i], neighbor_voxel.distance);
-          neighbor_voxel.in_queue = true;
+        if (!neighbor_voxel->in_queue) {
+          open->push(neighbor_key, neighbor_voxel->distance);
+          neighbor_voxel->in_queue = true;
         }
       }
     }
     num_updates++;
   }
   VLOG(3) << "[ESDF update]: raised " << num_updates << " voxels.";
+  return true;
 }
 
-void EsdfIntegrator::processOpenSet() {
+void EsdfIntegrator::processOpenSet() { processOpenSet(&open_, nullptr); }
+
+bool EsdfIntegrator::processOpenSet(BucketQueue<VoxelKey>* open,
+                                    RegionWorker* worker) {
+  DCHECK_NOTNULL(open);
   size_t num_updates = 0u;
-  while (!open_.empty()) {
-    VoxelKey kv = open_.front();
-    open_.pop();
+  BlockNeighborhood<EsdfVoxel> neighborhood(esdf_layer_);
+  VoxelKey neighbor_key;
+  while (!open->empty()) {
+    VoxelKey kv = open->front();
+    open->pop();
 
-    Block<EsdfVoxel>::Ptr esdf_block =
-        esdf_layer_->getBlockPtrByIndex(kv.first);
-    EsdfVoxel& esdf_voxel = esdf_block->getVoxelByVoxelIndex(kv.second);
+    neighborhood.setBlock(kv.first);
+    EsdfVoxel& esdf_voxel = neighborhood.setVoxel(kv.second);
 
     // Again, no point updating unobserved voxels.
     if (!esdf_voxel.observed) {
@@ -551,116 +1072,33 @@ void EsdfIntegrator::processOpenSet() {
       esdf_voxel.in_queue = false;
       continue;
     }
+    if (worker != nullptr && !enterRegionBlock(kv.first, worker)) {
+      return false;
+    }
     // See if you can update the neighbors.
-    std::vector<VoxelKey> neighbors;
-    std::vector<float> distances;
-    std::vector<Eigen::Vector3i> directions;
-    getNeighborsAndDistances(kv.first, kv.second, &neighbors, &distances,
-                             &directions);
-
-    // Do NOT update unobserved distances.
-    CHECK_EQ(neighbors.size(), distances.size());
-    for (size_t i = 0; i < neighbors.size(); ++i) {
-      BlockIndex neighbor_block_index = neighbors[i].first;
-      VoxelIndex neighbor_voxel_index = neighbors[i].second;
-
-      // Get the block for this voxel.
-      Block<EsdfVoxel>::Ptr neighbor_block;
-      if (neighbor_block_index == kv.first) {
-        neighbor_block = esdf_block;
-      } else {
-        neighbor_block = esdf_layer_->getBlockPtrByIndex(neighbor_block_index);
-      }
-      if (!neighbor_block) {
+    for (size_t i = 0u; i < NeighborStencil::kNumNeighbors; ++i) {
+      EsdfVoxel* neighbor_voxel_ptr =
+          neighborhood.getNeighbor(i, &neighbor_key);
+      // Do NOT update unobserved distances.
+      if (neighbor_voxel_ptr == nullptr) {
         continue;
       }
-      CHECK(neighbor_block->isValidVoxelIndex(neighbor_voxel_index))
-          << "Neigbor voxel index: " << neighbor_voxel_index.transpose();
-
-      EsdfVoxel& neighbor_voxel =
-          neighbor_block->getVoxelByVoxelIndex(neighbor_voxel_index);
+      EsdfVoxel& neighbor_voxel = *neighbor_voxel_ptr;
 
       if (!neighbor_voxel.observed) {
         continue;
       }
 
-      const FloatingPoint distance_to_neighbor =
-          distances[i] * esdf_voxel_size_;
-
       // Don't bother updating fixed voxels.
       if (neighbor_voxel.fixed) {
         continue;
       }
 
-      // Everything outside the surface.
-      // I think this can easily be combined with that below...
-      if (esdf_voxel.distance + distance_to_neighbor >= 0.0 &&
-          neighbor_voxel.distance >= 0.0 && esdf_voxel.distance >= 0.0 &&
-          esdf_voxel.distance + distance_to_neighbor + 1e-4 <
-              neighbor_voxel.distance) {
-        neighbor_voxel.distance = esdf_voxel.distance + distance_to_neighbor;
-        // Also update parent.
-        neighbor_voxel.parent = -directions[i];
-        // ONLY propagate this if we're below the max distance!
-        if (neighbor_voxel.distance < config_.max_distance_m) {
-          if (!neighbor_voxel.in_queue) {
-            open_.push(neighbors[i], neighbor_voxel.distance);
-            neighbor_voxel.in_queue = true;
-          }
-        }
-      }
-
-      // Everything inside the surface.
-      if (esdf_voxel.distance - distance_to_neighbor < 0.0 &&
-          neighbor_voxel.distance <= 0.0 && esdf_voxel.distance <= 0.0 &&
-          esdf_voxel.distance - distance_to_neighbor - 1e-4 >
-              neighbor_voxel.distance) {
-        neighbor_voxel.distance = esdf_voxel.distance - distance_to_neighbor;
-        // Also update parent.
-        neighbor_voxel.parent = -directions[i];
-        if (neighbor_voxel.distance > -config_.max_distance_m) {
-          if (!neighbor_voxel.in_queue) {
-            open_.push(neighbors[i], neighbor_voxel.distance);
-            neighbor_voxel.in_queue = true;
-          }
-        }
-      }
-
-      // If there's a sign flippy flip.
-      if (signum(esdf_voxel.distance) != signum(neighbor_voxel.distance)) {
-        if (esdf_voxel.fixed &&
-            std::abs(neighbor_voxel.distance + esdf_voxel.distance) >
-                distance_to_neighbor) {
-          neighbor_voxel.distance =
-              esdf_voxel.distance -
-              signum(esdf_voxel.distance) * distance_to_neighbor;
-          neighbor_voxel.parent = -directions[i];
-          if (!neighbor_voxel.in_queue) {
-            open_.push(neighbors[i], neighbor_voxel.distance);
-            neighbor_voxel.in_queue = true;
-          }
-        } else if (std::abs(neighbor_voxel.distance + esdf_voxel.distance) <
-                   distance_to_neighbor) {
-          // Do nothing, we good.
-        } else if (neighbor_voxel.distance < 0.0 &&
-                   esdf_voxel.distance > distance_to_neighbor) {
-          // OK now the other case is if it's 2 totally different signs...
-          neighbor_voxel.distance = -distance_to_neighbor;
-          neighbor_voxel.parent = -directions[i];
-          if (!neighbor_voxel.in_queue) {
-            open_.push(neighbors[i], neighbor_voxel.distance);
-            neighbor_voxel.in_queue = true;
-          }
-        } else if (neighbor_voxel.distance >= distance_to_neighbor &&
-                   esdf_voxel.distance < -distance_to_neighbor) {
-          // OK now the other case is if it's 2 totally different signs...
-          neighbor_voxel.distance = distance_to_neighbor;
-          neighbor_voxel.parent = -directions[i];
-          if (!neighbor_voxel.in_queue) {
-            open_.push(neighbors[i], neighbor_voxel.distance);
-            neighbor_voxel.in_queue = true;
-          }
-        }
+      if (lowerNeighbor(esdf_voxel.distance, esdf_voxel.fixed, i,
+                        &neighbor_voxel) &&
+          !neighbor_voxel.in_queue) {
+        open->push(neighbor_key, neighbor_voxel.distance);
+        neighbor_voxel.in_queue = true;
       }
     }
 
@@ -669,110 +1107,227 @@ void EsdfIntegrator::processOpenSet() {
   }
 
   VLOG(3) << "[ESDF update]: made " << num_updates << " voxel updates.";
+  return true;
+}
+
+bool EsdfIntegrator::lowerNeighbor(FloatingPoint distance, bool fixed,
+                                   size_t n, EsdfVoxel* neighbor_voxel) const {
+  DCHECK_NOTNULL(neighbor_voxel);
+  const FloatingPoint distance_to_neighbor =
+      NeighborStencil::distance(n) * esdf_voxel_size_;
+  bool propagate = false;
+
+  // Everything outside the surface.
+  // I think this can easily be combined with that below...
+  if (distance + distance_to_neighbor >= 0.0 &&
+      neighbor_voxel->distance >= 0.0 && distance >= 0.0 &&
+      distance + distance_to_neighbor + 1e-4 < neighbor_voxel->distance) {
+    neighbor_voxel->distance = distance + distance_to_neighbor;
+    // Also update parent.
+    neighbor_voxel->parent = NeighborStencil::parentOffset(n);
+    // ONLY propagate this if we're below the max distance!
+    propagate = neighbor_voxel->distance < config_.max_distance_m;
+  }
+
+  // Everything inside the surface.
+  if (distance - distance_to_neighbor < 0.0 &&
+      neighbor_voxel->distance <= 0.0 && distance <= 0.0 &&
+      distance - distance_to_neighbor - 1e-4 > neighbor_voxel->distance) {
+    neighbor_voxel->distance = distance - distance_to_neighbor;
+    // Also update parent.
+    neighbor_voxel->parent = NeighborStencil::parentOffset(n);
+    propagate = neighbor_voxel->distance > -config_.max_distance_m;
+  }
+
+  // If there's a sign flippy flip.
+  if (signum(distance) != signum(neighbor_voxel->distance)) {
+    if (fixed && std::abs(neighbor_voxel->distance + distance) >
+                     distance_to_neighbor) {
+      neighbor_voxel->distance =
+          distance - signum(distance) * distance_to_neighbor;
+      neighbor_voxel->parent = NeighborStencil::parentOffset(n);
+      propagate = true;
+    } else if (std::abs(neighbor_voxel->distance + distance) <
+               distance_to_neighbor) {
+      // Do nothing, we good.
+    } else if (neighbor_voxel->distance < 0.0 &&
+               distance > distance_to_neighbor) {
+      // OK now the other case is if it's 2 totally different signs...
+      neighbor_voxel->distance = -distance_to_neighbor;
+      neighbor_voxel->parent = NeighborStencil::parentOffset(n);
+      propagate = true;
+    } else if (neighbor_voxel->distance >= distance_to_neighbor &&
+               distance < -distance_to_neighbor) {
+      // OK now the other case is if it's 2 totally different signs...
+      neighbor_voxel->distance = distance_to_neighbor;
+      neighbor_voxel->parent = NeighborStencil::parentOffset(n);
+      propagate = true;
+    }
+  }
+  return propagate;
+}
+
+void EsdfIntegrator::processRaiseSetFullEuclidean() {
+  size_t num_updates = 0u;
+  // Same as processRaiseSet(), except that a neighbor is raised if its
+  // distance does not follow from its site anymore, whichever voxel it was
+  // reached through.
+  BlockNeighborhood<EsdfVoxel> neighborhood(esdf_layer_);
+  BlockNeighborhood<EsdfVoxel> site_neighborhood(esdf_layer_);
+  VoxelKey neighbor_key;
+  while (!raise_.empty()) {
+    VoxelKey kv = raise_.front();
+    raise_.pop();
+
+    if (neighborhood.setBlock(kv.first) == nullptr) {
+      continue;
+    }
+    neighborhood.setVoxel(kv.second);
+
+    for (size_t i = 0u; i < NeighborStencil::kNumNeighbors; ++i) {
+      EsdfVoxel* neighbor_voxel = neighborhood.getNeighbor(i, &neighbor_key);
+      if (neighbor_voxel == nullptr || !neighbor_voxel->observed) {
+        continue;
+      }
+      // Voxels without a parent are fixed or already raised.
+      if (!neighbor_voxel->parent.isZero() &&
+          getValidSite(neighbor_key, *neighbor_voxel, &site_neighborhood) ==
+              nullptr) {
+        neighbor_voxel->distance = (neighbor_voxel->distance >= 0.0 ? 1 : -1) *
+                                   config_.default_distance_m;
+        neighbor_voxel->parent.setZero();
+        raise_.push(neighbor_key);
+      } else if (!neighbor_voxel->in_queue) {
+        open_.push(neighbor_key, neighbor_voxel->distance);
+        neighbor_voxel->in_queue = true;
+      }
+    }
+    num_updates++;
+  }
+  VLOG(3) << "[ESDF update]: [Euclidean] raised " << num_updates
+          << " voxels.";
 }
 
 void EsdfIntegrator::processOpenSetFullEuclidean() {
   size_t num_updates = 0u;
+  BlockNeighborhood<EsdfVoxel> neighborhood(esdf_layer_);
+  BlockNeighborhood<EsdfVoxel> site_neighborhood(esdf_layer_);
+  VoxelKey neighbor_key;
   while (!open_.empty()) {
     VoxelKey kv = open_.front();
     open_.pop();
 
-    Block<EsdfVoxel>::Ptr esdf_block =
-        esdf_layer_->getBlockPtrByIndex(kv.first);
-    EsdfVoxel& esdf_voxel = esdf_block->getVoxelByVoxelIndex(kv.second);
+    neighborhood.setBlock(kv.first);
+    EsdfVoxel& esdf_voxel = neighborhood.setVoxel(kv.second);
+    esdf_voxel.in_queue = false;
 
     // Again, no point updating unobserved voxels.
     if (!esdf_voxel.observed) {
-      esdf_voxel.in_queue = false;
       continue;
     }
 
     // Don't bother propagating this -- can't make any active difference.
-    if (esdf_voxel.distance >= config_.max_distance_m) {
-      esdf_voxel.in_queue = false;
+    if (esdf_voxel.distance >= config_.max_distance_m ||
+        esdf_voxel.distance <= -config_.max_distance_m) {
       continue;
     }
 
-    // Figure out what the parent distance would have been.
-    FloatingPoint parent_distance =
-        esdf_voxel.distance - esdf_voxel.parent.norm() * esdf_voxel_size_;
-
-    // See if you can update the neighbors.
-    std::vector<VoxelKey> neighbors;
-    std::vector<float> distances;
-    std::vector<Eigen::Vector3i> directions;
-    getNeighborsAndDistances(kv.first, kv.second, &neighbors, &distances,
-                             &directions);
-
-    // Do NOT update unobserved distances.
-    CHECK_EQ(neighbors.size(), distances.size());
-
-    for (size_t i = 0; i < neighbors.size(); ++i) {
-      BlockIndex neighbor_block_index = neighbors[i].first;
-      VoxelIndex neighbor_voxel_index = neighbors[i].second;
-
-      // Get the block for this voxel.
-      Block<EsdfVoxel>::Ptr neighbor_block;
-      if (neighbor_block_index == kv.first) {
-        neighbor_block = esdf_block;
-      } else {
-        neighbor_block = esdf_layer_->getBlockPtrByIndex(neighbor_block_index);
+    // Every voxel passes its site on, so the neighbors get the distance to
+    // the site itself instead of the sum of the steps to it.
+    const EsdfVoxel* site_voxel = &esdf_voxel;
+    if (!esdf_voxel.fixed) {
+      if (esdf_voxel.parent.isZero()) {
+        // Raised or new, waits for its neighbors to lower it.
+        continue;
       }
-      if (!neighbor_block) {
+      site_voxel = getValidSite(kv, esdf_voxel, &site_neighborhood);
+      if (site_voxel == nullptr) {
+        // The site changed after this voxel was last lowered, but it was not
+        // reached by the raise set. Its neighbors lower it again.
+        esdf_voxel.distance = (esdf_voxel.distance >= 0.0 ? 1 : -1) *
+                              config_.default_distance_m;
+        esdf_voxel.parent.setZero();
+        pushNeighborsToOpen(kv.second, &neighborhood, &open_);
         continue;
       }
-      CHECK(neighbor_block->isValidVoxelIndex(neighbor_voxel_index))
-          << "Neigbor voxel index: " << neighbor_voxel_index.transpose();
+    }
+    const Eigen::Vector3i parent = esdf_voxel.parent.cast<int>();
 
-      EsdfVoxel& neighbor_voxel =
-          neighbor_block->getVoxelByVoxelIndex(neighbor_voxel_index);
+    // See if you can update the neighbors.
+    for (size_t i = 0u; i < NeighborStencil::kNumNeighbors; ++i) {
+      EsdfVoxel* neighbor_voxel_ptr =
+          neighborhood.getNeighbor(i, &neighbor_key);
+      // Do NOT update unobserved distances.
+      if (neighbor_voxel_ptr == nullptr) {
+        continue;
+      }
+      EsdfVoxel& neighbor_voxel = *neighbor_voxel_ptr;
 
       if (!neighbor_voxel.observed || neighbor_voxel.fixed) {
         continue;
       }
 
-      // + or - direction?? Maybe minus...
-      const FloatingPoint neighbor_distance =
-          parent_distance +
-          (-esdf_voxel.parent.cast<FloatingPoint>() +
-           directions[i].cast<FloatingPoint>())
-                  .norm() *
-              esdf_voxel_size_;
-
-      if (neighbor_distance >= 0.0 &&
-          neighbor_distance < neighbor_voxel.distance) {
-        neighbor_voxel.distance = neighbor_distance;
-        // Also update parent.
-        neighbor_voxel.parent = esdf_voxel.parent - directions[i];
-        // ONLY propagate this if we're below the max distance!
-        if (neighbor_voxel.distance < config_.max_distance_m) {
-          if (!neighbor_voxel.in_queue) {
-            open_.push(neighbors[i], neighbor_voxel.distance);
-            neighbor_voxel.in_queue = true;
-          }
-        }
+      const Eigen::Vector3i offset = parent - NeighborStencil::direction(i);
+      if (offset.cwiseAbs().maxCoeff() > kMaxParentOffset) {
+        continue;
       }
-
-      if (neighbor_distance < 0.0 &&
-          neighbor_distance > neighbor_voxel.distance) {
-        neighbor_voxel.distance = neighbor_distance;
-        // Also update parent.
-        neighbor_voxel.parent = esdf_voxel.parent - directions[i];
-        if (!neighbor_voxel.in_queue) {
-          open_.push(neighbors[i], neighbor_voxel.distance);
-          neighbor_voxel.in_queue = true;
+      // The neighbor keeps its side of the surface, the site may be on
+      // either side.
+      FloatingPoint neighbor_distance;
+      if (neighbor_voxel.distance >= 0.0) {
+        neighbor_distance = computeFullEuclideanDistance(
+            site_voxel->distance, offset, true);
+        if (neighbor_distance < 0.0 ||
+            neighbor_distance + 1e-4 >= neighbor_voxel.distance) {
+          continue;
+        }
+      } else {
+        neighbor_distance = computeFullEuclideanDistance(
+            site_voxel->distance, offset, false);
+        if (neighbor_distance >= 0.0 ||
+            neighbor_distance - 1e-4 <= neighbor_voxel.distance) {
+          continue;
         }
       }
+      neighbor_voxel.distance = neighbor_distance;
+      neighbor_voxel.parent = offset.cast<int8_t>();
+      // ONLY propagate this if we're below the max distance!
+      if (std::abs(neighbor_distance) < config_.max_distance_m &&
+          !neighbor_voxel.in_queue) {
+        open_.push(neighbor_key, neighbor_voxel.distance);
+        neighbor_voxel.in_queue = true;
+      }
     }
 
     num_updates++;
-    esdf_voxel.in_queue = false;
   }
 
   VLOG(3) << "[ESDF update]: [Euclidean] made " << num_updates
           << " voxel updates.";
 }
 
+const EsdfVoxel* EsdfIntegrator::getValidSite(
+    const VoxelKey& key, const EsdfVoxel& voxel,
+    BlockNeighborhood<EsdfVoxel>* neighborhood) const {
+  DCHECK_NOTNULL(neighborhood);
+  neighborhood->setBlock(key.first);
+  neighborhood->setVoxel(key.second);
+  const Eigen::Vector3i offset = voxel.parent.cast<int>();
+  VoxelKey site_key;
+  const EsdfVoxel* site_voxel =
+      neighborhood->getVoxelAtOffset(offset, &site_key);
+  if (site_voxel == nullptr || !site_voxel->observed || !site_voxel->fixed) {
+    return nullptr;
+  }
+  // Also catches sites whose distance changed.
+  const FloatingPoint distance = computeFullEuclideanDistance(
+      site_voxel->distance, offset, voxel.distance >= 0.0);
+  if (std::abs(distance - voxel.distance) > 1e-4) {
+    return nullptr;
+  }
+  return site_voxel;
+}
+
 // Uses 26-connectivity and quasi-Euclidean distances.
 // Directions is the direction that the neighbor voxel lives in. If you
 // need the direction FROM the neighbor voxel TO the current voxel, take
@@ -785,65 +1340,19 @@ void EsdfIntegrator::getNeighborsAndDistances(
   CHECK_NOTNULL(distances);
   CHECK_NOTNULL(directions);
 
-  static const double kSqrt2 = std::sqrt(2);
-  static const double kSqrt3 = std::sqrt(3);
-  static const size_t kNumNeighbors = 26;
-
-  neighbors->reserve(kNumNeighbors);
-  distances->reserve(kNumNeighbors);
-  directions->reserve(kNumNeighbors);
+  neighbors->reserve(NeighborStencil::kNumNeighbors);
+  distances->reserve(NeighborStencil::kNumNeighbors);
+  directions->reserve(NeighborStencil::kNumNeighbors);
 
   VoxelKey neighbor;
-  Eigen::Vector3i direction;
-  direction.setZero();
-  // Distance 1 set.
-  for (unsigned int i = 0; i < 3; ++i) {
-    for (int j = -1; j <= 1; j += 2) {
-      direction(i) = j;
-      getNeighbor(block_index, voxel_index, direction, &neighbor.first,
-                  &neighbor.second);
-      neighbors->emplace_back(neighbor);
-      distances->emplace_back(1.0);
-      directions->emplace_back(direction);
-    }
-    direction(i) = 0;
-  }
-
-  // Distance sqrt(2) set.
-  for (unsigned int i = 0; i < 3; ++i) {
-    unsigned int next_i = (i + 1) % 3;
-    for (int j = -1; j <= 1; j += 2) {
-      direction(i) = j;
-      for (int k = -1; k <= 1; k += 2) {
-        direction(next_i) = k;
-        getNeighbor(block_index, voxel_index, direction, &neighbor.first,
-                    &neighbor.second);
-        neighbors->emplace_back(neighbor);
-        distances->emplace_back(kSqrt2);
-        directions->emplace_back(direction);
-      }
-      direction(i) = 0;
-      direction(next_i) = 0;
-    }
+  for (size_t i = 0u; i < NeighborStencil::kNumNeighbors; ++i) {
+    const Eigen::Vector3i& direction = NeighborStencil::direction(i);
+    getNeighbor(block_index, voxel_index, direction, &neighbor.first,
+                &neighbor.second);
+    neighbors->emplace_back(neighbor);
+    distances->emplace_back(NeighborStencil::distance(i));
+    directions->emplace_back(direction);
   }
-
-  // Distance sqrt(3) set.
-  for (int i = -1; i <= 1; i += 2) {
-    direction(0) = i;
-    for (int j = -1; j <= 1; j += 2) {
-      direction(1) = j;
-      for (int k = -1; k <= 1; k += 2) {
-        direction(2) = k;
-        getNeighbor(block_index, voxel_index, direction, &neighbor.first,
-                    &neighbor.second);
-        neighbors->emplace_back(neighbor);
-        distances->emplace_back(kSqrt3);
-        directions->emplace_back(direction);
-      }
-    }
-  }
-
-  CHECK_EQ(neighbors->size(), kNumNeighbors);
 }
 
 void EsdfIntegrator::getNeighbor(const BlockIndex& block_index,
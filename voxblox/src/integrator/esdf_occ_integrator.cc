@@ -12,6 +12,11 @@ EsdfOccIntegrator::EsdfOccIntegrator(const Config& config,
   esdf_voxels_per_side_ = esdf_layer_->voxels_per_side();
   esdf_voxel_size_ = esdf_layer_->voxel_size();
 
+  if (config_.integrator_threads == 0) {
+    LOG(WARNING) << "Automatic core count failed, defaulting to 1 threads";
+    config_.integrator_threads = 1;
+  }
+
   open_.setNumBuckets(config_.num_buckets, config_.max_distance_m);
 }
 
@@ -65,7 +70,7 @@ void EsdfOccIntegrator::updateFromOccBlocks(const BlockIndexList& occ_blocks,
       // Check for frontier voxels.
       // This is the check for the lower frontier.
       // If the occupancy voxel is occupied... Count unknown as free.
-      if (occ_voxel.probability_log > 0.0) {
+      if (isOccupied(occ_voxel)) {
         // Assume batch for now.
         esdf_voxel.distance = 0.0;
         esdf_voxel.observed = true;
@@ -105,13 +110,14 @@ void EsdfOccIntegrator::updateFromOccBlocks(const BlockIndexList& occ_blocks,
 
 void EsdfOccIntegrator::processOpenSet() {
   size_t num_updates = 0u;
+  BlockNeighborhood<EsdfVoxel> neighborhood(esdf_layer_);
+  VoxelKey neighbor_key;
   while (!open_.empty()) {
     VoxelKey kv = open_.front();
     open_.pop();
 
-    Block<EsdfVoxel>::Ptr esdf_block =
-        esdf_layer_->getBlockPtrByIndex(kv.first);
-    EsdfVoxel& esdf_voxel = esdf_block->getVoxelByVoxelIndex(kv.second);
+    neighborhood.setBlock(kv.first);
+    EsdfVoxel& esdf_voxel = neighborhood.setVoxel(kv.second);
 
     // Again, no point updating unobserved voxels.
     if (!esdf_voxel.observed) {
@@ -125,51 +131,28 @@ void EsdfOccIntegrator::processOpenSet() {
       continue;
     }
     // See if you can update the neighbors.
-    std::vector<VoxelKey> neighbors;
-    std::vector<float> distances;
-    std::vector<Eigen::Vector3i> directions;
-    getNeighborsAndDistances(kv.first, kv.second, &neighbors, &distances,
-                             &directions);
-
-    // Do NOT update unobserved distances.
-    CHECK_EQ(neighbors.size(), distances.size());
-    for (size_t i = 0; i < neighbors.size(); ++i) {
-      BlockIndex neighbor_block_index = neighbors[i].first;
-      VoxelIndex neighbor_voxel_index = neighbors[i].second;
-
-      // Get the block for this voxel.
-      Block<EsdfVoxel>::Ptr neighbor_block;
-      if (neighbor_block_index == kv.first) {
-        neighbor_block = esdf_block;
-      } else {
-        neighbor_block = esdf_layer_->getBlockPtrByIndex(neighbor_block_index);
-      }
-      if (!neighbor_block) {
-        continue;
-      }
-      CHECK(neighbor_block->isValidVoxelIndex(neighbor_voxel_index))
-          << "Neigbor voxel index: " << neighbor_voxel_index.transpose();
-
-      EsdfVoxel& neighbor_voxel =
-          neighbor_block->getVoxelByVoxelIndex(neighbor_voxel_index);
-
-      if (!neighbor_voxel.observed) {
+    for (size_t i = 0u; i < NeighborStencil::kNumNeighbors; ++i) {
+      EsdfVoxel* neighbor_voxel_ptr =
+          neighborhood.getNeighbor(i, &neighbor_key);
+      // Do NOT update unobserved distances.
+      if (neighbor_voxel_ptr == nullptr || !neighbor_voxel_ptr->observed) {
         continue;
       }
+      EsdfVoxel& neighbor_voxel = *neighbor_voxel_ptr;
 
       const FloatingPoint distance_to_neighbor =
-          distances[i] * esdf_voxel_size_;
+          NeighborStencil::distance(i) * esdf_voxel_size_;
 
       if (!neighbor_voxel.fixed &&
           esdf_voxel.distance + distance_to_neighbor <
               neighbor_voxel.distance) {
         neighbor_voxel.distance = esdf_voxel.distance + distance_to_neighbor;
         // Also update parent.
-        neighbor_voxel.parent = -directions[i];
+        neighbor_voxel.parent = NeighborStencil::parentOffset(i);
         // ONLY propagate this if we're below the max distance!
         if (neighbor_voxel.distance < config_.max_distance_m) {
           if (!neighbor_voxel.in_queue) {
-            open_.push(neighbors[i], neighbor_voxel.distance);
+            open_.push(neighbor_key, neighbor_voxel.distance);
             neighbor_voxel.in_queue = true;
           }
         }
@@ -180,9 +163,9 @@ void EsdfOccIntegrator::processOpenSet() {
               neighbor_voxel.distance) {
         neighbor_voxel.distance = esdf_voxel.distance - distance_to_neighbor;
         // Also update parent.
-        neighbor_voxel.parent = -directions[i];
+        neighbor_voxel.parent = NeighborStencil::parentOffset(i);
         if (!neighbor_voxel.in_queue) {
-          open_.push(neighbors[i], neighbor_voxel.distance);
+          open_.push(neighbor_key, neighbor_voxel.distance);
           neighbor_voxel.in_queue = true;
         }
       }
@@ -195,6 +178,386 @@ void EsdfOccIntegrator::processOpenSet() {
   VLOG(3) << "[ESDF update]: made " << num_updates << " voxel updates.";
 }
 
+void EsdfOccIntegrator::updateFromOccLayerBatchExact() {
+  DCHECK_EQ(occ_layer_->voxels_per_side(), esdf_layer_->voxels_per_side());
+  timing::Timer esdf_timer("esdf_occ");
+  esdf_layer_->removeAllBlocks();
+
+  BlockIndexList occ_blocks;
+  occ_layer_->getAllAllocatedBlocks(&occ_blocks);
+  if (occ_blocks.empty()) {
+    return;
+  }
+
+  // The blocks are allocated up front, so the threads only write voxels of
+  // their own blocks.
+  for (const BlockIndex& block_index : occ_blocks) {
+    esdf_layer_->allocateBlockPtrByIndex(block_index);
+  }
+
+  // Occupied voxels further away than the maximum distance only produce
+  // distances that are cut off anyway, so the grid of a tile only needs the
+  // occupied voxels within that halo around it.
+  const int vps = static_cast<int>(esdf_voxels_per_side_);
+  const int halo_blocks = static_cast<int>(
+      std::ceil(config_.max_distance_m / (esdf_voxel_size_ * vps)));
+  std::vector<DistanceGridTile> tiles;
+  splitIntoDistanceGridTiles(occ_blocks, config_.exact_tile_size_blocks,
+                             halo_blocks, &tiles);
+
+  DenseDistanceGrid grid;
+  for (const DistanceGridTile& tile : tiles) {
+    // Dense grid over the tile and its halo, with a squared distance of 0 at
+    // the occupied voxels and infinity everywhere else.
+    timing::Timer init_timer("esdf_occ/exact_init");
+    grid.reset(tile, vps);
+    BlockIndex block_index;
+    for (block_index.z() = tile.min_block_index.z();
+         block_index.z() <= tile.max_block_index.z(); ++block_index.z()) {
+      for (block_index.y() = tile.min_block_index.y();
+           block_index.y() <= tile.max_block_index.y(); ++block_index.y()) {
+        for (block_index.x() = tile.min_block_index.x();
+             block_index.x() <= tile.max_block_index.x(); ++block_index.x()) {
+          Block<OccupancyVoxel>::ConstPtr occ_block =
+              occ_layer_->getBlockPtrByIndex(block_index);
+          if (!occ_block) {
+            continue;
+          }
+          const Eigen::Vector3i block_origin =
+              (block_index - grid.min_block_index) * vps;
+          for (size_t lin_index = 0u; lin_index < occ_block->num_voxels();
+               ++lin_index) {
+            const OccupancyVoxel& occ_voxel =
+                occ_block->getVoxelByLinearIndex(lin_index);
+            if (!occ_voxel.observed || !isOccupied(occ_voxel)) {
+              continue;
+            }
+            const Eigen::Vector3i grid_index =
+                block_origin +
+                occ_block->computeVoxelIndexFromLinearIndex(lin_index);
+            grid.squared_distances[grid.getLinearIndex(
+                grid_index.x(), grid_index.y(), grid_index.z())] = 0.0f;
+          }
+        }
+      }
+    }
+    init_timer.Stop();
+
+    timing::Timer transform_timer("esdf_occ/exact_transform");
+    grid.transform(config_.integrator_threads);
+    transform_timer.Stop();
+
+    timing::Timer write_timer("esdf_occ/exact_write");
+    const BlockIndexList& tile_blocks = tile.block_indices;
+    const size_t num_threads =
+        std::min(config_.integrator_threads, tile_blocks.size());
+    if (num_threads <= 1u) {
+      writeExactDistances(tile_blocks, 0u, tile_blocks.size(), grid);
+    } else {
+      std::vector<std::thread> integration_threads;
+      for (size_t i = 0; i < num_threads; ++i) {
+        integration_threads.emplace_back(
+            &EsdfOccIntegrator::writeExactDistances, this,
+            std::cref(tile_blocks), i * tile_blocks.size() / num_threads,
+            (i + 1) * tile_blocks.size() / num_threads, std::cref(grid));
+      }
+      for (std::thread& thread : integration_threads) {
+        thread.join();
+      }
+    }
+    write_timer.Stop();
+  }
+
+  esdf_timer.Stop();
+}
+
+void EsdfOccIntegrator::writeExactDistances(
+    const BlockIndexList& block_indices, size_t begin, size_t end,
+    const DenseDistanceGrid& grid) {
+  const int vps = static_cast<int>(esdf_voxels_per_side_);
+  for (size_t i = begin; i < end; ++i) {
+    const BlockIndex& block_index = block_indices[i];
+    const Block<OccupancyVoxel>& occ_block =
+        occ_layer_->getBlockByIndex(block_index);
+    Block<EsdfVoxel>& esdf_block = esdf_layer_->getBlockByIndex(block_index);
+    const Eigen::Vector3i block_origin =
+        (block_index - grid.min_block_index) * vps;
+
+    for (size_t lin_index = 0u; lin_index < occ_block.num_voxels();
+         ++lin_index) {
+      const OccupancyVoxel& occ_voxel =
+          occ_block.getVoxelByLinearIndex(lin_index);
+      if (!occ_voxel.observed) {
+        continue;
+      }
+      EsdfVoxel& esdf_voxel = esdf_block.getVoxelByLinearIndex(lin_index);
+      esdf_voxel.observed = true;
+      esdf_voxel.in_queue = false;
+      esdf_voxel.parent.setZero();
+      if (isOccupied(occ_voxel)) {
+        esdf_voxel.distance = 0.0;
+        esdf_voxel.fixed = true;
+        continue;
+      }
+      esdf_voxel.fixed = false;
+      esdf_voxel.distance = config_.default_distance_m;
+
+      const Eigen::Vector3i voxel =
+          block_origin + esdf_block.computeVoxelIndexFromLinearIndex(lin_index);
+      Eigen::Vector3i site;
+      if (!grid.getNearestSite(voxel, &site)) {
+        continue;
+      }
+      const FloatingPoint distance =
+          std::sqrt(grid.squared_distances[grid.getLinearIndex(
+              voxel.x(), voxel.y(), voxel.z())]) *
+          esdf_voxel_size_;
+      // Sites too far away for the parent offset are treated like the ones
+      // beyond the maximum distance, as in EsdfIntegrator.
+      if (distance >= config_.max_distance_m ||
+          !setParentOffset(site - voxel, &esdf_voxel)) {
+        continue;
+      }
+      esdf_voxel.distance = distance;
+    }
+  }
+}
+
+void EsdfOccIntegrator::updateFromOccLayer(bool clear_updated_flag) {
+  BlockIndexList occ_blocks;
+  occ_layer_->getAllUpdatedBlocks(&occ_blocks);
+  updateFromOccBlocksIncremental(occ_blocks);
+
+  if (clear_updated_flag) {
+    for (const BlockIndex& block_index : occ_blocks) {
+      occ_layer_->getBlockByIndex(block_index).updated() = false;
+    }
+  }
+}
+
+void EsdfOccIntegrator::updateFromOccBlocksIncremental(
+    const BlockIndexList& occ_blocks) {
+  DCHECK_EQ(occ_layer_->voxels_per_side(), esdf_layer_->voxels_per_side());
+  CHECK_LE(config_.max_distance_m, kMaxParentOffset * esdf_voxel_size_)
+      << "Incremental updates can only propagate up to " << kMaxParentOffset
+      << " voxels.";
+  timing::Timer esdf_timer("esdf_occ");
+
+  size_t num_lower = 0u;
+  size_t num_raise = 0u;
+  size_t num_new = 0u;
+  timing::Timer propagate_timer("esdf_occ/propagate_occ");
+  VLOG(3) << "[ESDF update]: Propagating " << occ_blocks.size()
+          << " updated blocks from the occupancy layer.";
+  for (const BlockIndex& block_index : occ_blocks) {
+    if (!occ_layer_->hasBlock(block_index)) {
+      continue;
+    }
+    const Block<OccupancyVoxel>& occ_block =
+        occ_layer_->getBlockByIndex(block_index);
+
+    // Block indices are the same across all layers.
+    Block<EsdfVoxel>::Ptr esdf_block =
+        esdf_layer_->allocateBlockPtrByIndex(block_index);
+    // No blocks are allocated while the voxels of this block are visited.
+    BlockNeighborhood<EsdfVoxel> neighborhood(esdf_layer_);
+    neighborhood.setBlock(block_index);
+
+    for (size_t lin_index = 0u; lin_index < occ_block.num_voxels();
+         ++lin_index) {
+      const OccupancyVoxel& occ_voxel =
+          occ_block.getVoxelByLinearIndex(lin_index);
+      if (!occ_voxel.observed) {
+        continue;
+      }
+
+      EsdfVoxel& esdf_voxel = esdf_block->getVoxelByLinearIndex(lin_index);
+      const VoxelIndex voxel_index =
+          esdf_block->computeVoxelIndexFromLinearIndex(lin_index);
+      if (isOccupied(occ_voxel)) {
+        // Newly occupied voxels are the lower frontier.
+        if (!esdf_voxel.observed || !esdf_voxel.fixed) {
+          esdf_voxel.distance = 0.0;
+          esdf_voxel.observed = true;
+          esdf_voxel.fixed = true;
+          esdf_voxel.parent.setZero();
+          if (!esdf_voxel.in_queue) {
+            open_.push(std::make_pair(block_index, voxel_index),
+                       esdf_voxel.distance);
+            esdf_voxel.in_queue = true;
+          }
+          num_lower++;
+        }
+      } else if (!esdf_voxel.observed) {
+        // New free voxels get their distances from their neighbors.
+        esdf_voxel.distance = config_.default_distance_m;
+        esdf_voxel.observed = true;
+        esdf_voxel.fixed = false;
+        esdf_voxel.parent.setZero();
+        pushNeighborsToOpen(voxel_index, &neighborhood);
+        num_new++;
+      } else if (esdf_voxel.fixed) {
+        // Voxels that turned free raise the voxels they were closest to.
+        esdf_voxel.distance = config_.default_distance_m;
+        esdf_voxel.fixed = false;
+        esdf_voxel.parent.setZero();
+        raise_.push(std::make_pair(block_index, voxel_index));
+        num_raise++;
+      }
+    }
+  }
+  propagate_timer.Stop();
+  VLOG(3) << "[ESDF update]: Lower: " << num_lower << " Raise: " << num_raise
+          << " New: " << num_new;
+
+  timing::Timer raise_timer("esdf_occ/raise_esdf");
+  processRaiseSetIncremental();
+  raise_timer.Stop();
+
+  timing::Timer update_timer("esdf_occ/update_esdf");
+  processOpenSetIncremental();
+  update_timer.Stop();
+
+  esdf_timer.Stop();
+}
+
+void EsdfOccIntegrator::pushNeighborsToOpen(
+    const VoxelIndex& voxel_index,
+    BlockNeighborhood<EsdfVoxel>* neighborhood) {
+  DCHECK_NOTNULL(neighborhood);
+  neighborhood->setVoxel(voxel_index);
+  VoxelKey neighbor_key;
+  for (size_t i = 0u; i < NeighborStencil::kNumNeighbors; ++i) {
+    EsdfVoxel* neighbor_voxel = neighborhood->getNeighbor(i, &neighbor_key);
+    if (neighbor_voxel == nullptr || !neighbor_voxel->observed) {
+      continue;
+    }
+
+    if (!neighbor_voxel->in_queue) {
+      open_.push(neighbor_key, neighbor_voxel->distance);
+      neighbor_voxel->in_queue = true;
+    }
+  }
+}
+
+bool EsdfOccIntegrator::hasValidSite(
+    const VoxelKey& key, const EsdfVoxel& voxel,
+    BlockNeighborhood<EsdfVoxel>* neighborhood) const {
+  DCHECK_NOTNULL(neighborhood);
+  if (voxel.parent.isZero()) {
+    return false;
+  }
+  neighborhood->setBlock(key.first);
+  neighborhood->setVoxel(key.second);
+  const Eigen::Vector3i offset = voxel.parent.cast<int>();
+  VoxelKey site_key;
+  const EsdfVoxel* site_voxel =
+      neighborhood->getVoxelAtOffset(offset, &site_key);
+  return site_voxel != nullptr && site_voxel->observed && site_voxel->fixed &&
+         std::abs(offset.cast<FloatingPoint>().norm() * esdf_voxel_size_ -
+                  voxel.distance) <= 1e-4;
+}
+
+void EsdfOccIntegrator::processRaiseSetIncremental() {
+  size_t num_updates = 0u;
+  BlockNeighborhood<EsdfVoxel> neighborhood(esdf_layer_);
+  BlockNeighborhood<EsdfVoxel> site_neighborhood(esdf_layer_);
+  VoxelKey neighbor_key;
+  while (!raise_.empty()) {
+    VoxelKey kv = raise_.front();
+    raise_.pop();
+
+    if (neighborhood.setBlock(kv.first) == nullptr) {
+      continue;
+    }
+    neighborhood.setVoxel(kv.second);
+
+    for (size_t i = 0u; i < NeighborStencil::kNumNeighbors; ++i) {
+      EsdfVoxel* neighbor_voxel = neighborhood.getNeighbor(i, &neighbor_key);
+      if (neighbor_voxel == nullptr || !neighbor_voxel->observed) {
+        continue;
+      }
+      // Voxels without a parent are already raised or too far from any
+      // occupied voxel. The occupied ones lower the raised voxels again.
+      if (!neighbor_voxel->fixed && !neighbor_voxel->parent.isZero() &&
+          !hasValidSite(neighbor_key, *neighbor_voxel, &site_neighborhood)) {
+        neighbor_voxel->distance = config_.default_distance_m;
+        neighbor_voxel->parent.setZero();
+        raise_.push(neighbor_key);
+      } else if (!neighbor_voxel->in_queue) {
+        open_.push(neighbor_key, neighbor_voxel->distance);
+        neighbor_voxel->in_queue = true;
+      }
+    }
+    num_updates++;
+  }
+  VLOG(3) << "[ESDF update]: raised " << num_updates << " voxels.";
+}
+
+void EsdfOccIntegrator::processOpenSetIncremental() {
+  size_t num_updates = 0u;
+  BlockNeighborhood<EsdfVoxel> neighborhood(esdf_layer_);
+  BlockNeighborhood<EsdfVoxel> site_neighborhood(esdf_layer_);
+  VoxelKey neighbor_key;
+  while (!open_.empty()) {
+    VoxelKey kv = open_.front();
+    open_.pop();
+
+    neighborhood.setBlock(kv.first);
+    EsdfVoxel& esdf_voxel = neighborhood.setVoxel(kv.second);
+    esdf_voxel.in_queue = false;
+
+    if (!esdf_voxel.observed ||
+        esdf_voxel.distance >= config_.max_distance_m) {
+      continue;
+    }
+    // Voxels without a parent have nothing to pass on.
+    if (!esdf_voxel.fixed && esdf_voxel.parent.isZero()) {
+      continue;
+    }
+    if (!esdf_voxel.fixed &&
+        !hasValidSite(kv, esdf_voxel, &site_neighborhood)) {
+      // Its nearest occupied voxel turned free after it was pushed. Its
+      // neighbors lower it again.
+      esdf_voxel.distance = config_.default_distance_m;
+      esdf_voxel.parent.setZero();
+      pushNeighborsToOpen(kv.second, &neighborhood);
+      continue;
+    }
+    const Eigen::Vector3i parent = esdf_voxel.parent.cast<int>();
+
+    // The neighbors get the distance to the nearest occupied voxel of this
+    // one, instead of the sum of the steps to it.
+    for (size_t i = 0u; i < NeighborStencil::kNumNeighbors; ++i) {
+      EsdfVoxel* neighbor_voxel = neighborhood.getNeighbor(i, &neighbor_key);
+      if (neighbor_voxel == nullptr || !neighbor_voxel->observed ||
+          neighbor_voxel->fixed) {
+        continue;
+      }
+      const Eigen::Vector3i offset = parent - NeighborStencil::direction(i);
+      if (offset.cwiseAbs().maxCoeff() > kMaxParentOffset) {
+        continue;
+      }
+      const FloatingPoint distance =
+          offset.cast<FloatingPoint>().norm() * esdf_voxel_size_;
+      if (distance + 1e-4 >= neighbor_voxel->distance) {
+        continue;
+      }
+      neighbor_voxel->distance = distance;
+      setParentOffset(offset, neighbor_voxel);
+      // ONLY propagate this if we're below the max distance!
+      if (distance < config_.max_distance_m && !neighbor_voxel->in_queue) {
+        open_.push(neighbor_key, neighbor_voxel->distance);
+        neighbor_voxel->in_queue = true;
+      }
+    }
+
+    num_updates++;
+  }
+
+  VLOG(3) << "[ESDF update]: made " << num_updates << " voxel updates.";
+}
+
 // Uses 26-connectivity and quasi-Euclidean distances.
 // Directions is the direction that the neighbor voxel lives in. If you
 // need the direction FROM the neighbor voxel TO the current voxel, take
@@ -207,65 +570,19 @@ void EsdfOccIntegrator::getNeighborsAndDistances(
   CHECK_NOTNULL(distances);
   CHECK_NOTNULL(directions);
 
-  static const double kSqrt2 = std::sqrt(2);
-  static const double kSqrt3 = std::sqrt(3);
-  static const size_t kNumNeighbors = 26;
-
-  neighbors->reserve(kNumNeighbors);
-  distances->reserve(kNumNeighbors);
-  directions->reserve(kNumNeighbors);
+  neighbors->reserve(NeighborStencil::kNumNeighbors);
+  distances->reserve(NeighborStencil::kNumNeighbors);
+  directions->reserve(NeighborStencil::kNumNeighbors);
 
   VoxelKey neighbor;
-  Eigen::Vector3i direction;
-  direction.setZero();
-  // Distance 1 set.
-  for (unsigned int i = 0; i < 3; ++i) {
-    for (int j = -1; j <= 1; j += 2) {
-      direction(i) = j;
-      getNeighbor(block_index, voxel_index, direction, &neighbor.first,
-                  &neighbor.second);
-      neighbors->emplace_back(neighbor);
-      distances->emplace_back(1.0);
-      directions->emplace_back(direction);
-    }
-    direction(i) = 0;
+  for (size_t i = 0u; i < NeighborStencil::kNumNeighbors; ++i) {
+    const Eigen::Vector3i& direction = NeighborStencil::direction(i);
+    getNeighbor(block_index, voxel_index, direction, &neighbor.first,
+                &neighbor.second);
+    neighbors->emplace_back(neighbor);
+    distances->emplace_back(NeighborStencil::distance(i));
+    directions->emplace_back(direction);
   }
-
-  // Distance sqrt(2) set.
-  for (unsigned int i = 0; i < 3; ++i) {
-    unsigned int next_i = (i + 1) % 3;
-    for (int j = -1; j <= 1; j += 2) {
-      direction(i) = j;
-      for (int k = -1; k <= 1; k += 2) {
-        direction(next_i) = k;
-        getNeighbor(block_index, voxel_index, direction, &neighbor.first,
-                    &neighbor.second);
-        neighbors->emplace_back(neighbor);
-        distances->emplace_back(kSqrt2);
-        directions->emplace_back(direction);
-      }
-      direction(i) = 0;
-      direction(next_i) = 0;
-    }
-  }
-
-  // Distance sqrt(3) set.
-  for (int i = -1; i <= 1; i += 2) {
-    direction(0) = i;
-    for (int j = -1; j <= 1; j += 2) {
-      direction(1) = j;
-      for (int k = -1; k <= 1; k += 2) {
-        direction(2) = k;
-        getNeighbor(block_index, voxel_index, direction, &neighbor.first,
-                    &neighbor.second);
-        neighbors->emplace_back(neighbor);
-        distances->emplace_back(kSqrt3);
-        directions->emplace_back(direction);
-      }
-    }
-  }
-
-  CHECK_EQ(neighbors->size(), kNumNeighbors);
 }
 
 void EsdfOccIntegrator::getNeighbor(const BlockIndex& block_index,
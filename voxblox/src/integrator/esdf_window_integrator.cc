@@ -0,0 +1,258 @@
+#include "voxblox/integrator/esdf_window_integrator.h"
+
+namespace voxblox {
+
+EsdfWindowIntegrator::EsdfWindowIntegrator(const Config& config,
+                                           Layer<TsdfVoxel>* tsdf_layer)
+    : config_(config),
+      tsdf_layer_(CHECK_NOTNULL(tsdf_layer)),
+      voxel_size_(tsdf_layer->voxel_size()),
+      voxel_size_inv_(1.0 / tsdf_layer->voxel_size()),
+      voxels_per_block_(tsdf_layer->voxels_per_side()),
+      radius_voxels_(std::max(
+          static_cast<int>(std::ceil(config.radius_m * voxel_size_inv_)), 1)),
+      window_(2 * radius_voxels_ + 1),
+      window_initialized_(false),
+      distances_outdated_(false) {
+  squared_distances_.resize(window_.num_voxels());
+  for (int axis = 0; axis < 3; ++axis) {
+    nearest_[axis].resize(window_.num_voxels());
+  }
+}
+
+void EsdfWindowIntegrator::updateFromTsdfLayer(const Point& position) {
+  BlockIndexList tsdf_blocks;
+  tsdf_layer_->getAllUpdatedBlocks(&tsdf_blocks);
+  updateFromTsdfBlocks(position, tsdf_blocks);
+}
+
+void EsdfWindowIntegrator::updateFromTsdfBlocks(
+    const Point& position, const BlockIndexList& tsdf_blocks) {
+  timing::Timer window_timer("esdf_window");
+
+  timing::Timer copy_timer("esdf_window/copy_tsdf");
+  const AnyIndex origin = getGridIndexFromPoint(position, voxel_size_inv_) -
+                          AnyIndex::Constant(radius_voxels_);
+  WindowGrid::IndexBoxList boxes;
+  if (window_initialized_) {
+    window_.moveOrigin(origin, &boxes);
+  } else {
+    window_.moveOrigin(origin, nullptr);
+    boxes.emplace_back(origin, origin + AnyIndex::Constant(
+                                            window_.voxels_per_side()));
+    window_initialized_ = true;
+  }
+
+  const AnyIndex window_end =
+      origin + AnyIndex::Constant(window_.voxels_per_side());
+  for (const BlockIndex& block_index : tsdf_blocks) {
+    const AnyIndex block_begin = block_index * voxels_per_block_;
+    WindowGrid::IndexBox box(
+        block_begin.cwiseMax(origin),
+        (block_begin + AnyIndex::Constant(voxels_per_block_))
+            .cwiseMin(window_end));
+    if ((box.first.array() < box.second.array()).all()) {
+      boxes.push_back(box);
+    }
+  }
+  for (const WindowGrid::IndexBox& box : boxes) {
+    copyTsdfBox(box);
+  }
+  copy_timer.Stop();
+
+  if (distances_outdated_) {
+    updateDistances();
+  }
+  window_timer.Stop();
+}
+
+void EsdfWindowIntegrator::copyTsdfBox(const WindowGrid::IndexBox& box) {
+  if (!(box.first.array() < box.second.array()).all()) {
+    return;
+  }
+  distances_outdated_ = true;
+
+  const BlockIndex min_block_index = getBlockIndexFromGlobalVoxelIndex(
+      box.first, 1.0 / voxels_per_block_);
+  const BlockIndex max_block_index = getBlockIndexFromGlobalVoxelIndex(
+      box.second - AnyIndex::Ones(), 1.0 / voxels_per_block_);
+  BlockIndex block_index;
+  for (block_index.z() = min_block_index.z();
+       block_index.z() <= max_block_index.z(); ++block_index.z()) {
+    for (block_index.y() = min_block_index.y();
+         block_index.y() <= max_block_index.y(); ++block_index.y()) {
+      for (block_index.x() = min_block_index.x();
+           block_index.x() <= max_block_index.x(); ++block_index.x()) {
+        Block<TsdfVoxel>::ConstPtr tsdf_block =
+            tsdf_layer_->getBlockPtrByIndex(block_index);
+        const AnyIndex block_begin = block_index * voxels_per_block_;
+        const AnyIndex begin = block_begin.cwiseMax(box.first);
+        const AnyIndex end =
+            (block_begin + AnyIndex::Constant(voxels_per_block_))
+                .cwiseMin(box.second);
+
+        AnyIndex global_voxel_index;
+        for (global_voxel_index.z() = begin.z();
+             global_voxel_index.z() < end.z(); ++global_voxel_index.z()) {
+          for (global_voxel_index.y() = begin.y();
+               global_voxel_index.y() < end.y(); ++global_voxel_index.y()) {
+            for (global_voxel_index.x() = begin.x();
+                 global_voxel_index.x() < end.x(); ++global_voxel_index.x()) {
+              WindowVoxel& voxel =
+                  window_.getVoxelByGlobalIndex(global_voxel_index);
+              voxel = WindowVoxel();
+              if (!tsdf_block) {
+                continue;
+              }
+              const TsdfVoxel& tsdf_voxel = tsdf_block->getVoxelByVoxelIndex(
+                  global_voxel_index - block_begin);
+              if (tsdf_voxel.weight < config_.min_weight) {
+                continue;
+              }
+              voxel.tsdf_distance = tsdf_voxel.distance;
+              voxel.esdf.observed = true;
+              voxel.esdf.fixed = isFixed(tsdf_voxel.distance);
+              voxel.esdf.distance = tsdf_voxel.distance;
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+void EsdfWindowIntegrator::updateDistances() {
+  timing::Timer transform_timer("esdf_window/transform");
+  const int n = window_.voxels_per_side();
+  const AnyIndex& origin = window_.origin();
+  const Eigen::Vector3i size = Eigen::Vector3i::Constant(n);
+
+  // The grid runs over the window from its origin, the fixed voxels are the
+  // sites.
+  size_t grid_lin_index = 0u;
+  AnyIndex voxel_index;
+  for (voxel_index.z() = 0; voxel_index.z() < n; ++voxel_index.z()) {
+    for (voxel_index.y() = 0; voxel_index.y() < n; ++voxel_index.y()) {
+      for (voxel_index.x() = 0; voxel_index.x() < n; ++voxel_index.x()) {
+        const EsdfVoxel& voxel =
+            window_.getVoxelByGlobalIndex(origin + voxel_index).esdf;
+        squared_distances_[grid_lin_index++] =
+            (voxel.observed && voxel.fixed) ? 0.0f
+                                            : DistanceTransform1D::kInfinity;
+      }
+    }
+  }
+  const size_t num_rows = window_.num_voxels() / n;
+  for (int axis = 0; axis < 3; ++axis) {
+    transformGridRows(size, axis, 0u, num_rows, squared_distances_.data(),
+                      nearest_[axis].data());
+  }
+
+  // Follows the minimizers of the z, y and x passes back to the site, as in
+  // EsdfIntegrator::writeExactDistances().
+  grid_lin_index = 0u;
+  for (voxel_index.z() = 0; voxel_index.z() < n; ++voxel_index.z()) {
+    for (voxel_index.y() = 0; voxel_index.y() < n; ++voxel_index.y()) {
+      for (voxel_index.x() = 0; voxel_index.x() < n;
+           ++voxel_index.x(), ++grid_lin_index) {
+        WindowVoxel& voxel =
+            window_.getVoxelByGlobalIndex(origin + voxel_index);
+        EsdfVoxel& esdf_voxel = voxel.esdf;
+        if (!esdf_voxel.observed) {
+          continue;
+        }
+        esdf_voxel.parent.setZero();
+        if (esdf_voxel.fixed) {
+          esdf_voxel.distance = voxel.tsdf_distance;
+          continue;
+        }
+
+        const int site_z = nearest_[2][grid_lin_index];
+        if (site_z < 0) {
+          esdf_voxel.distance =
+              signum(voxel.tsdf_distance) * config_.default_distance_m;
+          continue;
+        }
+        const int site_y =
+            nearest_[1][voxel_index.x() + n * (voxel_index.y() + n * site_z)];
+        const int site_x =
+            nearest_[0][voxel_index.x() + n * (site_y + n * site_z)];
+        const AnyIndex site(site_x, site_y, site_z);
+
+        const FloatingPoint site_distance =
+            window_.getVoxelByGlobalIndex(origin + site).tsdf_distance;
+        const FloatingPoint distance =
+            std::sqrt(squared_distances_[grid_lin_index]) * voxel_size_;
+        if (voxel.tsdf_distance >= 0.0) {
+          esdf_voxel.distance =
+              std::max<FloatingPoint>(site_distance + distance, 0.0);
+        } else {
+          esdf_voxel.distance =
+              std::min<FloatingPoint>(site_distance - distance, 0.0);
+        }
+        if (std::abs(esdf_voxel.distance) >= config_.max_distance_m) {
+          esdf_voxel.distance =
+              signum(voxel.tsdf_distance) * config_.default_distance_m;
+          continue;
+        }
+        if (!setParentOffset(site - voxel_index, &esdf_voxel)) {
+          esdf_voxel.distance =
+              signum(voxel.tsdf_distance) * config_.default_distance_m;
+        }
+      }
+    }
+  }
+  distances_outdated_ = false;
+  transform_timer.Stop();
+}
+
+bool EsdfWindowIntegrator::getDistanceAtPosition(
+    const Point& position, FloatingPoint* distance) const {
+  DCHECK_NOTNULL(distance);
+  const EsdfVoxel* voxel = getVoxelPtrByGlobalIndex(
+      getGridIndexFromPoint(position, voxel_size_inv_));
+  if (voxel == nullptr || !voxel->observed) {
+    return false;
+  }
+  *distance = voxel->distance;
+  return true;
+}
+
+bool EsdfWindowIntegrator::getDistanceAndGradientAtPosition(
+    const Point& position, FloatingPoint* distance, Point* gradient) const {
+  DCHECK_NOTNULL(distance);
+  DCHECK_NOTNULL(gradient);
+  const AnyIndex global_voxel_index =
+      getGridIndexFromPoint(position, voxel_size_inv_);
+  const EsdfVoxel* voxel = getVoxelPtrByGlobalIndex(global_voxel_index);
+  if (voxel == nullptr || !voxel->observed) {
+    return false;
+  }
+  *distance = voxel->distance;
+
+  for (int axis = 0; axis < 3; ++axis) {
+    AnyIndex neighbor_index = global_voxel_index;
+    neighbor_index(axis) += 1;
+    const EsdfVoxel* next_voxel = getVoxelPtrByGlobalIndex(neighbor_index);
+    neighbor_index(axis) -= 2;
+    const EsdfVoxel* previous_voxel = getVoxelPtrByGlobalIndex(neighbor_index);
+    const bool has_next = next_voxel != nullptr && next_voxel->observed;
+    const bool has_previous =
+        previous_voxel != nullptr && previous_voxel->observed;
+    if (has_next && has_previous) {
+      (*gradient)(axis) = (next_voxel->distance - previous_voxel->distance) /
+                          (2.0 * voxel_size_);
+    } else if (has_next) {
+      (*gradient)(axis) = (next_voxel->distance - voxel->distance) /
+                          voxel_size_;
+    } else if (has_previous) {
+      (*gradient)(axis) = (voxel->distance - previous_voxel->distance) /
+                          voxel_size_;
+    } else {
+      (*gradient)(axis) = 0.0;
+    }
+  }
+  return true;
+}
+
+}  // namespace voxblox
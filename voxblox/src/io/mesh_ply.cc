@@ -22,92 +22,96 @@
 
 #include "voxblox/io/mesh_ply.h"
 
+#include <vector>
+
 namespace voxblox {
 
+namespace {
+
+void writeMeshVertices(const Mesh& mesh, bool has_colors,
+                       io::PlyWriter* writer) {
+  DCHECK_NOTNULL(writer);
+  if (has_colors) {
+    for (size_t i = 0u; i < mesh.vertices.size(); ++i) {
+      writer->writeVertex(mesh.vertices[i], mesh.colors[i]);
+    }
+  } else {
+    for (const Point& vertex : mesh.vertices) {
+      writer->writeVertex(vertex);
+    }
+  }
+}
+
+void writeMeshFaces(const Mesh& mesh, size_t vertex_offset,
+                    io::PlyWriter* writer) {
+  DCHECK_NOTNULL(writer);
+  for (size_t i = 0u; i + 2u < mesh.indices.size(); i += 3u) {
+    writer->writeFace(vertex_offset + mesh.indices[i],
+                      vertex_offset + mesh.indices[i + 1],
+                      vertex_offset + mesh.indices[i + 2]);
+  }
+}
+
+}  // namespace
+
 bool outputMeshLayerAsPly(const std::string& filename,
-                          const MeshLayer& mesh_layer) {
-  Mesh::Ptr combined_mesh(new Mesh(mesh_layer.block_size(), Point::Zero()));
-  // Combine everything in the layer into one giant combined mesh.
-  size_t v = 0;
+                          const MeshLayer& mesh_layer, io::PlyFormat format) {
   BlockIndexList mesh_indices;
   mesh_layer.getAllAllocatedMeshes(&mesh_indices);
+  std::vector<Mesh::ConstPtr> meshes;
+  meshes.reserve(mesh_indices.size());
+  bool has_colors = true;
+  size_t num_vertices = 0u;
+  size_t num_indices = 0u;
   for (const BlockIndex& block_index : mesh_indices) {
     Mesh::ConstPtr mesh = mesh_layer.getMeshPtrByIndex(block_index);
-    for (const Point& vert : mesh->vertices) {
-      combined_mesh->vertices.push_back(vert);
-      combined_mesh->indices.push_back(v);
-      v++;
-    }
-
-    for (const Color& color : mesh->colors) {
-      combined_mesh->colors.push_back(color);
+    if (!mesh->hasVertices()) {
+      continue;
     }
+    has_colors &= mesh->hasColors();
+    num_vertices += mesh->vertices.size();
+    num_indices += mesh->indices.size();
+    meshes.push_back(mesh);
+  }
+  has_colors &= !meshes.empty();
 
-    for (const Point& normal : mesh->normals) {
-      combined_mesh->normals.push_back(normal);
-    }
+  io::PlyWriter writer(filename, format);
+  writer.addVerticesWithProperties(num_vertices, has_colors);
+  writer.addFaces(num_indices / 3u);
+  if (!writer.writeHeader()) {
+    return false;
   }
 
-  LOG(INFO) << "Full mesh has " << v << " verts";
-  bool success = outputMeshAsPly(filename, *combined_mesh);
+  // The vertices of all blocks come first, the indices of every block mesh
+  // start at 0.
+  for (const Mesh::ConstPtr& mesh : meshes) {
+    writeMeshVertices(*mesh, has_colors, &writer);
+  }
+  size_t vertex_offset = 0u;
+  for (const Mesh::ConstPtr& mesh : meshes) {
+    writeMeshFaces(*mesh, vertex_offset, &writer);
+    vertex_offset += mesh->vertices.size();
+  }
 
+  LOG(INFO) << "Full mesh has " << writer.vertices_written() << " verts";
+  const bool success = writer.closeFile();
   if (!success) {
     LOG(WARNING) << "Saving to PLY failed!";
   }
   return success;
 }
 
-bool outputMeshAsPly(const std::string& filename, const Mesh& mesh) {
-  std::ofstream stream(filename.c_str());
-
-  if (!stream) {
+bool outputMeshAsPly(const std::string& filename, const Mesh& mesh,
+                     io::PlyFormat format) {
+  io::PlyWriter writer(filename, format);
+  writer.addVerticesWithProperties(mesh.vertices.size(), mesh.hasColors());
+  writer.addFaces(mesh.indices.size() / 3u);
+  if (!writer.writeHeader()) {
     return false;
   }
-
-  size_t num_points = mesh.vertices.size();
-  stream << "ply" << std::endl;
-  stream << "format ascii 1.0" << std::endl;
-  stream << "element vertex " << num_points << std::endl;
-  stream << "property float x" << std::endl;
-  stream << "property float y" << std::endl;
-  stream << "property float z" << std::endl;
-  if (mesh.hasColors()) {
-    stream << "property uchar red" << std::endl;
-    stream << "property uchar green" << std::endl;
-    stream << "property uchar blue" << std::endl;
-  }
-  stream << "element face " << num_points / 3 << std::endl;
-  stream << "property list uchar int vertex_index" << std::endl;
-  stream << "end_header" << std::endl;
-
-  size_t vert_idx = 0;
-  for (const Point& vert : mesh.vertices) {
-    stream << vert(0) << " " << vert(1) << " " << vert(2);
-
-    if (mesh.hasColors()) {
-      const Color& color = mesh.colors[vert_idx];
-      int r = static_cast<int>(color.r);
-      int g = static_cast<int>(color.g);
-      int b = static_cast<int>(color.b);
-      // Uint8 prints as character otherwise. :(
-      stream << " " << r << " " << g << " " << b;
-    }
-
-    stream << std::endl;
-    vert_idx++;
-  }
-
-  for (size_t i = 0; i < mesh.indices.size(); i += 3) {
-    stream << "3 ";
-
-    for (int j = 0; j < 3; j++) {
-      stream << mesh.indices.at(i + j) << " ";
-    }
-
-    stream << std::endl;
-  }
-
-  return true;
+  writeMeshVertices(mesh, mesh.hasColors(), &writer);
+  writeMeshFaces(mesh, 0u, &writer);
+  return writer.closeFile();
 }
 
 }  // namespace voxblox
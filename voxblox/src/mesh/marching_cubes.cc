@@ -290,4 +290,10 @@ int MarchingCubes::kEdgeIndexPairs[12][2] = {{0, 1}, {1, 2}, {2, 3}, {3, 0},
                                              {4, 5}, {5, 6}, {6, 7}, {7, 4},
                                              {0, 4}, {1, 5}, {2, 6}, {3, 7}};
 
+// For every edge the cube corner with the lower coordinates and the axis the
+// edge runs along (0 = x, 1 = y, 2 = z).
+int MarchingCubes::kEdgeStartCornerAndAxis[12][2] = {
+    {0, 0}, {1, 1}, {3, 0}, {0, 1}, {4, 0}, {5, 1},
+    {7, 0}, {4, 1}, {0, 2}, {1, 2}, {2, 2}, {3, 2}};
+
 }  // namespace voxblox
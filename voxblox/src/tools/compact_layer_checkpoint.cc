@@ -0,0 +1,58 @@
+#include <fstream>  // NOLINT
+#include <iostream>  // NOLINT
+#include <string>
+
+#include <glog/logging.h>
+
+#include "./Layer.pb.h"
+#include "voxblox/core/voxel.h"
+#include "voxblox/io/layer_checkpoint.h"
+#include "voxblox/utils/protobuf_utils.h"
+
+// Merges the delta log of an incremental checkpoint into its base file.
+// Usage: compact_layer_checkpoint <checkpoint base file>
+int main(int argc, char** argv) {
+  google::InitGoogleLogging(argv[0]);
+
+  if (argc != 2) {
+    std::cerr << "Usage: " << argv[0] << " <checkpoint base file>"
+              << std::endl;
+    return 1;
+  }
+  const std::string base_path(argv[1]);
+
+  // Peek at the layer header to find out the voxel type.
+  std::fstream base_file;
+  base_file.open(base_path, std::fstream::in | std::fstream::binary);
+  if (!base_file.is_open()) {
+    LOG(ERROR) << "Could not open checkpoint base file: " << base_path;
+    return 1;
+  }
+  uint32_t byte_offset;
+  uint32_t num_messages;
+  voxblox::LayerProto layer_proto;
+  if (!voxblox::utils::readProtoMsgCountToStream(&base_file, &num_messages,
+                                                 &byte_offset) ||
+      num_messages == 0u ||
+      !voxblox::utils::readProtoMsgFromStream(&base_file, &layer_proto,
+                                              &byte_offset)) {
+    LOG(ERROR) << "Could not read the layer header of: " << base_path;
+    return 1;
+  }
+  base_file.close();
+
+  bool success = false;
+  if (layer_proto.type() == voxblox::voxel_types::kTsdf) {
+    success = voxblox::io::CompactLayerCheckpoint<voxblox::TsdfVoxel>(
+        base_path);
+  } else if (layer_proto.type() == voxblox::voxel_types::kEsdf) {
+    success = voxblox::io::CompactLayerCheckpoint<voxblox::EsdfVoxel>(
+        base_path);
+  } else if (layer_proto.type() == voxblox::voxel_types::kOccupancy) {
+    success = voxblox::io::CompactLayerCheckpoint<voxblox::OccupancyVoxel>(
+        base_path);
+  } else {
+    LOG(ERROR) << "Unknown layer type: " << layer_proto.type();
+  }
+  return success ? 0 : 1;
+}
@@ -0,0 +1,333 @@
+#include "voxblox/utils/compression_utils.h"
+
+#include <cstring>
+
+#ifdef VOXBLOX_WITH_ZSTD
+#include <zstd.h>
+#endif
+#ifdef VOXBLOX_WITH_LZ4
+#include <lz4.h>
+#endif
+
+namespace voxblox {
+
+namespace utils {
+
+// Hidden encoding helpers. All streams start with the number of uncompressed
+// words as a varint, followed by the codec specific payload. Words are always
+// stored little-endian.
+namespace {
+
+void appendVarint(uint64_t value, std::string* out) {
+  while (value >= 0x80u) {
+    out->push_back(static_cast<char>((value & 0x7Fu) | 0x80u));
+    value >>= 7;
+  }
+  out->push_back(static_cast<char>(value));
+}
+
+bool readVarint(const std::string& in, size_t* pos, uint64_t* value) {
+  *value = 0u;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (*pos >= in.size()) {
+      return false;
+    }
+    const uint8_t byte = static_cast<uint8_t>(in[(*pos)++]);
+    *value |= static_cast<uint64_t>(byte & 0x7Fu) << shift;
+    if ((byte & 0x80u) == 0u) {
+      return true;
+    }
+  }
+  return false;
+}
+
+inline void appendWord(uint32_t word, std::string* out) {
+  out->push_back(static_cast<char>(word & 0xFFu));
+  out->push_back(static_cast<char>((word >> 8) & 0xFFu));
+  out->push_back(static_cast<char>((word >> 16) & 0xFFu));
+  out->push_back(static_cast<char>((word >> 24) & 0xFFu));
+}
+
+inline uint32_t readWord(const char* in) {
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(in);
+  return static_cast<uint32_t>(bytes[0]) |
+         (static_cast<uint32_t>(bytes[1]) << 8) |
+         (static_cast<uint32_t>(bytes[2]) << 16) |
+         (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+#if defined(VOXBLOX_WITH_ZSTD) || defined(VOXBLOX_WITH_LZ4)
+void wordsToBytes(const std::vector<uint32_t>& data, std::string* bytes) {
+  bytes->clear();
+  bytes->reserve(data.size() * sizeof(uint32_t));
+  for (uint32_t word : data) {
+    appendWord(word, bytes);
+  }
+}
+#endif
+
+bool bytesToWords(const char* bytes, size_t num_words,
+                  std::vector<uint32_t>* data) {
+  data->resize(num_words);
+  for (size_t i = 0u; i < num_words; ++i) {
+    (*data)[i] = readWord(bytes + i * sizeof(uint32_t));
+  }
+  return true;
+}
+
+// RLE payload: the number of words per voxel, followed by a sequence of
+// packets. Each packet starts with a varint (count << 1 | is_run). A run
+// packet is followed by a single voxel that is repeated count times, a
+// literal packet by count voxels.
+void encodeRle(const std::vector<uint32_t>& data, size_t words_per_voxel,
+               std::string* out) {
+  const size_t num_voxels = data.size() / words_per_voxel;
+  appendVarint(words_per_voxel, out);
+
+  const uint32_t* voxels = data.data();
+  const size_t voxel_bytes = words_per_voxel * sizeof(uint32_t);
+
+  size_t literal_start = 0u;
+  size_t voxel_idx = 0u;
+  while (voxel_idx < num_voxels) {
+    const uint32_t* voxel = voxels + voxel_idx * words_per_voxel;
+    size_t run_end = voxel_idx + 1u;
+    while (run_end < num_voxels &&
+           memcmp(voxel, voxels + run_end * words_per_voxel, voxel_bytes) ==
+               0) {
+      ++run_end;
+    }
+    const size_t run_length = run_end - voxel_idx;
+    if (run_length < 2u) {
+      ++voxel_idx;
+      continue;
+    }
+
+    // Flush the pending literals before the run.
+    if (literal_start < voxel_idx) {
+      appendVarint((voxel_idx - literal_start) << 1, out);
+      for (size_t i = literal_start * words_per_voxel;
+           i < voxel_idx * words_per_voxel; ++i) {
+        appendWord(voxels[i], out);
+      }
+    }
+    appendVarint((run_length << 1) | 1u, out);
+    for (size_t i = 0u; i < words_per_voxel; ++i) {
+      appendWord(voxel[i], out);
+    }
+    voxel_idx = run_end;
+    literal_start = run_end;
+  }
+  if (literal_start < num_voxels) {
+    appendVarint((num_voxels - literal_start) << 1, out);
+    for (size_t i = literal_start * words_per_voxel; i < data.size(); ++i) {
+      appendWord(voxels[i], out);
+    }
+  }
+}
+
+bool decodeRle(const std::string& in, size_t pos, size_t num_words,
+               std::vector<uint32_t>* data) {
+  uint64_t words_per_voxel;
+  if (!readVarint(in, &pos, &words_per_voxel) || words_per_voxel == 0u) {
+    return false;
+  }
+  data->clear();
+  data->reserve(num_words);
+  while (data->size() < num_words) {
+    uint64_t packet;
+    if (!readVarint(in, &pos, &packet)) {
+      return false;
+    }
+    const uint64_t count = packet >> 1;
+    const bool is_run = (packet & 1u) != 0u;
+    const size_t packet_words = is_run ? words_per_voxel
+                                       : count * words_per_voxel;
+    if (pos + packet_words * sizeof(uint32_t) > in.size() ||
+        data->size() + count * words_per_voxel > num_words) {
+      return false;
+    }
+    if (is_run) {
+      const size_t voxel_start = data->size();
+      for (size_t i = 0u; i < words_per_voxel; ++i) {
+        data->push_back(readWord(&in[pos + i * sizeof(uint32_t)]));
+      }
+      for (size_t repeat = 1u; repeat < count; ++repeat) {
+        for (size_t i = 0u; i < words_per_voxel; ++i) {
+          data->push_back((*data)[voxel_start + i]);
+        }
+      }
+    } else {
+      for (size_t i = 0u; i < packet_words; ++i) {
+        data->push_back(readWord(&in[pos + i * sizeof(uint32_t)]));
+      }
+    }
+    pos += packet_words * sizeof(uint32_t);
+  }
+  return pos == in.size();
+}
+
+}  // namespace
+
+bool isCompressionAvailable(CompressionType compression) {
+  switch (compression) {
+    case CompressionType::kNone:
+    case CompressionType::kRle:
+      return true;
+    case CompressionType::kZstd:
+#ifdef VOXBLOX_WITH_ZSTD
+      return true;
+#else
+      return false;
+#endif
+    case CompressionType::kLz4:
+#ifdef VOXBLOX_WITH_LZ4
+      return true;
+#else
+      return false;
+#endif
+  }
+  return false;
+}
+
+CompressionType getBestAvailableCompression() {
+  if (isCompressionAvailable(CompressionType::kZstd)) {
+    return CompressionType::kZstd;
+  }
+  if (isCompressionAvailable(CompressionType::kLz4)) {
+    return CompressionType::kLz4;
+  }
+  return CompressionType::kRle;
+}
+
+bool compressVoxelData(CompressionType compression,
+                       const std::vector<uint32_t>& data,
+                       size_t words_per_voxel, std::string* compressed_data) {
+  CHECK_NOTNULL(compressed_data);
+  CHECK_GT(words_per_voxel, 0u);
+  CHECK_EQ(data.size() % words_per_voxel, 0u);
+
+  compressed_data->clear();
+  appendVarint(data.size(), compressed_data);
+
+  switch (compression) {
+    case CompressionType::kNone:
+      compressed_data->reserve(compressed_data->size() +
+                               data.size() * sizeof(uint32_t));
+      for (uint32_t word : data) {
+        appendWord(word, compressed_data);
+      }
+      return true;
+    case CompressionType::kRle:
+      encodeRle(data, words_per_voxel, compressed_data);
+      return true;
+    case CompressionType::kZstd: {
+#ifdef VOXBLOX_WITH_ZSTD
+      std::string bytes;
+      wordsToBytes(data, &bytes);
+      const size_t header_size = compressed_data->size();
+      compressed_data->resize(header_size + ZSTD_compressBound(bytes.size()));
+      constexpr int kZstdLevel = 3;
+      const size_t compressed_size =
+          ZSTD_compress(&(*compressed_data)[header_size],
+                        compressed_data->size() - header_size, bytes.data(),
+                        bytes.size(), kZstdLevel);
+      if (ZSTD_isError(compressed_size)) {
+        LOG(ERROR) << "zstd compression failed: "
+                   << ZSTD_getErrorName(compressed_size);
+        return false;
+      }
+      compressed_data->resize(header_size + compressed_size);
+      return true;
+#else
+      break;
+#endif
+    }
+    case CompressionType::kLz4: {
+#ifdef VOXBLOX_WITH_LZ4
+      std::string bytes;
+      wordsToBytes(data, &bytes);
+      const size_t header_size = compressed_data->size();
+      const int bound = LZ4_compressBound(static_cast<int>(bytes.size()));
+      compressed_data->resize(header_size + bound);
+      const int compressed_size = LZ4_compress_default(
+          bytes.data(), &(*compressed_data)[header_size],
+          static_cast<int>(bytes.size()), bound);
+      if (compressed_size <= 0 && !bytes.empty()) {
+        LOG(ERROR) << "LZ4 compression failed.";
+        return false;
+      }
+      compressed_data->resize(header_size + compressed_size);
+      return true;
+#else
+      break;
+#endif
+    }
+  }
+  LOG(ERROR) << "Compression type " << static_cast<uint32_t>(compression)
+             << " is not available in this build.";
+  return false;
+}
+
+bool decompressVoxelData(CompressionType compression,
+                         const std::string& compressed_data,
+                         std::vector<uint32_t>* data) {
+  CHECK_NOTNULL(data);
+
+  size_t pos = 0u;
+  uint64_t num_words;
+  if (!readVarint(compressed_data, &pos, &num_words)) {
+    LOG(ERROR) << "Could not read the size of the compressed voxel data.";
+    return false;
+  }
+
+  bool success = false;
+  switch (compression) {
+    case CompressionType::kNone:
+      success =
+          compressed_data.size() - pos == num_words * sizeof(uint32_t) &&
+          bytesToWords(compressed_data.data() + pos, num_words, data);
+      break;
+    case CompressionType::kRle:
+      success = decodeRle(compressed_data, pos, num_words, data);
+      break;
+    case CompressionType::kZstd: {
+#ifdef VOXBLOX_WITH_ZSTD
+      std::string bytes(num_words * sizeof(uint32_t), '\0');
+      const size_t decompressed_size =
+          ZSTD_decompress(&bytes[0], bytes.size(), compressed_data.data() + pos,
+                          compressed_data.size() - pos);
+      success = !ZSTD_isError(decompressed_size) &&
+                decompressed_size == bytes.size() &&
+                bytesToWords(bytes.data(), num_words, data);
+#else
+      LOG(ERROR) << "Voxel data is zstd compressed, but voxblox was built "
+                    "without zstd.";
+#endif
+    } break;
+    case CompressionType::kLz4: {
+#ifdef VOXBLOX_WITH_LZ4
+      std::string bytes(num_words * sizeof(uint32_t), '\0');
+      const int decompressed_size = LZ4_decompress_safe(
+          compressed_data.data() + pos, &bytes[0],
+          static_cast<int>(compressed_data.size() - pos),
+          static_cast<int>(bytes.size()));
+      success = decompressed_size == static_cast<int>(bytes.size()) &&
+                bytesToWords(bytes.data(), num_words, data);
+#else
+      LOG(ERROR) << "Voxel data is LZ4 compressed, but voxblox was built "
+                    "without LZ4.";
+#endif
+    } break;
+    default:
+      LOG(ERROR) << "Unknown compression type: "
+                 << static_cast<uint32_t>(compression);
+  }
+  if (!success) {
+    LOG(ERROR) << "Could not decompress voxel data.";
+  }
+  return success;
+}
+
+}  // namespace utils
+}  // namespace voxblox
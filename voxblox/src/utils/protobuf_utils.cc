@@ -38,9 +38,40 @@ bool writeProtoMsgCountToStream(uint32_t message_count,
   return true;
 }
 
+bool readProtoMsgCountFromStreamAtOffset(std::fstream* stream_in,
+                                         uint32_t* message_count,
+                                         uint64_t* byte_offset) {
+  CHECK_NOTNULL(stream_in);
+  CHECK_NOTNULL(message_count);
+  CHECK_NOTNULL(byte_offset);
+  CHECK(stream_in->is_open());
+  stream_in->clear();
+  stream_in->seekg(*byte_offset, std::ios::beg);
+  google::protobuf::io::IstreamInputStream raw_in(stream_in);
+  google::protobuf::io::CodedInputStream coded_in(&raw_in);
+  const int prev_position = coded_in.CurrentPosition();
+  if (!coded_in.ReadVarint32(message_count)) {
+    return false;
+  }
+  *byte_offset += coded_in.CurrentPosition() - prev_position;
+  return true;
+}
+
 bool readProtoMsgFromStream(std::fstream* stream_in,
                             google::protobuf::Message* message,
                             uint32_t* byte_offset) {
+  CHECK_NOTNULL(byte_offset);
+  uint64_t wide_byte_offset = *byte_offset;
+  if (!readProtoMsgFromStream(stream_in, message, &wide_byte_offset)) {
+    return false;
+  }
+  *byte_offset = static_cast<uint32_t>(wide_byte_offset);
+  return true;
+}
+
+bool readProtoMsgFromStream(std::fstream* stream_in,
+                            google::protobuf::Message* message,
+                            uint64_t* byte_offset) {
   CHECK_NOTNULL(stream_in);
   CHECK_NOTNULL(message);
   CHECK_NOTNULL(byte_offset);
@@ -99,5 +130,24 @@ bool writeProtoMsgToStream(const google::protobuf::Message& message,
   return true;
 }
 
+bool writeSerializedProtoMsgToStream(const std::string& serialized_message,
+                                     std::fstream* stream_out,
+                                     size_t* bytes_written) {
+  CHECK_NOTNULL(stream_out);
+  CHECK(stream_out->is_open());
+  google::protobuf::io::OstreamOutputStream raw_out(stream_out);
+  google::protobuf::io::CodedOutputStream coded_out(&raw_out);
+  const uint32_t size_bytes = serialized_message.size();
+  coded_out.WriteVarint32(size_bytes);
+  coded_out.WriteRaw(serialized_message.data(), size_bytes);
+  if (coded_out.HadError()) {
+    return false;
+  }
+  if (bytes_written != nullptr) {
+    *bytes_written = coded_out.ByteCount();
+  }
+  return true;
+}
+
 }  // namespace utils
 }  // namespace voxblox
@@ -0,0 +1,236 @@
+#include "voxblox/utils/quantized_block_encoding.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "voxblox/core/block.h"
+
+namespace voxblox {
+
+namespace utils {
+
+// Hidden encoding helpers. The quantized TSDF encoding is a byte stream,
+// packed little-endian into 32 bit words and zero padded:
+//   byte 0:      flags (kFlag16BitDistance | kFlagColor)
+//   bytes 1-3:   reserved
+//   bytes 4-7:   truncation distance (float bits)
+//   observed bitmask, one bit per voxel in linear index order
+//   distance of every observed voxel, int8 or int16
+//   weight of every observed voxel as zigzag varint of the bfloat16 delta to
+//   the previous observed voxel
+//   color of every observed voxel, r g b a (only if kFlagColor)
+namespace {
+
+constexpr uint8_t kFlag16BitDistance = 1u;
+constexpr uint8_t kFlagColor = 2u;
+constexpr size_t kHeaderSize = 8u;
+
+// Rounds to the nearest bfloat16, i.e. the upper half of the float bits.
+inline uint16_t floatToBFloat16(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  bits += 0x7FFFu + ((bits >> 16) & 1u);
+  return static_cast<uint16_t>(bits >> 16);
+}
+
+inline float bFloat16ToFloat(uint16_t value) {
+  const uint32_t bits = static_cast<uint32_t>(value) << 16;
+  float result;
+  memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+inline void appendVarint(uint32_t value, std::vector<uint8_t>* bytes) {
+  while (value >= 0x80u) {
+    bytes->push_back(static_cast<uint8_t>((value & 0x7Fu) | 0x80u));
+    value >>= 7;
+  }
+  bytes->push_back(static_cast<uint8_t>(value));
+}
+
+inline bool readVarint(const uint8_t* bytes, size_t num_bytes, size_t* pos,
+                       uint32_t* value) {
+  *value = 0u;
+  for (int shift = 0; shift < 35; shift += 7) {
+    if (*pos >= num_bytes) {
+      return false;
+    }
+    const uint8_t byte = bytes[(*pos)++];
+    *value |= static_cast<uint32_t>(byte & 0x7Fu) << shift;
+    if ((byte & 0x80u) == 0u) {
+      return true;
+    }
+  }
+  return false;
+}
+
+inline uint32_t zigzagEncode(int32_t value) {
+  return (static_cast<uint32_t>(value) << 1) ^
+         static_cast<uint32_t>(value >> 31);
+}
+
+inline int32_t zigzagDecode(uint32_t value) {
+  return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1u);
+}
+
+}  // namespace
+
+template <>
+void encodeQuantizedBlock<TsdfVoxel>(const Block<TsdfVoxel>& block,
+                                     const QuantizationConfig& config,
+                                     std::vector<uint32_t>* data) {
+  CHECK_NOTNULL(data);
+  CHECK_GT(config.truncation_distance, 0.0);
+
+  const size_t num_voxels = block.num_voxels();
+  const FloatingPoint max_quantized =
+      config.use_16_bit_distance ? 32767.0 : 127.0;
+  const FloatingPoint distance_scale =
+      max_quantized / config.truncation_distance;
+
+  std::vector<uint8_t> mask((num_voxels + 7u) / 8u, 0u);
+  std::vector<uint8_t> distances;
+  std::vector<uint8_t> weights;
+  std::vector<uint8_t> colors;
+  distances.reserve(num_voxels * (config.use_16_bit_distance ? 2u : 1u));
+  weights.reserve(num_voxels);
+  if (config.include_color) {
+    colors.reserve(num_voxels * 4u);
+  }
+
+  uint16_t previous_weight = 0u;
+  for (size_t i = 0u; i < num_voxels; ++i) {
+    const TsdfVoxel& voxel = block.getVoxelByLinearIndex(i);
+    if (!(voxel.weight > 0.0f)) {
+      continue;
+    }
+    mask[i / 8u] |= static_cast<uint8_t>(1u << (i % 8u));
+
+    const FloatingPoint clamped_distance =
+        std::max(-max_quantized,
+                 std::min(max_quantized, voxel.distance * distance_scale));
+    const int32_t quantized_distance =
+        static_cast<int32_t>(std::round(clamped_distance));
+    distances.push_back(static_cast<uint8_t>(quantized_distance & 0xFF));
+    if (config.use_16_bit_distance) {
+      distances.push_back(
+          static_cast<uint8_t>((quantized_distance >> 8) & 0xFF));
+    }
+
+    // Never round an observed voxel down to weight 0.
+    const uint16_t weight =
+        std::max<uint16_t>(floatToBFloat16(voxel.weight), 1u);
+    appendVarint(zigzagEncode(static_cast<int32_t>(weight) -
+                              static_cast<int32_t>(previous_weight)),
+                 &weights);
+    previous_weight = weight;
+
+    if (config.include_color) {
+      colors.push_back(voxel.color.r);
+      colors.push_back(voxel.color.g);
+      colors.push_back(voxel.color.b);
+      colors.push_back(voxel.color.a);
+    }
+  }
+
+  const size_t num_bytes = kHeaderSize + mask.size() + distances.size() +
+                           weights.size() + colors.size();
+  data->assign((num_bytes + 3u) / 4u, 0u);
+  uint8_t* bytes = reinterpret_cast<uint8_t*>(data->data());
+  bytes[0] = (config.use_16_bit_distance ? kFlag16BitDistance : 0u) |
+             (config.include_color ? kFlagColor : 0u);
+  const float truncation_distance = config.truncation_distance;
+  memcpy(bytes + 4u, &truncation_distance, sizeof(truncation_distance));
+  size_t pos = kHeaderSize;
+  for (const std::vector<uint8_t>* section :
+       {&mask, &distances, &weights, &colors}) {
+    if (!section->empty()) {
+      memcpy(bytes + pos, section->data(), section->size());
+      pos += section->size();
+    }
+  }
+
+  // The byte stream above relies on the words being stored little-endian.
+  static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+                "The quantized block encoding requires a little-endian host.");
+}
+
+template <>
+bool decodeQuantizedBlock<TsdfVoxel>(const uint32_t* data, size_t num_words,
+                                     Block<TsdfVoxel>* block) {
+  CHECK_NOTNULL(block);
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+  const size_t num_bytes = num_words * sizeof(uint32_t);
+  const size_t num_voxels = block->num_voxels();
+  const size_t mask_size = (num_voxels + 7u) / 8u;
+  if (data == nullptr || num_bytes < kHeaderSize + mask_size) {
+    return false;
+  }
+
+  const bool use_16_bit_distance = (bytes[0] & kFlag16BitDistance) != 0u;
+  const bool include_color = (bytes[0] & kFlagColor) != 0u;
+  float truncation_distance;
+  memcpy(&truncation_distance, bytes + 4u, sizeof(truncation_distance));
+  const FloatingPoint max_quantized = use_16_bit_distance ? 32767.0 : 127.0;
+  const FloatingPoint distance_scale = truncation_distance / max_quantized;
+
+  const uint8_t* mask = bytes + kHeaderSize;
+  size_t num_observed = 0u;
+  for (size_t i = 0u; i < mask_size; ++i) {
+    num_observed += __builtin_popcount(mask[i]);
+  }
+
+  const size_t distance_size = use_16_bit_distance ? 2u : 1u;
+  const uint8_t* distances = mask + mask_size;
+  size_t pos = kHeaderSize + mask_size + num_observed * distance_size;
+  if (pos > num_bytes) {
+    return false;
+  }
+
+  uint16_t weight = 0u;
+  size_t observed_idx = 0u;
+  std::vector<uint16_t> weights(num_observed);
+  for (uint16_t& observed_weight : weights) {
+    uint32_t delta;
+    if (!readVarint(bytes, num_bytes, &pos, &delta)) {
+      return false;
+    }
+    weight = static_cast<uint16_t>(weight + zigzagDecode(delta));
+    observed_weight = weight;
+  }
+  const uint8_t* colors = bytes + pos;
+  if (include_color && pos + num_observed * 4u > num_bytes) {
+    return false;
+  }
+
+  for (size_t i = 0u; i < num_voxels; ++i) {
+    TsdfVoxel& voxel = block->getVoxelByLinearIndex(i);
+    if ((mask[i / 8u] & (1u << (i % 8u))) == 0u) {
+      voxel = TsdfVoxel();
+      continue;
+    }
+
+    const uint8_t* distance = distances + observed_idx * distance_size;
+    const int32_t quantized_distance =
+        use_16_bit_distance
+            ? static_cast<int16_t>(distance[0] | (distance[1] << 8))
+            : static_cast<int8_t>(distance[0]);
+    voxel.distance = quantized_distance * distance_scale;
+    voxel.weight = bFloat16ToFloat(weights[observed_idx]);
+    if (include_color) {
+      const uint8_t* color = colors + observed_idx * 4u;
+      voxel.color.r = color[0];
+      voxel.color.g = color[1];
+      voxel.color.b = color[2];
+      voxel.color.a = color[3];
+    } else {
+      voxel.color = Color();
+    }
+    ++observed_idx;
+  }
+  return true;
+}
+
+}  // namespace utils
+}  // namespace voxblox
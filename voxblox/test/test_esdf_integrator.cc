@@ -0,0 +1,749 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "voxblox/core/common.h"
+#include "voxblox/core/esdf_map.h"
+#include "voxblox/core/layer.h"
+#include "voxblox/core/voxel.h"
+#include "voxblox/integrator/esdf_integrator.h"
+#include "voxblox/integrator/esdf_occ_integrator.h"
+#include "voxblox/integrator/esdf_window_integrator.h"
+#include "voxblox/utils/block_neighborhood.h"
+
+using namespace voxblox;  // NOLINT
+
+class EsdfIntegratorTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    tsdf_layer_.reset(new Layer<TsdfVoxel>(kVoxelSize, kVoxelsPerSide));
+    esdf_layer_.reset(new Layer<EsdfVoxel>(kVoxelSize, kVoxelsPerSide));
+    // Inside the truncation band, so the truncated TSDF values are not
+    // fixed.
+    config_.min_distance_m = 0.75 * kTruncationDistance;
+    config_.max_distance_m = 1.0;
+    config_.default_distance_m = 1.0;
+  }
+
+  // A TSDF of a sphere, observed in all blocks with an index in
+  // [-half_index_range, half_index_range).
+  void createSphereLayer(int half_index_range) {
+    createSphereLayer(half_index_range, BlockIndex::Zero());
+  }
+  // Same as above for a sphere that is moved by the given number of blocks.
+  void createSphereLayer(int half_index_range, const BlockIndex& block_offset) {
+    const FloatingPoint truncation_distance = kTruncationDistance;
+    const Point offset =
+        block_offset.cast<FloatingPoint>() * kVoxelSize * kVoxelsPerSide;
+    for (int x = -half_index_range; x < half_index_range; ++x) {
+      for (int y = -half_index_range; y < half_index_range; ++y) {
+        for (int z = -half_index_range; z < half_index_range; ++z) {
+          Block<TsdfVoxel>::Ptr block = tsdf_layer_->allocateBlockPtrByIndex(
+              BlockIndex(x, y, z) + block_offset);
+          for (size_t i = 0u; i < block->num_voxels(); ++i) {
+            TsdfVoxel& voxel = block->getVoxelByLinearIndex(i);
+            voxel.distance = std::max(
+                std::min(getSphereDistance(
+                             block->computeCoordinatesFromLinearIndex(i) -
+                             offset),
+                         truncation_distance),
+                -truncation_distance);
+            voxel.weight = 1.0;
+          }
+          block->has_data() = true;
+          block->updated() = true;
+        }
+      }
+    }
+  }
+
+  static FloatingPoint getSphereDistance(const Point& point) {
+    return (point - kCenter).norm() - kRadius;
+  }
+
+  static constexpr FloatingPoint kVoxelSize = 0.05;
+  static constexpr size_t kVoxelsPerSide = 8u;
+  static constexpr FloatingPoint kTruncationDistance = 0.1;
+  static constexpr FloatingPoint kRadius = 0.4;
+  static const Point kCenter;
+
+  EsdfIntegrator::Config config_;
+  std::unique_ptr<Layer<TsdfVoxel>> tsdf_layer_;
+  std::unique_ptr<Layer<EsdfVoxel>> esdf_layer_;
+};
+
+const Point EsdfIntegratorTest::kCenter(0.05, -0.1, 0.15);
+
+TEST_F(EsdfIntegratorTest, BlockNeighborhood) {
+  // A few allocated blocks around the origin, with gaps.
+  for (int x = -1; x <= 1; ++x) {
+    for (int y = -1; y <= 1; ++y) {
+      for (int z = -1; z <= 1; ++z) {
+        if ((x + 2 * y + 3 * z) % 4 != 0 || (x == 0 && y == 0 && z == 0)) {
+          esdf_layer_->allocateBlockPtrByIndex(BlockIndex(x, y, z));
+        }
+      }
+    }
+  }
+  EsdfIntegrator esdf_integrator(config_, tsdf_layer_.get(),
+                                 esdf_layer_.get());
+
+  BlockNeighborhood<EsdfVoxel> neighborhood(esdf_layer_.get());
+  BlockIndexList block_indices;
+  esdf_layer_->getAllAllocatedBlocks(&block_indices);
+  for (const BlockIndex& block_index : block_indices) {
+    Block<EsdfVoxel>* block = neighborhood.setBlock(block_index);
+    ASSERT_EQ(block, esdf_layer_->getBlockPtrByIndex(block_index).get());
+    for (size_t i = 0u; i < block->num_voxels(); ++i) {
+      const VoxelIndex voxel_index = block->computeVoxelIndexFromLinearIndex(i);
+      EXPECT_EQ(&neighborhood.setVoxel(voxel_index),
+                &block->getVoxelByLinearIndex(i));
+
+      std::vector<VoxelKey> neighbors;
+      std::vector<float> distances;
+      std::vector<Eigen::Vector3i> directions;
+      esdf_integrator.getNeighborsAndDistances(
+          block_index, voxel_index, &neighbors, &distances, &directions);
+      ASSERT_EQ(neighbors.size(), 26u);
+      for (size_t n = 0u; n < neighbors.size(); ++n) {
+        EXPECT_EQ(directions[n], NeighborStencil::direction(n));
+        EXPECT_EQ(distances[n], NeighborStencil::distance(n));
+
+        VoxelKey key;
+        EsdfVoxel* neighbor_voxel = neighborhood.getNeighbor(n, &key);
+        Block<EsdfVoxel>::Ptr neighbor_block =
+            esdf_layer_->getBlockPtrByIndex(neighbors[n].first);
+        EXPECT_EQ(key.first, neighbors[n].first);
+        EXPECT_EQ(key.second, neighbors[n].second);
+        if (neighbor_block) {
+          EXPECT_EQ(neighbor_voxel,
+                    &neighbor_block->getVoxelByVoxelIndex(neighbors[n].second));
+        } else {
+          EXPECT_TRUE(neighbor_voxel == nullptr);
+        }
+      }
+    }
+  }
+}
+
+TEST_F(EsdfIntegratorTest, SphereDistances) {
+  createSphereLayer(2);
+  EsdfIntegrator esdf_integrator(config_, tsdf_layer_.get(),
+                                 esdf_layer_.get());
+  esdf_integrator.updateFromTsdfLayerBatch();
+
+  // The quasi-Euclidean distances overestimate the Euclidean ones by up to
+  // about 8%, plus the error of the fixed band, which is copied from the
+  // TSDF.
+  BlockIndexList block_indices;
+  esdf_layer_->getAllAllocatedBlocks(&block_indices);
+  size_t num_checked = 0u;
+  for (const BlockIndex& block_index : block_indices) {
+    const Block<EsdfVoxel>& block = esdf_layer_->getBlockByIndex(block_index);
+    for (size_t i = 0u; i < block.num_voxels(); ++i) {
+      const EsdfVoxel& voxel = block.getVoxelByLinearIndex(i);
+      ASSERT_TRUE(voxel.observed);
+      const FloatingPoint distance =
+          getSphereDistance(block.computeCoordinatesFromLinearIndex(i));
+      if (std::abs(distance) > 0.8 * config_.max_distance_m) {
+        continue;
+      }
+      EXPECT_NEAR(voxel.distance, distance,
+                  0.1 * std::abs(distance) + kVoxelSize);
+      EXPECT_FALSE(voxel.in_queue);
+      ++num_checked;
+    }
+  }
+  EXPECT_GT(num_checked, 0u);
+}
+
+TEST_F(EsdfIntegratorTest, ExactSphereDistances) {
+  createSphereLayer(2);
+  Layer<EsdfVoxel> quasi_esdf_layer(kVoxelSize, kVoxelsPerSide);
+  EsdfIntegrator quasi_esdf_integrator(config_, tsdf_layer_.get(),
+                                       &quasi_esdf_layer);
+  quasi_esdf_integrator.updateFromTsdfLayerBatch();
+
+  config_.integrator_threads = 1u;
+  EsdfIntegrator esdf_integrator(config_, tsdf_layer_.get(),
+                                 esdf_layer_.get());
+  esdf_integrator.updateFromTsdfLayerBatchExact();
+
+  // One tile per block, whose halos reach across the whole map.
+  Layer<EsdfVoxel> threaded_esdf_layer(kVoxelSize, kVoxelsPerSide);
+  config_.integrator_threads = 4u;
+  config_.exact_tile_size_blocks = 1;
+  EsdfIntegrator threaded_esdf_integrator(config_, tsdf_layer_.get(),
+                                          &threaded_esdf_layer);
+  threaded_esdf_integrator.updateFromTsdfLayerBatchExact();
+
+  // The exact distances are only off by the error of the fixed band, and
+  // never larger than the quasi-Euclidean ones by more than that.
+  BlockIndexList block_indices;
+  esdf_layer_->getAllAllocatedBlocks(&block_indices);
+  ASSERT_EQ(block_indices.size(), quasi_esdf_layer.getNumberOfAllocatedBlocks());
+  size_t num_checked = 0u;
+  for (const BlockIndex& block_index : block_indices) {
+    const Block<EsdfVoxel>& block = esdf_layer_->getBlockByIndex(block_index);
+    const Block<EsdfVoxel>& quasi_block =
+        quasi_esdf_layer.getBlockByIndex(block_index);
+    const Block<EsdfVoxel>& threaded_block =
+        threaded_esdf_layer.getBlockByIndex(block_index);
+    for (size_t i = 0u; i < block.num_voxels(); ++i) {
+      const EsdfVoxel& voxel = block.getVoxelByLinearIndex(i);
+      const EsdfVoxel& quasi_voxel = quasi_block.getVoxelByLinearIndex(i);
+      const EsdfVoxel& threaded_voxel = threaded_block.getVoxelByLinearIndex(i);
+      ASSERT_TRUE(voxel.observed);
+      EXPECT_EQ(voxel.fixed, quasi_voxel.fixed);
+      EXPECT_EQ(voxel.distance, threaded_voxel.distance);
+      EXPECT_EQ(voxel.parent, threaded_voxel.parent);
+
+      const FloatingPoint distance =
+          getSphereDistance(block.computeCoordinatesFromLinearIndex(i));
+      if (std::abs(distance) > 0.8 * config_.max_distance_m) {
+        continue;
+      }
+      EXPECT_NEAR(voxel.distance, distance, kVoxelSize);
+      EXPECT_NEAR(voxel.distance, quasi_voxel.distance,
+                  0.1 * std::abs(distance) + kVoxelSize);
+      EXPECT_LE(std::abs(voxel.distance),
+                std::abs(quasi_voxel.distance) + kVoxelSize);
+      if (!voxel.fixed) {
+        // The parent points to a fixed voxel at the distance of the update.
+        const Point site = block.computeCoordinatesFromLinearIndex(i) +
+                           voxel.parent.cast<FloatingPoint>() * kVoxelSize;
+        EXPECT_LE(std::abs(getSphereDistance(site)),
+                  config_.min_distance_m + 1e-4);
+      }
+      ++num_checked;
+    }
+  }
+  EXPECT_GT(num_checked, 0u);
+}
+
+// Expects the two ESDF layers to be exactly the same.
+void expectSameEsdfLayers(const Layer<EsdfVoxel>& layer,
+                          const Layer<EsdfVoxel>& other_layer) {
+  BlockIndexList block_indices;
+  layer.getAllAllocatedBlocks(&block_indices);
+  EXPECT_EQ(block_indices.size(), other_layer.getNumberOfAllocatedBlocks());
+  for (const BlockIndex& block_index : block_indices) {
+    ASSERT_TRUE(other_layer.hasBlock(block_index));
+    const Block<EsdfVoxel>& block = layer.getBlockByIndex(block_index);
+    const Block<EsdfVoxel>& other_block =
+        other_layer.getBlockByIndex(block_index);
+    for (size_t i = 0u; i < block.num_voxels(); ++i) {
+      const EsdfVoxel& voxel = block.getVoxelByLinearIndex(i);
+      const EsdfVoxel& other_voxel = other_block.getVoxelByLinearIndex(i);
+      EXPECT_EQ(voxel.distance, other_voxel.distance);
+      EXPECT_EQ(voxel.observed, other_voxel.observed);
+      EXPECT_EQ(voxel.fixed, other_voxel.fixed);
+      EXPECT_EQ(voxel.in_queue, other_voxel.in_queue);
+      EXPECT_EQ(voxel.parent, other_voxel.parent);
+    }
+  }
+}
+
+TEST_F(EsdfIntegratorTest, ParallelIncrementalUpdate) {
+  // Four spheres that are too far apart for their wavefronts to meet, and a
+  // fifth one that is close to the first.
+  const std::vector<BlockIndex> sphere_offsets = {
+      BlockIndex(0, 0, 0), BlockIndex(12, 0, 0), BlockIndex(0, 12, 0),
+      BlockIndex(12, 12, 12), BlockIndex(0, 0, 5)};
+  for (const BlockIndex& sphere_offset : sphere_offsets) {
+    createSphereLayer(2, sphere_offset);
+  }
+  config_.integrator_threads = 1u;
+  config_.clear_sphere_radius = 0.3;
+  config_.occupied_sphere_radius = 0.6;
+  EsdfIntegrator esdf_integrator(config_, tsdf_layer_.get(),
+                                 esdf_layer_.get());
+  Layer<EsdfVoxel> parallel_esdf_layer(kVoxelSize, kVoxelsPerSide);
+  config_.integrator_threads = 4u;
+  config_.parallel_incremental_update = true;
+  EsdfIntegrator parallel_esdf_integrator(config_, tsdf_layer_.get(),
+                                          &parallel_esdf_layer);
+  esdf_integrator.updateFromTsdfLayerBatch();
+  parallel_esdf_integrator.updateFromTsdfLayerBatch();
+  expectSameEsdfLayers(*esdf_layer_, parallel_esdf_layer);
+
+  // Grows the spheres in half of their blocks and shrinks them back, which
+  // lowers and raises the distances around them. The last update only
+  // touches one sphere, which is a single region.
+  BlockIndexList block_indices;
+  tsdf_layer_->getAllAllocatedBlocks(&block_indices);
+  BlockIndexList updated_blocks;
+  BlockIndexList single_sphere_blocks;
+  for (const BlockIndex& block_index : block_indices) {
+    if (block_index.x() % 12 >= 0 && block_index.x() % 12 < 2) {
+      updated_blocks.push_back(block_index);
+      if (block_index.x() < 6 && block_index.y() < 6) {
+        single_sphere_blocks.push_back(block_index);
+      }
+    }
+  }
+  // Robot positions next to two of the spheres leave voxels in the open set
+  // for the next update.
+  const FloatingPoint block_size = kVoxelSize * kVoxelsPerSide;
+  for (EsdfIntegrator* integrator :
+       {&esdf_integrator, &parallel_esdf_integrator}) {
+    integrator->addNewRobotPosition(kCenter + Point(0.0, 0.0, -0.7));
+    integrator->addNewRobotPosition(kCenter +
+                                    Point(12.0 * block_size, -0.7, 0.0));
+  }
+  for (const FloatingPoint offset :
+       {-2.0 * kVoxelSize, 2.0 * kVoxelSize, 1.0 * kVoxelSize}) {
+    const BlockIndexList& blocks =
+        (offset < 1.5 * kVoxelSize) ? updated_blocks : single_sphere_blocks;
+    for (const BlockIndex& block_index : blocks) {
+      Block<TsdfVoxel>& block = tsdf_layer_->getBlockByIndex(block_index);
+      for (size_t i = 0u; i < block.num_voxels(); ++i) {
+        block.getVoxelByLinearIndex(i).distance += offset;
+      }
+    }
+    esdf_integrator.updateFromTsdfBlocks(blocks);
+    parallel_esdf_integrator.updateFromTsdfBlocks(blocks);
+    expectSameEsdfLayers(*esdf_layer_, parallel_esdf_layer);
+  }
+}
+
+TEST_F(EsdfIntegratorTest, ParallelIncrementalUpdateLeavingRegion) {
+  createSphereLayer(2);
+  createSphereLayer(2, BlockIndex(0, 12, 0));
+  config_.integrator_threads = 1u;
+  EsdfIntegrator esdf_integrator(config_, tsdf_layer_.get(),
+                                 esdf_layer_.get());
+  Layer<EsdfVoxel> parallel_esdf_layer(kVoxelSize, kVoxelsPerSide);
+  config_.integrator_threads = 4u;
+  config_.parallel_incremental_update = true;
+  EsdfIntegrator parallel_esdf_integrator(config_, tsdf_layer_.get(),
+                                          &parallel_esdf_layer);
+  esdf_integrator.updateFromTsdfLayerBatch();
+  parallel_esdf_integrator.updateFromTsdfLayerBatch();
+
+  // A fixed voxel of the first sphere is the parent of a chain of voxels
+  // along x that reaches far beyond its region.
+  const VoxelIndex surface_index = getGridIndexFromPoint(
+      kCenter + Point(kRadius, 0.0, 0.0), 1.0 / kVoxelSize);
+  TsdfVoxel* tsdf_voxel = tsdf_layer_->getVoxelPtrByGlobalIndex(surface_index);
+  ASSERT_TRUE(tsdf_voxel != nullptr);
+  ASSERT_TRUE(esdf_integrator.isFixed(tsdf_voxel->distance));
+  const int kChainLength = 10 * kVoxelsPerSide;
+  for (Layer<EsdfVoxel>* layer : {esdf_layer_.get(), &parallel_esdf_layer}) {
+    for (int i = 1; i <= kChainLength; ++i) {
+      const VoxelIndex global_index = surface_index + VoxelIndex(i, 0, 0);
+      layer->allocateBlockPtrByIndex(getBlockIndexFromGlobalVoxelIndex(
+          global_index, 1.0 / kVoxelsPerSide));
+      EsdfVoxel* voxel = layer->getVoxelPtrByGlobalIndex(global_index);
+      voxel->distance = i * kVoxelSize;
+      voxel->observed = true;
+      voxel->fixed = false;
+      voxel->parent = ParentOffset(-1, 0, 0);
+    }
+  }
+
+  // Unfixing the voxel raises the whole chain, so the parallel update falls
+  // back to the serial one.
+  tsdf_voxel->distance = 0.9 * kTruncationDistance;
+  const BlockIndexList updated_blocks = {
+      getBlockIndexFromGlobalVoxelIndex(surface_index, 1.0 / kVoxelsPerSide),
+      BlockIndex(0, 12, 0)};
+  esdf_integrator.updateFromTsdfBlocks(updated_blocks);
+  parallel_esdf_integrator.updateFromTsdfBlocks(updated_blocks);
+  expectSameEsdfLayers(*esdf_layer_, parallel_esdf_layer);
+  const EsdfVoxel* chain_end = parallel_esdf_layer.getVoxelPtrByGlobalIndex(
+      surface_index + VoxelIndex(kChainLength, 0, 0));
+  ASSERT_TRUE(chain_end != nullptr);
+  EXPECT_EQ(chain_end->distance, config_.default_distance_m);
+}
+
+TEST_F(EsdfIntegratorTest, FullEuclideanIncrementalUpdate) {
+  createSphereLayer(2);
+  config_.integrator_threads = 1u;
+  config_.full_euclidean_distance = true;
+  EsdfIntegrator esdf_integrator(config_, tsdf_layer_.get(),
+                                 esdf_layer_.get());
+  Layer<EsdfVoxel> batch_esdf_layer(kVoxelSize, kVoxelsPerSide);
+  EsdfIntegrator batch_esdf_integrator(config_, tsdf_layer_.get(),
+                                       &batch_esdf_layer);
+  esdf_integrator.updateFromTsdfLayerBatch();
+
+  // Grows the sphere in half of the blocks and shrinks it back, which lowers
+  // and raises the distances around them.
+  BlockIndexList block_indices;
+  tsdf_layer_->getAllAllocatedBlocks(&block_indices);
+  BlockIndexList updated_blocks;
+  for (const BlockIndex& block_index : block_indices) {
+    if (block_index.x() >= 0) {
+      updated_blocks.push_back(block_index);
+    }
+  }
+  for (const FloatingPoint offset :
+       {0.0, -2.0 * kVoxelSize, 2.0 * kVoxelSize}) {
+    if (offset != 0.0) {
+      for (const BlockIndex& block_index : updated_blocks) {
+        Block<TsdfVoxel>& block = tsdf_layer_->getBlockByIndex(block_index);
+        for (size_t i = 0u; i < block.num_voxels(); ++i) {
+          block.getVoxelByLinearIndex(i).distance += offset;
+        }
+      }
+      esdf_integrator.updateFromTsdfBlocks(updated_blocks);
+    }
+    batch_esdf_integrator.updateFromTsdfLayerBatch();
+
+    for (const BlockIndex& block_index : block_indices) {
+      const Block<EsdfVoxel>& block = esdf_layer_->getBlockByIndex(block_index);
+      const Block<EsdfVoxel>& batch_block =
+          batch_esdf_layer.getBlockByIndex(block_index);
+      for (size_t i = 0u; i < block.num_voxels(); ++i) {
+        const EsdfVoxel& voxel = block.getVoxelByLinearIndex(i);
+        const EsdfVoxel& batch_voxel = batch_block.getVoxelByLinearIndex(i);
+        EXPECT_EQ(voxel.fixed, batch_voxel.fixed);
+        EXPECT_FALSE(voxel.in_queue);
+        if (!voxel.fixed && std::abs(voxel.distance) < config_.max_distance_m) {
+          // The parent points to the site the distance is measured from.
+          const VoxelIndex site_index =
+              block_index * static_cast<IndexElement>(kVoxelsPerSide) +
+              block.computeVoxelIndexFromLinearIndex(i) +
+              voxel.parent.cast<IndexElement>();
+          const EsdfVoxel* site_voxel =
+              esdf_layer_->getVoxelPtrByGlobalIndex(site_index);
+          ASSERT_TRUE(site_voxel != nullptr);
+          EXPECT_TRUE(site_voxel->fixed);
+          EXPECT_NEAR(voxel.distance,
+                      site_voxel->distance +
+                          signum(voxel.distance) *
+                              voxel.parent.cast<FloatingPoint>().norm() *
+                              kVoxelSize,
+                      1e-4);
+        }
+
+        // Away from the surface, the distances follow the sphere, also where
+        // the quasi-Euclidean steps of the default update would not.
+        const FloatingPoint distance =
+            getSphereDistance(block.computeCoordinatesFromLinearIndex(i));
+        if (offset == 0.0 && !voxel.fixed &&
+            std::abs(distance) < 0.8 * config_.max_distance_m) {
+          EXPECT_NEAR(voxel.distance, distance, kVoxelSize);
+        }
+        // Sites that are about equally close may win in a different order.
+        EXPECT_NEAR(voxel.distance, batch_voxel.distance, 0.2 * kVoxelSize);
+      }
+    }
+  }
+}
+
+TEST_F(EsdfIntegratorTest, RobotPositionSpheres) {
+  config_.clear_sphere_radius = 0.3;
+  config_.occupied_sphere_radius = 0.6;
+  EsdfIntegrator esdf_integrator(config_, tsdf_layer_.get(),
+                                 esdf_layer_.get());
+  // An observed voxel inside both spheres is left alone.
+  const Point position(0.12, -0.31, 0.04);
+  const VoxelIndex center_index =
+      getGridIndexFromPoint(position, 1.0 / kVoxelSize);
+  const VoxelIndex observed_index = center_index + VoxelIndex(1, 2, 0);
+  esdf_layer_->allocateBlockPtrByIndex(getBlockIndexFromGlobalVoxelIndex(
+      observed_index, 1.0 / kVoxelsPerSide));
+  EsdfVoxel* observed_voxel =
+      esdf_layer_->getVoxelPtrByGlobalIndex(observed_index);
+  ASSERT_TRUE(observed_voxel != nullptr);
+  observed_voxel->observed = true;
+  observed_voxel->distance = 0.01;
+
+  esdf_integrator.addNewRobotPosition(position);
+
+  BlockIndexList block_indices;
+  esdf_layer_->getAllAllocatedBlocks(&block_indices);
+  size_t num_free = 0u;
+  size_t num_occupied = 0u;
+  for (const BlockIndex& block_index : block_indices) {
+    const Block<EsdfVoxel>& block = esdf_layer_->getBlockByIndex(block_index);
+    for (size_t i = 0u; i < block.num_voxels(); ++i) {
+      const VoxelIndex voxel_index =
+          block_index * static_cast<IndexElement>(kVoxelsPerSide) +
+          block.computeVoxelIndexFromLinearIndex(i);
+      const EsdfVoxel& voxel = block.getVoxelByLinearIndex(i);
+      if (voxel_index == observed_index) {
+        EXPECT_EQ(voxel.distance, 0.01f);
+        continue;
+      }
+      const FloatingPoint distance =
+          (voxel_index - center_index).cast<FloatingPoint>().norm() *
+          kVoxelSize;
+      EXPECT_EQ(voxel.observed,
+                distance <= config_.occupied_sphere_radius + 1e-4);
+      if (!voxel.observed) {
+        continue;
+      }
+      if (distance <= config_.clear_sphere_radius + 1e-4) {
+        EXPECT_EQ(voxel.distance, config_.default_distance_m);
+        ++num_free;
+      } else {
+        EXPECT_EQ(voxel.distance, -config_.default_distance_m);
+        ++num_occupied;
+      }
+    }
+  }
+  EXPECT_GT(num_free, 0u);
+  EXPECT_GT(num_occupied, num_free);
+}
+
+TEST_F(EsdfIntegratorTest, LocalWindow) {
+  createSphereLayer(2);
+  config_.integrator_threads = 1u;
+  EsdfIntegrator esdf_integrator(config_, tsdf_layer_.get(),
+                                 esdf_layer_.get());
+  esdf_integrator.updateFromTsdfLayerBatchExact();
+
+  EsdfWindowIntegrator::Config window_config;
+  window_config.radius_m = 0.6;
+  window_config.min_distance_m = config_.min_distance_m;
+  window_config.max_distance_m = config_.max_distance_m;
+  window_config.default_distance_m = config_.default_distance_m;
+  EsdfWindowIntegrator window_integrator(window_config, tsdf_layer_.get());
+  const BlockIndexList no_blocks;
+  window_integrator.updateFromTsdfBlocks(kCenter, no_blocks);
+  const int voxels_per_side = window_integrator.getWindowVoxelsPerSide();
+  EXPECT_EQ(voxels_per_side, 25);
+
+  // Where the nearest fixed voxel of the whole map is inside the window, the
+  // window has the exact distances of the map.
+  const AnyIndex origin = window_integrator.getWindowOrigin();
+  size_t num_checked = 0u;
+  AnyIndex index;
+  for (index.z() = 0; index.z() < voxels_per_side; ++index.z()) {
+    for (index.y() = 0; index.y() < voxels_per_side; ++index.y()) {
+      for (index.x() = 0; index.x() < voxels_per_side; ++index.x()) {
+        const AnyIndex global_index = origin + index;
+        const EsdfVoxel* window_voxel =
+            window_integrator.getVoxelPtrByGlobalIndex(global_index);
+        ASSERT_TRUE(window_voxel != nullptr);
+        const EsdfVoxel* voxel =
+            esdf_layer_->getVoxelPtrByGlobalIndex(global_index);
+        ASSERT_TRUE(voxel != nullptr);
+        ASSERT_EQ(window_voxel->observed, voxel->observed);
+        EXPECT_EQ(window_voxel->fixed, voxel->fixed);
+        const AnyIndex site = global_index + voxel->parent.cast<IndexElement>();
+        if (std::abs(voxel->distance) >= config_.max_distance_m ||
+            !window_integrator.getVoxelPtrByGlobalIndex(site)) {
+          continue;
+        }
+        EXPECT_NEAR(window_voxel->distance, voxel->distance, kVoxelSize);
+
+        FloatingPoint distance = 0.0;
+        EXPECT_TRUE(window_integrator.getDistanceAtPosition(
+            getCenterPointFromGridIndex(global_index, kVoxelSize), &distance));
+        EXPECT_EQ(distance, window_voxel->distance);
+        ++num_checked;
+      }
+    }
+  }
+  EXPECT_GT(num_checked, 0u);
+
+  // Next to the sphere, the gradient points away from its center.
+  const Point outside_point = kCenter + Point(kRadius + 0.15, 0.0, 0.0);
+  FloatingPoint distance = 0.0;
+  Point gradient;
+  ASSERT_TRUE(window_integrator.getDistanceAndGradientAtPosition(
+      outside_point, &distance, &gradient));
+  EXPECT_NEAR(distance, 0.15, kVoxelSize);
+  EXPECT_NEAR(gradient.x(), 1.0, 0.2);
+  EXPECT_NEAR(gradient.y(), 0.0, 0.2);
+  EXPECT_NEAR(gradient.z(), 0.0, 0.2);
+  EXPECT_FALSE(window_integrator.getDistanceAtPosition(
+      kCenter + Point(1.0, 0.0, 0.0), &distance));
+
+  // Moving the window in steps and changing a TSDF block inside of it gives
+  // the same window as a new one at the last position.
+  const Point step(0.1, -0.05, 0.15);
+  Point position = kCenter;
+  for (int i = 0; i < 3; ++i) {
+    position += step;
+    window_integrator.updateFromTsdfBlocks(position, no_blocks);
+  }
+  BlockIndexList changed_blocks;
+  changed_blocks.push_back(
+      tsdf_layer_->computeBlockIndexFromCoordinates(position));
+  Block<TsdfVoxel>& changed_block =
+      tsdf_layer_->getBlockByIndex(changed_blocks.front());
+  for (size_t i = 0u; i < changed_block.num_voxels(); ++i) {
+    changed_block.getVoxelByLinearIndex(i).weight = 0.0;
+  }
+  window_integrator.updateFromTsdfBlocks(position, changed_blocks);
+
+  EsdfWindowIntegrator new_window_integrator(window_config, tsdf_layer_.get());
+  new_window_integrator.updateFromTsdfBlocks(position, no_blocks);
+  const AnyIndex new_origin = new_window_integrator.getWindowOrigin();
+  ASSERT_EQ(window_integrator.getWindowOrigin(), new_origin);
+  EXPECT_NE(new_origin, origin);
+  for (index.z() = 0; index.z() < voxels_per_side; ++index.z()) {
+    for (index.y() = 0; index.y() < voxels_per_side; ++index.y()) {
+      for (index.x() = 0; index.x() < voxels_per_side; ++index.x()) {
+        const EsdfVoxel& voxel =
+            *window_integrator.getVoxelPtrByGlobalIndex(new_origin + index);
+        const EsdfVoxel& new_voxel =
+            *new_window_integrator.getVoxelPtrByGlobalIndex(new_origin +
+                                                            index);
+        ASSERT_EQ(voxel.observed, new_voxel.observed);
+        EXPECT_EQ(voxel.fixed, new_voxel.fixed);
+        EXPECT_EQ(voxel.distance, new_voxel.distance);
+        EXPECT_EQ(voxel.parent, new_voxel.parent);
+      }
+    }
+  }
+}
+
+TEST_F(EsdfIntegratorTest, BatchedDistanceAndGradientQueries) {
+  createSphereLayer(2);
+  EsdfMap::Config map_config;
+  map_config.esdf_voxel_size = kVoxelSize;
+  map_config.esdf_voxels_per_side = kVoxelsPerSide;
+  EsdfMap esdf_map(map_config);
+  EsdfIntegrator esdf_integrator(config_, tsdf_layer_.get(),
+                                 esdf_map.getEsdfLayerPtr());
+  esdf_integrator.updateFromTsdfLayerBatch();
+
+  // Points all over the map and beyond it, in no particular order.
+  constexpr int kNumPoints = 2000;
+  std::mt19937 generator(0u);
+  std::uniform_real_distribution<double> coordinate(-1.0, 1.0);
+  Eigen::Matrix3Xd positions(3, kNumPoints);
+  for (int i = 0; i < kNumPoints; ++i) {
+    positions.col(i) << coordinate(generator), coordinate(generator),
+        coordinate(generator);
+  }
+
+  Eigen::VectorXd distances;
+  Eigen::Matrix3Xd gradients;
+  Eigen::VectorXi observed;
+  esdf_map.batchGetDistanceAndGradientAtPosition(positions, &distances,
+                                                 &gradients, &observed);
+  ASSERT_EQ(distances.size(), kNumPoints);
+  ASSERT_EQ(gradients.cols(), kNumPoints);
+  ASSERT_EQ(observed.size(), kNumPoints);
+  int num_observed = 0;
+  for (int i = 0; i < kNumPoints; ++i) {
+    double distance = 0.0;
+    Eigen::Vector3d gradient = Eigen::Vector3d::Zero();
+    const bool success = esdf_map.getDistanceAndGradientAtPosition(
+        positions.col(i), &distance, &gradient);
+    ASSERT_EQ(observed(i), success ? 1 : 0);
+    if (success) {
+      EXPECT_EQ(distances(i), distance);
+      EXPECT_EQ(gradients.col(i), gradient);
+      ++num_observed;
+    } else {
+      EXPECT_EQ(distances(i), 0.0);
+      EXPECT_TRUE(gradients.col(i).isZero());
+    }
+  }
+  EXPECT_GT(num_observed, kNumPoints / 4);
+  EXPECT_LT(num_observed, kNumPoints);
+}
+
+TEST_F(EsdfIntegratorTest, OccupancyIncrementalUpdate) {
+  // A solid ball, observed in all blocks with an index in [-2, 2).
+  Layer<OccupancyVoxel> occ_layer(kVoxelSize, kVoxelsPerSide);
+  auto fill_ball = [&occ_layer](const Point& center) {
+    for (int x = -2; x < 2; ++x) {
+      for (int y = -2; y < 2; ++y) {
+        for (int z = -2; z < 2; ++z) {
+          Block<OccupancyVoxel>::Ptr block =
+              occ_layer.allocateBlockPtrByIndex(BlockIndex(x, y, z));
+          for (size_t i = 0u; i < block->num_voxels(); ++i) {
+            OccupancyVoxel& voxel = block->getVoxelByLinearIndex(i);
+            const Point point = block->computeCoordinatesFromLinearIndex(i);
+            voxel.probability_log =
+                ((point - center).norm() < kRadius) ? 1.0 : -1.0;
+            voxel.observed = true;
+          }
+          block->updated() = true;
+        }
+      }
+    }
+  };
+  fill_ball(kCenter);
+
+  EsdfOccIntegrator::Config occ_config;
+  occ_config.max_distance_m = 1.0;
+  occ_config.default_distance_m = 1.0;
+  occ_config.integrator_threads = 1u;
+  Layer<EsdfVoxel> serial_esdf_layer(kVoxelSize, kVoxelsPerSide);
+  EsdfOccIntegrator serial_esdf_integrator(occ_config, &occ_layer,
+                                           &serial_esdf_layer);
+  serial_esdf_integrator.updateFromOccLayerBatchExact();
+  occ_config.integrator_threads = 4u;
+  Layer<EsdfVoxel> batch_esdf_layer(kVoxelSize, kVoxelsPerSide);
+  EsdfOccIntegrator batch_esdf_integrator(occ_config, &occ_layer,
+                                          &batch_esdf_layer);
+  batch_esdf_integrator.updateFromOccLayerBatchExact();
+  Layer<EsdfVoxel> quasi_esdf_layer(kVoxelSize, kVoxelsPerSide);
+  EsdfOccIntegrator quasi_esdf_integrator(occ_config, &occ_layer,
+                                          &quasi_esdf_layer);
+  quasi_esdf_integrator.updateFromOccLayerBatch();
+
+  BlockIndexList block_indices;
+  occ_layer.getAllAllocatedBlocks(&block_indices);
+  for (const BlockIndex& block_index : block_indices) {
+    const Block<EsdfVoxel>& block =
+        batch_esdf_layer.getBlockByIndex(block_index);
+    const Block<EsdfVoxel>& serial_block =
+        serial_esdf_layer.getBlockByIndex(block_index);
+    const Block<EsdfVoxel>& quasi_block =
+        quasi_esdf_layer.getBlockByIndex(block_index);
+    for (size_t i = 0u; i < block.num_voxels(); ++i) {
+      const EsdfVoxel& voxel = block.getVoxelByLinearIndex(i);
+      EXPECT_EQ(voxel.distance, serial_block.getVoxelByLinearIndex(i).distance);
+      EXPECT_TRUE(voxel.parent ==
+                  serial_block.getVoxelByLinearIndex(i).parent);
+      // The quasi-Euclidean steps only overestimate the distances.
+      EXPECT_LE(voxel.distance,
+                quasi_block.getVoxelByLinearIndex(i).distance + 1e-4);
+
+      const FloatingPoint distance =
+          getSphereDistance(block.computeCoordinatesFromLinearIndex(i));
+      if (distance > 0.0 && distance < 0.8 * occ_config.max_distance_m) {
+        EXPECT_NEAR(voxel.distance, distance, kVoxelSize);
+      }
+    }
+  }
+
+  // Moves the ball back and forth, and also starts from an empty layer.
+  Layer<EsdfVoxel> esdf_layer(kVoxelSize, kVoxelsPerSide);
+  EsdfOccIntegrator esdf_integrator(occ_config, &occ_layer, &esdf_layer);
+  serial_esdf_integrator.updateFromOccLayer(true);
+  for (const FloatingPoint offset : {3.0 * kVoxelSize, -3.0 * kVoxelSize}) {
+    fill_ball(kCenter + Point(offset, 0.5 * offset, 0.0));
+    serial_esdf_integrator.updateFromOccLayer(false);
+    esdf_integrator.updateFromOccLayer(true);
+    batch_esdf_integrator.updateFromOccLayerBatchExact();
+
+    for (const BlockIndex& block_index : block_indices) {
+      const Block<EsdfVoxel>& batch_block =
+          batch_esdf_layer.getBlockByIndex(block_index);
+      for (const Layer<EsdfVoxel>* layer : {&serial_esdf_layer, &esdf_layer}) {
+        const Block<EsdfVoxel>& block = layer->getBlockByIndex(block_index);
+        for (size_t i = 0u; i < block.num_voxels(); ++i) {
+          const EsdfVoxel& voxel = block.getVoxelByLinearIndex(i);
+          const EsdfVoxel& batch_voxel = batch_block.getVoxelByLinearIndex(i);
+          EXPECT_EQ(voxel.fixed, batch_voxel.fixed);
+          EXPECT_FALSE(voxel.in_queue);
+          // Sites that are about equally close may win in a different order.
+          EXPECT_NEAR(voxel.distance, batch_voxel.distance, 0.2 * kVoxelSize);
+        }
+      }
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+
+  int result = RUN_ALL_TESTS();
+
+  return result;
+}
@@ -0,0 +1,591 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "voxblox/core/common.h"
+#include "voxblox/core/layer.h"
+#include "voxblox/core/voxel.h"
+#include "voxblox/mesh/lod_mesh_integrator.h"
+#include "voxblox/mesh/mesh_integrator.h"
+#include "voxblox/mesh/mesh_layer.h"
+
+using namespace voxblox;  // NOLINT
+
+class MeshIntegratorTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    createSphereLayer(kVoxelSize, kVoxelsPerSide, 3);
+  }
+
+  // A sphere spanning several blocks in every direction.
+  void createSphereLayer(FloatingPoint voxel_size, size_t voxels_per_side,
+                         int half_index_range) {
+    tsdf_layer_.reset(new Layer<TsdfVoxel>(voxel_size, voxels_per_side));
+
+    const Point center(0.05, -0.1, 0.15);
+    const FloatingPoint radius = 0.6;
+    for (int x = -half_index_range; x < half_index_range; ++x) {
+      for (int y = -half_index_range; y < half_index_range; ++y) {
+        for (int z = -half_index_range; z < half_index_range; ++z) {
+          Block<TsdfVoxel>::Ptr block =
+              tsdf_layer_->allocateBlockPtrByIndex(BlockIndex(x, y, z));
+          for (size_t i = 0u; i < block->num_voxels(); ++i) {
+            const FloatingPoint distance =
+                (block->computeCoordinatesFromLinearIndex(i) - center).norm() -
+                radius;
+            if (std::abs(distance) > kTruncationDistance) {
+              continue;
+            }
+            TsdfVoxel& voxel = block->getVoxelByLinearIndex(i);
+            voxel.distance = distance;
+            voxel.weight = 1.0;
+            voxel.color = Color(static_cast<uint8_t>(i % 256), 128, 255);
+          }
+          block->has_data() = true;
+          block->updated() = true;
+        }
+      }
+    }
+  }
+
+  void generateMesh(size_t num_threads, bool only_updated,
+                    MeshLayer* mesh_layer) {
+    MeshIntegrator::Config config;
+    config.integrator_threads = num_threads;
+    MeshIntegrator mesh_integrator(config, tsdf_layer_.get(), mesh_layer);
+    if (only_updated) {
+      constexpr bool kClearUpdatedFlag = false;
+      mesh_integrator.generateMeshForUpdatedBlocks(kClearUpdatedFlag);
+    } else {
+      mesh_integrator.generateWholeMesh();
+    }
+  }
+
+  void compareMeshLayers(const MeshLayer& mesh_layer_1,
+                         const MeshLayer& mesh_layer_2) const {
+    BlockIndexList mesh_indices;
+    mesh_layer_1.getAllAllocatedMeshes(&mesh_indices);
+    EXPECT_EQ(mesh_layer_1.getNumberOfAllocatedMeshes(),
+              mesh_layer_2.getNumberOfAllocatedMeshes());
+    for (const BlockIndex& mesh_index : mesh_indices) {
+      const Mesh& mesh_1 = mesh_layer_1.getMeshByIndex(mesh_index);
+      const Mesh& mesh_2 = mesh_layer_2.getMeshByIndex(mesh_index);
+      ASSERT_EQ(mesh_1.vertices.size(), mesh_2.vertices.size());
+      ASSERT_EQ(mesh_1.indices.size(), mesh_2.indices.size());
+      ASSERT_EQ(mesh_1.normals.size(), mesh_2.normals.size());
+      ASSERT_EQ(mesh_1.colors.size(), mesh_2.colors.size());
+      for (size_t i = 0u; i < mesh_1.vertices.size(); ++i) {
+        EXPECT_EQ(mesh_1.vertices[i], mesh_2.vertices[i]);
+      }
+      for (size_t i = 0u; i < mesh_1.indices.size(); ++i) {
+        EXPECT_EQ(mesh_1.indices[i], mesh_2.indices[i]);
+      }
+      for (size_t i = 0u; i < mesh_1.normals.size(); ++i) {
+        EXPECT_EQ(mesh_1.normals[i], mesh_2.normals[i]);
+      }
+      for (size_t i = 0u; i < mesh_1.colors.size(); ++i) {
+        EXPECT_EQ(mesh_1.colors[i].r, mesh_2.colors[i].r);
+        EXPECT_EQ(mesh_1.colors[i].g, mesh_2.colors[i].g);
+        EXPECT_EQ(mesh_1.colors[i].b, mesh_2.colors[i].b);
+        EXPECT_EQ(mesh_1.colors[i].a, mesh_2.colors[i].a);
+      }
+    }
+  }
+
+  static FloatingPoint getMeshArea(const Mesh& mesh) {
+    FloatingPoint area = 0.0;
+    for (size_t i = 0u; i < mesh.indices.size(); i += 3u) {
+      const Point& p0 = mesh.vertices[mesh.indices[i]];
+      const Point& p1 = mesh.vertices[mesh.indices[i + 1]];
+      const Point& p2 = mesh.vertices[mesh.indices[i + 2]];
+      area += 0.5 * (p1 - p0).cross(p2 - p0).norm();
+    }
+    return area;
+  }
+
+  static constexpr FloatingPoint kVoxelSize = 0.05;
+  static constexpr size_t kVoxelsPerSide = 8u;
+  static constexpr FloatingPoint kTruncationDistance = 0.15;
+
+  std::unique_ptr<Layer<TsdfVoxel>> tsdf_layer_;
+};
+
+TEST_F(MeshIntegratorTest, ParallelWholeMesh) {
+  MeshLayer serial_mesh_layer(tsdf_layer_->block_size());
+  generateMesh(1u, false, &serial_mesh_layer);
+
+  size_t num_vertices = 0u;
+  BlockIndexList mesh_indices;
+  serial_mesh_layer.getAllAllocatedMeshes(&mesh_indices);
+  for (const BlockIndex& mesh_index : mesh_indices) {
+    num_vertices +=
+        serial_mesh_layer.getMeshByIndex(mesh_index).vertices.size();
+  }
+  EXPECT_GT(num_vertices, 0u);
+
+  for (const size_t num_threads : {2u, 4u, 7u}) {
+    MeshLayer parallel_mesh_layer(tsdf_layer_->block_size());
+    generateMesh(num_threads, false, &parallel_mesh_layer);
+    compareMeshLayers(serial_mesh_layer, parallel_mesh_layer);
+  }
+}
+
+TEST_F(MeshIntegratorTest, ParallelUpdatedBlocks) {
+  MeshLayer serial_mesh_layer(tsdf_layer_->block_size());
+  generateMesh(1u, true, &serial_mesh_layer);
+
+  MeshLayer parallel_mesh_layer(tsdf_layer_->block_size());
+  generateMesh(4u, true, &parallel_mesh_layer);
+  compareMeshLayers(serial_mesh_layer, parallel_mesh_layer);
+
+  // Only the updated blocks are meshed, and the flags are cleared afterwards.
+  BlockIndexList block_indices;
+  tsdf_layer_->getAllAllocatedBlocks(&block_indices);
+  for (size_t i = 0u; i < block_indices.size(); ++i) {
+    tsdf_layer_->getBlockByIndex(block_indices[i]).updated() = (i % 2u) == 0u;
+  }
+  MeshLayer updated_mesh_layer(tsdf_layer_->block_size());
+  MeshIntegrator::Config config;
+  config.integrator_threads = 4u;
+  MeshIntegrator mesh_integrator(config, tsdf_layer_.get(),
+                                 &updated_mesh_layer);
+  constexpr bool kClearUpdatedFlag = true;
+  mesh_integrator.generateMeshForUpdatedBlocks(kClearUpdatedFlag);
+  EXPECT_EQ(updated_mesh_layer.getNumberOfAllocatedMeshes(),
+            (block_indices.size() + 1u) / 2u);
+  for (const BlockIndex& block_index : block_indices) {
+    EXPECT_FALSE(tsdf_layer_->getBlockByIndex(block_index).updated());
+  }
+}
+
+TEST_F(MeshIntegratorTest, IndexedMesh) {
+  MeshIntegrator::Config config;
+  config.compute_normals = false;
+  MeshLayer mesh_layer(tsdf_layer_->block_size());
+  MeshIntegrator mesh_integrator(config, tsdf_layer_.get(), &mesh_layer);
+  mesh_integrator.generateWholeMesh();
+
+  config.use_indexed_mesh = true;
+  MeshLayer indexed_mesh_layer(tsdf_layer_->block_size());
+  MeshIntegrator indexed_mesh_integrator(config, tsdf_layer_.get(),
+                                         &indexed_mesh_layer);
+  indexed_mesh_integrator.generateWholeMesh();
+
+  // Both meshes must contain the same triangles, but the indexed one only
+  // stores every vertex once.
+  BlockIndexList mesh_indices;
+  mesh_layer.getAllAllocatedMeshes(&mesh_indices);
+  ASSERT_EQ(mesh_layer.getNumberOfAllocatedMeshes(),
+            indexed_mesh_layer.getNumberOfAllocatedMeshes());
+  size_t num_vertices = 0u;
+  size_t num_indexed_vertices = 0u;
+  for (const BlockIndex& mesh_index : mesh_indices) {
+    const Mesh& mesh = mesh_layer.getMeshByIndex(mesh_index);
+    const Mesh& indexed_mesh = indexed_mesh_layer.getMeshByIndex(mesh_index);
+    ASSERT_EQ(mesh.indices.size(), indexed_mesh.indices.size());
+    ASSERT_EQ(indexed_mesh.vertices.size(), indexed_mesh.normals.size());
+    ASSERT_EQ(indexed_mesh.vertices.size(), indexed_mesh.colors.size());
+    num_vertices += mesh.vertices.size();
+    num_indexed_vertices += indexed_mesh.vertices.size();
+
+    const FloatingPoint area = getMeshArea(mesh);
+    EXPECT_NEAR(getMeshArea(indexed_mesh), area, 1e-5 * area);
+  }
+  EXPECT_GT(num_indexed_vertices, 0u);
+  EXPECT_LT(4u * num_indexed_vertices, num_vertices);
+}
+
+TEST_F(MeshIntegratorTest, SlabKernel) {
+  // Also covers rows that are split into several bitmask segments.
+  for (const size_t voxels_per_side : {8u, 70u}) {
+    createSphereLayer(0.8 / voxels_per_side, voxels_per_side, 1);
+
+    MeshIntegrator::Config config;
+    MeshLayer mesh_layer(tsdf_layer_->block_size());
+    MeshIntegrator mesh_integrator(config, tsdf_layer_.get(), &mesh_layer);
+
+    BlockIndexList block_indices;
+    tsdf_layer_->getAllAllocatedBlocks(&block_indices);
+    size_t num_triangles = 0u;
+    for (const BlockIndex& block_index : block_indices) {
+      Block<TsdfVoxel>::ConstPtr block =
+          tsdf_layer_->getBlockPtrByIndex(block_index);
+      Mesh::Ptr mesh(new Mesh(tsdf_layer_->block_size(), block->origin()));
+      mesh_integrator.extractBlockMesh(block, mesh);
+      Mesh::Ptr reference_mesh(
+          new Mesh(tsdf_layer_->block_size(), block->origin()));
+      mesh_integrator.extractBlockMeshPerCube(block, reference_mesh);
+
+      // Same triangles, but in a different order.
+      EXPECT_EQ(mesh->vertices.size(), reference_mesh->vertices.size());
+      EXPECT_EQ(mesh->indices.size(), reference_mesh->indices.size());
+      const FloatingPoint area = getMeshArea(*reference_mesh);
+      EXPECT_NEAR(getMeshArea(*mesh), area, 1e-5 * area);
+      num_triangles += mesh->indices.size() / 3u;
+    }
+    EXPECT_GT(num_triangles, 0u);
+  }
+}
+
+TEST_F(MeshIntegratorTest, SubCellUpdates) {
+  MeshIntegrator::Config config;
+  config.use_sub_cell_updates = true;
+  config.integrator_threads = 2u;
+  MeshLayer mesh_layer(tsdf_layer_->block_size());
+  MeshIntegrator mesh_integrator(config, tsdf_layer_.get(), &mesh_layer);
+  constexpr bool kClearUpdatedFlag = true;
+  mesh_integrator.generateMeshForUpdatedBlocks(kClearUpdatedFlag);
+
+  // Meshing per sub-cell gives the same surface as meshing whole blocks.
+  MeshLayer block_mesh_layer(tsdf_layer_->block_size());
+  generateMesh(1u, false, &block_mesh_layer);
+  BlockIndexList mesh_indices;
+  block_mesh_layer.getAllAllocatedMeshes(&mesh_indices);
+  ASSERT_EQ(mesh_layer.getNumberOfAllocatedMeshes(),
+            block_mesh_layer.getNumberOfAllocatedMeshes());
+  for (const BlockIndex& mesh_index : mesh_indices) {
+    const Mesh& mesh = mesh_layer.getMeshByIndex(mesh_index);
+    EXPECT_EQ(mesh.indices.size(),
+              block_mesh_layer.getMeshByIndex(mesh_index).indices.size());
+    const FloatingPoint area =
+        getMeshArea(block_mesh_layer.getMeshByIndex(mesh_index));
+    EXPECT_NEAR(getMeshArea(mesh), area, 1e-5 * area);
+  }
+
+  // Move the surface on the min x face of a block, the cubes on the max x face
+  // of its neighbor depend on these voxels as well.
+  Block<TsdfVoxel>& block = tsdf_layer_->getBlockByIndex(BlockIndex(1, 0, 0));
+  VoxelIndex voxel_index(0, 0, 0);
+  const uint64_t block_version = getNextBlockVersion();
+  size_t num_updated_voxels = 0u;
+  for (voxel_index.y() = 0; voxel_index.y() < kVoxelsPerSide;
+       ++voxel_index.y()) {
+    for (voxel_index.z() = 0; voxel_index.z() < kVoxelsPerSide;
+         ++voxel_index.z()) {
+      TsdfVoxel& voxel = block.getVoxelByVoxelIndex(voxel_index);
+      if (voxel.weight > 0.0) {
+        voxel.distance += 0.02;
+        block.setUpdated(voxel_index, block_version);
+        ++num_updated_voxels;
+      }
+    }
+  }
+  ASSERT_GT(num_updated_voxels, 0u);
+  EXPECT_NE(block.dirty_sub_cells(), kAllSubCells);
+  mesh_integrator.generateMeshForUpdatedBlocks(kClearUpdatedFlag);
+  EXPECT_FALSE(block.updated());
+  EXPECT_EQ(block.dirty_sub_cells(), 0u);
+
+  MeshLayer full_mesh_layer(tsdf_layer_->block_size());
+  MeshIntegrator full_mesh_integrator(config, tsdf_layer_.get(),
+                                      &full_mesh_layer);
+  full_mesh_integrator.generateWholeMesh();
+  compareMeshLayers(full_mesh_layer, mesh_layer);
+}
+
+TEST_F(MeshIntegratorTest, GradientNormals) {
+  const Point center(0.05, -0.1, 0.15);
+  for (const bool use_indexed_mesh : {false, true}) {
+    MeshIntegrator::Config config;
+    config.use_indexed_mesh = use_indexed_mesh;
+    MeshLayer mesh_layer(tsdf_layer_->block_size());
+    MeshIntegrator mesh_integrator(config, tsdf_layer_.get(), &mesh_layer);
+    mesh_integrator.generateWholeMesh();
+
+    // The normals of a sphere point away from its center.
+    BlockIndexList mesh_indices;
+    mesh_layer.getAllAllocatedMeshes(&mesh_indices);
+    size_t num_vertices = 0u;
+    FloatingPoint min_cosine = 1.0;
+    for (const BlockIndex& mesh_index : mesh_indices) {
+      const Mesh& mesh = mesh_layer.getMeshByIndex(mesh_index);
+      ASSERT_EQ(mesh.vertices.size(), mesh.normals.size());
+      for (size_t i = 0u; i < mesh.vertices.size(); ++i) {
+        EXPECT_NEAR(mesh.normals[i].norm(), 1.0, 1e-5);
+        min_cosine = std::min(
+            min_cosine,
+            mesh.normals[i].dot((mesh.vertices[i] - center).normalized()));
+      }
+      num_vertices += mesh.vertices.size();
+    }
+    EXPECT_GT(num_vertices, 0u);
+    EXPECT_GT(min_cosine, 0.95);
+  }
+}
+
+TEST_F(MeshIntegratorTest, InterpolatedColors) {
+  // Red increases linearly along x, so it can be predicted at every vertex.
+  BlockIndexList block_indices;
+  tsdf_layer_->getAllAllocatedBlocks(&block_indices);
+  for (const BlockIndex& block_index : block_indices) {
+    Block<TsdfVoxel>& block = tsdf_layer_->getBlockByIndex(block_index);
+    for (size_t i = 0u; i < block.num_voxels(); ++i) {
+      const FloatingPoint x = block.computeCoordinatesFromLinearIndex(i).x();
+      block.getVoxelByLinearIndex(i).color =
+          Color(static_cast<uint8_t>(std::round(100.0 + 2.0 * x / kVoxelSize)),
+                128, 255);
+    }
+  }
+
+  for (const bool use_indexed_mesh : {false, true}) {
+    MeshIntegrator::Config config;
+    config.use_indexed_mesh = use_indexed_mesh;
+    MeshLayer mesh_layer(tsdf_layer_->block_size());
+    MeshIntegrator mesh_integrator(config, tsdf_layer_.get(), &mesh_layer);
+    mesh_integrator.generateWholeMesh();
+
+    BlockIndexList mesh_indices;
+    mesh_layer.getAllAllocatedMeshes(&mesh_indices);
+    size_t num_vertices = 0u;
+    for (const BlockIndex& mesh_index : mesh_indices) {
+      const Mesh& mesh = mesh_layer.getMeshByIndex(mesh_index);
+      ASSERT_EQ(mesh.vertices.size(), mesh.colors.size());
+      for (size_t i = 0u; i < mesh.vertices.size(); ++i) {
+        EXPECT_NEAR(mesh.colors[i].r,
+                    100.0 + 2.0 * mesh.vertices[i].x() / kVoxelSize, 1.0);
+        EXPECT_EQ(mesh.colors[i].g, 128);
+        EXPECT_EQ(mesh.colors[i].b, 255);
+        EXPECT_EQ(mesh.colors[i].a, 255);
+      }
+      num_vertices += mesh.vertices.size();
+    }
+    EXPECT_GT(num_vertices, 0u);
+  }
+}
+
+TEST_F(MeshIntegratorTest, LevelsOfDetail) {
+  MeshLayer reference_mesh_layer(tsdf_layer_->block_size());
+  generateMesh(1u, false, &reference_mesh_layer);
+
+  LodMeshIntegrator::Config config;
+  config.num_lods = 3u;
+  config.mesh_config.integrator_threads = 1u;
+  MeshLayer mesh_layer(tsdf_layer_->block_size());
+  LodMeshIntegrator lod_mesh_integrator(config, tsdf_layer_.get(),
+                                        &mesh_layer);
+  lod_mesh_integrator.generateWholeMesh();
+  ASSERT_EQ(mesh_layer.getNumberOfLods(), 3u);
+
+  // The full resolution level is the regular mesh.
+  compareMeshLayers(reference_mesh_layer, mesh_layer);
+
+  // The coarser levels approximate the same sphere with fewer triangles.
+  const Point center(0.05, -0.1, 0.15);
+  const FloatingPoint radius = 0.6;
+  const FloatingPoint sphere_area = 4.0 * M_PI * radius * radius;
+  size_t previous_num_vertices = std::numeric_limits<size_t>::max();
+  for (size_t lod = 0u; lod < mesh_layer.getNumberOfLods(); ++lod) {
+    const MeshLayer& lod_layer = mesh_layer.getLodLayer(lod);
+    const FloatingPoint voxel_size = kVoxelSize * (1u << lod);
+    BlockIndexList mesh_indices;
+    lod_layer.getAllAllocatedMeshes(&mesh_indices);
+    size_t num_vertices = 0u;
+    FloatingPoint area = 0.0;
+    for (const BlockIndex& mesh_index : mesh_indices) {
+      const Mesh& mesh = lod_layer.getMeshByIndex(mesh_index);
+      for (const Point& vertex : mesh.vertices) {
+        EXPECT_NEAR((vertex - center).norm(), radius, 0.5 * voxel_size);
+      }
+      num_vertices += mesh.vertices.size();
+      area += getMeshArea(mesh);
+    }
+    EXPECT_LT(num_vertices, previous_num_vertices);
+    // The truncation band is thinner than the coarsest voxels, so some of the
+    // coarse cubes have unobserved corners and leave holes.
+    EXPECT_NEAR(area, sphere_area, 0.05 * (1u << lod) * sphere_area);
+    previous_num_vertices = num_vertices;
+  }
+
+  // Blocks far away from the viewpoint get the coarser meshes.
+  const Point viewpoint(-1.2, -1.2, -1.2);
+  const std::vector<FloatingPoint> lod_distances = {1.0, 2.0};
+  std::vector<Mesh::ConstPtr> meshes;
+  mesh_layer.getMeshesForViewpoint(viewpoint, lod_distances, &meshes);
+  EXPECT_EQ(meshes.size(), mesh_layer.getNumberOfAllocatedMeshes());
+  size_t num_lods_used[3] = {0u, 0u, 0u};
+  for (const Mesh::ConstPtr& mesh : meshes) {
+    const BlockIndex block_index =
+        mesh_layer.computeBlockIndexFromCoordinates(
+            mesh->origin + Point::Constant(0.5 * mesh->block_size));
+    const size_t lod = mesh_layer.selectLod(block_index, viewpoint,
+                                            lod_distances);
+    EXPECT_EQ(mesh.get(),
+              mesh_layer.getLodLayer(lod).getMeshPtrByIndex(block_index).get());
+    ++num_lods_used[lod];
+  }
+  for (size_t lod = 0u; lod < 3u; ++lod) {
+    EXPECT_GT(num_lods_used[lod], 0u);
+  }
+
+  // Removing a TSDF block also removes it from the coarser levels.
+  const BlockIndex removed_index =
+      mesh_layer.getLodLayer(2u).computeBlockIndexFromCoordinates(
+          center + Point(radius, 0.0, 0.0));
+  ASSERT_TRUE(
+      lod_mesh_integrator.getLodTsdfLayer(2u).hasBlock(removed_index));
+  tsdf_layer_->removeBlock(removed_index);
+  lod_mesh_integrator.generateMeshForUpdatedBlocks(true);
+  for (size_t lod = 1u; lod < mesh_layer.getNumberOfLods(); ++lod) {
+    EXPECT_FALSE(
+        lod_mesh_integrator.getLodTsdfLayer(lod).hasBlock(removed_index));
+    BlockIndexList mesh_indices;
+    mesh_layer.getLodLayer(lod).getAllAllocatedMeshes(&mesh_indices);
+    EXPECT_EQ(std::count(mesh_indices.begin(), mesh_indices.end(),
+                         removed_index),
+              0);
+  }
+}
+
+TEST_F(MeshIntegratorTest, DualContouring) {
+  // A box with its faces half way between the voxel centers, so the zero
+  // crossings are exact. The sharp edges and corners fall between the voxels
+  // though, where the sampled SDF is smooth.
+  const Point box_min(-0.35, -0.2, -0.3);
+  const Point box_max(0.25, 0.4, 0.3);
+  const Point box_center = 0.5 * (box_min + box_max);
+  const Point box_half_size = 0.5 * (box_max - box_min);
+  tsdf_layer_.reset(new Layer<TsdfVoxel>(kVoxelSize, kVoxelsPerSide));
+  for (int x = -2; x < 2; ++x) {
+    for (int y = -2; y < 2; ++y) {
+      for (int z = -2; z < 2; ++z) {
+        Block<TsdfVoxel>::Ptr block =
+            tsdf_layer_->allocateBlockPtrByIndex(BlockIndex(x, y, z));
+        for (size_t i = 0u; i < block->num_voxels(); ++i) {
+          const Point q =
+              (block->computeCoordinatesFromLinearIndex(i) - box_center)
+                  .cwiseAbs() -
+              box_half_size;
+          const FloatingPoint distance =
+              q.cwiseMax(0.0).norm() + std::min(q.maxCoeff(), 0.0f);
+          if (std::abs(distance) > kTruncationDistance) {
+            continue;
+          }
+          TsdfVoxel& voxel = block->getVoxelByLinearIndex(i);
+          voxel.distance = distance;
+          voxel.weight = 1.0;
+        }
+        block->has_data() = true;
+      }
+    }
+  }
+
+  MeshIntegrator::Config config;
+  config.integrator_threads = 1u;
+  MeshLayer mesh_layer(tsdf_layer_->block_size());
+  MeshIntegrator mesh_integrator(config, tsdf_layer_.get(), &mesh_layer);
+  mesh_integrator.generateWholeMesh();
+
+  config.use_dual_contouring = true;
+  MeshLayer dual_mesh_layer(tsdf_layer_->block_size());
+  MeshIntegrator dual_mesh_integrator(config, tsdf_layer_.get(),
+                                      &dual_mesh_layer);
+  dual_mesh_integrator.generateWholeMesh();
+
+  config.use_indexed_mesh = true;
+  MeshLayer indexed_dual_mesh_layer(tsdf_layer_->block_size());
+  MeshIntegrator indexed_dual_mesh_integrator(config, tsdf_layer_.get(),
+                                              &indexed_dual_mesh_layer);
+  indexed_dual_mesh_integrator.generateWholeMesh();
+
+  const FloatingPoint box_area =
+      8.0 * (box_half_size.x() * box_half_size.y() +
+             box_half_size.y() * box_half_size.z() +
+             box_half_size.z() * box_half_size.x());
+  FloatingPoint box_corner_errors[2] = {0.0, 0.0};
+  const MeshLayer* mesh_layers[2] = {&mesh_layer, &dual_mesh_layer};
+  for (int i = 0; i < 2; ++i) {
+    BlockIndexList mesh_indices;
+    mesh_layers[i]->getAllAllocatedMeshes(&mesh_indices);
+    FloatingPoint area = 0.0;
+    AlignedVector<Point> vertices;
+    for (const BlockIndex& mesh_index : mesh_indices) {
+      const Mesh& mesh = mesh_layers[i]->getMeshByIndex(mesh_index);
+      area += getMeshArea(mesh);
+      vertices.insert(vertices.end(), mesh.vertices.begin(),
+                      mesh.vertices.end());
+      EXPECT_EQ(mesh.vertices.size(), mesh.normals.size());
+    }
+    EXPECT_NEAR(area, box_area, 0.1 * box_area);
+
+    for (int corner = 0; corner < 8; ++corner) {
+      const Point box_corner((corner & 1) ? box_max.x() : box_min.x(),
+                             (corner & 2) ? box_max.y() : box_min.y(),
+                             (corner & 4) ? box_max.z() : box_min.z());
+      FloatingPoint min_distance = std::numeric_limits<FloatingPoint>::max();
+      for (const Point& vertex : vertices) {
+        min_distance = std::min(min_distance, (vertex - box_corner).norm());
+      }
+      box_corner_errors[i] = std::max(box_corner_errors[i], min_distance);
+    }
+  }
+  // Marching cubes cuts off the edges and corners, the QEF vertices move
+  // towards them.
+  EXPECT_LT(box_corner_errors[1], 0.75 * box_corner_errors[0]);
+
+  // The dual mesh is closed and oriented outwards: every directed edge is
+  // used once in each direction. The vertices on the block borders are
+  // computed in both blocks, so they are merged by position.
+  AlignedVector<Point> unique_vertices;
+  size_t num_vertices = 0u;
+  size_t num_indexed_vertices = 0u;
+  std::map<std::pair<size_t, size_t>, int> edge_counts;
+  BlockIndexList mesh_indices;
+  dual_mesh_layer.getAllAllocatedMeshes(&mesh_indices);
+  for (const BlockIndex& mesh_index : mesh_indices) {
+    const Mesh& mesh = dual_mesh_layer.getMeshByIndex(mesh_index);
+    const Mesh& indexed_mesh = indexed_dual_mesh_layer.getMeshByIndex(
+        mesh_index);
+    EXPECT_EQ(mesh.indices.size(), indexed_mesh.indices.size());
+    num_vertices += mesh.vertices.size();
+    num_indexed_vertices += indexed_mesh.vertices.size();
+    const FloatingPoint area = getMeshArea(mesh);
+    EXPECT_NEAR(getMeshArea(indexed_mesh), area, 1e-5 * area);
+
+    std::vector<size_t> ids;
+    for (const Point& vertex : mesh.vertices) {
+      size_t id = 0u;
+      while (id < unique_vertices.size() &&
+             (unique_vertices[id] - vertex).norm() > 1e-5) {
+        ++id;
+      }
+      if (id == unique_vertices.size()) {
+        unique_vertices.push_back(vertex);
+      }
+      ids.push_back(id);
+    }
+    for (size_t i = 0u; i < mesh.indices.size(); i += 3u) {
+      const Point& p0 = mesh.vertices[mesh.indices[i]];
+      const Point& p1 = mesh.vertices[mesh.indices[i + 1]];
+      const Point& p2 = mesh.vertices[mesh.indices[i + 2]];
+      EXPECT_GT((p1 - p0).cross(p2 - p0).dot((p0 + p1 + p2) / 3.0 -
+                                             box_center),
+                0.0);
+      for (size_t j = 0u; j < 3u; ++j) {
+        ++edge_counts[std::make_pair(ids[mesh.indices[i + j]],
+                                     ids[mesh.indices[i + (j + 1) % 3]])];
+      }
+    }
+  }
+  EXPECT_GT(num_indexed_vertices, 0u);
+  EXPECT_LT(4u * num_indexed_vertices, num_vertices);
+  EXPECT_GT(edge_counts.size(), 0u);
+  for (const std::pair<const std::pair<size_t, size_t>, int>& edge_count :
+       edge_counts) {
+    EXPECT_EQ(edge_count.second, 1);
+    EXPECT_EQ(edge_counts.count(std::make_pair(edge_count.first.second,
+                                               edge_count.first.first)),
+              1u);
+  }
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+
+  int result = RUN_ALL_TESTS();
+
+  return result;
+}
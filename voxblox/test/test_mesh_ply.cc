@@ -0,0 +1,166 @@
+#include <cstdint>
+#include <cstring>
+#include <fstream>  // NOLINT
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "voxblox/core/common.h"
+#include "voxblox/io/mesh_ply.h"
+#include "voxblox/io/ply_writer.h"
+#include "voxblox/mesh/mesh_layer.h"
+
+using namespace voxblox;  // NOLINT
+
+class MeshPlyTest : public ::testing::Test {
+ protected:
+  struct PlyFile {
+    std::vector<std::string> header;
+    size_t num_vertices = 0u;
+    size_t num_faces = 0u;
+    std::string data;
+  };
+
+  virtual void SetUp() {
+    mesh_layer_.reset(new MeshLayer(1.0));
+    // Two blocks with a quad each, as indexed meshes.
+    for (int block = 0; block < 2; ++block) {
+      Mesh::Ptr mesh =
+          mesh_layer_->allocateMeshPtrByIndex(BlockIndex(block, 0, 0));
+      for (int i = 0; i < 4; ++i) {
+        mesh->vertices.emplace_back(block + 0.25 * i, 0.5 * (i % 2), 0.1);
+        mesh->colors.emplace_back(static_cast<uint8_t>(10 * i + block), 20,
+                                  30);
+      }
+      const VertexIndex indices[6] = {0u, 1u, 2u, 2u, 1u, 3u};
+      mesh->indices.assign(indices, indices + 6);
+    }
+  }
+
+  static bool readPlyFile(const std::string& filename, PlyFile* ply) {
+    std::ifstream stream(filename, std::ios::binary);
+    std::string line;
+    while (std::getline(stream, line)) {
+      ply->header.push_back(line);
+      std::istringstream line_stream(line);
+      std::string keyword, element;
+      size_t count;
+      if ((line_stream >> keyword >> element >> count) &&
+          keyword == "element") {
+        if (element == "vertex") {
+          ply->num_vertices = count;
+        } else if (element == "face") {
+          ply->num_faces = count;
+        }
+      }
+      if (line == "end_header") {
+        std::ostringstream data;
+        data << stream.rdbuf();
+        ply->data = data.str();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  std::unique_ptr<MeshLayer> mesh_layer_;
+};
+
+TEST_F(MeshPlyTest, BinaryMeshLayer) {
+  const std::string filename = "mesh_layer_test.ply";
+  ASSERT_TRUE(outputMeshLayerAsPly(filename, *mesh_layer_,
+                                   io::PlyFormat::kBinaryLittleEndian));
+
+  PlyFile ply;
+  ASSERT_TRUE(readPlyFile(filename, &ply));
+  EXPECT_EQ(ply.header[1], "format binary_little_endian 1.0");
+  ASSERT_EQ(ply.num_vertices, 8u);
+  ASSERT_EQ(ply.num_faces, 4u);
+  constexpr size_t kVertexSize = 3u * sizeof(float) + 3u;
+  constexpr size_t kFaceSize = 1u + 3u * sizeof(int32_t);
+  ASSERT_EQ(ply.data.size(),
+            ply.num_vertices * kVertexSize + ply.num_faces * kFaceSize);
+
+  // The vertices are written block by block, so the faces of the second
+  // block have to be offset by the vertices of the first one.
+  BlockIndexList mesh_indices;
+  mesh_layer_->getAllAllocatedMeshes(&mesh_indices);
+  const char* vertex_data = ply.data.data();
+  const char* face_data = vertex_data + ply.num_vertices * kVertexSize;
+  size_t vertex_offset = 0u;
+  for (const BlockIndex& block_index : mesh_indices) {
+    const Mesh& mesh = mesh_layer_->getMeshByIndex(block_index);
+    for (size_t i = 0u; i < mesh.vertices.size(); ++i) {
+      float xyz[3];
+      std::memcpy(xyz, vertex_data, sizeof(xyz));
+      EXPECT_EQ(mesh.vertices[i].x(), xyz[0]);
+      EXPECT_EQ(mesh.vertices[i].y(), xyz[1]);
+      EXPECT_EQ(mesh.vertices[i].z(), xyz[2]);
+      EXPECT_EQ(mesh.colors[i].r, static_cast<uint8_t>(vertex_data[12]));
+      EXPECT_EQ(mesh.colors[i].g, static_cast<uint8_t>(vertex_data[13]));
+      EXPECT_EQ(mesh.colors[i].b, static_cast<uint8_t>(vertex_data[14]));
+      vertex_data += kVertexSize;
+    }
+    for (size_t i = 0u; i < mesh.indices.size(); i += 3u) {
+      EXPECT_EQ(face_data[0], 3);
+      int32_t indices[3];
+      std::memcpy(indices, face_data + 1, sizeof(indices));
+      for (size_t j = 0u; j < 3u; ++j) {
+        EXPECT_EQ(indices[j], vertex_offset + mesh.indices[i + j]);
+      }
+      face_data += kFaceSize;
+    }
+    vertex_offset += mesh.vertices.size();
+  }
+}
+
+TEST_F(MeshPlyTest, HeaderCountPatchUp) {
+  for (const io::PlyFormat format :
+       {io::PlyFormat::kAscii, io::PlyFormat::kBinaryLittleEndian}) {
+    const std::string filename = "patch_up_test.ply";
+    {
+      io::PlyWriter writer(filename, format);
+      // Only an estimate, the writer fixes the counts up when closing.
+      const bool has_color = false;
+      writer.addVerticesWithProperties(1000u, has_color);
+      writer.addFaces(1u);
+      ASSERT_TRUE(writer.writeHeader());
+      for (int i = 0; i < 5; ++i) {
+        EXPECT_TRUE(writer.writeVertex(Point(i, 2 * i, 3 * i)));
+      }
+      for (int i = 0; i < 3; ++i) {
+        EXPECT_TRUE(writer.writeFace(i, i + 1, i + 2));
+      }
+      EXPECT_TRUE(writer.closeFile());
+    }
+
+    PlyFile ply;
+    ASSERT_TRUE(readPlyFile(filename, &ply));
+    EXPECT_EQ(ply.num_vertices, 5u);
+    EXPECT_EQ(ply.num_faces, 3u);
+    if (format == io::PlyFormat::kAscii) {
+      std::istringstream data(ply.data);
+      std::string line;
+      size_t num_lines = 0u;
+      while (std::getline(data, line)) {
+        ++num_lines;
+      }
+      EXPECT_EQ(num_lines, 8u);
+    } else {
+      EXPECT_EQ(ply.data.size(),
+                5u * 3u * sizeof(float) + 3u * (1u + 3u * sizeof(int32_t)));
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+
+  int result = RUN_ALL_TESTS();
+
+  return result;
+}
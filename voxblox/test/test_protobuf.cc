@@ -1,3 +1,4 @@
+#include <cmath>
 #include <iostream>  // NOLINT
 
 #include <gtest/gtest.h>
@@ -7,6 +8,8 @@
 #include "voxblox/core/block.h"
 #include "voxblox/core/layer.h"
 #include "voxblox/core/voxel.h"
+#include "voxblox/io/async_layer_saver.h"
+#include "voxblox/io/layer_checkpoint.h"
 #include "voxblox/io/layer_io.h"
 #include "voxblox/test/layer_test_utils.h"
 
@@ -82,6 +85,148 @@ TEST_F(ProtobufTsdfTest, BlockSerialization) {
   }
 }
 
+TEST_F(ProtobufTsdfTest, CompressedBlockSerialization) {
+  BlockIndexList block_index_list;
+  layer_->getAllAllocatedBlocks(&block_index_list);
+  for (const BlockIndex& index : block_index_list) {
+    Block<TsdfVoxel>::Ptr block = layer_->getBlockPtrByIndex(index);
+    ASSERT_NE(block.get(), nullptr);
+
+    BlockProto uncompressed_proto_block;
+    block->getProto(&uncompressed_proto_block);
+
+    // Convert to a compressed BlockProto.
+    BlockProto proto_block;
+    block->getProto(utils::getBestAvailableCompression(), &proto_block);
+    EXPECT_EQ(proto_block.voxel_data_size(), 0);
+    EXPECT_LT(proto_block.ByteSizeLong(),
+              uncompressed_proto_block.ByteSizeLong());
+
+    // Create from compressed BlockProto.
+    Block<TsdfVoxel> block_from_proto(proto_block);
+
+    CompareBlocks(*block, block_from_proto);
+  }
+}
+
+TEST(ProtobufQuantizedTsdfTest, BlockSerialization) {
+  constexpr FloatingPoint kTruncationDistance = 0.1;
+  Block<TsdfVoxel> block(8u, 0.02, Point(0.16, -0.32, 0.0));
+  for (size_t i = 0u; i < block.num_voxels(); ++i) {
+    // Leave every third voxel unobserved.
+    if ((i % 3u) == 0u) {
+      continue;
+    }
+    TsdfVoxel& voxel = block.getVoxelByLinearIndex(i);
+    voxel.distance =
+        kTruncationDistance * std::sin(0.1 * static_cast<FloatingPoint>(i));
+    voxel.weight = 0.5 + 0.25 * (i % 17u);
+    voxel.color.r = static_cast<uint8_t>(i % 255);
+    voxel.color.g = static_cast<uint8_t>((2 * i) % 255);
+    voxel.color.b = static_cast<uint8_t>((3 * i) % 255);
+    voxel.color.a = 255u;
+  }
+  block.has_data() = true;
+
+  BlockProto raw_proto_block;
+  block.getProto(&raw_proto_block);
+
+  for (const bool use_16_bit_distance : {false, true}) {
+    utils::QuantizationConfig config;
+    config.truncation_distance = kTruncationDistance;
+    config.use_16_bit_distance = use_16_bit_distance;
+    const FloatingPoint max_distance_error =
+        kTruncationDistance / (use_16_bit_distance ? 32767.0 : 127.0);
+
+    for (const utils::CompressionType compression :
+         {utils::CompressionType::kNone,
+          utils::getBestAvailableCompression()}) {
+      BlockProto proto_block;
+      block.getQuantizedProto(config, compression, &proto_block);
+      EXPECT_EQ(proto_block.encoding(),
+                static_cast<uint32_t>(utils::BlockEncoding::kQuantizedTsdf));
+      EXPECT_LT(proto_block.ByteSizeLong(), raw_proto_block.ByteSizeLong());
+
+      Block<TsdfVoxel> block_from_proto(proto_block);
+      EXPECT_EQ(block_from_proto.has_data(), block.has_data());
+      for (size_t i = 0u; i < block.num_voxels(); ++i) {
+        const TsdfVoxel& voxel = block.getVoxelByLinearIndex(i);
+        const TsdfVoxel& voxel_from_proto =
+            block_from_proto.getVoxelByLinearIndex(i);
+        EXPECT_NEAR(voxel.distance, voxel_from_proto.distance,
+                    max_distance_error);
+        // Weights are rounded to bfloat16, i.e. 8 significant bits.
+        EXPECT_NEAR(voxel.weight, voxel_from_proto.weight,
+                    voxel.weight / 256.0);
+        EXPECT_EQ(voxel.color.r, voxel_from_proto.color.r);
+        EXPECT_EQ(voxel.color.g, voxel_from_proto.color.g);
+        EXPECT_EQ(voxel.color.b, voxel_from_proto.color.b);
+        EXPECT_EQ(voxel.color.a, voxel_from_proto.color.a);
+      }
+    }
+  }
+
+  // Malformed data must be rejected.
+  std::vector<uint32_t> data;
+  utils::encodeQuantizedBlock(block, utils::QuantizationConfig(), &data);
+  Block<TsdfVoxel> block_from_data(8u, 0.02, Point(0.16, -0.32, 0.0));
+  EXPECT_TRUE(utils::decodeQuantizedBlock(data.data(), data.size(),
+                                          &block_from_data));
+  EXPECT_FALSE(utils::decodeQuantizedBlock(data.data(), data.size() / 2u,
+                                           &block_from_data));
+}
+
+TEST(ProtobufEsdfTest, BlockSerializationToBuffer) {
+  Block<EsdfVoxel> block(8u, 0.1, Point(0.8, -1.6, 0.0));
+  for (size_t i = 0u; i < block.num_voxels(); ++i) {
+    EsdfVoxel& voxel = block.getVoxelByLinearIndex(i);
+    voxel.distance = 0.01 * i;
+    voxel.observed = (i % 2u) == 0u;
+    voxel.fixed = (i % 3u) == 0u;
+    // Full parent offsets over the whole range, not only directions.
+    EXPECT_TRUE(setParentOffset(
+        Eigen::Vector3i(static_cast<int>(i % 255u) - 127,
+                        static_cast<int>((i * 7u) % 255u) - 127,
+                        static_cast<int>((i * 13u) % 5u) - 2),
+        &voxel));
+  }
+
+  // Offsets out of range are rejected instead of clamped.
+  EsdfVoxel far_voxel;
+  EXPECT_FALSE(setParentOffset(Eigen::Vector3i(1, -128, 0), &far_voxel));
+  EXPECT_TRUE(far_voxel.parent.isZero());
+
+  std::vector<uint32_t> buffer(block.num_voxels() *
+                               Block<EsdfVoxel>::getNumDataPacketsPerVoxel());
+  block.serializeToIntegers(buffer.data());
+  std::vector<uint32_t> data;
+  block.serializeToIntegers(&data);
+  EXPECT_EQ(buffer, data);
+
+  Block<EsdfVoxel> block_from_buffer(8u, 0.1, Point(0.8, -1.6, 0.0));
+  block_from_buffer.deserializeFromIntegers(buffer.data(), buffer.size());
+  for (size_t i = 0u; i < block.num_voxels(); ++i) {
+    const EsdfVoxel& voxel = block.getVoxelByLinearIndex(i);
+    const EsdfVoxel& voxel_from_buffer =
+        block_from_buffer.getVoxelByLinearIndex(i);
+    EXPECT_EQ(voxel.distance, voxel_from_buffer.distance);
+    EXPECT_EQ(voxel.observed, voxel_from_buffer.observed);
+    EXPECT_EQ(voxel.fixed, voxel_from_buffer.fixed);
+    EXPECT_EQ(voxel.parent, voxel_from_buffer.parent);
+  }
+
+  // Data in the older format, with one byte per flag and the signs of the
+  // parent direction, is still read.
+  const uint32_t old_format_data[2] = {0u, 0x19000101u};
+  Block<EsdfVoxel> old_format_block(1u, 0.1, Point::Zero());
+  old_format_block.deserializeFromIntegers(old_format_data, 2u);
+  const EsdfVoxel& old_format_voxel = old_format_block.getVoxelByLinearIndex(0);
+  EXPECT_TRUE(old_format_voxel.observed);
+  EXPECT_TRUE(old_format_voxel.in_queue);
+  EXPECT_FALSE(old_format_voxel.fixed);
+  EXPECT_EQ(old_format_voxel.parent.cast<int>(), Eigen::Vector3i(1, -1, 1));
+}
+
 TEST_F(ProtobufTsdfTest, LayerSerialization) {
   // Convert to LayerProto.
   LayerProto proto_layer;
@@ -174,6 +319,98 @@ TEST_F(ProtobufTsdfTest, LayerSubsetSerializationFromFile) {
   CompareLayers(*layer_, layer_with_blocks_from_file);
 }
 
+TEST_F(ProtobufTsdfTest, AsyncLayerSerializationToFile) {
+  const std::string file = "async_layer_test.tsdf.voxblox";
+
+  io::AsyncLayerSaver<TsdfVoxel>::Config config;
+  config.serialization_threads = 4u;
+  config.compression = utils::CompressionType::kRle;
+  io::AsyncLayerSaver<TsdfVoxel> saver(config);
+
+  size_t num_progress_calls = 0u;
+  io::AsyncLayerSaver<TsdfVoxel>::Progress last_progress;
+  ASSERT_TRUE(saver.saveLayer(
+      *layer_, file,
+      [&](const io::AsyncLayerSaver<TsdfVoxel>::Progress& progress) {
+        ++num_progress_calls;
+        last_progress = progress;
+      }));
+
+  // The snapshot was taken, so modifying the layer must not affect the file.
+  Layer<TsdfVoxel> layer_copy(voxel_size_, voxels_per_side_);
+  BlockIndexList block_index_list;
+  layer_->getAllAllocatedBlocks(&block_index_list);
+  for (const BlockIndex& index : block_index_list) {
+    BlockProto proto_block;
+    layer_->getBlockPtrByIndex(index)->getProto(&proto_block);
+    layer_copy.addBlockFromProto(
+        proto_block, Layer<TsdfVoxel>::BlockMergingStrategy::kProhibit);
+  }
+  layer_->removeAllBlocks();
+
+  ASSERT_TRUE(saver.wait());
+  EXPECT_FALSE(saver.isSaving());
+  EXPECT_EQ(num_progress_calls, block_index_list.size());
+  EXPECT_EQ(last_progress.blocks_written, block_index_list.size());
+  EXPECT_EQ(last_progress.num_blocks, block_index_list.size());
+
+  std::ifstream file_stream(file, std::ifstream::ate | std::ifstream::binary);
+  EXPECT_EQ(static_cast<size_t>(file_stream.tellg()),
+            saver.getProgress().bytes_written);
+
+  Layer<TsdfVoxel>::Ptr layer_from_file;
+  ASSERT_TRUE(io::LoadLayer<TsdfVoxel>(file, &layer_from_file));
+
+  CompareLayers(layer_copy, *layer_from_file);
+}
+
+TEST_F(ProtobufTsdfTest, IncrementalCheckpoints) {
+  const std::string file = "checkpoint_test.tsdf.voxblox";
+
+  io::LayerCheckpointer<TsdfVoxel> checkpointer(file);
+  ASSERT_TRUE(checkpointer.writeCheckpoint(*layer_));
+  EXPECT_EQ(checkpointer.getNumBlocksInLastCheckpoint(),
+            layer_->getNumberOfAllocatedBlocks());
+
+  // Nothing changed, so nothing should be written.
+  ASSERT_TRUE(checkpointer.writeCheckpoint(*layer_));
+  EXPECT_EQ(checkpointer.getNumBlocksInLastCheckpoint(), 0u);
+
+  // Update, remove and add one block each.
+  Block<TsdfVoxel>::Ptr updated_block =
+      layer_->getBlockPtrByIndex(BlockIndex(1, 2, 3));
+  updated_block->getVoxelByLinearIndex(7u).distance = 0.123;
+  updated_block->setUpdated();
+  layer_->removeBlock(BlockIndex(-2, 0, 4));
+  Block<TsdfVoxel>::Ptr new_block =
+      layer_->allocateNewBlock(BlockIndex(100, 100, 100));
+  new_block->getVoxelByLinearIndex(3u).weight = 2.0;
+  new_block->has_data() = true;
+
+  ASSERT_TRUE(checkpointer.writeCheckpoint(*layer_));
+  EXPECT_EQ(checkpointer.getNumBlocksInLastCheckpoint(), 3u);
+
+  // A second delta segment on top of the first one.
+  layer_->removeBlock(BlockIndex(100, 100, 100));
+  ASSERT_TRUE(checkpointer.writeCheckpoint(*layer_));
+  EXPECT_EQ(checkpointer.getNumBlocksInLastCheckpoint(), 1u);
+
+  Layer<TsdfVoxel>::Ptr layer_from_checkpoint;
+  ASSERT_TRUE(
+      io::LoadLayerCheckpoint<TsdfVoxel>(file, &layer_from_checkpoint));
+  CompareLayers(*layer_, *layer_from_checkpoint);
+
+  // After compaction the base file alone holds the latest state.
+  ASSERT_TRUE(io::CompactLayerCheckpoint<TsdfVoxel>(file));
+  std::ifstream delta_log(io::getCheckpointDeltaLogPath(file),
+                          std::ifstream::ate | std::ifstream::binary);
+  EXPECT_EQ(delta_log.tellg(), 0);
+
+  Layer<TsdfVoxel>::Ptr layer_from_base;
+  ASSERT_TRUE(io::LoadLayer<TsdfVoxel>(file, &layer_from_base));
+  CompareLayers(*layer_, *layer_from_base);
+}
+
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
   google::InitGoogleLogging(argv[0]);
@@ -3,6 +3,7 @@
 #include <gtest/gtest.h>
 
 #include "voxblox/core/tsdf_map.h"
+#include "voxblox/utils/voxel_extraction.h"
 
 using namespace voxblox;  // NOLINT
 
@@ -106,6 +107,50 @@ TEST_F(TsdfMapTest, ComputeBlockIndexFromOriginFromBlockIndexTest) {
   }
 }
 
+TEST_F(TsdfMapTest, ParallelVoxelExtraction) {
+  Layer<TsdfVoxel>* layer = map_->getTsdfLayerPtr();
+  for (int x = -3; x < 3; ++x) {
+    for (int y = -2; y < 2; ++y) {
+      Block<TsdfVoxel>::Ptr block =
+          layer->allocateBlockPtrByIndex(BlockIndex(x, y, x * y));
+      for (size_t i = 0u; i < block->num_voxels(); ++i) {
+        TsdfVoxel& voxel = block->getVoxelByLinearIndex(i);
+        voxel.weight = (i % 3 == 0) ? 1.0 : 0.0;
+        voxel.distance = 0.01 * i;
+      }
+    }
+  }
+
+  // Serial reference with the block accessors.
+  Pointcloud reference;
+  BlockIndexList block_indices;
+  layer->getAllAllocatedBlocks(&block_indices);
+  for (const BlockIndex& block_index : block_indices) {
+    const Block<TsdfVoxel>& block = layer->getBlockByIndex(block_index);
+    for (size_t i = 0u; i < block.num_voxels(); ++i) {
+      if (block.getVoxelByLinearIndex(i).weight > 0.0) {
+        reference.push_back(block.computeCoordinatesFromLinearIndex(i));
+      }
+    }
+  }
+  ASSERT_GT(reference.size(), 0u);
+
+  auto extractor = [](const TsdfVoxel& voxel, const Point& coord,
+                      Point* item) {
+    *item = coord;
+    return voxel.weight > 0.0;
+  };
+  for (const size_t num_threads : {1u, 2u, 5u, 100u}) {
+    Pointcloud points;
+    extractVoxelsFromLayer<TsdfVoxel, Point>(*layer, extractor, num_threads,
+                                             &points);
+    ASSERT_EQ(points.size(), reference.size());
+    for (size_t i = 0u; i < points.size(); ++i) {
+      EXPECT_EQ(points[i], reference[i]);
+    }
+  }
+}
+
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
   google::InitGoogleLogging(argv[0]);
@@ -11,6 +11,7 @@
 #include <voxblox/core/common.h>
 #include <voxblox/mesh/mesh.h>
 #include <voxblox/core/layer.h>
+#include <voxblox/utils/quantized_block_encoding.h>
 
 namespace voxblox {
 
@@ -66,10 +67,20 @@ inline void pointcloudToPclXYZ(const Pointcloud& ptcloud,
 }
 
 // Declarations
+// Serializes all (or only the updated) blocks of the layer. The voxel data of
+// every block is written directly into the preallocated message payload.
 template <typename VoxelType>
-void serializeLayerAsMsg(const Layer<VoxelType>& layer,
+void serializeLayerAsMsg(const Layer<VoxelType>& layer, bool only_updated,
                          voxblox_msgs::Layer* msg);
 
+// Same as above, but with the lossy and much smaller quantized block encoding,
+// see voxblox/utils/quantized_block_encoding.h. Only for TSDF layers.
+template <typename VoxelType>
+void serializeLayerAsQuantizedMsg(const Layer<VoxelType>& layer,
+                                  bool only_updated,
+                                  const utils::QuantizationConfig& config,
+                                  voxblox_msgs::Layer* msg);
+
 // Returns true if could parse the data into the existing layer (all parameters
 // are compatible), false otherwise.
 template <typename VoxelType>
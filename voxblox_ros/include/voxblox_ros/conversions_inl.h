@@ -1,40 +1,81 @@
 #ifndef VOXBLOX_ROS_CONVERSIONS_INL_H_
 #define VOXBLOX_ROS_CONVERSIONS_INL_H_
 
+#include <memory>
 #include <vector>
 
+#include <voxblox/utils/quantized_block_encoding.h>
+
 namespace voxblox {
 
+// Fills in the layer parameters and returns the blocks to serialize.
 template <typename VoxelType>
-void serializeLayerAsMsg(const Layer<VoxelType>& layer, bool only_updated,
-                         voxblox_msgs::Layer* msg) {
+void serializeLayerHeaderAsMsg(const Layer<VoxelType>& layer,
+                               bool only_updated, voxblox_msgs::Layer* msg,
+                               BlockIndexList* block_list) {
   CHECK_NOTNULL(msg);
+  CHECK_NOTNULL(block_list);
   msg->voxels_per_side = layer.voxels_per_side();
   msg->voxel_size = layer.voxel_size();
 
   msg->layer_type = getVoxelType<VoxelType>();
 
-  BlockIndexList block_list;
   if (only_updated) {
-    layer.getAllUpdatedBlocks(&block_list);
+    layer.getAllUpdatedBlocks(block_list);
     msg->action = voxblox_msgs::Layer::ACTION_UPDATE;
   } else {
-    layer.getAllAllocatedBlocks(&block_list);
+    layer.getAllAllocatedBlocks(block_list);
     msg->action = voxblox_msgs::Layer::ACTION_FULL_MAP;
   }
+}
 
-  voxblox_msgs::Block block_msg;
-  msg->blocks.reserve(block_list.size());
-  for (const BlockIndex& index : block_list) {
+template <typename VoxelType>
+void serializeLayerAsMsg(const Layer<VoxelType>& layer, bool only_updated,
+                         voxblox_msgs::Layer* msg) {
+  BlockIndexList block_list;
+  serializeLayerHeaderAsMsg(layer, only_updated, msg, &block_list);
+
+  // Construct all block messages in place and let every block serialize
+  // itself straight into its payload, so the voxel data is never copied.
+  const size_t num_data_packets = layer.voxels_per_side() *
+                                  layer.voxels_per_side() *
+                                  layer.voxels_per_side() *
+                                  Block<VoxelType>::getNumDataPacketsPerVoxel();
+  msg->blocks.clear();
+  msg->blocks.resize(block_list.size());
+  for (size_t i = 0u; i < block_list.size(); ++i) {
+    const BlockIndex& index = block_list[i];
+    voxblox_msgs::Block& block_msg = msg->blocks[i];
     block_msg.x_index = index.x();
     block_msg.y_index = index.y();
     block_msg.z_index = index.z();
 
-    std::vector<uint32_t> data;
-    layer.getBlockByIndex(index).serializeToIntegers(&data);
+    block_msg.encoding = voxblox_msgs::Block::ENCODING_RAW;
+    block_msg.data.resize(num_data_packets);
+    layer.getBlockByIndex(index).serializeToIntegers(block_msg.data.data());
+  }
+}
 
-    block_msg.data = data;
-    msg->blocks.push_back(block_msg);
+template <typename VoxelType>
+void serializeLayerAsQuantizedMsg(const Layer<VoxelType>& layer,
+                                  bool only_updated,
+                                  const utils::QuantizationConfig& config,
+                                  voxblox_msgs::Layer* msg) {
+  BlockIndexList block_list;
+  serializeLayerHeaderAsMsg(layer, only_updated, msg, &block_list);
+
+  msg->blocks.clear();
+  msg->blocks.resize(block_list.size());
+  for (size_t i = 0u; i < block_list.size(); ++i) {
+    const BlockIndex& index = block_list[i];
+    voxblox_msgs::Block& block_msg = msg->blocks[i];
+    block_msg.x_index = index.x();
+    block_msg.y_index = index.y();
+    block_msg.z_index = index.z();
+
+    block_msg.encoding = voxblox_msgs::Block::ENCODING_QUANTIZED_TSDF;
+    utils::encodeQuantizedBlock(layer.getBlockByIndex(index), config,
+                                &block_msg.data);
   }
 }
 
@@ -54,17 +95,62 @@ bool deserializeMsgToLayer(const voxblox_msgs::Layer& msg,
     return false;
   }
 
+  // The payload size is fixed by the layer parameters, reject malformed
+  // messages instead of failing inside the block.
+  const size_t num_data_packets = layer->voxels_per_side() *
+                                  layer->voxels_per_side() *
+                                  layer->voxels_per_side() *
+                                  Block<VoxelType>::getNumDataPacketsPerVoxel();
+  for (const voxblox_msgs::Block& block_msg : msg.blocks) {
+    if (block_msg.encoding == voxblox_msgs::Block::ENCODING_RAW) {
+      if (block_msg.data.size() != num_data_packets) {
+        return false;
+      }
+    } else if (block_msg.encoding !=
+               voxblox_msgs::Block::ENCODING_QUANTIZED_TSDF) {
+      return false;
+    }
+  }
+
+  // Decode the quantized payloads into temporary blocks first, so a malformed
+  // message leaves the layer untouched.
+  std::vector<typename Block<VoxelType>::Ptr> decoded_blocks(
+      msg.blocks.size());
+  for (size_t i = 0u; i < msg.blocks.size(); ++i) {
+    const voxblox_msgs::Block& block_msg = msg.blocks[i];
+    if (block_msg.encoding != voxblox_msgs::Block::ENCODING_QUANTIZED_TSDF) {
+      continue;
+    }
+    decoded_blocks[i] = std::make_shared<Block<VoxelType>>(
+        layer->voxels_per_side(), layer->voxel_size(), Point::Zero());
+    if (!utils::decodeQuantizedBlock(block_msg.data.data(),
+                                     block_msg.data.size(),
+                                     decoded_blocks[i].get())) {
+      return false;
+    }
+  }
+
   // TODO(helenol): For now treat both actions the same. In the future should
   // clear the map for ACTION_FULL_MAP.
-  for (const voxblox_msgs::Block& block_msg : msg.blocks) {
+  for (size_t i = 0u; i < msg.blocks.size(); ++i) {
+    const voxblox_msgs::Block& block_msg = msg.blocks[i];
     // Create a new block if it doesn't exist yet, or get the existing one
     // at the correct block index.
     BlockIndex index(block_msg.x_index, block_msg.y_index, block_msg.z_index);
     typename Block<VoxelType>::Ptr block_ptr =
         layer->allocateBlockPtrByIndex(index);
 
-    std::vector<uint32_t> data = block_msg.data;
-    block_ptr->deserializeFromIntegers(data);
+    if (decoded_blocks[i]) {
+      for (size_t voxel_idx = 0u; voxel_idx < block_ptr->num_voxels();
+           ++voxel_idx) {
+        block_ptr->getVoxelByLinearIndex(voxel_idx) =
+            decoded_blocks[i]->getVoxelByLinearIndex(voxel_idx);
+      }
+    } else {
+      // Decode straight from the message payload.
+      block_ptr->deserializeFromIntegers(block_msg.data.data(),
+                                         block_msg.data.size());
+    }
   }
 
   return true;
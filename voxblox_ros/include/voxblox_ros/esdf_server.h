@@ -3,6 +3,7 @@
 
 #include <voxblox/core/esdf_map.h>
 #include <voxblox/integrator/esdf_integrator.h>
+#include <voxblox/integrator/esdf_window_integrator.h>
 #include <voxblox_msgs/Layer.h>
 
 #include "voxblox_ros/tsdf_server.h"
@@ -26,6 +27,10 @@ class EsdfServer : public TsdfServer {
   void esdfMapCallback(const voxblox_msgs::Layer& layer_msg);
 
   std::shared_ptr<EsdfMap> getEsdfMapPtr() { return esdf_map_; }
+  // Only set in local window mode, nullptr otherwise.
+  const EsdfWindowIntegrator* getEsdfWindowPtr() const {
+    return esdf_window_integrator_.get();
+  }
 
  protected:
   // Publish markers for visualization.
@@ -43,9 +48,16 @@ class EsdfServer : public TsdfServer {
 
   bool clear_sphere_for_planning_;
 
+  // In local window mode, only the ESDF of a window around the last robot
+  // position is updated, instead of the ESDF map.
+  bool local_window_;
+  bool robot_position_received_;
+  Point robot_position_;
+
   // ESDF maps.
   std::shared_ptr<EsdfMap> esdf_map_;
   std::unique_ptr<EsdfIntegrator> esdf_integrator_;
+  std::unique_ptr<EsdfWindowIntegrator> esdf_window_integrator_;
 };
 
 }  // namespace voxblox
@@ -25,6 +25,7 @@
 #define VOXBLOX_ROS_MESH_VIS_H_
 
 #include <algorithm>
+#include <vector>
 #include <visualization_msgs/Marker.h>
 #include <eigen_conversions/eigen_msg.h>
 
@@ -82,9 +83,50 @@ inline void heightColorFromVertex(const Point& vertex,
   colorVoxbloxToMsg(rainbowColorMap(mapped_height), color_msg);
 }
 
-inline void fillMarkerWithMesh(const MeshLayer::ConstPtr& mesh_layer,
-                        ColorMode color_mode,
-                        visualization_msgs::Marker* marker) {
+// Appends the triangles of a mesh to a triangle list marker.
+inline void appendMeshToMarker(const Mesh& mesh, ColorMode color_mode,
+                               visualization_msgs::Marker* marker) {
+  CHECK_NOTNULL(marker);
+  if (!mesh.hasVertices()) {
+    return;
+  }
+  // Check that we can actually do the color stuff.
+  if (color_mode == kColor) {
+    CHECK(mesh.hasColors());
+  }
+  if (color_mode == kNormals || color_mode == kLambert) {
+    CHECK(mesh.hasNormals());
+  }
+
+  // Triangle lists can not share vertices, so expand indexed meshes.
+  for (const VertexIndex i : mesh.indices) {
+    geometry_msgs::Point point_msg;
+    tf::pointEigenToMsg(mesh.vertices[i].cast<double>(), point_msg);
+    marker->points.push_back(point_msg);
+    std_msgs::ColorRGBA color_msg;
+    switch (color_mode) {
+      case kColor:
+        colorVoxbloxToMsg(mesh.colors[i], &color_msg);
+        break;
+      case kHeight:
+        heightColorFromVertex(mesh.vertices[i], &color_msg);
+        break;
+      case kNormals:
+        normalColorFromNormal(mesh.normals[i], &color_msg);
+        break;
+      case kLambert:
+        lambertColorFromNormal(mesh.normals[i], &color_msg);
+        break;
+      case kGray:
+        color_msg.r = color_msg.g = color_msg.b = 0.5;
+        break;
+    }
+    color_msg.a = 1.0;
+    marker->colors.push_back(color_msg);
+  }
+}
+
+inline void initializeMeshMarker(visualization_msgs::Marker* marker) {
   CHECK_NOTNULL(marker);
   marker->header.stamp = ros::Time::now();
   marker->ns = "mesh";
@@ -96,49 +138,34 @@ inline void fillMarkerWithMesh(const MeshLayer::ConstPtr& mesh_layer,
   marker->pose.orientation.z = 0;
   marker->pose.orientation.w = 1;
   marker->type = visualization_msgs::Marker::TRIANGLE_LIST;
+}
+
+inline void fillMarkerWithMesh(const MeshLayer::ConstPtr& mesh_layer,
+                        ColorMode color_mode,
+                        visualization_msgs::Marker* marker) {
+  initializeMeshMarker(marker);
 
   BlockIndexList mesh_indices;
   mesh_layer->getAllAllocatedMeshes(&mesh_indices);
 
   for (const BlockIndex& block_index : mesh_indices) {
-    Mesh::ConstPtr mesh = mesh_layer->getMeshPtrByIndex(block_index);
-
-    if (!mesh->hasVertices()) {
-      continue;
-    }
-    // Check that we can actually do the color stuff.
-    if (color_mode == kColor) {
-      CHECK(mesh->hasColors());
-    }
-    if (color_mode == kNormals || color_mode == kLambert) {
-      CHECK(mesh->hasNormals());
-    }
+    appendMeshToMarker(*mesh_layer->getMeshPtrByIndex(block_index), color_mode,
+                       marker);
+  }
+}
 
-    for (size_t i = 0u; i < mesh->vertices.size(); i++) {
-      geometry_msgs::Point point_msg;
-      tf::pointEigenToMsg(mesh->vertices[i].cast<double>(), point_msg);
-      marker->points.push_back(point_msg);
-      std_msgs::ColorRGBA color_msg;
-      switch (color_mode) {
-        case kColor:
-          colorVoxbloxToMsg(mesh->colors[i], &color_msg);
-          break;
-        case kHeight:
-          heightColorFromVertex(mesh->vertices[i], &color_msg);
-          break;
-        case kNormals:
-          normalColorFromNormal(mesh->normals[i], &color_msg);
-          break;
-        case kLambert:
-          lambertColorFromNormal(mesh->normals[i], &color_msg);
-          break;
-        case kGray:
-          color_msg.r = color_msg.g = color_msg.b = 0.5;
-          break;
-      }
-      color_msg.a = 1.0;
-      marker->colors.push_back(color_msg);
-    }
+// Same as above, but uses the coarser levels of detail of the mesh for the
+// blocks far away from the viewpoint, see MeshLayer::selectLod.
+inline void fillMarkerWithMesh(const MeshLayer::ConstPtr& mesh_layer,
+                               ColorMode color_mode, const Point& viewpoint,
+                               const std::vector<FloatingPoint>& lod_distances,
+                               visualization_msgs::Marker* marker) {
+  initializeMeshMarker(marker);
+
+  std::vector<Mesh::ConstPtr> meshes;
+  mesh_layer->getMeshesForViewpoint(viewpoint, lod_distances, &meshes);
+  for (const Mesh::ConstPtr& mesh : meshes) {
+    appendMeshToMarker(*mesh, color_mode, marker);
   }
 }
 
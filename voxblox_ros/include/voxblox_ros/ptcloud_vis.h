@@ -3,6 +3,7 @@
 
 #include <algorithm>
 #include <string>
+#include <thread>
 
 #include <eigen_conversions/eigen_msg.h>
 #include <pcl/point_types.h>
@@ -13,12 +14,15 @@
 #include <voxblox/core/common.h>
 #include <voxblox/core/layer.h>
 #include <voxblox/core/voxel.h>
+#include <voxblox/integrator/esdf_window_integrator.h>
+#include <voxblox/utils/voxel_extraction.h>
 
 #include "voxblox_ros/conversions.h"
 
 // This file contains a set of functions to visualize layers as pointclouds
 // (or marker arrays) based on a passed-in function. It also offers some
-// specializations of functions as samples.
+// specializations of functions as samples. All of them run on the voxel
+// extraction in voxblox/utils/voxel_extraction.h.
 
 namespace voxblox {
 
@@ -43,94 +47,68 @@ template <typename VoxelType>
 using ShouldVisualizeVoxelFunctionType =
     std::function<bool(const VoxelType& voxel, const Point& coord)>;  // NOLINT;
 
-// Template function to visualize a colored pointcloud.
-template <typename VoxelType>
+// Template function to visualize a colored pointcloud. The visibility
+// function can be any callable with the signature of
+// ShouldVisualizeVoxelColorFunctionType, lambdas and functors are inlined into
+// the voxel loop. The blocks are processed by num_threads threads.
+template <typename VoxelType, typename VisFunctionType>
 void createColorPointcloudFromLayer(
-    const Layer<VoxelType>& layer,
-    const ShouldVisualizeVoxelColorFunctionType<VoxelType>& vis_function,
-    pcl::PointCloud<pcl::PointXYZRGB>* pointcloud) {
+    const Layer<VoxelType>& layer, const VisFunctionType& vis_function,
+    pcl::PointCloud<pcl::PointXYZRGB>* pointcloud,
+    size_t num_threads = std::thread::hardware_concurrency()) {
   CHECK_NOTNULL(pointcloud);
-  pointcloud->clear();
-  BlockIndexList blocks;
-  layer.getAllAllocatedBlocks(&blocks);
-
-  // Cache layer settings.
-  size_t vps = layer.voxels_per_side();
-  size_t num_voxels_per_block = vps * vps * vps;
-
-  // Temp variables.
-  Color color;
-  // Iterate over all blocks.
-  for (const BlockIndex& index : blocks) {
-    // Iterate over all voxels in said blocks.
-    const Block<VoxelType>& block = layer.getBlockByIndex(index);
-
-    for (size_t linear_index = 0; linear_index < num_voxels_per_block;
-         ++linear_index) {
-      Point coord = block.computeCoordinatesFromLinearIndex(linear_index);
-      if (vis_function(block.getVoxelByLinearIndex(linear_index), coord,
-                       &color)) {
-        pcl::PointXYZRGB point;
-        point.x = coord.x();
-        point.y = coord.y();
-        point.z = coord.z();
-        point.r = color.r;
-        point.g = color.g;
-        point.b = color.b;
-        pointcloud->push_back(point);
-      }
+  auto extractor = [&vis_function](const VoxelType& voxel, const Point& coord,
+                                   pcl::PointXYZRGB* point) {
+    Color color;
+    if (!vis_function(voxel, coord, &color)) {
+      return false;
     }
-  }
+    point->x = coord.x();
+    point->y = coord.y();
+    point->z = coord.z();
+    point->r = color.r;
+    point->g = color.g;
+    point->b = color.b;
+    return true;
+  };
+  extractVoxelsFromLayer<VoxelType, pcl::PointXYZRGB>(
+      layer, extractor, num_threads, &pointcloud->points);
+  pointcloud->width = pointcloud->points.size();
+  pointcloud->height = 1u;
 }
 
 // Template function to visualize an intensity pointcloud.
-template <typename VoxelType>
+template <typename VoxelType, typename VisFunctionType>
 void createColorPointcloudFromLayer(
-    const Layer<VoxelType>& layer,
-    const ShouldVisualizeVoxelIntensityFunctionType<VoxelType>& vis_function,
-    pcl::PointCloud<pcl::PointXYZI>* pointcloud) {
+    const Layer<VoxelType>& layer, const VisFunctionType& vis_function,
+    pcl::PointCloud<pcl::PointXYZI>* pointcloud,
+    size_t num_threads = std::thread::hardware_concurrency()) {
   CHECK_NOTNULL(pointcloud);
-  pointcloud->clear();
-  BlockIndexList blocks;
-  layer.getAllAllocatedBlocks(&blocks);
-
-  // Cache layer settings.
-  size_t vps = layer.voxels_per_side();
-  size_t num_voxels_per_block = vps * vps * vps;
-
-  // Temp variables.
-  double intensity = 0.0;
-  // Iterate over all blocks.
-  for (const BlockIndex& index : blocks) {
-    // Iterate over all voxels in said blocks.
-    const Block<VoxelType>& block = layer.getBlockByIndex(index);
-
-    for (size_t linear_index = 0; linear_index < num_voxels_per_block;
-         ++linear_index) {
-      Point coord = block.computeCoordinatesFromLinearIndex(linear_index);
-      if (vis_function(block.getVoxelByLinearIndex(linear_index), coord,
-                       &intensity)) {
-        pcl::PointXYZI point;
-        point.x = coord.x();
-        point.y = coord.y();
-        point.z = coord.z();
-        point.intensity = intensity;
-        pointcloud->push_back(point);
-      }
+  auto extractor = [&vis_function](const VoxelType& voxel, const Point& coord,
+                                   pcl::PointXYZI* point) {
+    double intensity = 0.0;
+    if (!vis_function(voxel, coord, &intensity)) {
+      return false;
     }
-  }
+    point->x = coord.x();
+    point->y = coord.y();
+    point->z = coord.z();
+    point->intensity = intensity;
+    return true;
+  };
+  extractVoxelsFromLayer<VoxelType, pcl::PointXYZI>(
+      layer, extractor, num_threads, &pointcloud->points);
+  pointcloud->width = pointcloud->points.size();
+  pointcloud->height = 1u;
 }
 
-template <typename VoxelType>
+template <typename VoxelType, typename VisFunctionType>
 void createOccupancyBlocksFromLayer(
-    const Layer<VoxelType>& layer,
-    const ShouldVisualizeVoxelFunctionType<VoxelType>& vis_function,
-    const std::string& frame_id,
-    visualization_msgs::MarkerArray* marker_array) {
+    const Layer<VoxelType>& layer, const VisFunctionType& vis_function,
+    const std::string& frame_id, visualization_msgs::MarkerArray* marker_array,
+    size_t num_threads = std::thread::hardware_concurrency()) {
   CHECK_NOTNULL(marker_array);
   // Cache layer settings.
-  size_t vps = layer.voxels_per_side();
-  size_t num_voxels_per_block = vps * vps * vps;
   FloatingPoint voxel_size = layer.voxel_size();
 
   visualization_msgs::Marker block_marker;
@@ -142,26 +120,29 @@ void createOccupancyBlocksFromLayer(
       voxel_size;
   block_marker.action = visualization_msgs::Marker::ADD;
 
-  BlockIndexList blocks;
-  layer.getAllAllocatedBlocks(&blocks);
-  for (const BlockIndex& index : blocks) {
-    // Iterate over all voxels in said blocks.
-    const Block<VoxelType>& block = layer.getBlockByIndex(index);
-
-    for (size_t linear_index = 0; linear_index < num_voxels_per_block;
-         ++linear_index) {
-      Point coord = block.computeCoordinatesFromLinearIndex(linear_index);
-      if (vis_function(block.getVoxelByLinearIndex(linear_index), coord)) {
-        geometry_msgs::Point cube_center;
-        cube_center.x = coord.x();
-        cube_center.y = coord.y();
-        cube_center.z = coord.z();
-        block_marker.points.push_back(cube_center);
-        std_msgs::ColorRGBA color_msg;
-        colorVoxbloxToMsg(rainbowColorMap((coord.z() + 2.5) / 5.0), &color_msg);
-        block_marker.colors.push_back(color_msg);
-      }
+  auto extractor = [&vis_function](const VoxelType& voxel, const Point& coord,
+                                   Point* point) {
+    if (!vis_function(voxel, coord)) {
+      return false;
     }
+    *point = coord;
+    return true;
+  };
+  Pointcloud cube_centers;
+  extractVoxelsFromLayer<VoxelType, Point>(layer, extractor, num_threads,
+                                           &cube_centers);
+
+  block_marker.points.reserve(cube_centers.size());
+  block_marker.colors.reserve(cube_centers.size());
+  for (const Point& coord : cube_centers) {
+    geometry_msgs::Point cube_center;
+    cube_center.x = coord.x();
+    cube_center.y = coord.y();
+    cube_center.z = coord.z();
+    block_marker.points.push_back(cube_center);
+    std_msgs::ColorRGBA color_msg;
+    colorVoxbloxToMsg(rainbowColorMap((coord.z() + 2.5) / 5.0), &color_msg);
+    block_marker.colors.push_back(color_msg);
   }
   marker_array->markers.push_back(block_marker);
 }
@@ -249,8 +230,12 @@ inline void createSurfacePointcloudFromTsdfLayer(
     const Layer<TsdfVoxel>& layer, double surface_distance,
     pcl::PointCloud<pcl::PointXYZRGB>* pointcloud) {
   createColorPointcloudFromLayer<TsdfVoxel>(
-      layer, std::bind(&visualizeNearSurfaceTsdfVoxels, ph::_1, ph::_2,
-                       surface_distance, ph::_3),
+      layer,
+      [surface_distance](const TsdfVoxel& voxel, const Point& coord,
+                         Color* color) {
+        return visualizeNearSurfaceTsdfVoxels(voxel, coord, surface_distance,
+                                              color);
+      },
       pointcloud);
 }
 
@@ -258,48 +243,103 @@ inline void createDistancePointcloudFromTsdfLayer(
     const Layer<TsdfVoxel>& layer,
     pcl::PointCloud<pcl::PointXYZI>* pointcloud) {
   createColorPointcloudFromLayer<TsdfVoxel>(
-      layer, &visualizeDistanceIntensityTsdfVoxels, pointcloud);
+      layer,
+      [](const TsdfVoxel& voxel, const Point& coord, double* intensity) {
+        return visualizeDistanceIntensityTsdfVoxels(voxel, coord, intensity);
+      },
+      pointcloud);
 }
 
 inline void createDistancePointcloudFromEsdfLayer(
     const Layer<EsdfVoxel>& layer,
     pcl::PointCloud<pcl::PointXYZI>* pointcloud) {
   createColorPointcloudFromLayer<EsdfVoxel>(
-      layer, &visualizeDistanceIntensityEsdfVoxels, pointcloud);
+      layer,
+      [](const EsdfVoxel& voxel, const Point& coord, double* intensity) {
+        return visualizeDistanceIntensityEsdfVoxels(voxel, coord, intensity);
+      },
+      pointcloud);
+}
+
+// Points of all observed voxels of a local ESDF window.
+inline void createDistancePointcloudFromEsdfWindow(
+    const EsdfWindowIntegrator& window,
+    pcl::PointCloud<pcl::PointXYZI>* pointcloud) {
+  DCHECK_NOTNULL(pointcloud);
+  pointcloud->clear();
+  const int voxels_per_side = window.getWindowVoxelsPerSide();
+  AnyIndex index;
+  for (index.z() = 0; index.z() < voxels_per_side; ++index.z()) {
+    for (index.y() = 0; index.y() < voxels_per_side; ++index.y()) {
+      for (index.x() = 0; index.x() < voxels_per_side; ++index.x()) {
+        const AnyIndex global_index = window.getWindowOrigin() + index;
+        const EsdfVoxel* voxel = window.getVoxelPtrByGlobalIndex(global_index);
+        if (!voxel->observed) {
+          continue;
+        }
+        const Point coord =
+            getCenterPointFromGridIndex(global_index, window.voxel_size());
+        pcl::PointXYZI point;
+        point.x = coord.x();
+        point.y = coord.y();
+        point.z = coord.z();
+        point.intensity = voxel->distance;
+        pointcloud->push_back(point);
+      }
+    }
+  }
 }
 
 inline void createDistancePointcloudFromTsdfLayerSlice(
     const Layer<TsdfVoxel>& layer, unsigned int free_plane_index,
     FloatingPoint free_plane_val, pcl::PointCloud<pcl::PointXYZI>* pointcloud) {
+  const FloatingPoint voxel_size = layer.voxel_size();
   createColorPointcloudFromLayer<TsdfVoxel>(
       layer,
-      std::bind(&visualizeDistanceIntensityTsdfVoxelsSlice, ph::_1, ph::_2,
-                free_plane_index, free_plane_val, layer.voxel_size(), ph::_3),
+      [free_plane_index, free_plane_val, voxel_size](
+          const TsdfVoxel& voxel, const Point& coord, double* intensity) {
+        return visualizeDistanceIntensityTsdfVoxelsSlice(
+            voxel, coord, free_plane_index, free_plane_val, voxel_size,
+            intensity);
+      },
       pointcloud);
 }
 
 inline void createDistancePointcloudFromEsdfLayerSlice(
     const Layer<EsdfVoxel>& layer, unsigned int free_plane_index,
     FloatingPoint free_plane_val, pcl::PointCloud<pcl::PointXYZI>* pointcloud) {
+  const FloatingPoint voxel_size = layer.voxel_size();
   createColorPointcloudFromLayer<EsdfVoxel>(
       layer,
-      std::bind(&visualizeDistanceIntensityEsdfVoxelsSlice, ph::_1, ph::_2,
-                free_plane_index, free_plane_val, layer.voxel_size(), ph::_3),
+      [free_plane_index, free_plane_val, voxel_size](
+          const EsdfVoxel& voxel, const Point& coord, double* intensity) {
+        return visualizeDistanceIntensityEsdfVoxelsSlice(
+            voxel, coord, free_plane_index, free_plane_val, voxel_size,
+            intensity);
+      },
       pointcloud);
 }
 
 inline void createOccupancyBlocksFromTsdfLayer(
     const Layer<TsdfVoxel>& layer, const std::string& frame_id,
     visualization_msgs::MarkerArray* marker_array) {
-  createOccupancyBlocksFromLayer<TsdfVoxel>(layer, &visualizeOccupiedTsdfVoxels,
-                                            frame_id, marker_array);
+  createOccupancyBlocksFromLayer<TsdfVoxel>(
+      layer,
+      [](const TsdfVoxel& voxel, const Point& coord) {
+        return visualizeOccupiedTsdfVoxels(voxel, coord);
+      },
+      frame_id, marker_array);
 }
 
 inline void createOccupancyBlocksFromOccupancyLayer(
     const Layer<OccupancyVoxel>& layer, const std::string& frame_id,
     visualization_msgs::MarkerArray* marker_array) {
   createOccupancyBlocksFromLayer<OccupancyVoxel>(
-      layer, &visualizeOccupiedOccupancyVoxels, frame_id, marker_array);
+      layer,
+      [](const OccupancyVoxel& voxel, const Point& coord) {
+        return visualizeOccupiedOccupancyVoxels(voxel, coord);
+      },
+      frame_id, marker_array);
 }
 
 }  // namespace voxblox
@@ -10,13 +10,14 @@
 #include <sensor_msgs/PointCloud2.h>
 #include <std_srvs/Empty.h>
 #include <string>
+#include <vector>
 #include <visualization_msgs/MarkerArray.h>
 
 #include <voxblox/core/tsdf_map.h>
 #include <voxblox/integrator/tsdf_integrator.h>
 #include <voxblox/io/layer_io.h>
 #include <voxblox/io/mesh_ply.h>
-#include <voxblox/mesh/mesh_integrator.h>
+#include <voxblox/mesh/lod_mesh_integrator.h>
 
 #include <voxblox_msgs/FilePath.h>
 #include "voxblox_ros/mesh_vis.h"
@@ -71,6 +72,10 @@ class TsdfServer {
   std::string mesh_filename_;
   // How to color the mesh.
   ColorMode color_mode_;
+  // If the mesh has several levels of detail, level i is published for the
+  // blocks within mesh_lod_distances_[i] of the last sensor position.
+  std::vector<FloatingPoint> mesh_lod_distances_;
+  Point mesh_viewpoint_;
 
   // Keep track of these for throttling.
   ros::Duration min_time_between_msgs_;
@@ -100,7 +105,7 @@ class TsdfServer {
 
   // Mesh accessories.
   std::shared_ptr<MeshLayer> mesh_layer_;
-  std::unique_ptr<MeshIntegrator> mesh_integrator_;
+  std::unique_ptr<LodMeshIntegrator> mesh_integrator_;
 
   // Transformer object to keep track of either TF transforms or messages from
   // a transform topic.
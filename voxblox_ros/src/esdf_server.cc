@@ -6,7 +6,11 @@ namespace voxblox {
 
 EsdfServer::EsdfServer(const ros::NodeHandle& nh,
                        const ros::NodeHandle& nh_private)
-    : TsdfServer(nh, nh_private), clear_sphere_for_planning_(false) {
+    : TsdfServer(nh, nh_private),
+      clear_sphere_for_planning_(false),
+      local_window_(false),
+      robot_position_received_(false),
+      robot_position_(Point::Zero()) {
   esdf_pointcloud_pub_ =
       nh_private_.advertise<pcl::PointCloud<pcl::PointXYZI> >("esdf_pointcloud",
                                                               1, true);
@@ -43,11 +47,42 @@ EsdfServer::EsdfServer(const ros::NodeHandle& nh,
   nh_private_.param("esdf_default_distance_m",
                     esdf_integrator_config.default_distance_m,
                     esdf_integrator_config.default_distance_m);
+  int esdf_integrator_threads = esdf_integrator_config.integrator_threads;
+  nh_private_.param("esdf_integrator_threads", esdf_integrator_threads,
+                    esdf_integrator_threads);
+  if (esdf_integrator_threads < 1) {
+    ROS_WARN_STREAM("Invalid esdf_integrator_threads: "
+                    << esdf_integrator_threads << ", using 1 thread.");
+    esdf_integrator_threads = 1;
+  }
+  esdf_integrator_config.integrator_threads = esdf_integrator_threads;
+  nh_private_.param("esdf_parallel_incremental_update",
+                    esdf_integrator_config.parallel_incremental_update,
+                    esdf_integrator_config.parallel_incremental_update);
+  nh_private_.param("esdf_full_euclidean_distance",
+                    esdf_integrator_config.full_euclidean_distance,
+                    esdf_integrator_config.full_euclidean_distance);
 
   esdf_integrator_.reset(new EsdfIntegrator(esdf_integrator_config,
                                             tsdf_map_->getTsdfLayerPtr(),
                                             esdf_map_->getEsdfLayerPtr()));
 
+  // Whether to only keep the ESDF of a window around the robot, for local
+  // planners.
+  nh_private_.param("esdf_local_window", local_window_, local_window_);
+  if (local_window_) {
+    EsdfWindowIntegrator::Config esdf_window_config;
+    esdf_window_config.min_distance_m = esdf_integrator_config.min_distance_m;
+    esdf_window_config.max_distance_m = esdf_integrator_config.max_distance_m;
+    esdf_window_config.default_distance_m =
+        esdf_integrator_config.default_distance_m;
+    nh_private_.param("esdf_local_window_radius_m",
+                      esdf_window_config.radius_m,
+                      esdf_window_config.radius_m);
+    esdf_window_integrator_.reset(new EsdfWindowIntegrator(
+        esdf_window_config, tsdf_map_->getTsdfLayerPtr()));
+  }
+
   // Whether to clear each new pose as it comes in, and then set a sphere
   // around it to occupied.
   nh_private_.param("clear_sphere_for_planning", clear_sphere_for_planning_,
@@ -58,7 +93,13 @@ void EsdfServer::publishAllUpdatedEsdfVoxels() {
   // Create a pointcloud with distance = intensity.
   pcl::PointCloud<pcl::PointXYZI> pointcloud;
 
-  createDistancePointcloudFromEsdfLayer(esdf_map_->getEsdfLayer(), &pointcloud);
+  if (local_window_) {
+    createDistancePointcloudFromEsdfWindow(*esdf_window_integrator_,
+                                           &pointcloud);
+  } else {
+    createDistancePointcloudFromEsdfLayer(esdf_map_->getEsdfLayer(),
+                                          &pointcloud);
+  }
 
   pointcloud.header.frame_id = world_frame_;
   esdf_pointcloud_pub_.publish(pointcloud);
@@ -94,7 +135,11 @@ bool EsdfServer::generateEsdfCallback(
 
 void EsdfServer::updateMeshEvent(const ros::TimerEvent& event) {
   // Also update the ESDF now, if there's any blocks in the TSDF.
-  if (tsdf_map_->getTsdfLayer().getNumberOfAllocatedBlocks() > 0) {
+  if (local_window_) {
+    if (robot_position_received_) {
+      esdf_window_integrator_->updateFromTsdfLayer(robot_position_);
+    }
+  } else if (tsdf_map_->getTsdfLayer().getNumberOfAllocatedBlocks() > 0) {
     const bool clear_updated_flag_esdf = false;
     esdf_integrator_->updateFromTsdfLayer(clear_updated_flag_esdf);
   }
@@ -113,7 +158,11 @@ void EsdfServer::updateMeshEvent(const ros::TimerEvent& event) {
 }
 
 void EsdfServer::newPoseCallback(const Transformation& T_G_C) {
-  if (clear_sphere_for_planning_) {
+  robot_position_ = T_G_C.getPosition();
+  robot_position_received_ = true;
+  // The global integrator is not run in local window mode, so it would only
+  // accumulate the queued sphere updates.
+  if (clear_sphere_for_planning_ && !local_window_) {
     esdf_integrator_->addNewRobotPosition(T_G_C.getPosition());
   }
 }
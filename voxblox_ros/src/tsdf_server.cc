@@ -113,11 +113,39 @@ TsdfServer::TsdfServer(const ros::NodeHandle& nh,
   MeshIntegrator::Config mesh_config;
   nh_private_.param("mesh_min_weight", mesh_config.min_weight,
                     mesh_config.min_weight);
+  int mesh_integrator_threads = mesh_config.integrator_threads;
+  nh_private_.param("mesh_integrator_threads", mesh_integrator_threads,
+                    mesh_integrator_threads);
+  if (mesh_integrator_threads < 1) {
+    ROS_WARN_STREAM("Invalid mesh_integrator_threads: "
+                    << mesh_integrator_threads << ", using 1 thread.");
+    mesh_integrator_threads = 1;
+  }
+  mesh_config.integrator_threads = mesh_integrator_threads;
+  nh_private_.param("mesh_use_indexed", mesh_config.use_indexed_mesh,
+                    mesh_config.use_indexed_mesh);
+  nh_private_.param("mesh_sub_cell_updates", mesh_config.use_sub_cell_updates,
+                    mesh_config.use_sub_cell_updates);
+  nh_private_.param("mesh_dual_contouring", mesh_config.use_dual_contouring,
+                    mesh_config.use_dual_contouring);
+
+  // Levels of detail of the mesh, each one with half the resolution of the
+  // previous one.
+  LodMeshIntegrator::Config lod_mesh_config;
+  lod_mesh_config.mesh_config = mesh_config;
+  int mesh_lod_levels = 1;
+  nh_private_.param("mesh_lod_levels", mesh_lod_levels, mesh_lod_levels);
+  lod_mesh_config.num_lods = std::max(mesh_lod_levels, 1);
+  std::vector<double> mesh_lod_distances;
+  nh_private_.getParam("mesh_lod_distances", mesh_lod_distances);
+  mesh_lod_distances_.assign(mesh_lod_distances.begin(),
+                             mesh_lod_distances.end());
+  mesh_viewpoint_ = Point::Zero();
 
   mesh_layer_.reset(new MeshLayer(tsdf_map_->block_size()));
 
-  mesh_integrator_.reset(new MeshIntegrator(
-      mesh_config, tsdf_map_->getTsdfLayerPtr(), mesh_layer_.get()));
+  mesh_integrator_.reset(new LodMeshIntegrator(
+      lod_mesh_config, tsdf_map_->getTsdfLayerPtr(), mesh_layer_.get()));
 
   // Advertise services.
   generate_mesh_srv_ = nh_private_.advertiseService(
@@ -213,6 +241,8 @@ void TsdfServer::insertPointcloud(
     publishTsdfOccupiedNodes();
     publishSlices();
 
+    mesh_viewpoint_ = T_G_C.getPosition();
+
     // Callback for inheriting classes.
     newPoseCallback(T_G_C);
 
@@ -278,7 +308,8 @@ bool TsdfServer::generateMeshCallback(
   timing::Timer publish_mesh_timer("mesh/publish");
   visualization_msgs::MarkerArray marker_array;
   marker_array.markers.resize(1);
-  fillMarkerWithMesh(mesh_layer_, color_mode_, &marker_array.markers[0]);
+  fillMarkerWithMesh(mesh_layer_, color_mode_, mesh_viewpoint_,
+                     mesh_lod_distances_, &marker_array.markers[0]);
   marker_array.markers[0].header.frame_id = world_frame_;
   mesh_pub_.publish(marker_array);
   publish_mesh_timer.Stop();
@@ -328,7 +359,8 @@ void TsdfServer::updateMeshEvent(const ros::TimerEvent& event) {
   timing::Timer publish_mesh_timer("mesh/publish");
   visualization_msgs::MarkerArray marker_array;
   marker_array.markers.resize(1);
-  fillMarkerWithMesh(mesh_layer_, color_mode_, &marker_array.markers[0]);
+  fillMarkerWithMesh(mesh_layer_, color_mode_, mesh_viewpoint_,
+                     mesh_lod_distances_, &marker_array.markers[0]);
   marker_array.markers[0].header.frame_id = world_frame_;
   mesh_pub_.publish(marker_array);
   publish_mesh_timer.Stop();